@@ -383,6 +383,7 @@ impl Default for audio_dev_debug_info {
             longest_wake_nsec: 0,
             software_gain_scaler: 0.0,
             dev_idx: 0,
+            silent_frames_skipped: 0,
         }
     }
 }
@@ -412,6 +413,7 @@ pub struct AudioDevDebugInfo {
     )]
     pub longest_wake: Duration,
     pub software_gain_scaler: f64,
+    pub silent_frames_skipped: u64,
 }
 
 impl From<audio_dev_debug_info> for AudioDevDebugInfo {
@@ -433,6 +435,7 @@ impl From<audio_dev_debug_info> for AudioDevDebugInfo {
             runtime: Duration::new(info.runtime_sec.into(), info.runtime_nsec),
             longest_wake: Duration::new(info.longest_wake_sec.into(), info.longest_wake_nsec),
             software_gain_scaler: info.software_gain_scaler,
+            silent_frames_skipped: info.silent_frames_skipped,
         }
     }
 }
@@ -459,6 +462,7 @@ impl fmt::Display for AudioDevDebugInfo {
         writeln!(f, "  Runtime: {:?}", self.runtime)?;
         writeln!(f, "  Longest wake: {:?}", self.longest_wake)?;
         writeln!(f, "  Software gain scaler: {}", self.software_gain_scaler)?;
+        writeln!(f, "  Silent frames skipped: {}", self.silent_frames_skipped)?;
         Ok(())
     }
 }
@@ -297,6 +297,20 @@ void cras_client_set_connection_status_cb(
 void cras_client_set_thread_priority_cb(struct cras_client* client,
                                         cras_thread_priority_cb_t cb);
 
+/* Services the audio callbacks of the streams of this client from a pool of
+ * shared threads instead of starting a thread per stream. A stream always
+ * stays on the same thread, so its callbacks are run in order. Must be
+ * called before adding streams.
+ * Args:
+ *    client - The client from cras_client_create.
+ *    num_threads - Size of the pool, or 0 for a thread per stream.
+ * Returns:
+ *    0 on success, -EINVAL if num_threads is larger than 8, or -EBUSY if the
+ *    pool has already been started.
+ */
+int cras_client_set_num_callback_threads(struct cras_client* client,
+                                         unsigned int num_threads);
+
 /* Returns the current list of output devices.
  *
  * Requires that the connection to the server has been established.
@@ -600,6 +614,15 @@ void cras_client_stream_params_set_client_type(
     struct cras_stream_params* params,
     enum CRAS_CLIENT_TYPE client_type);
 
+/* Lets the application move samples itself with the begin/commit functions
+ * below instead of having them pulled through the stream callbacks. No audio
+ * thread is started for the stream and the callbacks may be NULL.
+ * Args:
+ *    params - Stream configuration parameters.
+ */
+void cras_client_stream_params_enable_direct_io(
+    struct cras_stream_params* params);
+
 /* Functions to enable or disable specific effect on given stream parameter.
  * Args:
  *    params - Stream configuration parameters.
@@ -708,6 +731,74 @@ int cras_client_add_pinned_stream(struct cras_client* client,
 int cras_client_rm_stream(struct cras_client* client,
                           cras_stream_id_t stream_id);
 
+/* Gets the fd to poll for readability before calling the begin functions
+ * of a stream with direct io enabled.
+ * Args:
+ *    client - Client owning the stream.
+ *    stream_id - ID returned from cras_client_add_stream.
+ * Returns:
+ *    The fd on success, -EINVAL if the stream doesn't use direct io, or
+ *    -EAGAIN if it isn't connected to the server yet.
+ */
+int cras_client_stream_get_poll_fd(struct cras_client* client,
+                                   cras_stream_id_t stream_id);
+
+/* Gets the part of the shm of a direct io playback stream requested by the
+ * server. The application writes up to "frames" frames at "samples" and
+ * hands them over with cras_client_stream_commit_write(). Calling it again
+ * before committing returns the same buffer. The stream must not be removed
+ * while this is in progress.
+ * Args:
+ *    client - Client owning the stream.
+ *    stream_id - ID returned from cras_client_add_stream.
+ *    samples - Filled with the address to write samples to.
+ *    frames - Filled with the number of frames the server asks for.
+ *    ts - Filled with the time the first sample will be played, can be NULL.
+ *    timeout_ms - How long to wait for a request, -1 to block or 0 to return
+ *        at once.
+ * Returns:
+ *    0 on success, -EAGAIN if there is no request yet, -ETIMEDOUT if the
+ *    timeout expired or another negative error code.
+ */
+int cras_client_stream_begin_write(struct cras_client* client,
+                                   cras_stream_id_t stream_id,
+                                   uint8_t** samples,
+                                   unsigned int* frames,
+                                   struct timespec* ts,
+                                   int timeout_ms);
+
+/* Hands "frames" frames written after cras_client_stream_begin_write() to
+ * the server.
+ * Args:
+ *    client - Client owning the stream.
+ *    stream_id - ID returned from cras_client_add_stream.
+ *    frames - Number of frames written, at most the number begun.
+ * Returns:
+ *    0 on success or a negative error code.
+ */
+int cras_client_stream_commit_write(struct cras_client* client,
+                                    cras_stream_id_t stream_id,
+                                    unsigned int frames);
+
+/* Gets the captured samples of a direct io input stream in its shm. Works
+ * like cras_client_stream_begin_write() with "ts" set to the time the first
+ * sample was captured.
+ */
+int cras_client_stream_begin_read(struct cras_client* client,
+                                  cras_stream_id_t stream_id,
+                                  uint8_t** samples,
+                                  unsigned int* frames,
+                                  struct timespec* ts,
+                                  int timeout_ms);
+
+/* Releases "frames" frames read after cras_client_stream_begin_read() back
+ * to the server. The server waits for this reply before it captures more,
+ * so the read is committed even when no frames were used.
+ */
+int cras_client_stream_commit_read(struct cras_client* client,
+                                   cras_stream_id_t stream_id,
+                                   unsigned int frames);
+
 /* Sets the volume scaling factor for the given stream.
  *
  * Requires execution of cras_client_run_thread().
@@ -1376,6 +1467,20 @@ int cras_client_set_num_active_streams_changed_callback(
     struct cras_client* client,
     cras_client_num_active_streams_changed_callback cb);
 
+/* Set the minimum time between state change callbacks. Changes within the
+ * interval are coalesced by the server, keeping the last value of each, and
+ * delivered together once it has passed. This saves wakeups when the state
+ * changes rapidly, e.g. while the volume slider is dragged.
+ * Args:
+ *    client - The client from cras_client_create.
+ *    interval_ms - The interval in milliseconds, 0 to get every change right
+ *        away, which is the default.
+ * Returns:
+ *    0 for success or negative errno error code on error.
+ */
+int cras_client_set_notification_interval(struct cras_client* client,
+                                          unsigned int interval_ms);
+
 /*
  * The functions below prefixed with libcras wrap the original CRAS library
  * They provide an interface that maps the pointers to the functions above.
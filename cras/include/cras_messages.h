@@ -9,14 +9,17 @@
 #ifndef CRAS_INCLUDE_CRAS_MESSAGES_H_
 #define CRAS_INCLUDE_CRAS_MESSAGES_H_
 
+#include <errno.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "cras_iodev_info.h"
 #include "cras_types.h"
 
 /* Rev when message format changes. If new messages are added, or message ID
  * values change. */
-#define CRAS_PROTO_VER 7
+#define CRAS_PROTO_VER 8
 #define CRAS_SERV_MAX_MSG_SIZE 256
 #define CRAS_CLIENT_MAX_MSG_SIZE 256
 #define CRAS_MAX_HOTWORD_MODELS 243
@@ -60,6 +63,7 @@ enum CRAS_SERVER_MESSAGE_ID {
   CRAS_SERVER_DUMP_MAIN,
   CRAS_SERVER_SET_AEC_REF,
   CRAS_SERVER_REQUEST_FLOOP,
+  CRAS_SERVER_SET_NOTIFICATION_INTERVAL,
 };
 
 enum CRAS_CLIENT_MESSAGE_ID {
@@ -82,6 +86,7 @@ enum CRAS_CLIENT_MESSAGE_ID {
   // Server -> Client
   CRAS_CLIENT_ATLOG_FD_READY,
   CRAS_CLIENT_REQUEST_FLOOP_READY,
+  CRAS_CLIENT_NOTIFICATIONS,
 };
 
 /* Messages that control the server. These are sent from the client to affect
@@ -515,6 +520,22 @@ static inline void cras_fill_request_floop(
   m->tag = (uintptr_t)tag;
 }
 
+/* Sets the minimum time between notifications sent to the client. Changes
+ * within the interval are coalesced, keeping the last value of each, and sent
+ * together in a CRAS_CLIENT_NOTIFICATIONS message. 0 sends every notification
+ * on its own as soon as it happens, which is the default. */
+struct __attribute__((__packed__)) cras_set_notification_interval {
+  struct cras_server_message header;
+  uint32_t interval_ms;
+};
+static inline void cras_fill_set_notification_interval(
+    struct cras_set_notification_interval* m,
+    uint32_t interval_ms) {
+  m->header.id = CRAS_SERVER_SET_NOTIFICATION_INTERVAL;
+  m->header.length = sizeof(*m);
+  m->interval_ms = interval_ms;
+}
+
 /*
  * Messages sent from server to client.
  */
@@ -743,6 +764,35 @@ static inline void cras_fill_client_request_floop_ready(
   m->tag = tag;
 }
 
+/* Several notifications in one message. data holds num_notifications
+ * notification messages back to back, each starting with its header. Only
+ * header.length bytes are sent. */
+struct __attribute__((__packed__)) cras_client_notifications {
+  struct cras_client_message header;
+  uint32_t num_notifications;
+  uint8_t data[CRAS_CLIENT_MAX_MSG_SIZE - sizeof(struct cras_client_message) -
+               sizeof(uint32_t)];
+};
+static inline void cras_fill_client_notifications(
+    struct cras_client_notifications* m) {
+  m->header.id = CRAS_CLIENT_NOTIFICATIONS;
+  m->header.length = offsetof(struct cras_client_notifications, data);
+  m->num_notifications = 0;
+}
+/* Appends a notification message to m. Returns 0 on success or -ENOSPC if it
+ * doesn't fit. */
+static inline int cras_client_notifications_add(
+    struct cras_client_notifications* m,
+    const struct cras_client_message* notification) {
+  if (m->header.length + notification->length > sizeof(*m)) {
+    return -ENOSPC;
+  }
+  memcpy((uint8_t*)m + m->header.length, notification, notification->length);
+  m->header.length += notification->length;
+  m->num_notifications++;
+  return 0;
+}
+
 /*
  * Messages specific to passing audio between client and server
  */
@@ -72,6 +72,22 @@ struct __attribute__((__packed__)) cras_audio_shm_header {
   // Only applies to output streams, always 0 for input streams.
   // The value is cumulative.
   struct cras_timespec underrun_duration;
+  // The fields below are only used by streams connected with SHM_DOORBELL,
+  // which exchange audio requests and replies through this header instead
+  // of writing audio_messages to the stream socket. They stay 4 byte
+  // aligned because the doorbell is used as a futex.
+  // Futex word the client sleeps on. Bumped by the server on every
+  // request and by the client to wake its own audio thread.
+  uint32_t doorbell;
+  // Incremented by the server for each audio request (output) or data
+  // ready (input) notification.
+  uint32_t request_seq;
+  // Number of frames requested or ready with the latest request_seq.
+  uint32_t request_frames;
+  // Incremented by the client for each reply.
+  uint32_t reply_seq;
+  // Negative error code sent with the latest reply_seq, or 0.
+  int32_t reply_error;
 };
 
 // Returns the number of bytes needed to hold a cras_audio_shm_header.
@@ -542,6 +558,43 @@ static inline int cras_shm_callback_pending(const struct cras_audio_shm* shm) {
   return shm->header->callback_pending;
 }
 
+// Returns the current value of the doorbell futex word.
+static inline uint32_t cras_shm_get_doorbell(const struct cras_audio_shm* shm) {
+  return __atomic_load_n(&shm->header->doorbell, __ATOMIC_ACQUIRE);
+}
+
+// Returns the sequence number of the latest request posted by the server.
+static inline uint32_t cras_shm_get_request_seq(
+    const struct cras_audio_shm* shm) {
+  return __atomic_load_n(&shm->header->request_seq, __ATOMIC_ACQUIRE);
+}
+
+// Returns the number of frames of the latest request posted by the server.
+static inline uint32_t cras_shm_get_request_frames(
+    const struct cras_audio_shm* shm) {
+  return shm->header->request_frames;
+}
+
+// Returns the sequence number of the latest reply posted by the client.
+static inline uint32_t cras_shm_get_reply_seq(
+    const struct cras_audio_shm* shm) {
+  return __atomic_load_n(&shm->header->reply_seq, __ATOMIC_ACQUIRE);
+}
+
+// Returns the error code of the latest reply posted by the client.
+static inline int32_t cras_shm_get_reply_error(
+    const struct cras_audio_shm* shm) {
+  return shm->header->reply_error;
+}
+
+/* Posts a reply to the latest request. The caller is responsible for waking
+ * the server through the stream doorbell fd. */
+static inline void cras_shm_post_reply(struct cras_audio_shm* shm,
+                                       int32_t error) {
+  shm->header->reply_error = error;
+  __atomic_add_fetch(&shm->header->reply_seq, 1, __ATOMIC_RELEASE);
+}
+
 // Sets the starting offset of a buffer
 static inline void cras_shm_set_buffer_offset(struct cras_audio_shm* shm,
                                               uint32_t buf_idx,
@@ -664,6 +717,38 @@ int cras_shm_reopen_ro(const char* name, int fd);
  */
 void cras_shm_close_unlink(const char* name, int fd);
 
+/*
+ * Posts an audio request of the given number of frames to the client and
+ * rings the doorbell. Only valid for streams connected with SHM_DOORBELL.
+ * Args:
+ *    shm - The shm region of the stream.
+ *    frames - Frames requested for output, or ready for input.
+ * Returns:
+ *    0 on success, or negative error code if waking the client failed.
+ */
+int cras_shm_post_request(struct cras_audio_shm* shm, uint32_t frames);
+
+/*
+ * Bumps the doorbell and wakes the thread sleeping on it, if any.
+ * Args:
+ *    shm - The shm region of the stream.
+ * Returns:
+ *    0 on success, or negative error code.
+ */
+int cras_shm_ring_doorbell(struct cras_audio_shm* shm);
+
+/*
+ * Sleeps until the doorbell is rung. Returns immediately if the doorbell
+ * has already moved past the given value.
+ * Args:
+ *    shm - The shm region of the stream.
+ *    doorbell - The value returned by cras_shm_get_doorbell() before the
+ *        caller checked for pending work.
+ * Returns:
+ *    0 when woken or the doorbell had already moved, or negative error code.
+ */
+int cras_shm_wait_doorbell(struct cras_audio_shm* shm, uint32_t doorbell);
+
 /*
  * Configure shared memory for the system state.
  * Args:
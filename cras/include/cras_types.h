@@ -114,6 +114,10 @@ enum CRAS_INPUT_STREAM_FLAG {
   // This stream doesn't associate to a client. It's used mainly
   // for audio data to flow from hardware through iodev's dsp pipeline.
   SERVER_ONLY = 0x08,
+  // Exchange audio requests and replies through the shm header and a
+  // doorbell instead of the stream socket. Set by the client at connect
+  // time, honored only if the server replies with a doorbell fd.
+  SHM_DOORBELL = 0x10,
 };
 
 /*
@@ -267,6 +271,9 @@ static inline uint32_t node_index_of(cras_node_id_t id) {
 #define CRAS_MAX_IONODES 20
 #define CRAS_MAX_ATTACHED_CLIENTS 20
 #define CRAS_MAX_AUDIO_THREAD_SNAPSHOTS 10
+/* Most audio threads run by the server. The shared memory of the audio thread
+ * log holds one event log per thread, the primary thread's first. */
+#define CRAS_MAX_AUDIO_THREADS 3
 #define CRAS_MAX_HOTWORD_MODEL_NAME_SIZE 12
 #define MAX_DEBUG_DEVS 4
 #define MAX_DEBUG_STREAMS 8
@@ -322,6 +329,7 @@ enum AUDIO_THREAD_LOG_EVENTS {
   AUDIO_THREAD_LOOPBACK_GET,
   AUDIO_THREAD_LOOPBACK_SAMPLE_HOOK,
   AUDIO_THREAD_DEV_OVERRUN,
+  AUDIO_THREAD_WRITE_STREAMS_PASSTHROUGH,
 };
 
 // Important events in main thread.
@@ -441,6 +449,7 @@ struct __attribute__((__packed__)) audio_dev_debug_info {
   uint32_t longest_wake_nsec;
   double software_gain_scaler;
   uint32_t dev_idx;
+  uint64_t silent_frames_skipped;
 };
 
 struct __attribute__((__packed__)) audio_stream_debug_info {
@@ -480,6 +489,9 @@ struct __attribute__((__packed__)) audio_debug_info {
   struct audio_dev_debug_info devs[MAX_DEBUG_DEVS];
   struct audio_stream_debug_info streams[MAX_DEBUG_STREAMS];
   struct audio_thread_event_log log;
+  // Converters reused and created by config_format_converter().
+  uint32_t conv_pool_hits;
+  uint32_t conv_pool_misses;
 };
 
 struct __attribute__((__packed__)) main_thread_event {
@@ -642,7 +654,7 @@ static inline bool cras_floop_params_eq(const struct cras_floop_params* a,
  *        1 - Noise Cancellation standalone mode, which implies that NC is
  *        integrated without AEC on DSP. 0 - otherwise.
  */
-#define CRAS_SERVER_STATE_VERSION 2
+#define CRAS_SERVER_STATE_VERSION 4
 struct __attribute__((packed, aligned(4))) cras_server_state {
   uint32_t state_version;
   uint32_t volume;
@@ -12,7 +12,7 @@
 struct snd_pcm_cras {
   // ALSA ioplug object.
   snd_pcm_ioplug_t io;
-  // Wakes users with polled io.
+  // Other end of io.poll_fd, which is polled while there is no stream.
   int fd;
   // Indicates if the stream is playing/capturing.
   int stream_playing;
@@ -26,8 +26,17 @@ struct snd_pcm_cras {
   size_t bytes_per_frame;
   // input or output.
   enum CRAS_STREAM_DIRECTION direction;
-  // ALSA areas used to read from/write to.
+  // Frames written ahead of the server (playback) or captured ahead of the
+  // application (capture), buffer_size frames long.
+  uint8_t* ring;
+  // Number of frames held in ring.
+  snd_pcm_uframes_t ring_frames;
+  // Frames already placed in the shm of the pending playback request.
+  unsigned int io_filled;
+  // ALSA areas of the stream shm.
   snd_pcm_channel_area_t* areas;
+  // ALSA areas of ring.
+  snd_pcm_channel_area_t* ring_areas;
   // CRAS client object.
   struct cras_client* client;
   // The sample tracked for capture latency calculation.
@@ -53,7 +62,9 @@ static void snd_pcm_cras_free(struct snd_pcm_cras* pcm_cras) {
     close(pcm_cras->io.poll_fd);
   }
   cras_client_destroy(pcm_cras->client);
+  free(pcm_cras->ring_areas);
   free(pcm_cras->areas);
+  free(pcm_cras->ring);
   free(pcm_cras);
 }
 
@@ -65,6 +76,7 @@ static int snd_pcm_cras_stop(snd_pcm_ioplug_t* io) {
     cras_client_rm_stream(pcm_cras->client, pcm_cras->stream_id);
     cras_client_stop(pcm_cras->client);
     pcm_cras->stream_playing = 0;
+    pcm_cras->io_filled = 0;
   }
   return 0;
 }
@@ -80,129 +92,278 @@ static int snd_pcm_cras_close(snd_pcm_ioplug_t* io) {
   return 0;
 }
 
-/* Poll callback used to wait for data ready (playback) or space available
- * (capture). */
-static int snd_pcm_cras_poll_revents(snd_pcm_ioplug_t* io,
-                                     struct pollfd* pfds,
-                                     unsigned int nfds,
-                                     unsigned short* revents) {
-  static char buf[1];
-  int rc;
+static int snd_pcm_cras_poll_descriptors_count(snd_pcm_ioplug_t* io) {
+  return 1;
+}
 
-  if (pfds == NULL || nfds != 1 || revents == NULL) {
+/* Users wait on the fd of the CRAS stream, which becomes readable when the
+ * server requests (playback) or provides (capture) samples. */
+static int snd_pcm_cras_poll_descriptors(snd_pcm_ioplug_t* io,
+                                         struct pollfd* pfds,
+                                         unsigned int space) {
+  struct snd_pcm_cras* pcm_cras = io->private_data;
+  int fd = -1;
+
+  if (space < 1) {
     return -EINVAL;
   }
-  rc = read(pfds[0].fd, buf, 1);
-  if (rc < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
-    fprintf(stderr, "%s read failed %d\n", __func__, errno);
-    return errno;
+  if (pcm_cras->stream_playing) {
+    fd = cras_client_stream_get_poll_fd(pcm_cras->client, pcm_cras->stream_id);
   }
-  *revents = pfds[0].revents & ~(POLLIN | POLLOUT);
-  if (pfds[0].revents & POLLIN) {
-    *revents |= (io->stream == SND_PCM_STREAM_PLAYBACK) ? POLLOUT : POLLIN;
+  pfds[0].fd = (fd >= 0) ? fd : io->poll_fd;
+  pfds[0].events = POLLIN;
+  pfds[0].revents = 0;
+  return 1;
+}
+
+/* Points areas at the interleaved frames at base. CRAS always takes
+ * interleaved samples. */
+static void pcm_cras_set_areas(snd_pcm_ioplug_t* io,
+                               snd_pcm_channel_area_t* areas,
+                               uint8_t* base) {
+  unsigned int width = snd_pcm_format_physical_width(io->format);
+  size_t chan;
+
+  for (chan = 0; chan < io->channels; chan++) {
+    areas[chan].addr = base;
+    areas[chan].first = chan * width;
+    areas[chan].step = width * io->channels;
   }
-  return 0;
 }
 
-/* Callback to return the location of the write (playback) or read (capture)
- * pointer. */
-static snd_pcm_sframes_t snd_pcm_cras_pointer(snd_pcm_ioplug_t* io) {
+/* Copies frames between the ring and areas, wrapping at the end of the ring.
+ * Args:
+ *    io - The ALSA ioplug object.
+ *    pos - Position in the ring of the first frame.
+ *    areas - The areas to copy from or to.
+ *    offset - Offset in areas of the first frame.
+ *    frames - Number of frames to copy.
+ *    to_ring - Copy from areas into the ring instead of out of it.
+ */
+static void pcm_cras_ring_copy(snd_pcm_ioplug_t* io,
+                               snd_pcm_uframes_t pos,
+                               const snd_pcm_channel_area_t* areas,
+                               snd_pcm_uframes_t offset,
+                               snd_pcm_uframes_t frames,
+                               int to_ring) {
   struct snd_pcm_cras* pcm_cras = io->private_data;
-  return pcm_cras->hw_ptr;
+
+  while (frames > 0) {
+    snd_pcm_uframes_t n = frames;
+
+    if (n > io->buffer_size - pos) {
+      n = io->buffer_size - pos;
+    }
+    if (to_ring) {
+      snd_pcm_areas_copy(pcm_cras->ring_areas, pos, areas, offset,
+                         io->channels, n, io->format);
+    } else {
+      snd_pcm_areas_copy(areas, offset, pcm_cras->ring_areas, pos,
+                         io->channels, n, io->format);
+    }
+    pos = (pos + n) % io->buffer_size;
+    offset += n;
+    frames -= n;
+  }
 }
 
-/* Main callback for processing audio.  This is called by CRAS when more samples
- * are needed (playback) or ready (capture).  Copies bytes between ALSA and CRAS
- * buffers. */
-static int pcm_cras_process_cb(struct cras_client* client,
-                               cras_stream_id_t stream_id,
-                               uint8_t* capture_samples,
-                               uint8_t* playback_samples,
-                               unsigned int nframes,
-                               const struct timespec* capture_ts,
-                               const struct timespec* playback_ts,
-                               void* arg) {
-  snd_pcm_ioplug_t* io;
-  struct snd_pcm_cras* pcm_cras;
-  const snd_pcm_channel_area_t* areas;
-  snd_pcm_uframes_t copied_frames;
-  char empty_byte;
-  size_t chan, frame_bytes, sample_bytes;
-  int rc;
+/* Serves the pending requests of the server from the ring, then from the
+ * frames the application is writing once the ring runs dry. Samples are
+ * copied straight into the stream shm from the calling thread.
+ * Args:
+ *    io - The ALSA ioplug object.
+ *    areas - Frames written by the application, NULL if there are none.
+ *    offset - Offset in areas of the first frame.
+ *    size - Number of frames in areas.
+ * Returns:
+ *    The number of frames taken from areas.
+ */
+static snd_pcm_uframes_t pcm_cras_service_playback(
+    snd_pcm_ioplug_t* io,
+    const snd_pcm_channel_area_t* areas,
+    snd_pcm_uframes_t offset,
+    snd_pcm_uframes_t size) {
+  struct snd_pcm_cras* pcm_cras = io->private_data;
+  struct timespec sample_time;
+  snd_pcm_uframes_t taken = 0;
+  snd_pcm_uframes_t n;
   uint8_t* samples;
-  const struct timespec* sample_time;
-
-  samples = capture_samples ?: playback_samples;
-  sample_time = capture_ts ?: playback_ts;
+  unsigned int frames;
+  int rc;
 
-  io = (snd_pcm_ioplug_t*)arg;
-  pcm_cras = (struct snd_pcm_cras*)io->private_data;
-  frame_bytes = pcm_cras->bytes_per_frame;
-  sample_bytes = snd_pcm_format_physical_width(io->format) / 8;
+  while (pcm_cras->stream_playing) {
+    rc = cras_client_stream_begin_write(pcm_cras->client, pcm_cras->stream_id,
+                                        &samples, &frames, &sample_time, 0);
+    if (rc < 0) {
+      break;
+    }
 
-  if (io->stream == SND_PCM_STREAM_PLAYBACK) {
     if (io->state != SND_PCM_STATE_RUNNING &&
         io->state != SND_PCM_STATE_DRAINING) {
-      memset(samples, 0, nframes * frame_bytes);
-      return nframes;
+      memset(samples, 0, frames * pcm_cras->bytes_per_frame);
+      pcm_cras->io_filled = frames;
+    } else {
+      // Only take one period of data at a time.
+      if (frames > io->period_size) {
+        frames = io->period_size;
+      }
+      if (pcm_cras->io_filled == 0) {
+        /* Keep track of the first transmitted sample index and the time
+         * it will be played. */
+        pcm_cras->playback_sample_index = io->hw_ptr;
+        pcm_cras->playback_sample_time = sample_time;
+      }
+      pcm_cras_set_areas(io, pcm_cras->areas, samples);
+
+      n = frames - pcm_cras->io_filled;
+      if (n > pcm_cras->ring_frames) {
+        n = pcm_cras->ring_frames;
+      }
+      pcm_cras_ring_copy(io, pcm_cras->hw_ptr, pcm_cras->areas,
+                         pcm_cras->io_filled, n, 0);
+      pcm_cras->ring_frames -= n;
+      pcm_cras->io_filled += n;
+      pcm_cras->hw_ptr = (pcm_cras->hw_ptr + n) % io->buffer_size;
+
+      // Frames written past the ring skip it.
+      if (areas && pcm_cras->ring_frames == 0) {
+        n = frames - pcm_cras->io_filled;
+        if (n > size - taken) {
+          n = size - taken;
+        }
+        snd_pcm_areas_copy(pcm_cras->areas, pcm_cras->io_filled, areas,
+                           offset + taken, io->channels, n, io->format);
+        taken += n;
+        pcm_cras->io_filled += n;
+        pcm_cras->hw_ptr = (pcm_cras->hw_ptr + n) % io->buffer_size;
+      }
+
+      // Hold the request for the next write unless draining.
+      if (pcm_cras->io_filled < frames &&
+          io->state == SND_PCM_STATE_RUNNING) {
+        break;
+      }
     }
-    // Only take one period of data at a time.
-    if (nframes > io->period_size) {
-      nframes = io->period_size;
+
+    rc = cras_client_stream_commit_write(pcm_cras->client, pcm_cras->stream_id,
+                                         pcm_cras->io_filled);
+    pcm_cras->io_filled = 0;
+    if (rc < 0) {
+      fprintf(stderr, "%s commit failed %d\n", __func__, rc);
+      break;
+    }
+  }
+
+  return taken;
+}
+
+/* Moves the samples captured by the server from the stream shm into the
+ * ring, where they wait for the application to read them. */
+static void pcm_cras_service_capture(snd_pcm_ioplug_t* io) {
+  struct snd_pcm_cras* pcm_cras = io->private_data;
+  struct timespec sample_time;
+  uint8_t* samples;
+  unsigned int frames;
+  int rc;
+
+  while (pcm_cras->stream_playing) {
+    rc = cras_client_stream_begin_read(pcm_cras->client, pcm_cras->stream_id,
+                                       &samples, &frames, &sample_time, 0);
+    if (rc < 0) {
+      break;
     }
 
-    /* Keep track of the first transmitted sample index and the time
-     * it will be played. */
-    pcm_cras->playback_sample_index = io->hw_ptr;
-    pcm_cras->playback_sample_time = *sample_time;
-  } else {
     /* Keep track of the first read sample index and the time it
      * was captured. */
     pcm_cras->capture_sample_index = io->hw_ptr;
-    pcm_cras->capture_sample_time = *sample_time;
-  }
+    pcm_cras->capture_sample_time = sample_time;
+
+    pcm_cras_set_areas(io, pcm_cras->areas, samples);
+    pcm_cras_ring_copy(io, pcm_cras->hw_ptr, pcm_cras->areas, 0, frames, 1);
+    pcm_cras->hw_ptr = (pcm_cras->hw_ptr + frames) % io->buffer_size;
+    // On overrun the oldest frames are overwritten.
+    pcm_cras->ring_frames += frames;
+    if (pcm_cras->ring_frames > io->buffer_size) {
+      pcm_cras->ring_frames = io->buffer_size;
+    }
 
-  // CRAS always takes interleaved samples.
-  for (chan = 0; chan < io->channels; chan++) {
-    pcm_cras->areas[chan].addr = samples + chan * sample_bytes;
-    pcm_cras->areas[chan].first = 0;
-    pcm_cras->areas[chan].step =
-        snd_pcm_format_physical_width(io->format) * io->channels;
+    rc = cras_client_stream_commit_read(pcm_cras->client, pcm_cras->stream_id,
+                                        frames);
+    if (rc < 0) {
+      fprintf(stderr, "%s commit failed %d\n", __func__, rc);
+      break;
+    }
   }
+}
 
-  areas = snd_pcm_ioplug_mmap_areas(io);
-
-  copied_frames = 0;
-  while (copied_frames < nframes) {
-    snd_pcm_uframes_t frames = nframes - copied_frames;
-    snd_pcm_uframes_t remain = io->buffer_size - pcm_cras->hw_ptr;
+// Serves the pending requests of the server from the calling thread.
+static void pcm_cras_service(snd_pcm_ioplug_t* io) {
+  if (io->stream == SND_PCM_STREAM_PLAYBACK) {
+    pcm_cras_service_playback(io, NULL, 0, 0);
+  } else {
+    pcm_cras_service_capture(io);
+  }
+}
 
-    if (frames > remain) {
-      frames = remain;
-    }
+/* Transfer callback, called with the frames the application writes (playback)
+ * or wants to read (capture). Pending requests of the server are served
+ * first. Playback frames go straight into the stream shm while a request waits
+ * for them, only the rest is queued in the ring. */
+static snd_pcm_sframes_t snd_pcm_cras_transfer(
+    snd_pcm_ioplug_t* io,
+    const snd_pcm_channel_area_t* areas,
+    snd_pcm_uframes_t offset,
+    snd_pcm_uframes_t size) {
+  struct snd_pcm_cras* pcm_cras = io->private_data;
+  snd_pcm_uframes_t pos;
+  snd_pcm_uframes_t taken;
 
-    for (chan = 0; chan < io->channels; chan++) {
-      if (io->stream == SND_PCM_STREAM_PLAYBACK) {
-        snd_pcm_area_copy(&pcm_cras->areas[chan], copied_frames, &areas[chan],
-                          pcm_cras->hw_ptr, frames, io->format);
-      } else {
-        snd_pcm_area_copy(&areas[chan], pcm_cras->hw_ptr,
-                          &pcm_cras->areas[chan], copied_frames, frames,
-                          io->format);
-      }
-    }
+  if (io->stream == SND_PCM_STREAM_PLAYBACK) {
+    taken = pcm_cras_service_playback(io, areas, offset, size);
+    pos = (pcm_cras->hw_ptr + pcm_cras->ring_frames) % io->buffer_size;
+    pcm_cras_ring_copy(io, pos, areas, offset + taken, size - taken, 1);
+    pcm_cras->ring_frames += size - taken;
+    return size;
+  }
 
-    pcm_cras->hw_ptr += frames;
-    pcm_cras->hw_ptr %= io->buffer_size;
-    copied_frames += frames;
+  pcm_cras_service_capture(io);
+  if (size > pcm_cras->ring_frames) {
+    size = pcm_cras->ring_frames;
   }
+  pos = (pcm_cras->hw_ptr + io->buffer_size - pcm_cras->ring_frames) %
+        io->buffer_size;
+  pcm_cras_ring_copy(io, pos, areas, offset, size, 0);
+  pcm_cras->ring_frames -= size;
+  return size;
+}
 
-  rc = write(pcm_cras->fd, &empty_byte, 1);  // Wake up polling clients.
-  if (rc < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
-    fprintf(stderr, "%s write failed %d\n", __func__, errno);
+/* Poll callback used to wait for data ready (playback) or space available
+ * (capture). The requests of the server that woke the poller are served here
+ * from the ring, so applications that write a whole buffer ahead and then
+ * sleep in poll keep the server fed without calling back into ALSA. */
+static int snd_pcm_cras_poll_revents(snd_pcm_ioplug_t* io,
+                                     struct pollfd* pfds,
+                                     unsigned int nfds,
+                                     unsigned short* revents) {
+  if (pfds == NULL || nfds != 1 || revents == NULL) {
+    return -EINVAL;
   }
+  *revents = pfds[0].revents & ~(POLLIN | POLLOUT);
+  if (pfds[0].revents & POLLIN) {
+    pcm_cras_service(io);
+    *revents |= (io->stream == SND_PCM_STREAM_PLAYBACK) ? POLLOUT : POLLIN;
+  }
+  return 0;
+}
 
-  return nframes;
+/* Callback to return the location of the write (playback) or read (capture)
+ * pointer. Serves the requests of the server that arrived since the last wake
+ * first. */
+static snd_pcm_sframes_t snd_pcm_cras_pointer(snd_pcm_ioplug_t* io) {
+  struct snd_pcm_cras* pcm_cras = io->private_data;
+
+  pcm_cras_service(io);
+  return pcm_cras->hw_ptr;
 }
 
 // Callback from CRAS for stream errors.
@@ -218,6 +379,18 @@ static int pcm_cras_error_cb(struct cras_client* client,
  * SND_PCM_STATE_PREPARED state. */
 static int snd_pcm_cras_prepare(snd_pcm_ioplug_t* io) {
   struct snd_pcm_cras* pcm_cras = io->private_data;
+  size_t frame_bytes;
+  uint8_t* ring;
+
+  frame_bytes = snd_pcm_format_physical_width(io->format) / 8 * io->channels;
+  ring = realloc(pcm_cras->ring, io->buffer_size * frame_bytes);
+  if (ring == NULL) {
+    return -ENOMEM;
+  }
+  pcm_cras->ring = ring;
+  pcm_cras->ring_frames = 0;
+  pcm_cras->hw_ptr = 0;
+  pcm_cras_set_areas(io, pcm_cras->ring_areas, ring);
 
   return cras_client_connect(pcm_cras->client);
 }
@@ -234,15 +407,16 @@ static int snd_pcm_cras_start(snd_pcm_ioplug_t* io) {
     return -ENOMEM;
   }
 
-  params = cras_client_unified_params_create(
-      pcm_cras->direction, io->period_size, 0, 0, io, pcm_cras_process_cb,
-      pcm_cras_error_cb, audio_format);
+  params = cras_client_unified_params_create(pcm_cras->direction,
+                                             io->period_size, 0, 0, io, NULL,
+                                             pcm_cras_error_cb, audio_format);
   if (params == NULL) {
     rc = -ENOMEM;
     goto error_out;
   }
 
   cras_client_stream_params_set_client_type(params, CRAS_CLIENT_TYPE_PCM);
+  cras_client_stream_params_enable_direct_io(params);
 
   rc = cras_client_run_thread(pcm_cras->client);
   if (rc < 0) {
@@ -269,7 +443,10 @@ static snd_pcm_ioplug_callback_t cras_pcm_callback = {
     .start = snd_pcm_cras_start,
     .stop = snd_pcm_cras_stop,
     .pointer = snd_pcm_cras_pointer,
+    .transfer = snd_pcm_cras_transfer,
     .prepare = snd_pcm_cras_prepare,
+    .poll_descriptors_count = snd_pcm_cras_poll_descriptors_count,
+    .poll_descriptors = snd_pcm_cras_poll_descriptors,
     .poll_revents = snd_pcm_cras_poll_revents,
 };
 
@@ -358,7 +535,9 @@ static int snd_pcm_cras_open(snd_pcm_t** pcmp,
   }
 
   pcm_cras->areas = calloc(pcm_cras->channels, sizeof(snd_pcm_channel_area_t));
-  if (pcm_cras->areas == NULL) {
+  pcm_cras->ring_areas =
+      calloc(pcm_cras->channels, sizeof(snd_pcm_channel_area_t));
+  if (pcm_cras->areas == NULL || pcm_cras->ring_areas == NULL) {
     snd_pcm_cras_free(pcm_cras);
     return -ENOMEM;
   }
@@ -376,7 +555,7 @@ static int snd_pcm_cras_open(snd_pcm_t** pcmp,
   pcm_cras->io.private_data = pcm_cras;
   pcm_cras->io.poll_fd = fd[1];
   pcm_cras->io.poll_events = POLLIN;
-  pcm_cras->io.mmap_rw = 1;
+  pcm_cras->io.mmap_rw = 0;
 
   rc = snd_pcm_ioplug_create(&pcm_cras->io, name, stream, mode);
   if (rc < 0) {
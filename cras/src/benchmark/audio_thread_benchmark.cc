@@ -0,0 +1,88 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+/*
+ * Per-iteration cost of waiting on the audio thread fds against the number of
+ * attached streams. Every stream owns a socket, one of which has a pending
+ * client reply so each wait returns without sleeping.
+ */
+class BM_AudioThreadWait : public benchmark::Fixture {
+ public:
+  void SetUp(const ::benchmark::State& state) {
+    int sv[2];
+    char c = 0;
+
+    for (int i = 0; i < state.range(0); i++) {
+      socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv);
+      stream_fds.push_back(sv[0]);
+      client_fds.push_back(sv[1]);
+    }
+    write(client_fds.back(), &c, 1);
+  }
+
+  void TearDown(const ::benchmark::State& state) {
+    for (int fd : stream_fds) {
+      close(fd);
+    }
+    for (int fd : client_fds) {
+      close(fd);
+    }
+    stream_fds.clear();
+    client_fds.clear();
+  }
+
+  std::vector<int> stream_fds;
+  std::vector<int> client_fds;
+};
+
+// Rebuilds the pollfd array from the stream list on every wake up.
+BENCHMARK_DEFINE_F(BM_AudioThreadWait, RebuildPoll)(benchmark::State& state) {
+  std::vector<struct pollfd> pollfds;
+  struct timespec ts = {0, 0};
+
+  for (auto _ : state) {
+    pollfds.clear();
+    for (int fd : stream_fds) {
+      pollfds.push_back({.fd = fd, .events = POLLIN, .revents = 0});
+    }
+    benchmark::DoNotOptimize(ppoll(pollfds.data(), pollfds.size(), &ts, NULL));
+  }
+  state.counters["streams"] = state.range(0);
+}
+
+// Waits on a persistent epoll set updated only when streams come and go.
+BENCHMARK_DEFINE_F(BM_AudioThreadWait, WaitSet)(benchmark::State& state) {
+  struct epoll_event events[32];
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+  for (int fd : stream_fds) {
+    struct epoll_event ev = {.events = EPOLLIN, .data = {.ptr = NULL}};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(epoll_wait(epoll_fd, events, 32, 0));
+  }
+  close(epoll_fd);
+  state.counters["streams"] = state.range(0);
+}
+
+BENCHMARK_REGISTER_F(BM_AudioThreadWait, RebuildPoll)
+    ->RangeMultiplier(2)
+    ->Range(1, 64);
+BENCHMARK_REGISTER_F(BM_AudioThreadWait, WaitSet)
+    ->RangeMultiplier(2)
+    ->Range(1, 64);
+
+}  // namespace
@@ -12,11 +12,28 @@
 namespace {
 extern "C" {
 #include "cras/src/dsp/drc.h"
+#include "cras/src/dsp/dsp_util.h"
+#include "cras/src/dsp/eq.h"
 #include "cras/src/dsp/eq2.h"
+#include "cras/src/dsp/eqn.h"
 }
 
 constexpr int NUM_CHANNELS = 2;
 
+// Returns the DSP_X86_* instruction sets this CPU has.
+unsigned int cpu_x86_features() {
+  unsigned int features = 0;
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2")) {
+    features |= DSP_X86_AVX2;
+  }
+  if (__builtin_cpu_supports("fma")) {
+    features |= DSP_X86_FMA;
+  }
+#endif
+  return features;
+}
+
 class BM_Dsp : public benchmark::Fixture {
  public:
   void SetUp(const ::benchmark::State& state) {
@@ -63,6 +80,94 @@ BENCHMARK_DEFINE_F(BM_Dsp, Eq2)(benchmark::State& state) {
 
 BENCHMARK_REGISTER_F(BM_Dsp, Eq2)->RangeMultiplier(2)->Range(256, 8 << 10);
 
+// Speaker tuning for the channel sweep, the same biquads on every channel.
+static const struct {
+  enum biquad_type type;
+  double freq, Q, gain;
+} speaker_eq[] = {
+    {BQ_PEAKING, 380, 3, -10},  {BQ_PEAKING, 720, 3, -12},
+    {BQ_PEAKING, 1705, 3, -8},  {BQ_HIGHPASS, 218, 0.7, -10.2},
+    {BQ_PEAKING, 580, 6, -8},   {BQ_HIGHSHELF, 8000, 3, 2},
+};
+
+// Args: frames, channels.
+class BM_DspChannels : public benchmark::Fixture {
+ public:
+  void SetUp(const ::benchmark::State& state) {
+    std::random_device rnd_device;
+    std::mt19937 engine{rnd_device()};
+    frames = state.range(0);
+    num_channels = state.range(1);
+    samples = gen_float_samples(frames * num_channels, engine);
+    for (int ch = 0; ch < num_channels; ch++) {
+      data.push_back(samples.data() + ch * frames);
+    }
+  }
+
+  void TearDown(const ::benchmark::State& state) { data.clear(); }
+
+  void SetCounters(benchmark::State& state) {
+    state.counters["frames_per_second"] = benchmark::Counter(
+        int64_t(state.iterations()) * frames, benchmark::Counter::kIsRate);
+    state.counters["time_per_48k_frames"] = benchmark::Counter(
+        int64_t(state.iterations()) * frames / 48000,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  }
+
+  size_t frames;
+  int num_channels;
+  // |num_channels| planes of |frames| samples.
+  std::vector<float> samples;
+  std::vector<float*> data;
+};
+
+// One scalar eq per channel, what multichannel tuning falls back to.
+BENCHMARK_DEFINE_F(BM_DspChannels, Eq)(benchmark::State& state) {
+  const double NQ = 44100 / 2;  // nyquist frequency
+  std::vector<struct eq*> eqs;
+
+  for (int ch = 0; ch < num_channels; ch++) {
+    struct eq* eq = eq_new();
+    for (auto& bq : speaker_eq) {
+      eq_append_biquad(eq, bq.type, bq.freq / NQ, bq.Q, bq.gain);
+    }
+    eqs.push_back(eq);
+  }
+  for (auto _ : state) {
+    for (int ch = 0; ch < num_channels; ch++) {
+      eq_process(eqs[ch], data[ch], frames);
+    }
+  }
+  for (auto eq : eqs) {
+    eq_free(eq);
+  }
+  SetCounters(state);
+}
+
+BENCHMARK_REGISTER_F(BM_DspChannels, Eq)
+    ->ArgsProduct({{256, 1024, 4096}, {2, 4, 6, 8}});
+
+BENCHMARK_DEFINE_F(BM_DspChannels, EqN)(benchmark::State& state) {
+  const double NQ = 44100 / 2;  // nyquist frequency
+  dsp_set_x86_features(cpu_x86_features());
+  struct eqn* eqn = eqn_new(num_channels);
+  dsp_set_x86_features(0);
+
+  for (int ch = 0; ch < num_channels; ch++) {
+    for (auto& bq : speaker_eq) {
+      eqn_append_biquad(eqn, ch, bq.type, bq.freq / NQ, bq.Q, bq.gain);
+    }
+  }
+  for (auto _ : state) {
+    eqn_process(eqn, data.data(), frames);
+  }
+  eqn_free(eqn);
+  SetCounters(state);
+}
+
+BENCHMARK_REGISTER_F(BM_DspChannels, EqN)
+    ->ArgsProduct({{256, 1024, 4096}, {2, 4, 6, 8}});
+
 BENCHMARK_DEFINE_F(BM_Dsp, Drc)(benchmark::State& state) {
   const double NQ = 44100 / 2;  // nyquist frequency
 
@@ -95,7 +200,14 @@ BENCHMARK_DEFINE_F(BM_Dsp, Drc)(benchmark::State& state) {
   drc_set_param(drc, 2, PARAM_RELEASE, 1);
   drc_set_param(drc, 2, PARAM_POST_GAIN, 0);
 
+  // Arg 1 picks the AVX2 and FMA kernels.
+  const unsigned int avx2_fma = DSP_X86_AVX2 | DSP_X86_FMA;
+  if (state.range(1) && (cpu_x86_features() & avx2_fma) != avx2_fma) {
+    state.SkipWithError("No AVX2 and FMA");
+  }
+  dsp_set_x86_features(state.range(1) ? avx2_fma : 0);
   drc_init(drc);
+  dsp_set_x86_features(0);
   for (auto _ : state) {
     for (size_t start = 0; start < frames;) {
       float* data[2] = {samples.data() + start,
@@ -114,6 +226,7 @@ BENCHMARK_DEFINE_F(BM_Dsp, Drc)(benchmark::State& state) {
       benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
 }
 
-BENCHMARK_REGISTER_F(BM_Dsp, Drc)->RangeMultiplier(2)->Range(256, 8 << 10);
+BENCHMARK_REGISTER_F(BM_Dsp, Drc)
+    ->ArgsProduct({benchmark::CreateRange(256, 8 << 10, 2), {0, 1}});
 
 }  // namespace
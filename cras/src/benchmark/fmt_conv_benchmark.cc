@@ -0,0 +1,158 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cras/src/benchmark/benchmark_util.h"
+
+namespace {
+extern "C" {
+#include "cras/src/server/cras_fmt_conv_ops.h"
+#include "cras/src/server/cras_mix.h"
+}
+
+// The scalar converters every table is checked against.
+const struct cras_fmt_conv_ops scalar_ops = {
+    .s24le_to_s16le = convert_s24le_to_s16le,
+    .s32le_to_s16le = convert_s32le_to_s16le,
+    .s16le_to_s32le = convert_s16le_to_s32le,
+    .s16_stereo_to_51 = s16_stereo_to_51,
+    .s16_51_to_stereo = s16_51_to_stereo,
+    .s16_convert_channels = s16_convert_channels,
+};
+
+/*
+ * Converts kFrames frames with the table picked by state.range(0): 0 for the
+ * scalar converters, then the tables for no SIMD flag, SSE4.2 and AVX2.
+ * Tables the CPU can't run are skipped.
+ */
+class BM_FmtConvOps : public benchmark::Fixture {
+ public:
+  static constexpr size_t kFrames = 1024;
+
+  void SetUp(benchmark::State& state) override {
+    std::random_device rnd_device;
+    std::mt19937 engine{rnd_device()};
+
+    ops = GetOps(state);
+    src = gen_s16_le_samples(kFrames * 2 * CRAS_CH_MAX, engine);
+    dst.resize(kFrames * 2 * CRAS_CH_MAX);
+  }
+
+  static const struct cras_fmt_conv_ops* GetOps(benchmark::State& state) {
+    switch (state.range(0)) {
+      case 0:
+        return &scalar_ops;
+      case 1:
+        return cras_fmt_conv_get_ops(0);
+#if defined(__x86_64__)
+      case 2:
+        if (__builtin_cpu_supports("sse4.2")) {
+          return cras_fmt_conv_get_ops(CPU_X86_SSE4_2);
+        }
+        break;
+      case 3:
+        if (__builtin_cpu_supports("avx2")) {
+          return cras_fmt_conv_get_ops(CPU_X86_AVX2);
+        }
+        break;
+#endif
+    }
+    state.SkipWithError("unsupported CPU");
+    return NULL;
+  }
+
+  void SetBytes(benchmark::State& state, size_t bytes_per_frame) {
+    state.SetBytesProcessed(int64_t(state.iterations()) * kFrames *
+                            bytes_per_frame);
+  }
+
+  const struct cras_fmt_conv_ops* ops;
+  std::vector<int16_t> src;
+  std::vector<int16_t> dst;
+};
+
+BENCHMARK_DEFINE_F(BM_FmtConvOps, S24LEToS16LE)(benchmark::State& state) {
+  for (auto _ : state) {
+    ops->s24le_to_s16le((uint8_t*)src.data(), kFrames * 2,
+                        (uint8_t*)dst.data());
+  }
+  SetBytes(state, 2 * 4);
+}
+
+BENCHMARK_DEFINE_F(BM_FmtConvOps, S32LEToS16LE)(benchmark::State& state) {
+  for (auto _ : state) {
+    ops->s32le_to_s16le((uint8_t*)src.data(), kFrames * 2,
+                        (uint8_t*)dst.data());
+  }
+  SetBytes(state, 2 * 4);
+}
+
+BENCHMARK_DEFINE_F(BM_FmtConvOps, S16LEToS32LE)(benchmark::State& state) {
+  for (auto _ : state) {
+    ops->s16le_to_s32le((uint8_t*)src.data(), kFrames * 2,
+                        (uint8_t*)dst.data());
+  }
+  SetBytes(state, 2 * 2);
+}
+
+// state.range(1) selects placing the stereo on front left/right or center.
+BENCHMARK_DEFINE_F(BM_FmtConvOps, StereoTo51)(benchmark::State& state) {
+  size_t left = state.range(1) ? -1 : 0;
+  size_t right = state.range(1) ? -1 : 1;
+
+  for (auto _ : state) {
+    ops->s16_stereo_to_51(left, right, 2, (uint8_t*)src.data(), kFrames,
+                          (uint8_t*)dst.data());
+  }
+  SetBytes(state, 2 * 2);
+}
+
+BENCHMARK_DEFINE_F(BM_FmtConvOps, Surround51ToStereo)(benchmark::State& state) {
+  for (auto _ : state) {
+    ops->s16_51_to_stereo((uint8_t*)src.data(), kFrames, (uint8_t*)dst.data());
+  }
+  SetBytes(state, 6 * 2);
+}
+
+// Converts state.range(1) channels to state.range(2) through a matrix.
+BENCHMARK_DEFINE_F(BM_FmtConvOps, ConvertChannels)(benchmark::State& state) {
+  size_t in_ch = state.range(1);
+  size_t out_ch = state.range(2);
+  std::vector<float> coef(in_ch * out_ch, 0.3);
+  std::vector<float*> mtx(out_ch);
+
+  for (size_t i = 0; i < out_ch; i++) {
+    mtx[i] = &coef[i * in_ch];
+  }
+  for (auto _ : state) {
+    ops->s16_convert_channels(mtx.data(), in_ch, out_ch, (uint8_t*)src.data(),
+                              kFrames, (uint8_t*)dst.data());
+  }
+  SetBytes(state, in_ch * 2);
+}
+
+static void ChannelLayouts(benchmark::internal::Benchmark* b) {
+  const int layouts[][2] = {{2, 4}, {2, 6}, {2, 8}, {6, 2},
+                            {6, 4}, {6, 6}, {8, 8}, {8, 2}};
+
+  for (int ops = 0; ops < 4; ops++) {
+    for (auto& l : layouts) {
+      b->Args({ops, l[0], l[1]});
+    }
+  }
+}
+
+BENCHMARK_REGISTER_F(BM_FmtConvOps, S24LEToS16LE)->DenseRange(0, 3);
+BENCHMARK_REGISTER_F(BM_FmtConvOps, S32LEToS16LE)->DenseRange(0, 3);
+BENCHMARK_REGISTER_F(BM_FmtConvOps, S16LEToS32LE)->DenseRange(0, 3);
+BENCHMARK_REGISTER_F(BM_FmtConvOps, StereoTo51)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, 3, 1), {0, 1}});
+BENCHMARK_REGISTER_F(BM_FmtConvOps, Surround51ToStereo)->DenseRange(0, 3);
+BENCHMARK_REGISTER_F(BM_FmtConvOps, ConvertChannels)->Apply(ChannelLayouts);
+
+}  // namespace
@@ -12,6 +12,7 @@
 
 namespace {
 extern "C" {
+#include "cras/src/server/cras_fmt_conv_ops.h"
 #include "cras/src/server/cras_mix.h"
 }
 
@@ -51,4 +52,82 @@ static void BM_CrasMixerOpsMixAdd(benchmark::State& state) {
 }
 
 BENCHMARK(BM_CrasMixerOpsMixAdd)->RangeMultiplier(2)->Range(256, 8 << 10);
+
+/*
+ * Mixes a S16_LE stream of state.range(0) channels into a stereo device,
+ * S32_LE if state.range(1) is set and S16_LE otherwise.
+ */
+class BM_CrasMixerOpsMixStream : public benchmark::Fixture {
+ public:
+  static constexpr size_t kFrames = 1024;
+
+  void SetUp(const ::benchmark::State& state) {
+    std::random_device rnd_device;
+    std::mt19937 engine{rnd_device()};
+
+    cras_mix_init();
+    in_channels = state.range(0);
+    fmt = state.range(1) ? SND_PCM_FORMAT_S32_LE : SND_PCM_FORMAT_S16_LE;
+    src = gen_s16_le_samples(kFrames * in_channels, engine);
+    stereo.resize(kFrames * 2);
+    converted.resize(kFrames * 2);
+    dst.assign(kFrames * 2, 0);
+  }
+
+  void Report(benchmark::State& state) {
+    state.SetItemsProcessed(int64_t(state.iterations()) * kFrames);
+    state.counters["in_channels"] = in_channels;
+    state.counters["s32"] = state.range(1);
+  }
+
+  unsigned int in_channels;
+  snd_pcm_format_t fmt;
+  std::vector<int16_t> src;
+  std::vector<int16_t> stereo;
+  std::vector<int32_t> converted;
+  std::vector<int32_t> dst;
+};
+
+// Converts into intermediate buffers with the cras_fmt_conv ops, then mixes.
+BENCHMARK_DEFINE_F(BM_CrasMixerOpsMixStream, TwoPass)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    uint8_t* mix_src = (uint8_t*)stereo.data();
+
+    if (in_channels == 1) {
+      s16_mono_to_stereo((uint8_t*)src.data(), kFrames,
+                         (uint8_t*)stereo.data());
+    } else {
+      mix_src = (uint8_t*)src.data();
+    }
+    if (fmt == SND_PCM_FORMAT_S32_LE) {
+      convert_s16le_to_s32le(mix_src, kFrames * 2,
+                             (uint8_t*)converted.data());
+      mix_src = (uint8_t*)converted.data();
+    }
+    cras_mix_add(fmt, (uint8_t*)dst.data(), mix_src, kFrames * 2, 1, 0, 0.7);
+    benchmark::ClobberMemory();
+  }
+  Report(state);
+}
+
+BENCHMARK_DEFINE_F(BM_CrasMixerOpsMixStream, Fused)(benchmark::State& state) {
+  for (auto _ : state) {
+    cras_mix_add_s16_stereo(fmt, (uint8_t*)dst.data(), src.data(), kFrames,
+                            in_channels, 0, 0.7);
+    benchmark::ClobberMemory();
+  }
+  Report(state);
+}
+
+static void MixStreamArgs(benchmark::internal::Benchmark* b) {
+  for (int in_channels = 1; in_channels <= 2; in_channels++) {
+    for (int s32 = 0; s32 <= 1; s32++) {
+      b->Args({in_channels, s32});
+    }
+  }
+}
+
+BENCHMARK_REGISTER_F(BM_CrasMixerOpsMixStream, TwoPass)->Apply(MixStreamArgs);
+BENCHMARK_REGISTER_F(BM_CrasMixerOpsMixStream, Fused)->Apply(MixStreamArgs);
 }  // namespace
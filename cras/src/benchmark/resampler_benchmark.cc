@@ -0,0 +1,218 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <speex/speex_resampler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cras/src/benchmark/benchmark_util.h"
+
+namespace {
+extern "C" {
+#include "cras/src/server/cras_mix.h"
+#include "cras/src/server/linear_resampler.h"
+#include "cras/src/server/polyphase_resampler.h"
+}
+
+/*
+ * Resamples one 10ms period of state.range(0) channels the way
+ * cras_fmt_conv_convert_frames() does, asking for the input frames needed to
+ * fill the period first. state.range(1) selects the rates: 0 for a small
+ * drift correction, 1 for 44100 to 48000 and 2 for 48000 to 44100.
+ */
+class BM_LinearResampler : public benchmark::Fixture {
+ public:
+  static constexpr unsigned int kFrames = 480;
+
+  void SetUp(benchmark::State& state) override {
+    std::random_device rnd_device;
+    std::mt19937 engine{rnd_device()};
+    const float rates[][2] = {
+        {48000, 48000.37}, {44100, 48000}, {48000, 44100}};
+
+    num_channels = state.range(0);
+    lr = linear_resampler_create(num_channels, num_channels * 2,
+                                 rates[state.range(1)][0],
+                                 rates[state.range(1)][1]);
+    src = gen_s16_le_samples(kFrames * 2 * num_channels, engine);
+    dst.resize(kFrames * num_channels);
+  }
+
+  void TearDown(benchmark::State& state) override {
+    linear_resampler_destroy(lr);
+  }
+
+  struct linear_resampler* lr;
+  unsigned int num_channels;
+  std::vector<int16_t> src;
+  std::vector<int16_t> dst;
+};
+
+BENCHMARK_DEFINE_F(BM_LinearResampler, Resample)(benchmark::State& state) {
+  int64_t frames = 0;
+
+  for (auto _ : state) {
+    unsigned int count = linear_resampler_out_frames_to_in(lr, kFrames);
+
+    frames += linear_resampler_resample(lr, (uint8_t*)src.data(), &count,
+                                        (uint8_t*)dst.data(), kFrames);
+  }
+  state.SetItemsProcessed(frames);
+  state.SetBytesProcessed(frames * num_channels * 2);
+  state.counters["frames_per_second"] =
+      benchmark::Counter(frames, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(BM_LinearResampler, Resample)
+    ->ArgsProduct({{1, 2, 6}, {0, 1, 2}});
+
+/*
+ * Compares the rate converters cras_fmt_conv_create() can pick, on one 10ms
+ * output period of state.range(0) channels. state.range(1) selects the rates:
+ * 0 for 44100 to 48000, 1 for 16000 to 48000 and 2 for 48000 to 44100.
+ * state.range(2) is 0 for speex at the quality cras_fmt_conv uses and 1 for
+ * the polyphase resampler. The snr_db counter is measured once on a 1 kHz sine.
+ */
+class BM_RateConverter : public benchmark::Fixture {
+ public:
+  static constexpr unsigned int kFrames = 480;
+  static constexpr int kSpeexQuality = 4;
+
+  void SetUp(benchmark::State& state) override {
+    std::random_device rnd_device;
+    std::mt19937 engine{rnd_device()};
+    const unsigned int rates[][2] = {{44100, 48000}, {16000, 48000},
+                                     {48000, 44100}};
+    int rc;
+
+    num_channels = state.range(0);
+    in_rate = rates[state.range(1)][0];
+    out_rate = rates[state.range(1)][1];
+    use_polyphase = state.range(2);
+    speex = NULL;
+    pr = NULL;
+    if (use_polyphase) {
+      polyphase_resampler_init(cpu_get_flags());
+      pr = polyphase_resampler_create(num_channels, in_rate, out_rate,
+                                      POLYPHASE_QUALITY_MEDIUM);
+    } else {
+      speex = speex_resampler_init(num_channels, in_rate, out_rate,
+                                   kSpeexQuality, &rc);
+    }
+    snr_db = MeasureSnr();
+    src = gen_s16_le_samples(kFrames * 4 * num_channels, engine);
+    dst.resize(kFrames * num_channels);
+  }
+
+  void TearDown(benchmark::State& state) override {
+    if (speex) {
+      speex_resampler_destroy(speex);
+    }
+    polyphase_resampler_destroy(pr);
+  }
+
+  void Process(const int16_t* in,
+               unsigned int* in_frames,
+               int16_t* out,
+               unsigned int* out_frames) {
+    if (pr) {
+      polyphase_resampler_process_s16(pr, in, in_frames, out, out_frames);
+    } else {
+      speex_resampler_process_interleaved_int(speex, in, in_frames, out,
+                                              out_frames);
+    }
+  }
+
+  // Resamples one second of a 1 kHz sine and fits a sine to the output.
+  double MeasureSnr() {
+    const double freq = 1000;
+    std::vector<int16_t> in(in_rate * num_channels);
+    std::vector<int16_t> out(out_rate * num_channels);
+    unsigned int in_done = 0, out_done = 0;
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+    double signal = 0, noise = 0;
+
+    for (unsigned int i = 0; i < in_rate; i++) {
+      for (unsigned int ch = 0; ch < num_channels; ch++) {
+        in[i * num_channels + ch] = 16000 * sin(2 * M_PI * freq * i / in_rate);
+      }
+    }
+    while (in_done < in_rate && out_done < out_rate) {
+      unsigned int in_frames = std::min(kFrames, in_rate - in_done);
+      unsigned int out_frames = out_rate - out_done;
+
+      Process(&in[in_done * num_channels], &in_frames,
+              &out[out_done * num_channels], &out_frames);
+      in_done += in_frames;
+      out_done += out_frames;
+    }
+    // Skips the start up transient.
+    for (unsigned int i = out_done / 4; i < out_done; i++) {
+      double s = sin(2 * M_PI * freq * i / out_rate);
+      double c = cos(2 * M_PI * freq * i / out_rate);
+
+      ss += s * s;
+      cc += c * c;
+      sc += s * c;
+      ys += out[i * num_channels] * s;
+      yc += out[i * num_channels] * c;
+    }
+    double a = (ys * cc - yc * sc) / (ss * cc - sc * sc);
+    double b = (yc * ss - ys * sc) / (ss * cc - sc * sc);
+    for (unsigned int i = out_done / 4; i < out_done; i++) {
+      double ideal = a * sin(2 * M_PI * freq * i / out_rate) +
+                     b * cos(2 * M_PI * freq * i / out_rate);
+      double err = out[i * num_channels] - ideal;
+
+      signal += ideal * ideal;
+      noise += err * err;
+    }
+    if (use_polyphase) {
+      polyphase_resampler_reset(pr);
+    } else {
+      speex_resampler_reset_mem(speex);
+    }
+    return 10 * log10(signal / std::max(noise, 1e-9));
+  }
+
+  struct polyphase_resampler* pr;
+  SpeexResamplerState* speex;
+  unsigned int num_channels;
+  unsigned int in_rate;
+  unsigned int out_rate;
+  bool use_polyphase;
+  double snr_db;
+  std::vector<int16_t> src;
+  std::vector<int16_t> dst;
+};
+
+BENCHMARK_DEFINE_F(BM_RateConverter, Resample)(benchmark::State& state) {
+  int64_t frames = 0;
+
+  if (!speex && !pr) {
+    state.SkipWithError("no resampler for the rates");
+    return;
+  }
+  for (auto _ : state) {
+    unsigned int in_frames = kFrames * 4;
+    unsigned int out_frames = kFrames;
+
+    Process(src.data(), &in_frames, dst.data(), &out_frames);
+    frames += out_frames;
+  }
+  state.SetItemsProcessed(frames);
+  state.counters["frames_per_second"] =
+      benchmark::Counter(frames, benchmark::Counter::kIsRate);
+  state.counters["snr_db"] = snr_db;
+}
+
+BENCHMARK_REGISTER_F(BM_RateConverter, Resample)
+    ->ArgsProduct({{1, 2, 6}, {0, 1, 2}, {0, 1}});
+
+}  // namespace
@@ -0,0 +1,230 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+extern "C" {
+#include "cras_messages.h"
+#include "cras_shm.h"
+}
+
+namespace {
+
+/*
+ * Cost of one audio period for the server when requesting samples from
+ * state.range(0) client streams and waiting for all of them to reply. Each
+ * stream is served by its own client thread, like in libcras.
+ */
+class BM_StreamTransport : public benchmark::Fixture {
+ public:
+  void SetUp(const ::benchmark::State& state) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    running = true;
+  }
+
+  void TearDown(const ::benchmark::State& state) {
+    running = false;
+    StopClients();
+    for (auto& t : clients) {
+      t.join();
+    }
+    for (int fd : client_fds) {
+      close(fd);
+    }
+    for (int fd : server_fds) {
+      close(fd);
+    }
+    for (struct cras_audio_shm* shm : shms) {
+      free(shm->header);
+      free(shm);
+    }
+    close(epoll_fd);
+    clients.clear();
+    client_fds.clear();
+    server_fds.clear();
+    shms.clear();
+  }
+
+  // Waits until all streams have replied.
+  void WaitReplies(int num_streams) {
+    struct epoll_event events[64];
+    int replied = 0;
+
+    while (replied < num_streams) {
+      int n = epoll_wait(epoll_fd, events, 64, -1);
+      for (int i = 0; i < n; i++) {
+        replied += ReadReply(events[i].data.u32);
+      }
+    }
+  }
+
+  virtual void StopClients() = 0;
+  virtual int ReadReply(int stream) = 0;
+
+  int epoll_fd;
+  std::atomic<bool> running;
+  std::vector<std::thread> clients;
+  std::vector<int> client_fds;
+  std::vector<int> server_fds;
+  std::vector<struct cras_audio_shm*> shms;
+};
+
+// Requests and replies are audio_messages written to the stream sockets.
+class BM_StreamSocket : public BM_StreamTransport {
+ public:
+  void SetUp(const ::benchmark::State& state) {
+    BM_StreamTransport::SetUp(state);
+    for (int i = 0; i < state.range(0); i++) {
+      int sv[2];
+      struct epoll_event ev = {.events = EPOLLIN, .data = {.u32 = (uint32_t)i}};
+
+      socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+      server_fds.push_back(sv[0]);
+      client_fds.push_back(sv[1]);
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sv[0], &ev);
+      clients.emplace_back(Client, sv[1]);
+    }
+  }
+
+  static void Client(int fd) {
+    struct audio_message msg;
+
+    while (read(fd, &msg, sizeof(msg)) == sizeof(msg)) {
+      msg.id = AUDIO_MESSAGE_DATA_READY;
+      msg.error = 0;
+      if (write(fd, &msg, sizeof(msg)) != sizeof(msg)) {
+        return;
+      }
+    }
+  }
+
+  void StopClients() override {
+    for (int fd : server_fds) {
+      shutdown(fd, SHUT_RDWR);
+    }
+  }
+
+  int ReadReply(int stream) override {
+    struct audio_message msg;
+
+    return read(server_fds[stream], &msg, sizeof(msg)) == sizeof(msg);
+  }
+};
+
+BENCHMARK_DEFINE_F(BM_StreamSocket, Period)(benchmark::State& state) {
+  struct audio_message msg = {AUDIO_MESSAGE_REQUEST_DATA, 0, 480};
+
+  for (auto _ : state) {
+    for (int fd : server_fds) {
+      benchmark::DoNotOptimize(write(fd, &msg, sizeof(msg)));
+    }
+    WaitReplies(state.range(0));
+  }
+  state.counters["streams"] = state.range(0);
+}
+
+/*
+ * Requests are posted in the shm header and wake the client through the
+ * futex doorbell. Replies are posted in shm and ring an eventfd which the
+ * server watches edge triggered without reading it back.
+ */
+class BM_StreamDoorbell : public BM_StreamTransport {
+ public:
+  void SetUp(const ::benchmark::State& state) {
+    BM_StreamTransport::SetUp(state);
+    for (int i = 0; i < state.range(0); i++) {
+      struct cras_audio_shm* shm =
+          (struct cras_audio_shm*)calloc(1, sizeof(*shm));
+      int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      struct epoll_event ev = {.events = EPOLLIN | EPOLLET,
+                               .data = {.u32 = (uint32_t)i}};
+
+      shm->header = (struct cras_audio_shm_header*)calloc(
+          1, sizeof(*shm->header));
+      shms.push_back(shm);
+      server_fds.push_back(fd);
+      reply_seqs.push_back(0);
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+      clients.emplace_back(Client, this, shm, fd);
+    }
+  }
+
+  void TearDown(const ::benchmark::State& state) {
+    BM_StreamTransport::TearDown(state);
+    reply_seqs.clear();
+  }
+
+  void StopClients() override {
+    for (struct cras_audio_shm* shm : shms) {
+      cras_shm_ring_doorbell(shm);
+    }
+  }
+
+  static void Client(BM_StreamDoorbell* self,
+                     struct cras_audio_shm* shm,
+                     int fd) {
+    uint32_t seq = 0;
+    uint64_t one = 1;
+
+    while (self->running) {
+      uint32_t doorbell = cras_shm_get_doorbell(shm);
+
+      if (cras_shm_get_request_seq(shm) == seq) {
+        if (self->running) {
+          cras_shm_wait_doorbell(shm, doorbell);
+        }
+        continue;
+      }
+      seq = cras_shm_get_request_seq(shm);
+      cras_shm_post_reply(shm, 0);
+      if (write(fd, &one, sizeof(one)) != sizeof(one)) {
+        return;
+      }
+    }
+  }
+
+  int ReadReply(int stream) override {
+    uint32_t seq = cras_shm_get_reply_seq(shms[stream]);
+
+    if (seq == reply_seqs[stream]) {
+      return 0;
+    }
+    reply_seqs[stream] = seq;
+    return 1;
+  }
+
+  std::vector<uint32_t> reply_seqs;
+};
+
+BENCHMARK_DEFINE_F(BM_StreamDoorbell, Period)(benchmark::State& state) {
+  for (auto _ : state) {
+    for (struct cras_audio_shm* shm : shms) {
+      benchmark::DoNotOptimize(cras_shm_post_request(shm, 480));
+    }
+    WaitReplies(state.range(0));
+  }
+  state.counters["streams"] = state.range(0);
+}
+
+BENCHMARK_REGISTER_F(BM_StreamSocket, Period)
+    ->RangeMultiplier(2)
+    ->Range(1, 64)
+    ->Arg(40)
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BM_StreamDoorbell, Period)
+    ->RangeMultiplier(2)
+    ->Range(1, 64)
+    ->Arg(40)
+    ->UseRealTime();
+
+}  // namespace
@@ -3,8 +3,10 @@
  * found in the LICENSE file.
  */
 
+#include <linux/futex.h>
 #include <sys/cdefs.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #ifdef __BIONIC__
 #include <cutils/ashmem.h>
 #else
@@ -309,3 +311,32 @@ void* cras_shm_setup(const char* name,
 
   return exp_state;
 }
+
+int cras_shm_post_request(struct cras_audio_shm* shm, uint32_t frames) {
+  shm->header->request_frames = frames;
+  __atomic_add_fetch(&shm->header->request_seq, 1, __ATOMIC_RELEASE);
+  return cras_shm_ring_doorbell(shm);
+}
+
+/* The header is shared with another process, so the futex calls must not
+ * use FUTEX_PRIVATE_FLAG. */
+int cras_shm_ring_doorbell(struct cras_audio_shm* shm) {
+  __atomic_add_fetch(&shm->header->doorbell, 1, __ATOMIC_RELEASE);
+  if (syscall(SYS_futex, &shm->header->doorbell, FUTEX_WAKE, INT32_MAX, NULL,
+              NULL, 0) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+int cras_shm_wait_doorbell(struct cras_audio_shm* shm, uint32_t doorbell) {
+  if (syscall(SYS_futex, &shm->header->doorbell, FUTEX_WAIT, doorbell, NULL,
+              NULL, 0) < 0) {
+    // EAGAIN means the doorbell was rung before going to sleep.
+    if (errno == EAGAIN || errno == EINTR) {
+      return 0;
+    }
+    return -errno;
+  }
+  return 0;
+}
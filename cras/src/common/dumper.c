@@ -81,7 +81,12 @@ static void mem_vprintf(struct dumper* dumper, const char* format, va_list ap) {
   while (1) {
     // try to use the remaining space
     int remaining = data->capacity - data->size;
-    n = vsnprintf(data->buf + data->size, remaining, format, ap);
+    va_list aq;
+
+    // ap can only be used once, retries need their own copy
+    va_copy(aq, ap);
+    n = vsnprintf(data->buf + data->size, remaining, format, aq);
+    va_end(aq);
 
     // enough space?
     if (n > -1 && n < remaining) {
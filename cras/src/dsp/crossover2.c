@@ -8,6 +8,7 @@
 #include <string.h>
 
 #include "cras/src/dsp/biquad.h"
+#include "cras/src/dsp/dsp_util.h"
 
 static void lr42_set(struct lr42* lr42, enum biquad_type type, float freq) {
   struct biquad q;
@@ -664,6 +665,189 @@ static void lr42_merge(struct lr42* lp,
 }
 #endif
 
+#if HAVE_AVX2
+#include <immintrin.h>
+
+/* The lp and hp filters of both channels in one vector. The second biquad of
+ * each LR4 runs a frame behind the first, on the output the first gave for
+ * the previous frame, so the two don't wait on each other:
+ *   lanes 0-3: first biquad (y) of lp left, lp right, hp left, hp right
+ *   lanes 4-7: second biquad (z) of the same filters
+ * Each lane evaluates the expression of the scalar filters in the same order
+ * and without FMA, so the output is the same.
+ */
+struct lr42_lanes {
+  __m256 b0, b1, b2;
+  __m256 a1, a2;
+  __m256 in1, in2;
+  __m256 out1, out2;
+};
+
+__attribute__((target("avx2"))) static inline void lr42_lanes_load(
+    struct lr42_lanes* v,
+    const struct lr42* lp,
+    const struct lr42* hp) {
+  v->b0 = _mm256_setr_ps(lp->b0, lp->b0, hp->b0, hp->b0, lp->b0, lp->b0,
+                         hp->b0, hp->b0);
+  v->b1 = _mm256_setr_ps(lp->b1, lp->b1, hp->b1, hp->b1, lp->b1, lp->b1,
+                         hp->b1, hp->b1);
+  v->b2 = _mm256_setr_ps(lp->b2, lp->b2, hp->b2, hp->b2, lp->b2, lp->b2,
+                         hp->b2, hp->b2);
+  v->a1 = _mm256_setr_ps(lp->a1, lp->a1, hp->a1, hp->a1, lp->a1, lp->a1,
+                         hp->a1, hp->a1);
+  v->a2 = _mm256_setr_ps(lp->a2, lp->a2, hp->a2, hp->a2, lp->a2, lp->a2,
+                         hp->a2, hp->a2);
+  v->in1 = _mm256_setr_ps(lp->x1L, lp->x1R, hp->x1L, hp->x1R, lp->y1L,
+                          lp->y1R, hp->y1L, hp->y1R);
+  v->in2 = _mm256_setr_ps(lp->x2L, lp->x2R, hp->x2L, hp->x2R, lp->y2L,
+                          lp->y2R, hp->y2L, hp->y2R);
+  v->out1 = _mm256_setr_ps(lp->y1L, lp->y1R, hp->y1L, hp->y1R, lp->z1L,
+                           lp->z1R, hp->z1L, hp->z1R);
+  v->out2 = _mm256_setr_ps(lp->y2L, lp->y2R, hp->y2L, hp->y2R, lp->z2L,
+                           lp->z2R, hp->z2L, hp->z2R);
+}
+
+__attribute__((target("avx2"))) static inline void lr42_lanes_store(
+    const struct lr42_lanes* v,
+    struct lr42* lp,
+    struct lr42* hp) {
+  float in1[8], in2[8], out1[8], out2[8];
+
+  _mm256_storeu_ps(in1, v->in1);
+  _mm256_storeu_ps(in2, v->in2);
+  _mm256_storeu_ps(out1, v->out1);
+  _mm256_storeu_ps(out2, v->out2);
+
+  lp->x1L = in1[0];
+  lp->x1R = in1[1];
+  hp->x1L = in1[2];
+  hp->x1R = in1[3];
+  lp->x2L = in2[0];
+  lp->x2R = in2[1];
+  hp->x2L = in2[2];
+  hp->x2R = in2[3];
+  lp->y1L = out1[0];
+  lp->y1R = out1[1];
+  hp->y1L = out1[2];
+  hp->y1R = out1[3];
+  lp->y2L = out2[0];
+  lp->y2R = out2[1];
+  hp->y2L = out2[2];
+  hp->y2R = out2[3];
+  lp->z1L = out1[4];
+  lp->z1R = out1[5];
+  hp->z1L = out1[6];
+  hp->z1R = out1[7];
+  lp->z2L = out2[4];
+  lp->z2R = out2[5];
+  hp->z2L = out2[6];
+  hp->z2R = out2[7];
+}
+
+/* Feeds one frame to the first biquads and the previous frame to the second
+ * ones. Returns the new outputs, lanes 4-7 are the filtered previous frame. */
+__attribute__((target("avx2"))) static inline __m256 lr42_lanes_step(
+    struct lr42_lanes* v,
+    float xL,
+    float xR) {
+  __m128 x = _mm_setr_ps(xL, xR, xL, xR);
+  __m256 in = _mm256_insertf128_ps(_mm256_castps128_ps256(x),
+                                   _mm256_castps256_ps128(v->out1), 1);
+  __m256 out = _mm256_mul_ps(v->b0, in);
+
+  out = _mm256_add_ps(out, _mm256_mul_ps(v->b1, v->in1));
+  out = _mm256_add_ps(out, _mm256_mul_ps(v->b2, v->in2));
+  out = _mm256_sub_ps(out, _mm256_mul_ps(v->a1, v->out1));
+  out = _mm256_sub_ps(out, _mm256_mul_ps(v->a2, v->out2));
+  v->in2 = v->in1;
+  v->in1 = in;
+  v->out2 = v->out1;
+  v->out1 = out;
+  return out;
+}
+
+/* Steps only the first biquads, for the first frame of a run. The second ones
+ * have no previous frame to filter yet. */
+__attribute__((target("avx2"))) static inline void lr42_lanes_start(
+    struct lr42_lanes* v,
+    float xL,
+    float xR) {
+  struct lr42_lanes old = *v;
+
+  lr42_lanes_step(v, xL, xR);
+  v->in1 = _mm256_blend_ps(v->in1, old.in1, 0xf0);
+  v->in2 = _mm256_blend_ps(v->in2, old.in2, 0xf0);
+  v->out1 = _mm256_blend_ps(v->out1, old.out1, 0xf0);
+  v->out2 = _mm256_blend_ps(v->out2, old.out2, 0xf0);
+}
+
+/* Steps only the second biquads, for the last frame of a run. Returns the
+ * outputs like lr42_lanes_step(). */
+__attribute__((target("avx2"))) static inline __m256 lr42_lanes_finish(
+    struct lr42_lanes* v) {
+  struct lr42_lanes old = *v;
+  __m256 out = lr42_lanes_step(v, 0, 0);
+
+  v->in1 = _mm256_blend_ps(v->in1, old.in1, 0x0f);
+  v->in2 = _mm256_blend_ps(v->in2, old.in2, 0x0f);
+  v->out1 = _mm256_blend_ps(v->out1, old.out1, 0x0f);
+  v->out2 = _mm256_blend_ps(v->out2, old.out2, 0x0f);
+  return out;
+}
+
+// Same as lr42_split() with all the filters in one vector.
+__attribute__((target("avx2"))) static void lr42_split_avx2(struct lr42* lp,
+                                                            struct lr42* hp,
+                                                            int count,
+                                                            float* data0L,
+                                                            float* data0R,
+                                                            float* data1L,
+                                                            float* data1R) {
+  struct lr42_lanes v;
+  float z[8];
+  int i;
+
+  lr42_lanes_load(&v, lp, hp);
+  lr42_lanes_start(&v, data0L[0], data0R[0]);
+  for (i = 1; i <= count; i++) {
+    if (i < count) {
+      _mm256_storeu_ps(z, lr42_lanes_step(&v, data0L[i], data0R[i]));
+    } else {
+      _mm256_storeu_ps(z, lr42_lanes_finish(&v));
+    }
+    data0L[i - 1] = z[4];
+    data0R[i - 1] = z[5];
+    data1L[i - 1] = z[6];
+    data1R[i - 1] = z[7];
+  }
+  lr42_lanes_store(&v, lp, hp);
+}
+
+// Same as lr42_merge() with all the filters in one vector.
+__attribute__((target("avx2"))) static void lr42_merge_avx2(struct lr42* lp,
+                                                            struct lr42* hp,
+                                                            int count,
+                                                            float* dataL,
+                                                            float* dataR) {
+  struct lr42_lanes v;
+  float z[8];
+  int i;
+
+  lr42_lanes_load(&v, lp, hp);
+  lr42_lanes_start(&v, dataL[0], dataR[0]);
+  for (i = 1; i <= count; i++) {
+    if (i < count) {
+      _mm256_storeu_ps(z, lr42_lanes_step(&v, dataL[i], dataR[i]));
+    } else {
+      _mm256_storeu_ps(z, lr42_lanes_finish(&v));
+    }
+    dataL[i - 1] = z[6] + z[4];
+    dataR[i - 1] = z[7] + z[5];
+  }
+  lr42_lanes_store(&v, lp, hp);
+}
+#endif
+
 void crossover2_init(struct crossover2* xo2, float freq1, float freq2) {
   int i;
   for (i = 0; i < 3; i++) {
@@ -671,6 +855,7 @@ void crossover2_init(struct crossover2* xo2, float freq1, float freq2) {
     lr42_set(&xo2->lp[i], BQ_LOWPASS, f);
     lr42_set(&xo2->hp[i], BQ_HIGHPASS, f);
   }
+  xo2->use_avx2 = !!(dsp_get_x86_features() & DSP_X86_AVX2);
 }
 
 void crossover2_process(struct crossover2* xo2,
@@ -685,6 +870,17 @@ void crossover2_process(struct crossover2* xo2,
     return;
   }
 
+#if HAVE_AVX2
+  if (xo2->use_avx2) {
+    lr42_split_avx2(&xo2->lp[0], &xo2->hp[0], count, data0L, data0R, data1L,
+                    data1R);
+    lr42_merge_avx2(&xo2->lp[1], &xo2->hp[1], count, data0L, data0R);
+    lr42_split_avx2(&xo2->lp[2], &xo2->hp[2], count, data1L, data1R, data2L,
+                    data2R);
+    return;
+  }
+#endif
+
   lr42_split(&xo2->lp[0], &xo2->hp[0], count, data0L, data0R, data1L, data1R);
   lr42_merge(&xo2->lp[1], &xo2->hp[1], count, data0L, data0R);
   lr42_split(&xo2->lp[2], &xo2->hp[2], count, data1L, data1R, data2L, data2R);
@@ -45,6 +45,9 @@ struct lr42 {
  */
 struct crossover2 {
   struct lr42 lp[3], hp[3];
+  /* Set by crossover2_init() if the AVX2 filters can be used, see
+   * dsp_set_x86_features(). */
+  int use_avx2;
 };
 
 /* Initializes a crossover2 filter
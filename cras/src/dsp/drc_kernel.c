@@ -15,6 +15,7 @@
 #include <string.h>
 
 #include "cras/src/dsp/drc_math.h"
+#include "cras/src/dsp/dsp_util.h"
 
 #define MAX_PRE_DELAY_FRAMES 1024
 #define MAX_PRE_DELAY_FRAMES_MASK (MAX_PRE_DELAY_FRAMES - 1)
@@ -54,9 +55,11 @@ void dk_init(struct drc_kernel* dk, float sample_rate) {
   dk->knee_threshold = uninitialized_value;
   dk->ratio_base = uninitialized_value;
   dk->K = uninitialized_value;
+  dk->use_avx2_fma = (dsp_get_x86_features() & (DSP_X86_AVX2 | DSP_X86_FMA)) ==
+                     (DSP_X86_AVX2 | DSP_X86_FMA);
 
   assert_on_compile_is_power_of_2(DIVISION_FRAMES);
-  assert_on_compile(DIVISION_FRAMES % 4 == 0);
+  assert_on_compile(DIVISION_FRAMES % 8 == 0);
   // Allocate predelay buffers
   assert_on_compile_is_power_of_2(MAX_PRE_DELAY_FRAMES);
   for (i = 0; i < DRC_NUM_CHANNELS; i++) {
@@ -501,6 +504,24 @@ static inline void max_abs_division(float* output,
 }
 #endif
 
+#if HAVE_AVX2
+#include <immintrin.h>
+
+__attribute__((target("avx2,fma"))) static void max_abs_division_avx2(
+    float* output,
+    const float* data0,
+    const float* data1) {
+  const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  int i;
+
+  for (i = 0; i < DIVISION_FRAMES; i += 8) {
+    __m256 x = _mm256_and_ps(_mm256_loadu_ps(data0 + i), mask);
+    __m256 y = _mm256_and_ps(_mm256_loadu_ps(data1 + i), mask);
+    _mm256_storeu_ps(output + i, _mm256_max_ps(x, y));
+  }
+}
+#endif
+
 // Update detector_average from the last input division.
 static void dk_update_detector_average(struct drc_kernel* dk) {
   float abs_input_array[DIVISION_FRAMES] = {0};
@@ -517,9 +538,19 @@ static void dk_update_detector_average(struct drc_kernel* dk) {
     div_start = dk->pre_delay_write_index - DIVISION_FRAMES;
   }
 
+  const float* data0 = &dk->pre_delay_buffers[0][div_start];
+  const float* data1 = &dk->pre_delay_buffers[1][div_start];
+
   // The max abs value across all channels for this frame
-  max_abs_division(abs_input_array, &dk->pre_delay_buffers[0][div_start],
-                   &dk->pre_delay_buffers[1][div_start]);
+#if HAVE_AVX2
+  if (dk->use_avx2_fma) {
+    max_abs_division_avx2(abs_input_array, data0, data1);
+  } else {
+    max_abs_division(abs_input_array, data0, data1);
+  }
+#else
+  max_abs_division(abs_input_array, data0, data1);
+#endif
 
   for (i = 0; i < DIVISION_FRAMES; i++) {
     // Compute compression amount from un-delayed signal
@@ -948,6 +979,92 @@ static void dk_compress_output(struct drc_kernel* dk) {
 }
 #endif
 
+#if HAVE_AVX2
+// warp_sinf() of eight values.
+__attribute__((target("avx2,fma"))) static inline __m256 warp_sin_avx2(
+    __m256 x) {
+  // See warp_sinf() for the details for the constants.
+  const __m256 A7 = _mm256_set1_ps(-4.3330336920917034149169921875e-3f);
+  const __m256 A5 = _mm256_set1_ps(7.9434238374233245849609375e-2f);
+  const __m256 A3 = _mm256_set1_ps(-0.645892798900604248046875f);
+  const __m256 A1 = _mm256_set1_ps(1.5707910060882568359375f);
+  __m256 x2 = _mm256_mul_ps(x, x);
+  __m256 x4 = _mm256_mul_ps(x2, x2);
+  __m256 lo = _mm256_fmadd_ps(A3, x2, A1);
+  __m256 hi = _mm256_fmadd_ps(A7, x2, A5);
+
+  return _mm256_mul_ps(x, _mm256_fmadd_ps(hi, x4, lo));
+}
+
+/* Same as dk_compress_output() with eight frames per step. The gains round
+ * differently with FMA, by a few ulps. */
+__attribute__((target("avx2,fma"))) static void dk_compress_output_avx2(
+    struct drc_kernel* dk) {
+  const float envelope_rate = dk->envelope_rate;
+  const float scaled_desired_gain = dk->scaled_desired_gain;
+  const float compressor_gain = dk->compressor_gain;
+  const int div_start = dk->pre_delay_read_index;
+  const __m256 g = _mm256_set1_ps(dk->main_linear_gain);
+  float* ptr_left = &dk->pre_delay_buffers[0][div_start];
+  float* ptr_right = &dk->pre_delay_buffers[1][div_start];
+  float c, r, base, limit, x0[8];
+  int i;
+
+  // Exponential approach to desired gain.
+  if (envelope_rate < 1) {
+    // Attack - reduce gain to desired.
+    c = compressor_gain - scaled_desired_gain;
+    base = scaled_desired_gain;
+    r = 1 - envelope_rate;
+    limit = INFINITY;
+  } else {
+    // Release - exponentially increase gain to 1.0
+    c = compressor_gain;
+    base = 0;
+    r = envelope_rate;
+    limit = 1;
+  }
+
+  for (i = 0; i < 8; i++) {
+    c *= r;
+    x0[i] = c;
+  }
+  float r4 = r * r * r * r;
+  const __m256 r8 = _mm256_set1_ps(r4 * r4);
+  const __m256 vbase = _mm256_set1_ps(base);
+  const __m256 vlimit = _mm256_set1_ps(limit);
+  __m256 x = _mm256_loadu_ps(x0);
+
+  for (i = 0; i < DIVISION_FRAMES; i += 8) {
+    if (i) {
+      x = _mm256_min_ps(_mm256_mul_ps(x, r8), vlimit);
+    }
+    /* Warp pre-compression gain to smooth out sharp exponential
+     * transition points, then apply the main gain. */
+    __m256 total_gain =
+        _mm256_mul_ps(g, warp_sin_avx2(_mm256_add_ps(x, vbase)));
+
+    _mm256_storeu_ps(ptr_left + i,
+                     _mm256_mul_ps(_mm256_loadu_ps(ptr_left + i), total_gain));
+    _mm256_storeu_ps(ptr_right + i,
+                     _mm256_mul_ps(_mm256_loadu_ps(ptr_right + i), total_gain));
+  }
+
+  dk->compressor_gain = x[7] + base;
+}
+#endif
+
+// Compresses the next output division with the kernel dk_init() picked.
+static void dk_compress(struct drc_kernel* dk) {
+#if HAVE_AVX2
+  if (dk->use_avx2_fma) {
+    dk_compress_output_avx2(dk);
+    return;
+  }
+#endif
+  dk_compress_output(dk);
+}
+
 /* After one complete divison of samples have been received (and one divison of
  * samples have been output), we calculate shaped power average
  * (detector_average) from the input division, update envelope parameters from
@@ -957,7 +1074,7 @@ static void dk_compress_output(struct drc_kernel* dk) {
 static void dk_process_one_division(struct drc_kernel* dk) {
   dk_update_detector_average(dk);
   dk_update_envelope(dk);
-  dk_compress_output(dk);
+  dk_compress(dk);
 }
 
 /* Copy the input data to the pre-delay buffer, and copy the output data back to
@@ -1030,7 +1147,7 @@ void dk_process(struct drc_kernel* dk, float* data_channels[], unsigned count) {
 
   if (!dk->processed) {
     dk_update_envelope(dk);
-    dk_compress_output(dk);
+    dk_compress(dk);
     dk->processed = 1;
   }
 
@@ -76,6 +76,10 @@ struct drc_kernel {
   // envelope for the current division
   float envelope_rate;
   float scaled_desired_gain;
+
+  /* Set by dk_init() if the AVX2 and FMA kernels can be used, see
+   * dsp_set_x86_features(). */
+  int use_avx2_fma;
 };
 
 // Initializes a drc kernel
@@ -457,6 +457,24 @@ static void dsp_util_deinterleave_s32le(int32_t* input,
   }
 }
 
+static void dsp_util_deinterleave_f32le(float* input,
+                                        float* const* output,
+                                        int channels,
+                                        int frames) {
+  float* output_ptr[channels];
+  int i, j;
+
+  for (i = 0; i < channels; i++) {
+    output_ptr[i] = output[i];
+  }
+
+  for (i = 0; i < frames; i++) {
+    for (j = 0; j < channels; j++, input++) {
+      *(output_ptr[j]++) = *input;
+    }
+  }
+}
+
 int dsp_util_deinterleave(uint8_t* input,
                           float* const* output,
                           int channels,
@@ -475,6 +493,9 @@ int dsp_util_deinterleave(uint8_t* input,
     case SND_PCM_FORMAT_S32_LE:
       dsp_util_deinterleave_s32le((int32_t*)input, output, channels, frames);
       break;
+    case SND_PCM_FORMAT_FLOAT_LE:
+      dsp_util_deinterleave_f32le((float*)input, output, channels, frames);
+      break;
     default:
       syslog(LOG_ERR, "Invalid format to deinterleave");
       return -EINVAL;
@@ -573,6 +594,24 @@ static void dsp_util_interleave_s32le(float* const* input,
   }
 }
 
+static void dsp_util_interleave_f32le(float* const* input,
+                                      float* output,
+                                      int channels,
+                                      int frames) {
+  float* input_ptr[channels];
+  int i, j;
+
+  for (i = 0; i < channels; i++) {
+    input_ptr[i] = input[i];
+  }
+
+  for (i = 0; i < frames; i++) {
+    for (j = 0; j < channels; j++) {
+      *output++ = *(input_ptr[j]++);
+    }
+  }
+}
+
 int dsp_util_interleave(float* const* input,
                         uint8_t* output,
                         int channels,
@@ -591,6 +630,9 @@ int dsp_util_interleave(float* const* input,
     case SND_PCM_FORMAT_S32_LE:
       dsp_util_interleave_s32le(input, (int32_t*)output, channels, frames);
       break;
+    case SND_PCM_FORMAT_FLOAT_LE:
+      dsp_util_interleave_f32le(input, (float*)output, channels, frames);
+      break;
     default:
       syslog(LOG_ERR, "Invalid format to interleave");
       return -EINVAL;
@@ -598,6 +640,16 @@ int dsp_util_interleave(float* const* input,
   return 0;
 }
 
+static unsigned int x86_features;
+
+void dsp_set_x86_features(unsigned int features) {
+  x86_features = features;
+}
+
+unsigned int dsp_get_x86_features() {
+  return x86_features;
+}
+
 void dsp_enable_flush_denormal_to_zero() {
 #if defined(__i386__) || defined(__x86_64__)
   unsigned int mxcsr;
@@ -16,7 +16,7 @@ extern "C" {
 
 /* Converts from interleaved int16_t samples to non-interleaved float samples.
  * The int16_t samples have range [-32768, 32767], and the float samples have
- * range [-1.0, 1.0].
+ * range [-1.0, 1.0]. SND_PCM_FORMAT_FLOAT_LE input is only deinterleaved.
  * Args:
  *    input - The interleaved input buffer. Every "channels" samples is a frame.
  *    output - Pointers to output buffers. There are "channels" output buffers.
@@ -54,6 +54,20 @@ int dsp_util_interleave(float* const* input,
  */
 void dsp_enable_flush_denormal_to_zero();
 
+// x86 instruction sets the DSP kernels can use besides the build target's.
+#define DSP_X86_AVX2 (1 << 0)
+#define DSP_X86_FMA (1 << 1)
+
+/* Sets the DSP_X86_* instruction sets the CPU runs reliably. The server
+ * derives them from cpu_get_flags(), which knows the CPUs that crash with FMA.
+ * The kernels check them when a filter is initialized, so this should be
+ * called before any is created. None are used by default.
+ */
+void dsp_set_x86_features(unsigned int features);
+
+// Returns the DSP_X86_* instruction sets given to dsp_set_x86_features().
+unsigned int dsp_get_x86_features();
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
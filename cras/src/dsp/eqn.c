@@ -0,0 +1,186 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cras/src/dsp/eqn.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cras/src/dsp/dsp_util.h"
+
+// Frames moved into the lane layout at a time.
+#define BLOCK_FRAMES 64
+
+// One sample of each channel, channel ch in lane ch.
+typedef float lanes_t __attribute__((vector_size(MAX_EQN_CHANNELS * 4)));
+
+/* The ith biquad of every channel. Lanes of channels with fewer biquads, or
+ * beyond num_channels, hold identity filters. */
+struct eqn_stage {
+  lanes_t b0, b1, b2;
+  lanes_t a1, a2;
+  lanes_t x1, x2;
+  lanes_t y1, y2;
+};
+
+struct eqn {
+  int num_channels;
+  int n[MAX_EQN_CHANNELS];
+  // The number of stages to run, the largest of n.
+  int num_stages;
+  struct eqn_stage stage[MAX_BIQUADS_PER_EQN];
+  void (*process_block)(struct eqn_stage* stages,
+                        int num_stages,
+                        lanes_t* buf,
+                        int count);
+};
+
+/* Runs the stages over a block in the lane layout. The expression is the one
+ * eq_process() evaluates, so every lane gives the same samples as the scalar
+ * filter of its channel. */
+static inline __attribute__((always_inline)) void process_block_lanes(
+    struct eqn_stage* stages,
+    int num_stages,
+    lanes_t* buf,
+    int count) {
+  for (int i = 0; i < num_stages; i++) {
+    struct eqn_stage* q = &stages[i];
+    lanes_t b0 = q->b0, b1 = q->b1, b2 = q->b2;
+    lanes_t a1 = q->a1, a2 = q->a2;
+    lanes_t x1 = q->x1, x2 = q->x2;
+    lanes_t y1 = q->y1, y2 = q->y2;
+
+    for (int j = 0; j < count; j++) {
+      lanes_t x = buf[j];
+      lanes_t y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+      buf[j] = y;
+      x2 = x1;
+      x1 = x;
+      y2 = y1;
+      y1 = y;
+    }
+
+    q->x1 = x1;
+    q->x2 = x2;
+    q->y1 = y1;
+    q->y2 = y2;
+  }
+}
+
+static void process_block(struct eqn_stage* stages,
+                          int num_stages,
+                          lanes_t* buf,
+                          int count) {
+  process_block_lanes(stages, num_stages, buf, count);
+}
+
+#if HAVE_AVX2
+// All eight lanes in one register. Not built with FMA to keep the rounding.
+__attribute__((target("avx2"))) static void process_block_avx2(
+    struct eqn_stage* stages,
+    int num_stages,
+    lanes_t* buf,
+    int count) {
+  process_block_lanes(stages, num_stages, buf, count);
+}
+#endif
+
+struct eqn* eqn_new(int num_channels) {
+  int i, ch;
+  struct eqn* eqn;
+
+  if (num_channels < 1 || num_channels > MAX_EQN_CHANNELS) {
+    return NULL;
+  }
+  eqn = aligned_alloc(sizeof(lanes_t), sizeof(*eqn));
+  if (!eqn) {
+    return NULL;
+  }
+  memset(eqn, 0, sizeof(*eqn));
+  eqn->num_channels = num_channels;
+
+  // Identity filters in all lanes, the history is already cleared.
+  for (i = 0; i < MAX_BIQUADS_PER_EQN; i++) {
+    for (ch = 0; ch < MAX_EQN_CHANNELS; ch++) {
+      eqn->stage[i].b0[ch] = 1;
+    }
+  }
+
+  eqn->process_block = process_block;
+#if HAVE_AVX2
+  if (dsp_get_x86_features() & DSP_X86_AVX2) {
+    eqn->process_block = process_block_avx2;
+  }
+#endif
+  return eqn;
+}
+
+void eqn_free(struct eqn* eqn) {
+  free(eqn);
+}
+
+int eqn_append_biquad(struct eqn* eqn,
+                      int channel,
+                      enum biquad_type type,
+                      float freq,
+                      float Q,
+                      float gain) {
+  struct biquad bq;
+
+  biquad_set(&bq, type, freq, Q, gain);
+  return eqn_append_biquad_direct(eqn, channel, &bq);
+}
+
+int eqn_append_biquad_direct(struct eqn* eqn,
+                             int channel,
+                             const struct biquad* biquad) {
+  struct eqn_stage* q;
+
+  if (channel < 0 || channel >= eqn->num_channels ||
+      eqn->n[channel] >= MAX_BIQUADS_PER_EQN) {
+    return -EINVAL;
+  }
+  q = &eqn->stage[eqn->n[channel]++];
+  q->b0[channel] = biquad->b0;
+  q->b1[channel] = biquad->b1;
+  q->b2[channel] = biquad->b2;
+  q->a1[channel] = biquad->a1;
+  q->a2[channel] = biquad->a2;
+  q->x1[channel] = biquad->x1;
+  q->x2[channel] = biquad->x2;
+  q->y1[channel] = biquad->y1;
+  q->y2[channel] = biquad->y2;
+  if (eqn->n[channel] > eqn->num_stages) {
+    eqn->num_stages = eqn->n[channel];
+  }
+  return 0;
+}
+
+void eqn_process(struct eqn* eqn, float** data, int count) {
+  // Lanes without a channel stay zero.
+  lanes_t buf[BLOCK_FRAMES] = {};
+  int num_channels = eqn->num_channels;
+
+  if (!eqn->num_stages) {
+    return;
+  }
+  for (int start = 0; start < count; start += BLOCK_FRAMES) {
+    int frames = count - start < BLOCK_FRAMES ? count - start : BLOCK_FRAMES;
+
+    for (int ch = 0; ch < num_channels; ch++) {
+      const float* in = data[ch] + start;
+      for (int j = 0; j < frames; j++) {
+        buf[j][ch] = in[j];
+      }
+    }
+    eqn->process_block(eqn->stage, eqn->num_stages, buf, frames);
+    for (int ch = 0; ch < num_channels; ch++) {
+      float* out = data[ch] + start;
+      for (int j = 0; j < frames; j++) {
+        out[j] = buf[j][ch];
+      }
+    }
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRAS_SRC_DSP_EQN_H_
+#define CRAS_SRC_DSP_EQN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "eqn" is a multichannel version of the "eq2" filter. The same biquad stage
+ * of every channel is run in one vector, one channel per lane, so up to
+ * MAX_EQN_CHANNELS channels are filtered for the cost of one. */
+
+#include "cras/src/dsp/biquad.h"
+
+// Maximum number of channels an EQN can filter
+#define MAX_EQN_CHANNELS 8
+
+// Maximum number of biquad filters an EQN can have per channel
+#define MAX_BIQUADS_PER_EQN 10
+
+struct eqn;
+
+/* Create an EQN.
+ * Args:
+ *    num_channels - The number of channels, at most MAX_EQN_CHANNELS.
+ * Returns:
+ *    The EQN, or NULL if num_channels is out of range or out of memory.
+ */
+struct eqn* eqn_new(int num_channels);
+
+// Free an EQN.
+void eqn_free(struct eqn* eqn);
+
+/* Append a biquad filter to a channel of an EQN. An EQN can have at most
+ * MAX_BIQUADS_PER_EQN biquad filters per channel.
+ * Args:
+ *    eqn - The EQN we want to use.
+ *    channel - The channel we want to append the filter to.
+ *    type - The type of the biquad filter we want to append.
+ *    frequency - The value should be in the range [0, 1]. It is relative to
+ *        half of the sampling rate.
+ *    Q, gain - The meaning depends on the type of the filter. See Web Audio
+ *        API for details.
+ * Returns:
+ *    0 if success. -EINVAL if the channel is out of range or has no room for
+ *    more biquads.
+ */
+int eqn_append_biquad(struct eqn* eqn,
+                      int channel,
+                      enum biquad_type type,
+                      float freq,
+                      float Q,
+                      float gain);
+
+/* Append a biquad filter to a channel of an EQN. This is similar to
+ * eqn_append_biquad(), but it specifies the biquad coefficients directly.
+ * Args:
+ *    eqn - The EQN we want to use.
+ *    channel - The channel we want to append the filter to.
+ *    biquad - The parameters for the biquad filter.
+ * Returns:
+ *    0 if success. -EINVAL if the channel is out of range or has no room for
+ *    more biquads.
+ */
+int eqn_append_biquad_direct(struct eqn* eqn,
+                             int channel,
+                             const struct biquad* biquad);
+
+/* Process a buffer of audio data through the EQN.
+ * Args:
+ *    eqn - The EQN we want to use.
+ *    data - The arrays of audio samples, one per channel.
+ *    count - The number of elements in each of the data array to process.
+ */
+void eqn_process(struct eqn* eqn, float** data, int count);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_DSP_EQN_H_
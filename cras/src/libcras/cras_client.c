@@ -33,7 +33,9 @@
 #include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/ipc.h>
 #include <sys/mman.h>
@@ -128,6 +130,31 @@ struct thread_state {
   enum CRAS_THREAD_STATE state;
 };
 
+// Maximum number of shared callback threads of a client.
+#define CRAS_MAX_CALLBACK_THREADS 8
+
+/* A thread servicing the audio messages of several streams, used instead of
+ * a thread per stream when enabled with cras_client_set_num_callback_threads.
+ */
+struct callback_thread {
+  pthread_t tid;
+  // The client whose streams are serviced.
+  struct cras_client* client;
+  // Waits on wake_fd and on the aud_fd of every stream on this thread.
+  int epoll_fd;
+  // Eventfd to wake the thread when it has to exit.
+  int wake_fd;
+  // Held while streams are serviced, and to add or remove them.
+  pthread_mutex_t mutex;
+  // Cleared to make the thread exit.
+  bool running;
+  /* Incremented when a stream is removed so the thread drops events it
+   * got for that stream before taking the mutex. */
+  uint32_t epoch;
+  // Number of streams assigned to this thread.
+  unsigned int num_streams;
+};
+
 /* Parameters used when setting up a capture or playback stream. See comment
  * above cras_client_stream_params_create or libcras_stream_params_set in the
  * header for descriptions. */
@@ -145,6 +172,7 @@ struct cras_stream_params {
   cras_error_cb_t err_cb;
   struct cras_audio_format format;
   libcras_stream_cb_t stream_cb;
+  bool direct_io;
 };
 
 // Represents an attached audio stream.
@@ -153,6 +181,11 @@ struct client_stream {
   cras_stream_id_t id;
   // After server connects audio messages come in here.
   int aud_fd;  // audio messages from server come in here.
+  /* Eventfd to ring the server after posting a reply in shm. Only valid
+   * once the server accepted SHM_DOORBELL, which is then set in flags. */
+  int doorbell_fd;
+  // The latest request_seq handled from the shm header.
+  uint32_t request_seq;
   // playback, capture, or loopback (see CRAS_STREAM_DIRECTION).
   enum CRAS_STREAM_DIRECTION direction;
   // Currently only used for CRAS_INPUT_STREAM_FLAG.
@@ -170,6 +203,14 @@ struct client_stream {
   struct cras_stream_params* config;
   // Shared memory used to exchange audio samples with the server.
   struct cras_audio_shm* shm;
+  // The shared thread servicing this stream, or NULL if it has its own.
+  struct callback_thread* cb_thread;
+  // Set while aud_fd is watched by cb_thread.
+  bool cb_watched;
+  // Set between the begin and commit calls of a direct io stream.
+  bool io_pending;
+  // Number of frames handed out by the last direct io begin call.
+  unsigned int io_frames;
   // Form a linked list of streams attached to a client.
   struct client_stream *prev, *next;
 };
@@ -243,6 +284,9 @@ struct cras_client {
   int last_command_result;
   // Linked list of streams attached to this client.
   struct client_stream* streams;
+  /* Protects the list of streams against lookups from application threads
+   * of direct io streams. Only the client thread changes the list. */
+  pthread_mutex_t streams_lock;
   // RO shared memory region holding server state.
   const struct cras_server_state* server_state;
   // RO shared memory region holding audio thread log.
@@ -259,10 +303,16 @@ struct cras_client {
   void* server_connection_user_arg;
   // Function to call for setting audio thread priority.
   cras_thread_priority_cb_t thread_priority_cb;
+  // Number of shared threads servicing streams, 0 for a thread per stream.
+  unsigned int num_callback_threads;
+  // The shared callback threads, started when the first stream is added.
+  struct callback_thread* callback_threads;
   // Functions to call when system state changes.
   struct cras_observer_ops observer_ops;
   // Context passed to client in state change callbacks.
   void* observer_context;
+  // Minimum time between state change callbacks, 0 for no limit.
+  unsigned int notification_interval_ms;
   struct floop_request* floop_request_list;
   pthread_mutex_t floop_request_list_mu;
 };
@@ -1149,6 +1199,53 @@ static int read_with_wake_fd(int wake_fd,
 
   return nread;
 }
+
+// Checks if the server accepted to exchange audio messages through shm.
+static inline bool stream_uses_doorbell(const struct client_stream* stream) {
+  return stream->flags & SHM_DOORBELL;
+}
+
+/* Blocks until the server posts a request in shm or the thread is woken by
+ * wake_aud_thread(). Fills "msg" as if it was read from the audio socket.
+ * Returns:
+ *    sizeof(*msg) if a request was received, 0 if woken without one, or
+ *    negative error code.
+ */
+static int wait_for_doorbell(struct client_stream* stream,
+                             struct audio_message* msg) {
+  struct cras_audio_shm* shm = stream->shm;
+  uint32_t doorbell = cras_shm_get_doorbell(shm);
+  uint32_t seq = cras_shm_get_request_seq(shm);
+
+  if (seq == stream->request_seq) {
+    /* The doorbell was sampled before checking the thread state so that
+     * a concurrent stop_aud_thread() can't be missed. */
+    if (!thread_is_running(&stream->thread)) {
+      return 0;
+    }
+    return cras_shm_wait_doorbell(shm, doorbell);
+  }
+
+  stream->request_seq = seq;
+  msg->id = stream->direction == CRAS_STREAM_OUTPUT
+                ? AUDIO_MESSAGE_REQUEST_DATA
+                : AUDIO_MESSAGE_DATA_READY;
+  msg->frames = cras_shm_get_request_frames(shm);
+  msg->error = 0;
+  return sizeof(*msg);
+}
+
+// Posts a reply in shm and rings the server.
+static int ring_server_doorbell(struct client_stream* stream, int err) {
+  uint64_t one = 1;
+
+  cras_shm_post_reply(stream->shm, err);
+  if (write(stream->doorbell_fd, &one, sizeof(one)) != sizeof(one)) {
+    return -EPIPE;
+  }
+  return 0;
+}
+
 /* Check the availability and configures a capture buffer.
  * Args:
  *     stream - The input stream to configure buffer for.
@@ -1197,6 +1294,10 @@ static int send_capture_reply(struct client_stream* stream,
     return 0;
   }
 
+  if (stream_uses_doorbell(stream)) {
+    return ring_server_doorbell(stream, err);
+  }
+
   aud_msg.id = AUDIO_MESSAGE_DATA_CAPTURED;
   aud_msg.frames = frames;
   aud_msg.error = err;
@@ -1290,6 +1391,10 @@ static int send_playback_reply(struct client_stream* stream,
     return 0;
   }
 
+  if (stream_uses_doorbell(stream)) {
+    return ring_server_doorbell(stream, error);
+  }
+
   aud_msg.id = AUDIO_MESSAGE_DATA_READY;
   aud_msg.frames = frames;
   aud_msg.error = error;
@@ -1369,10 +1474,10 @@ reply_written:
   return rc;
 }
 
-static void audio_thread_set_priority(struct client_stream* stream) {
+static void audio_thread_set_priority(struct cras_client* client) {
   // Use provided callback to set priority if available.
-  if (stream->client->thread_priority_cb) {
-    stream->client->thread_priority_cb(stream->client);
+  if (client->thread_priority_cb) {
+    client->thread_priority_cb(client);
     return;
   }
 
@@ -1383,6 +1488,22 @@ static void audio_thread_set_priority(struct client_stream* stream) {
   }
 }
 
+/* Dispatches an audio message from the server to the stream callback.
+ * Returns:
+ *    0, unless there is a fatal error or the client declares end of file.
+ */
+static int handle_audio_message(struct client_stream* stream,
+                                const struct audio_message* aud_msg) {
+  switch (aud_msg->id) {
+    case AUDIO_MESSAGE_DATA_READY:
+      return handle_capture_data_ready(stream, aud_msg->frames);
+    case AUDIO_MESSAGE_REQUEST_DATA:
+      return handle_playback_request(stream, aud_msg->frames);
+    default:
+      return 0;
+  }
+}
+
 /* Listens to the audio socket for messages from the server indicating that
  * the stream needs to be serviced.  One of these runs per stream. */
 static void* audio_thread(void* arg) {
@@ -1396,7 +1517,7 @@ static void* audio_thread(void* arg) {
     return (void*)-EIO;
   }
 
-  audio_thread_set_priority(stream);
+  audio_thread_set_priority(stream->client);
 
   // Notify the control thread that we've started.
   pthread_mutex_lock(&stream->client->stream_start_lock);
@@ -1407,8 +1528,12 @@ static void* audio_thread(void* arg) {
     /* While we are warming up, aud_fd may not be valid and some
      * shared memory resources may not yet be available. */
     aud_fd = (stream->thread.state == CRAS_THREAD_WARMUP) ? -1 : stream->aud_fd;
-    num_read = read_with_wake_fd(stream->wake_fds[0], aud_fd,
-                                 (uint8_t*)&aud_msg, sizeof(aud_msg));
+    if (aud_fd >= 0 && stream_uses_doorbell(stream)) {
+      num_read = wait_for_doorbell(stream, &aud_msg);
+    } else {
+      num_read = read_with_wake_fd(stream->wake_fds[0], aud_fd,
+                                   (uint8_t*)&aud_msg, sizeof(aud_msg));
+    }
     if (num_read < 0) {
       return (void*)-EIO;
     }
@@ -1416,21 +1541,208 @@ static void* audio_thread(void* arg) {
       continue;
     }
 
-    switch (aud_msg.id) {
-      case AUDIO_MESSAGE_DATA_READY:
-        thread_terminated = handle_capture_data_ready(stream, aud_msg.frames);
-        break;
-      case AUDIO_MESSAGE_REQUEST_DATA:
-        thread_terminated = handle_playback_request(stream, aud_msg.frames);
-        break;
-      default:
-        break;
+    thread_terminated = handle_audio_message(stream, &aud_msg);
+  }
+
+  return NULL;
+}
+
+/* Stops servicing a stream on its shared thread. Called with the mutex
+ * held. */
+static void callback_thread_unwatch_locked(struct client_stream* stream) {
+  struct callback_thread* cb_thread = stream->cb_thread;
+
+  if (!stream->cb_watched) {
+    return;
+  }
+  epoll_ctl(cb_thread->epoll_fd, EPOLL_CTL_DEL, stream->aud_fd, NULL);
+  cb_thread->epoch++;
+  stream->cb_watched = false;
+}
+
+/* Services the audio messages of all the streams assigned to a shared
+ * callback thread. */
+static void* callback_thread_loop(void* arg) {
+  struct callback_thread* cb_thread = (struct callback_thread*)arg;
+  struct epoll_event events[16];
+  struct audio_message aud_msg;
+  struct client_stream* stream;
+  uint32_t epoch;
+  int i, n, rc;
+
+  audio_thread_set_priority(cb_thread->client);
+
+  while (1) {
+    pthread_mutex_lock(&cb_thread->mutex);
+    epoch = cb_thread->epoch;
+    if (!cb_thread->running) {
+      pthread_mutex_unlock(&cb_thread->mutex);
+      break;
     }
+    pthread_mutex_unlock(&cb_thread->mutex);
+
+    n = epoll_wait(cb_thread->epoll_fd, events, ARRAY_SIZE(events), -1);
+    if (n < 0 && errno != EINTR) {
+      syslog(LOG_WARNING, "cras_client: callback thread wait: %s",
+             cras_strerror(errno));
+      break;
+    }
+
+    pthread_mutex_lock(&cb_thread->mutex);
+    /* Events of a removed stream may have been returned before it was
+     * removed. Drop the batch, the remaining ones are level triggered and
+     * will show up again. */
+    for (i = 0; i < n && cb_thread->epoch == epoch; i++) {
+      stream = (struct client_stream*)events[i].data.ptr;
+      if (!stream) {
+        eventfd_t value;
+        eventfd_read(cb_thread->wake_fd, &value);
+        continue;
+      }
+      rc = read(stream->aud_fd, &aud_msg, sizeof(aud_msg));
+      if (rc != sizeof(aud_msg) || handle_audio_message(stream, &aud_msg)) {
+        // Same as the exit of a dedicated audio thread.
+        callback_thread_unwatch_locked(stream);
+      }
+    }
+    pthread_mutex_unlock(&cb_thread->mutex);
   }
 
   return NULL;
 }
 
+static void callback_thread_stop(struct callback_thread* cb_thread) {
+  pthread_mutex_lock(&cb_thread->mutex);
+  cb_thread->running = false;
+  pthread_mutex_unlock(&cb_thread->mutex);
+  eventfd_write(cb_thread->wake_fd, 1);
+  pthread_join(cb_thread->tid, NULL);
+}
+
+/* Stops and frees the shared callback threads of a client. All streams must
+ * have been removed. */
+static void callback_threads_destroy(struct cras_client* client) {
+  struct callback_thread* cb_thread;
+  unsigned int i;
+
+  if (!client->callback_threads) {
+    return;
+  }
+  for (i = 0; i < client->num_callback_threads; i++) {
+    cb_thread = &client->callback_threads[i];
+    if (cb_thread->epoll_fd < 0) {
+      continue;
+    }
+    if (cb_thread->running) {
+      callback_thread_stop(cb_thread);
+    }
+    close(cb_thread->epoll_fd);
+    close(cb_thread->wake_fd);
+    pthread_mutex_destroy(&cb_thread->mutex);
+  }
+  free(client->callback_threads);
+  client->callback_threads = NULL;
+}
+
+static int callback_thread_start(struct callback_thread* cb_thread) {
+  struct epoll_event ev = {.events = EPOLLIN, .data = {.ptr = NULL}};
+  int rc;
+
+  cb_thread->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (cb_thread->epoll_fd < 0) {
+    return -errno;
+  }
+  cb_thread->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (cb_thread->wake_fd < 0) {
+    rc = -errno;
+    close(cb_thread->epoll_fd);
+    cb_thread->epoll_fd = -1;
+    return rc;
+  }
+  pthread_mutex_init(&cb_thread->mutex, NULL);
+  if (epoll_ctl(cb_thread->epoll_fd, EPOLL_CTL_ADD, cb_thread->wake_fd, &ev)) {
+    return -errno;
+  }
+  cb_thread->running = true;
+  rc = pthread_create(&cb_thread->tid, NULL, callback_thread_loop, cb_thread);
+  if (rc) {
+    cb_thread->running = false;
+    return -rc;
+  }
+  return 0;
+}
+
+/* Assigns a stream to the shared callback thread with the fewest streams,
+ * starting the threads when the first stream is added. */
+static int callback_thread_assign(struct client_stream* stream) {
+  struct cras_client* client = stream->client;
+  struct callback_thread* cb_thread;
+  unsigned int i;
+  int rc;
+
+  if (!client->callback_threads) {
+    client->callback_threads = (struct callback_thread*)calloc(
+        client->num_callback_threads, sizeof(*client->callback_threads));
+    if (!client->callback_threads) {
+      return -ENOMEM;
+    }
+    for (i = 0; i < client->num_callback_threads; i++) {
+      client->callback_threads[i].client = client;
+      client->callback_threads[i].epoll_fd = -1;
+    }
+    for (i = 0; i < client->num_callback_threads; i++) {
+      rc = callback_thread_start(&client->callback_threads[i]);
+      if (rc < 0) {
+        syslog(LOG_WARNING, "cras_client: Couldn't create callback thread: %s",
+               cras_strerror(-rc));
+        callback_threads_destroy(client);
+        return rc;
+      }
+    }
+  }
+
+  cb_thread = &client->callback_threads[0];
+  for (i = 1; i < client->num_callback_threads; i++) {
+    if (client->callback_threads[i].num_streams < cb_thread->num_streams) {
+      cb_thread = &client->callback_threads[i];
+    }
+  }
+
+  pthread_mutex_lock(&cb_thread->mutex);
+  cb_thread->num_streams++;
+  stream->cb_thread = cb_thread;
+  pthread_mutex_unlock(&cb_thread->mutex);
+  return 0;
+}
+
+// Starts servicing a connected stream on its shared callback thread.
+static int callback_thread_watch(struct client_stream* stream) {
+  struct callback_thread* cb_thread = stream->cb_thread;
+  struct epoll_event ev = {.events = EPOLLIN, .data = {.ptr = stream}};
+  int rc = 0;
+
+  pthread_mutex_lock(&cb_thread->mutex);
+  if (epoll_ctl(cb_thread->epoll_fd, EPOLL_CTL_ADD, stream->aud_fd, &ev)) {
+    rc = -errno;
+  } else {
+    stream->cb_watched = true;
+  }
+  pthread_mutex_unlock(&cb_thread->mutex);
+  return rc;
+}
+
+/* Removes a stream from its shared callback thread. Returns once the
+ * thread is no longer servicing it. */
+static void callback_thread_release(struct client_stream* stream) {
+  struct callback_thread* cb_thread = stream->cb_thread;
+
+  pthread_mutex_lock(&cb_thread->mutex);
+  callback_thread_unwatch_locked(stream);
+  cb_thread->num_streams--;
+  pthread_mutex_unlock(&cb_thread->mutex);
+  stream->cb_thread = NULL;
+}
+
 // Pokes the audio thread so that it can notice if it has been terminated.
 static int wake_aud_thread(struct client_stream* stream) {
   char buf[1] = {0};
@@ -1440,6 +1752,10 @@ static int wake_aud_thread(struct client_stream* stream) {
   if (rc != 1) {
     return rc;
   }
+  // The audio thread sleeps on the doorbell instead of the pipe if any.
+  if (stream_uses_doorbell(stream) && stream->shm) {
+    return cras_shm_ring_doorbell(stream->shm);
+  }
   return 0;
 }
 
@@ -1450,6 +1766,17 @@ static int wake_aud_thread(struct client_stream* stream) {
  *           complete).
  */
 static void stop_aud_thread(struct client_stream* stream, int join) {
+  if (stream->cb_thread) {
+    stream->thread.state = CRAS_THREAD_STOP;
+    callback_thread_release(stream);
+    return;
+  }
+
+  if (stream->config->direct_io) {
+    stream->thread.state = CRAS_THREAD_STOP;
+    return;
+  }
+
   if (thread_is_running(&stream->thread)) {
     stream->thread.state = CRAS_THREAD_STOP;
     wake_aud_thread(stream);
@@ -1476,6 +1803,20 @@ static int start_aud_thread(struct client_stream* stream) {
   int rc;
   struct timespec future;
 
+  // The application moves the samples of direct io streams itself.
+  if (stream->config->direct_io) {
+    stream->thread.state = CRAS_THREAD_WARMUP;
+    return 0;
+  }
+
+  if (stream->client->num_callback_threads) {
+    rc = callback_thread_assign(stream);
+    if (rc == 0) {
+      stream->thread.state = CRAS_THREAD_WARMUP;
+    }
+    return rc;
+  }
+
   rc = pipe(stream->wake_fds);
   if (rc < 0) {
     rc = -errno;
@@ -1552,13 +1893,14 @@ static void free_shm(struct client_stream* stream) {
  * thread that will handle requests from the server. */
 static int stream_connected(struct client_stream* stream,
                             const struct cras_client_stream_connected* msg,
-                            const int stream_fds[2],
+                            const int stream_fds[3],
                             const unsigned int num_fds) {
   int rc, samples_prot;
   unsigned int i;
   struct cras_shm_info header_info, samples_info;
 
-  if (msg->err || num_fds != 2) {
+  // A third fd means the server accepted the SHM_DOORBELL transport.
+  if (msg->err || num_fds < 2 || num_fds > 3) {
     syslog(LOG_WARNING, "cras_client: Error setting up stream %d\n", msg->err);
     rc = msg->err;
     goto err_ret;
@@ -1591,9 +1933,23 @@ static int stream_connected(struct client_stream* stream,
   }
   cras_shm_copy_shared_config(stream->shm);
   cras_shm_set_volume_scaler(stream->shm, stream->volume_scaler);
+  if (num_fds == 3) {
+    stream->doorbell_fd = stream_fds[2];
+    stream->flags |= SHM_DOORBELL;
+    /* The server counts requests from zero and may post the first one
+     * before this reply is handled. */
+    stream->request_seq = 0;
+  }
 
   stream->thread.state = CRAS_THREAD_RUNNING;
-  wake_aud_thread(stream);
+  if (stream->cb_thread) {
+    rc = callback_thread_watch(stream);
+    if (rc < 0) {
+      goto err_ret;
+    }
+  } else if (!stream->config->direct_io) {
+    wake_aud_thread(stream);
+  }
 
   close(stream_fds[0]);
   close(stream_fds[1]);
@@ -1607,6 +1963,15 @@ err_ret:
   return rc;
 }
 
+/* Shared callback threads wait on the stream sockets, so only streams with
+ * their own thread can sleep on the shm doorbell. */
+static uint32_t stream_connect_flags(const struct client_stream* stream) {
+  if (stream->cb_thread || stream->config->direct_io) {
+    return stream->flags;
+  }
+  return stream->flags | SHM_DOORBELL;
+}
+
 static int send_connect_message(struct cras_client* client,
                                 struct client_stream* stream,
                                 uint32_t dev_idx) {
@@ -1626,7 +1991,8 @@ static int send_connect_message(struct cras_client* client,
       &serv_msg, stream->config->direction, stream->id,
       stream->config->stream_type, stream->config->client_type,
       stream->config->buffer_frames, stream->config->cb_threshold,
-      stream->flags, stream->config->effects, stream->config->format, dev_idx);
+      stream_connect_flags(stream), stream->config->effects,
+      stream->config->format, dev_idx);
 
   rc = cras_send_with_fds(client->server_fd, &serv_msg, sizeof(serv_msg),
                           &sock[1], 1);
@@ -1712,7 +2078,9 @@ static int client_thread_add_stream(struct cras_client* client,
   }
 
   // Add the stream to the linked list
+  pthread_mutex_lock(&client->streams_lock);
   DL_APPEND(client->streams, stream);
+  pthread_mutex_unlock(&client->streams_lock);
 
   return 0;
 }
@@ -1743,10 +2111,15 @@ static int client_thread_rm_stream(struct cras_client* client,
 
   free_shm(stream);
 
+  pthread_mutex_lock(&client->streams_lock);
   DL_DELETE(client->streams, stream);
+  pthread_mutex_unlock(&client->streams_lock);
   if (stream->aud_fd >= 0) {
     close(stream->aud_fd);
   }
+  if (stream_uses_doorbell(stream)) {
+    close(stream->doorbell_fd);
+  }
 
   free(stream->config);
   free(stream);
@@ -1872,94 +2245,10 @@ cleanup:
   return;
 }
 
-// Handles messages from the cras server.
-static int handle_message_from_server(struct cras_client* client) {
-  uint8_t buf[CRAS_CLIENT_MAX_MSG_SIZE];
-  struct cras_client_message* msg;
-  int rc = 0;
-  int nread;
-  int server_fds[2];
-  unsigned int num_fds = 2;
-
-  msg = (struct cras_client_message*)buf;
-  nread = cras_recv_with_fds(client->server_fd, buf, sizeof(buf), server_fds,
-                             &num_fds);
-  if (nread < (int)sizeof(msg->length) || (int)msg->length != nread) {
-    return -EIO;
-  }
-
+// Calls the observer callback for a state change notification from the server.
+static void handle_notification(struct cras_client* client,
+                                struct cras_client_message* msg) {
   switch (msg->id) {
-    case CRAS_CLIENT_CONNECTED: {
-      struct cras_client_connected* cmsg = (struct cras_client_connected*)msg;
-      if (num_fds != 1) {
-        return -EINVAL;
-      }
-      rc = client_attach_shm(client, server_fds[0]);
-      if (rc) {
-        return rc;
-      }
-      client->id = cmsg->client_id;
-
-      break;
-    }
-    case CRAS_CLIENT_STREAM_CONNECTED: {
-      struct cras_client_stream_connected* cmsg =
-          (struct cras_client_stream_connected*)msg;
-      struct client_stream* stream = stream_from_id(client, cmsg->stream_id);
-      if (stream == NULL) {
-        if (num_fds != 2) {
-          syslog(LOG_WARNING,
-                 "cras_client: Error receiving "
-                 "stream 0x%x connected message",
-                 cmsg->stream_id);
-          return -EINVAL;
-        }
-
-        /*
-         * Usually, the fds should be closed in stream_connected
-         * callback. However, sometimes a stream is removed
-         * before it is connected.
-         */
-        close(server_fds[0]);
-        close(server_fds[1]);
-        break;
-      }
-      rc = stream_connected(stream, cmsg, server_fds, num_fds);
-      if (rc < 0) {
-        stream->config->err_cb(stream->client, stream->id, rc,
-                               stream->config->user_data);
-      }
-      break;
-    }
-    case CRAS_CLIENT_AUDIO_DEBUG_INFO_READY:
-      if (client->debug_info_callback) {
-        client->debug_info_callback(client);
-      }
-      client->debug_info_callback = NULL;
-      break;
-    case CRAS_CLIENT_ATLOG_FD_READY:
-      if (num_fds != 1 || server_fds[0] < 0) {
-        return -EINVAL;
-      }
-      attach_atlog_shm(client, server_fds[0]);
-      if (client->atlog_access_callback) {
-        client->atlog_access_callback(client);
-      }
-      client->atlog_access_callback = NULL;
-      break;
-    case CRAS_CLIENT_GET_HOTWORD_MODELS_READY: {
-      struct cras_client_get_hotword_models_ready* cmsg =
-          (struct cras_client_get_hotword_models_ready*)msg;
-      cras_client_get_hotword_models_ready(client,
-                                           (const char*)cmsg->hotword_models);
-      break;
-    }
-    case CRAS_CLIENT_REQUEST_FLOOP_READY: {
-      struct cras_client_request_floop_ready* cmsg =
-          (struct cras_client_request_floop_ready*)msg;
-      request_floop_ready(client, cmsg->dev_idx, cmsg->tag);
-      break;
-    }
     case CRAS_CLIENT_OUTPUT_VOLUME_CHANGED: {
       struct cras_client_volume_changed* cmsg =
           (struct cras_client_volume_changed*)msg;
@@ -2055,6 +2344,124 @@ static int handle_message_from_server(struct cras_client* client) {
     default:
       break;
   }
+}
+
+// Handles messages from the cras server.
+static int handle_message_from_server(struct cras_client* client) {
+  uint8_t buf[CRAS_CLIENT_MAX_MSG_SIZE];
+  struct cras_client_message* msg;
+  int rc = 0;
+  int nread;
+  int server_fds[3];
+  unsigned int num_fds = 3;
+
+  msg = (struct cras_client_message*)buf;
+  nread = cras_recv_with_fds(client->server_fd, buf, sizeof(buf), server_fds,
+                             &num_fds);
+  if (nread < (int)sizeof(msg->length) || (int)msg->length != nread) {
+    return -EIO;
+  }
+
+  switch (msg->id) {
+    case CRAS_CLIENT_CONNECTED: {
+      struct cras_client_connected* cmsg = (struct cras_client_connected*)msg;
+      if (num_fds != 1) {
+        return -EINVAL;
+      }
+      rc = client_attach_shm(client, server_fds[0]);
+      if (rc) {
+        return rc;
+      }
+      client->id = cmsg->client_id;
+
+      break;
+    }
+    case CRAS_CLIENT_STREAM_CONNECTED: {
+      struct cras_client_stream_connected* cmsg =
+          (struct cras_client_stream_connected*)msg;
+      struct client_stream* stream = stream_from_id(client, cmsg->stream_id);
+      if (stream == NULL) {
+        if (num_fds < 2) {
+          syslog(LOG_WARNING,
+                 "cras_client: Error receiving "
+                 "stream 0x%x connected message",
+                 cmsg->stream_id);
+          return -EINVAL;
+        }
+
+        /*
+         * Usually, the fds should be closed in stream_connected
+         * callback. However, sometimes a stream is removed
+         * before it is connected.
+         */
+        for (unsigned int i = 0; i < num_fds; i++) {
+          close(server_fds[i]);
+        }
+        break;
+      }
+      rc = stream_connected(stream, cmsg, server_fds, num_fds);
+      if (rc < 0) {
+        stream->config->err_cb(stream->client, stream->id, rc,
+                               stream->config->user_data);
+      }
+      break;
+    }
+    case CRAS_CLIENT_AUDIO_DEBUG_INFO_READY:
+      if (client->debug_info_callback) {
+        client->debug_info_callback(client);
+      }
+      client->debug_info_callback = NULL;
+      break;
+    case CRAS_CLIENT_ATLOG_FD_READY:
+      if (num_fds != 1 || server_fds[0] < 0) {
+        return -EINVAL;
+      }
+      attach_atlog_shm(client, server_fds[0]);
+      if (client->atlog_access_callback) {
+        client->atlog_access_callback(client);
+      }
+      client->atlog_access_callback = NULL;
+      break;
+    case CRAS_CLIENT_GET_HOTWORD_MODELS_READY: {
+      struct cras_client_get_hotword_models_ready* cmsg =
+          (struct cras_client_get_hotword_models_ready*)msg;
+      cras_client_get_hotword_models_ready(client,
+                                           (const char*)cmsg->hotword_models);
+      break;
+    }
+    case CRAS_CLIENT_REQUEST_FLOOP_READY: {
+      struct cras_client_request_floop_ready* cmsg =
+          (struct cras_client_request_floop_ready*)msg;
+      request_floop_ready(client, cmsg->dev_idx, cmsg->tag);
+      break;
+    }
+    case CRAS_CLIENT_NOTIFICATIONS: {
+      struct cras_client_notifications* cmsg =
+          (struct cras_client_notifications*)msg;
+      uint8_t* data = cmsg->data;
+      uint8_t* end = buf + nread;
+
+      if (nread < (int)offsetof(struct cras_client_notifications, data)) {
+        return -EINVAL;
+      }
+      for (uint32_t i = 0; i < cmsg->num_notifications; i++) {
+        struct cras_client_message* notification =
+            (struct cras_client_message*)data;
+
+        if (end - data < (ptrdiff_t)sizeof(*notification) ||
+            notification->length < sizeof(*notification) ||
+            notification->length > (size_t)(end - data)) {
+          return -EINVAL;
+        }
+        handle_notification(client, notification);
+        data += notification->length;
+      }
+      break;
+    }
+    default:
+      handle_notification(client, msg);
+      break;
+  }
 
   return 0;
 }
@@ -2377,6 +2784,13 @@ int cras_client_create_with_type(struct cras_client** client,
     goto free_rwlock;
   }
 
+  rc = pthread_mutex_init(&(*client)->streams_lock, NULL);
+  if (rc != 0) {
+    syslog(LOG_WARNING, "cras_client: Could not init streams lock.");
+    rc = -rc;
+    goto free_lock;
+  }
+
   pthread_condattr_init(&cond_attr);
   pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
   rc = pthread_cond_init(&(*client)->stream_start_cond, &cond_attr);
@@ -2384,7 +2798,7 @@ int cras_client_create_with_type(struct cras_client** client,
   if (rc != 0) {
     syslog(LOG_WARNING, "cras_client: Could not init start cond.");
     rc = -rc;
-    goto free_lock;
+    goto free_streams_lock;
   }
 
   (*client)->server_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
@@ -2436,6 +2850,8 @@ free_server_event_fd:
   }
 free_cond:
   pthread_cond_destroy(&(*client)->stream_start_cond);
+free_streams_lock:
+  pthread_mutex_destroy(&(*client)->streams_lock);
 free_lock:
   pthread_mutex_destroy(&(*client)->stream_start_lock);
 free_rwlock:
@@ -2459,12 +2875,14 @@ void cras_client_destroy(struct cras_client* client) {
   client->server_connection_cb = NULL;
   cras_client_stop(client);
   server_disconnect(client);
+  callback_threads_destroy(client);
   close(client->server_event_fd);
   close(client->command_fds[0]);
   close(client->command_fds[1]);
   close(client->stream_fds[0]);
   close(client->stream_fds[1]);
   cras_file_wait_destroy(client->sock_file_wait);
+  pthread_mutex_destroy(&client->streams_lock);
   pthread_rwlock_destroy(&client_int->server_state_rwlock);
   free((void*)client->sock_file);
   free(client_int);
@@ -2517,6 +2935,7 @@ struct cras_stream_params* cras_client_stream_params_create(
   params->unified_cb = 0;
   params->stream_cb = 0;
   params->err_cb = err_cb;
+  params->direct_io = false;
   memcpy(&(params->format), format, sizeof(*format));
   return params;
 }
@@ -2527,6 +2946,11 @@ void cras_client_stream_params_set_client_type(
   params->client_type = client_type;
 }
 
+void cras_client_stream_params_enable_direct_io(
+    struct cras_stream_params* params) {
+  params->direct_io = true;
+}
+
 void cras_client_stream_params_enable_aec(struct cras_stream_params* params) {
   params->effects |= APM_ECHO_CANCELLATION;
 }
@@ -2616,6 +3040,7 @@ struct cras_stream_params* cras_client_unified_params_create(
   params->unified_cb = unified_cb;
   params->stream_cb = 0;
   params->err_cb = err_cb;
+  params->direct_io = false;
   memcpy(&(params->format), format, sizeof(*format));
 
   return params;
@@ -2638,8 +3063,8 @@ static inline int cras_client_send_add_stream_command_message(
     return -EINVAL;
   }
 
-  if (config->stream_cb == NULL && config->aud_cb == NULL &&
-      config->unified_cb == NULL) {
+  if (!config->direct_io && config->stream_cb == NULL &&
+      config->aud_cb == NULL && config->unified_cb == NULL) {
     return -EINVAL;
   }
 
@@ -2660,6 +3085,7 @@ static inline int cras_client_send_add_stream_command_message(
   }
   memcpy(stream->config, config, sizeof(*config));
   stream->aud_fd = -1;
+  stream->doorbell_fd = -1;
   stream->wake_fds[0] = -1;
   stream->wake_fds[1] = -1;
   stream->direction = config->direction;
@@ -2717,6 +3143,184 @@ int cras_client_rm_stream(struct cras_client* client,
   return send_simple_cmd_msg(client, stream_id, CLIENT_REMOVE_STREAM);
 }
 
+/* Looks up a connected direct io stream from an application thread.
+ * Returns NULL if there is no such stream in the given direction. */
+static struct client_stream* direct_io_stream(
+    struct cras_client* client,
+    cras_stream_id_t stream_id,
+    enum CRAS_STREAM_DIRECTION direction) {
+  struct client_stream* stream;
+
+  if (client == NULL) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&client->streams_lock);
+  stream = stream_from_id(client, stream_id);
+  pthread_mutex_unlock(&client->streams_lock);
+  if (!stream || !stream->config->direct_io ||
+      (direction == CRAS_STREAM_OUTPUT) !=
+          (stream->direction == CRAS_STREAM_OUTPUT)) {
+    return NULL;
+  }
+  return stream;
+}
+
+/* Waits for the next message of the server for a direct io stream.
+ * Args:
+ *    stream - The stream to wait for.
+ *    id - The message expected for the direction of the stream.
+ *    timeout_ms - Passed to poll(), 0 only checks for a pending message.
+ * Returns:
+ *    The number of frames in the message or a negative error code.
+ */
+static int direct_io_wait(struct client_stream* stream,
+                          enum CRAS_AUDIO_MESSAGE_ID id,
+                          int timeout_ms) {
+  struct pollfd pollfd = {.fd = stream->aud_fd, .events = POLLIN};
+  struct audio_message msg;
+  int rc;
+
+  if (timeout_ms) {
+    rc = poll(&pollfd, 1, timeout_ms);
+    if (rc < 0) {
+      return -errno;
+    }
+    if (rc == 0) {
+      return -ETIMEDOUT;
+    }
+  }
+
+  // The message may arrive before the client thread maps the shm.
+  if (stream->thread.state != CRAS_THREAD_RUNNING) {
+    return -EAGAIN;
+  }
+
+  rc = recv(stream->aud_fd, &msg, sizeof(msg), MSG_DONTWAIT);
+  if (rc < 0) {
+    return (errno == EWOULDBLOCK) ? -EAGAIN : -errno;
+  }
+  if (rc != sizeof(msg) || msg.id != id) {
+    return -EIO;
+  }
+  return msg.frames;
+}
+
+int cras_client_stream_get_poll_fd(struct cras_client* client,
+                                   cras_stream_id_t stream_id) {
+  struct client_stream* stream;
+
+  if (client == NULL) {
+    return -EINVAL;
+  }
+
+  pthread_mutex_lock(&client->streams_lock);
+  stream = stream_from_id(client, stream_id);
+  pthread_mutex_unlock(&client->streams_lock);
+  if (!stream || !stream->config->direct_io) {
+    return -EINVAL;
+  }
+  if (stream->aud_fd < 0) {
+    return -EAGAIN;
+  }
+  return stream->aud_fd;
+}
+
+int cras_client_stream_begin_write(struct cras_client* client,
+                                   cras_stream_id_t stream_id,
+                                   uint8_t** samples,
+                                   unsigned int* frames,
+                                   struct timespec* ts,
+                                   int timeout_ms) {
+  struct client_stream* stream;
+  int rc;
+
+  stream = direct_io_stream(client, stream_id, CRAS_STREAM_OUTPUT);
+  if (!stream || !samples || !frames) {
+    return -EINVAL;
+  }
+
+  if (!stream->io_pending) {
+    rc = direct_io_wait(stream, AUDIO_MESSAGE_REQUEST_DATA, timeout_ms);
+    if (rc < 0) {
+      return rc;
+    }
+    stream->io_frames = MIN((size_t)rc, stream->config->cb_threshold);
+    stream->io_pending = true;
+  }
+
+  *samples = cras_shm_get_write_buffer_base(stream->shm);
+  *frames = stream->io_frames;
+  if (ts) {
+    cras_timespec_to_timespec(ts, &stream->shm->header->ts);
+  }
+  return 0;
+}
+
+int cras_client_stream_commit_write(struct cras_client* client,
+                                    cras_stream_id_t stream_id,
+                                    unsigned int frames) {
+  struct client_stream* stream;
+
+  stream = direct_io_stream(client, stream_id, CRAS_STREAM_OUTPUT);
+  if (!stream || !stream->io_pending || frames > stream->io_frames) {
+    return -EINVAL;
+  }
+
+  cras_shm_buffer_written_start(stream->shm, frames);
+  stream->io_pending = false;
+  return send_playback_reply(stream, frames, 0);
+}
+
+int cras_client_stream_begin_read(struct cras_client* client,
+                                  cras_stream_id_t stream_id,
+                                  uint8_t** samples,
+                                  unsigned int* frames,
+                                  struct timespec* ts,
+                                  int timeout_ms) {
+  struct client_stream* stream;
+  int rc;
+
+  stream = direct_io_stream(client, stream_id, CRAS_STREAM_INPUT);
+  if (!stream || !samples || !frames) {
+    return -EINVAL;
+  }
+
+  if (!stream->io_pending) {
+    rc = direct_io_wait(stream, AUDIO_MESSAGE_DATA_READY, timeout_ms);
+    if (rc < 0) {
+      return rc;
+    }
+    // Skip overrun buffers like handle_capture_data_ready() does.
+    stream->io_frames = config_capture_buf(stream, samples, rc);
+    if (stream->io_frames == 0) {
+      return -EAGAIN;
+    }
+    stream->io_pending = true;
+  }
+
+  *samples = cras_shm_get_read_buffer_base(stream->shm);
+  *frames = stream->io_frames;
+  if (ts) {
+    cras_timespec_to_timespec(ts, &stream->shm->header->ts);
+  }
+  return 0;
+}
+
+int cras_client_stream_commit_read(struct cras_client* client,
+                                   cras_stream_id_t stream_id,
+                                   unsigned int frames) {
+  struct client_stream* stream;
+
+  stream = direct_io_stream(client, stream_id, CRAS_STREAM_INPUT);
+  if (!stream || !stream->io_pending || frames > stream->io_frames) {
+    return -EINVAL;
+  }
+  complete_capture_read_current(stream, frames);
+  stream->io_pending = false;
+  return send_capture_reply(stream, frames, 0);
+}
+
 int cras_client_set_stream_volume(struct cras_client* client,
                                   cras_stream_id_t stream_id,
                                   float volume_scaler) {
@@ -3066,6 +3670,18 @@ void cras_client_set_thread_priority_cb(struct cras_client* client,
   client->thread_priority_cb = cb;
 }
 
+int cras_client_set_num_callback_threads(struct cras_client* client,
+                                         unsigned int num_threads) {
+  if (num_threads > CRAS_MAX_CALLBACK_THREADS) {
+    return -EINVAL;
+  }
+  if (client->callback_threads) {
+    return -EBUSY;
+  }
+  client->num_callback_threads = num_threads;
+  return 0;
+}
+
 int cras_client_get_output_devices(const struct cras_client* client,
                                    struct cras_iodev_info* devs,
                                    struct cras_ionode_info* nodes,
@@ -3970,9 +4586,35 @@ int cras_client_set_num_active_streams_changed_callback(
       client, CRAS_CLIENT_NUM_ACTIVE_STREAMS_CHANGED, cb != NULL);
 }
 
+int cras_client_set_notification_interval(struct cras_client* client,
+                                          unsigned int interval_ms) {
+  struct cras_set_notification_interval msg;
+  int rc;
+
+  if (!client) {
+    return -EINVAL;
+  }
+  client->notification_interval_ms = interval_ms;
+  // Sent again by reregister_notifications when reconnecting.
+  cras_fill_set_notification_interval(&msg, interval_ms);
+  rc = write_message_to_server(client, &msg.header);
+  if (rc == -EPIPE) {
+    rc = 0;
+  }
+  return rc;
+}
+
 static int reregister_notifications(struct cras_client* client) {
   int rc;
 
+  if (client->notification_interval_ms) {
+    rc = cras_client_set_notification_interval(
+        client, client->notification_interval_ms);
+    if (rc != 0) {
+      return rc;
+    }
+  }
+
   if (client->observer_ops.output_volume_changed) {
     rc = cras_client_set_output_volume_changed_callback(
         client, client->observer_ops.output_volume_changed);
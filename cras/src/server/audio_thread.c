@@ -4,16 +4,18 @@
  */
 
 #ifndef _GNU_SOURCE
-#define _GNU_SOURCE  // for ppoll and asprintf
+#define _GNU_SOURCE  // for asprintf
 #endif
 
 #include "cras/src/server/audio_thread.h"
 
-#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/param.h>
+#include <sys/timerfd.h>
 #include <syslog.h>
 
 #include "cras/src/server/audio_thread_log.h"
@@ -46,6 +48,14 @@
  */
 #define MAX_CONTINUOUS_ZERO_SLEEP_METRIC_LIMIT 1000
 
+// Maximum number of ready fds handled per wake up.
+#define MAX_WAIT_EVENTS 32
+
+// Number of commands that can be queued to the audio thread.
+#define CMD_RING_SLOTS 64
+// Maximum size of a command message.
+#define CMD_MAX_LENGTH 256
+
 // Messages that can be sent from the main context to the audio thread.
 enum AUDIO_THREAD_COMMAND {
   AUDIO_THREAD_ADD_OPEN_DEV,
@@ -60,11 +70,31 @@ enum AUDIO_THREAD_COMMAND {
   AUDIO_THREAD_DEV_START_RAMP,
   AUDIO_THREAD_REMOVE_CALLBACK,
   AUDIO_THREAD_AEC_DUMP,
+  AUDIO_THREAD_SYNC,
 };
 
 struct audio_thread_msg {
   size_t length;
   enum AUDIO_THREAD_COMMAND id;
+  // Non-zero if the main thread waits for the response.
+  int sync;
+};
+
+/* Single producer single consumer ring of commands from the main thread to
+ * the audio thread. Sequence numbers only grow, the command with sequence
+ * number seq is stored in slots[seq % CMD_RING_SLOTS]. The sequence number of
+ * a command is its token.
+ */
+struct audio_thread_cmd_ring {
+  // Sequence number of the last queued command. Written by main thread.
+  uint64_t write_seq __attribute__((aligned(64)));
+  // Sequence number of the last handled command. Written by audio thread.
+  uint64_t read_seq __attribute__((aligned(64)));
+  /* Set by main thread when it waits for room in the full ring, cleared by
+   * audio thread when it signals ring_space_fd. */
+  int space_wanted;
+  uint8_t slots[CMD_RING_SLOTS][CMD_MAX_LENGTH]
+      __attribute__((aligned(64)));
 };
 
 struct audio_thread_config_global_remix {
@@ -116,13 +146,29 @@ struct audio_thread_aec_dump_msg {
 /* Audio thread logging. If atlog is successfully created from cras_shm_setup,
  * then the fds should have valid value. Or audio thread will fallback to use
  * calloc to create atlog and leave the fds as -1.
+ * Each audio thread has its own event log and atlog points to the one of the
+ * calling thread. The logs are the sections of one shared memory region,
+ * the main thread logs to the one of the primary thread.
  */
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 char* atlog_name;
 int atlog_rw_shm_fd;
 int atlog_ro_shm_fd;
 
-static struct iodev_callback_list* iodev_callbacks;
+// The CRAS_MAX_AUDIO_THREADS event logs and the threads using them.
+static struct audio_thread_event_log* atlog_sections;
+static struct audio_thread* atlog_owners[CRAS_MAX_AUDIO_THREADS];
+
+// First created audio thread, the one whose event log is shared.
+static struct audio_thread* primary_thread;
+
+/* Audio thread that callbacks and streams registered from the calling thread
+ * belong to. See audio_thread_set_current().
+ */
+static __thread struct audio_thread* current_thread;
+
+// Callbacks registered before any audio thread exists.
+static struct iodev_callback_list* pending_callbacks;
 
 struct iodev_callback_list {
   int fd;
@@ -130,18 +176,100 @@ struct iodev_callback_list {
   enum AUDIO_THREAD_EVENTS_CB_TRIGGER trigger;
   thread_callback cb;
   void* cb_data;
-  struct pollfd* pollfd;
+  // True if fd is currently in the wait set.
+  bool in_wait_set;
   struct iodev_callback_list *prev, *next;
 };
 
+/* Adds fd to the wait set of thread. The data pointer is handed back on wake
+ * up to tell what became ready.
+ * Returns:
+ *    0 on success, negative error code on failure.
+ */
+static int wait_set_add(struct audio_thread* thread,
+                        int fd,
+                        uint32_t events,
+                        void* data) {
+  struct epoll_event ev;
+
+  if (!thread || thread->wait_set_fd < 0) {
+    return -ENODEV;
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = data;
+  if (epoll_ctl(thread->wait_set_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+static void wait_set_rm(struct audio_thread* thread, int fd) {
+  if (!thread || thread->wait_set_fd < 0) {
+    return;
+  }
+  // The fd may already be closed, which removed it from the set.
+  epoll_ctl(thread->wait_set_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+// Gets the callback list of thread, or the pending one if there is no thread.
+static struct iodev_callback_list** callback_list(struct audio_thread* thread) {
+  return thread ? &thread->callbacks : &pending_callbacks;
+}
+
+// Keeps iodev_cb in the wait set if and only if it is triggered by poll.
+static void update_callback_wait(struct audio_thread* thread,
+                                 struct iodev_callback_list* iodev_cb) {
+  int rc;
+
+  if (iodev_cb->trigger == TRIGGER_POLL && !iodev_cb->in_wait_set) {
+    rc = wait_set_add(thread, iodev_cb->fd, iodev_cb->events, iodev_cb);
+    if (rc < 0 && rc != -ENODEV) {
+      syslog(LOG_ERR, "Failed to wait on callback fd %d: %d", iodev_cb->fd,
+             rc);
+    }
+    iodev_cb->in_wait_set = (rc == 0);
+  } else if (iodev_cb->trigger != TRIGGER_POLL && iodev_cb->in_wait_set) {
+    wait_set_rm(thread, iodev_cb->fd);
+    iodev_cb->in_wait_set = false;
+  }
+}
+
+/* Checks that iodev_cb, handed back by the wait set, is still registered for
+ * poll. A callback may be removed while handling an earlier event. */
+static bool callback_is_polled(struct audio_thread* thread,
+                               const struct iodev_callback_list* iodev_cb) {
+  struct iodev_callback_list* curr;
+
+  DL_FOREACH (thread->callbacks, curr) {
+    if (curr == iodev_cb) {
+      return curr->in_wait_set;
+    }
+  }
+  return false;
+}
+
+struct audio_thread* audio_thread_set_current(struct audio_thread* thread) {
+  struct audio_thread* prev = current_thread;
+
+  current_thread = thread;
+  return prev;
+}
+
+struct audio_thread* audio_thread_get_current() {
+  return current_thread;
+}
+
 void audio_thread_add_events_callback(int fd,
                                       thread_callback cb,
                                       void* data,
                                       int events) {
+  struct iodev_callback_list** callbacks = callback_list(current_thread);
   struct iodev_callback_list* iodev_cb;
 
   // Don't add iodev_cb twice
-  DL_FOREACH (iodev_callbacks, iodev_cb) {
+  DL_FOREACH (*callbacks, iodev_cb) {
     if (iodev_cb->fd == fd && iodev_cb->cb_data == data) {
       return;
     }
@@ -154,15 +282,20 @@ void audio_thread_add_events_callback(int fd,
   iodev_cb->trigger = TRIGGER_POLL;
   iodev_cb->events = events;
 
-  DL_APPEND(iodev_callbacks, iodev_cb);
+  DL_APPEND(*callbacks, iodev_cb);
+  update_callback_wait(current_thread, iodev_cb);
 }
 
 void audio_thread_rm_callback(int fd) {
+  struct iodev_callback_list** callbacks = callback_list(current_thread);
   struct iodev_callback_list* iodev_cb;
 
-  DL_FOREACH (iodev_callbacks, iodev_cb) {
+  DL_FOREACH (*callbacks, iodev_cb) {
     if (iodev_cb->fd == fd) {
-      DL_DELETE(iodev_callbacks, iodev_cb);
+      if (iodev_cb->in_wait_set) {
+        wait_set_rm(current_thread, fd);
+      }
+      DL_DELETE(*callbacks, iodev_cb);
       free(iodev_cb);
       return;
     }
@@ -174,14 +307,88 @@ void audio_thread_config_events_callback(
     enum AUDIO_THREAD_EVENTS_CB_TRIGGER trigger) {
   struct iodev_callback_list* iodev_cb;
 
-  DL_FOREACH (iodev_callbacks, iodev_cb) {
+  DL_FOREACH (*callback_list(current_thread), iodev_cb) {
     if (iodev_cb->fd == fd) {
       iodev_cb->trigger = trigger;
+      update_callback_wait(current_thread, iodev_cb);
       return;
     }
   }
 }
 
+/* Returns true if the reply the client of stream is about to send should wake
+ * the thread up. Output streams wait for the samples they were asked for,
+ * input streams on device timing for the client to read its samples. */
+static bool stream_waits_reply(const struct cras_rstream* stream) {
+  if (!cras_rstream_is_pending_reply(stream)) {
+    return false;
+  }
+  if (stream_uses_input(stream) && (stream->flags & USE_DEV_TIMING)) {
+    return true;
+  }
+  return stream_uses_output(stream) && !cras_rstream_get_is_draining(stream);
+}
+
+// Adds or removes the fd of stream from the wait set of thread.
+static void set_stream_wait(struct audio_thread* thread,
+                            struct cras_rstream* stream,
+                            bool wait) {
+  int fd = cras_rstream_get_audio_fd(stream);
+  int doorbell_fd = cras_rstream_get_doorbell_fd(stream);
+  uint64_t count;
+  int rc;
+
+  if (fd < 0 || stream->reply_wait_armed == wait) {
+    return;
+  }
+
+  if (!wait) {
+    wait_set_rm(thread, fd);
+    stream->reply_wait_armed = 0;
+    return;
+  }
+
+  /* The doorbell counter is never read by the stream, clear the rings of
+   * handled replies so that only the next one wakes the thread up. */
+  if (doorbell_fd >= 0 && read(doorbell_fd, &count, sizeof(count)) < 0 &&
+      errno != EAGAIN) {
+    syslog(LOG_WARNING, "Failed to clear doorbell of stream %x",
+           stream->stream_id);
+  }
+
+  /* Edge triggered because the client reply is consumed when the stream is
+   * serviced, not when the thread wakes up. */
+  rc = wait_set_add(thread, fd, EPOLLIN | EPOLLET, NULL);
+  if (rc < 0 && rc != -ENODEV) {
+    syslog(LOG_ERR, "Failed to wait on stream %x: %d", stream->stream_id, rc);
+  }
+  stream->reply_wait_armed = (rc == 0);
+}
+
+/* Waits on the fds of the streams of thread only while they are pending a
+ * reply the thread should wake up for, so that other messages from the
+ * clients don't wake it up. Streams attached to several devices are visited
+ * more than once, but their fd is only added once. */
+static void update_stream_waits(struct audio_thread* thread) {
+  struct open_dev* adev;
+  struct dev_stream* curr;
+
+  DL_FOREACH (thread->open_devs[CRAS_STREAM_OUTPUT], adev) {
+    DL_FOREACH (adev->dev->streams, curr) {
+      set_stream_wait(thread, curr->stream, stream_waits_reply(curr->stream));
+    }
+  }
+  DL_FOREACH (thread->open_devs[CRAS_STREAM_INPUT], adev) {
+    DL_FOREACH (adev->dev->streams, curr) {
+      set_stream_wait(thread, curr->stream, stream_waits_reply(curr->stream));
+    }
+  }
+}
+
+void audio_thread_unwatch_stream(struct cras_rstream* stream) {
+  set_stream_wait(current_thread, stream, false);
+}
+
 /* Sends a response (error code) from the audio thread to the main thread.
  * Indicates that the last message sent to the audio thread has been handled
  * with an error code of rc.
@@ -224,40 +431,81 @@ static int read_until_finished(int fd, void* buf, size_t count) {
   return count;
 }
 
-/* Reads a command from the main thread.  Called from the playback/capture
- * thread.  This will read the next available command from the main thread and
- * put it in buf.
+// Returns true if the command with sequence number seq fits in the ring.
+static bool cmd_ring_has_room(struct audio_thread_cmd_ring* ring,
+                              uint64_t seq) {
+  return seq - __atomic_load_n(&ring->read_seq, __ATOMIC_SEQ_CST) <=
+         CMD_RING_SLOTS;
+}
+
+/* Queues a command for the audio thread and signals its doorbell. Called from
+ * the main thread. Blocks until the audio thread makes room if the ring is
+ * full.
  * Args:
- *    thread - thread reading the command.
- *    buf - Message is stored here on return.
- *    max_len - maximum length of message to put into buf.
+ *    thread - thread to receive the command.
+ *    msg - The command, copied into the ring.
+ *    token - Filled with the token of the command.
  * Returns:
- *    0 on success, negative error code on failure.
+ *    0 on success, -EAGAIN if the ring is full and the thread isn't running,
+ *    otherwise a negative error code.
  */
-static int audio_thread_read_command(struct audio_thread* thread,
-                                     uint8_t* buf,
-                                     size_t max_len) {
-  int to_read, nread, rc;
-  struct audio_thread_msg* msg = (struct audio_thread_msg*)buf;
-
-  // Get the length of the message first
-  nread =
-      read_until_finished(thread->to_thread_fds[0], buf, sizeof(msg->length));
-  if (nread < 0) {
-    return nread;
+static int cmd_ring_push(struct audio_thread* thread,
+                         const struct audio_thread_msg* msg,
+                         audio_thread_token_t* token) {
+  struct audio_thread_cmd_ring* ring = thread->cmd_ring;
+  uint64_t seq = ring->write_seq + 1;
+  eventfd_t count;
+
+  assert(msg->length <= CMD_MAX_LENGTH);
+
+  while (!cmd_ring_has_room(ring, seq)) {
+    if (!thread->started) {
+      return -EAGAIN;
+    }
+    /* Check again once the audio thread is sure to see the flag, it may
+     * have made room in between. */
+    __atomic_store_n(&ring->space_wanted, 1, __ATOMIC_SEQ_CST);
+    if (cmd_ring_has_room(ring, seq)) {
+      break;
+    }
+    if (eventfd_read(thread->ring_space_fd, &count) < 0 && errno != EINTR) {
+      return -errno;
+    }
   }
 
-  if (msg->length > max_len) {
-    return -ENOMEM;
+  memcpy(ring->slots[seq % CMD_RING_SLOTS], msg, msg->length);
+  __atomic_store_n(&ring->write_seq, seq, __ATOMIC_RELEASE);
+  eventfd_write(thread->doorbell_fd, 1);
+
+  *token = seq;
+  return 0;
+}
+
+/* Gets the next command queued by the main thread, in place. Called from the
+ * audio thread.
+ * Returns:
+ *    The next command, or NULL if there is none. It stays valid until
+ *    cmd_ring_pop() is called.
+ */
+static struct audio_thread_msg* cmd_ring_peek(
+    struct audio_thread_cmd_ring* ring) {
+  uint64_t seq = ring->read_seq + 1;
+
+  if (seq > __atomic_load_n(&ring->write_seq, __ATOMIC_ACQUIRE)) {
+    return NULL;
   }
+  return (struct audio_thread_msg*)ring->slots[seq % CMD_RING_SLOTS];
+}
 
-  to_read = msg->length - sizeof(msg->length);
-  rc = read_until_finished(thread->to_thread_fds[0],
-                           &buf[0] + sizeof(msg->length), to_read);
-  if (rc < 0) {
-    return rc;
+/* Marks the command returned by cmd_ring_peek() as handled. Wakes up the
+ * main thread if it waits for room in the ring. */
+static void cmd_ring_pop(struct audio_thread* thread) {
+  struct audio_thread_cmd_ring* ring = thread->cmd_ring;
+
+  __atomic_store_n(&ring->read_seq, ring->read_seq + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_exchange_n(&ring->space_wanted, 0, __ATOMIC_SEQ_CST)) {
+    eventfd_write(thread->ring_space_fd, 1);
   }
-  return 0;
 }
 
 // Builds an initial buffer to avoid an underrun. Adds min_level of latency.
@@ -499,6 +747,7 @@ static void append_dev_dump_info(struct audio_dev_debug_info* di,
   di->num_underruns = cras_iodev_get_num_underruns(adev->dev);
   di->num_severe_underruns = cras_iodev_get_num_severe_underruns(adev->dev);
   di->highest_hw_level = adev->dev->highest_hw_level;
+  di->silent_frames_skipped = adev->dev->num_silent_frames_skipped;
   di->software_gain_scaler = (adev->dev->direction == CRAS_STREAM_INPUT)
                                  ? adev->dev->software_gain_scaler
                                  : 0.0f;
@@ -570,21 +819,15 @@ static void append_stream_dump_info(struct audio_debug_info* info,
   si->runtime_nsec = time_since.tv_nsec;
 }
 
-/* Handle a message sent from main thread to the audio thread.
+/* Handle a command sent from main thread to the audio thread.
  * Returns:
- *    Error code when reading or sending message fails.
+ *    The result code of the command.
  */
-static int handle_audio_thread_message(struct audio_thread* thread) {
-  uint8_t buf[256];
-  struct audio_thread_msg* msg = (struct audio_thread_msg*)buf;
+static int handle_audio_thread_command(struct audio_thread* thread,
+                                       struct audio_thread_msg* msg) {
   int ret = 0;
   int err;
 
-  err = audio_thread_read_command(thread, buf, 256);
-  if (err < 0) {
-    return err;
-  }
-
   ATLOG(atlog, AUDIO_THREAD_PB_MSG, msg->id, 0, 0);
 
   switch (msg->id) {
@@ -625,6 +868,7 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
     }
     case AUDIO_THREAD_STOP:
       ret = 0;
+      cmd_ring_pop(thread);
       err = audio_thread_send_response(thread, ret);
       if (err < 0) {
         return err;
@@ -638,6 +882,7 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
       struct audio_debug_info* info;
       unsigned int num_streams = 0;
       unsigned int num_devs = 0;
+      uint32_t pool_hits, pool_misses;
 
       ret = 0;
       dmsg = (struct audio_thread_dump_debug_info_msg*)msg;
@@ -674,6 +919,9 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
       info->num_devs = num_devs;
 
       info->num_streams = num_streams;
+      cras_fmt_conv_pool_stats(&pool_hits, &pool_misses);
+      info->conv_pool_hits = pool_hits;
+      info->conv_pool_misses = pool_misses;
 
       memcpy(&info->log, atlog, sizeof(info->log));
       break;
@@ -694,16 +942,12 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
     }
     case AUDIO_THREAD_CONFIG_GLOBAL_REMIX: {
       struct audio_thread_config_global_remix* rmsg;
-      void* rsp;
-
-      /* Respond the pointer to the old remix converter, so it can be
-       * freed later in main thread. */
-      rsp = (void*)thread->remix_converter;
 
+      /* The old remix converter is freed by main thread once this command
+       * is handled. */
       rmsg = (struct audio_thread_config_global_remix*)msg;
       thread->remix_converter = rmsg->fmt_conv;
-
-      return write(thread->to_main_fds[1], &rsp, sizeof(rsp));
+      break;
     }
     case AUDIO_THREAD_DEV_START_RAMP: {
       struct audio_thread_dev_start_ramp_msg* rmsg;
@@ -718,14 +962,46 @@ static int handle_audio_thread_message(struct audio_thread* thread) {
       ret = thread_set_aec_dump(thread, rmsg->stream_id, rmsg->start, rmsg->fd);
       break;
     }
+    case AUDIO_THREAD_SYNC:
+      break;
     default:
       ret = -EINVAL;
       break;
   }
 
-  err = audio_thread_send_response(thread, ret);
-  if (err < 0) {
-    return err;
+  return ret;
+}
+
+/* Handle all the commands queued by the main thread. Responds to the
+ * synchronous ones.
+ * Returns:
+ *    Error code when sending a response fails.
+ */
+static int handle_audio_thread_message(struct audio_thread* thread) {
+  struct audio_thread_msg* msg;
+  eventfd_t count;
+  int ret;
+  int err;
+
+  // Reset the doorbell before checking the ring so no command is missed.
+  eventfd_read(thread->doorbell_fd, &count);
+
+  while ((msg = cmd_ring_peek(thread->cmd_ring))) {
+    enum AUDIO_THREAD_COMMAND id = msg->id;
+    int sync = msg->sync;
+
+    ret = handle_audio_thread_command(thread, msg);
+    // Main thread may reuse the slot from here.
+    cmd_ring_pop(thread);
+
+    if (sync) {
+      err = audio_thread_send_response(thread, ret);
+      if (err < 0) {
+        return err;
+      }
+    } else if (ret < 0) {
+      syslog(LOG_WARNING, "Async audio thread command %d failed: %d", id, ret);
+    }
   }
   return 0;
 }
@@ -754,20 +1030,40 @@ static int fill_next_sleep_interval(struct audio_thread* thread,
   return ret;
 }
 
-static struct pollfd* add_pollfd(struct audio_thread* thread,
-                                 int fd,
-                                 int events) {
-  thread->pollfds[thread->num_pollfds].fd = fd;
-  thread->pollfds[thread->num_pollfds].events = events;
-  thread->num_pollfds++;
-  if (thread->num_pollfds >= thread->pollfds_size) {
-    thread->pollfds_size *= 2;
-    thread->pollfds = (struct pollfd*)realloc(
-        thread->pollfds, sizeof(*thread->pollfds) * thread->pollfds_size);
-    return NULL;
+/* Waits for ready fds in the wait set or for wait_ts to elapse.
+ * Args:
+ *    thread - The thread owning the wake up timer.
+ *    wait_ts - Time to wait, NULL to wait until an fd is ready.
+ *    events - Filled with the ready fds.
+ *    max_events - Size of events.
+ * Returns:
+ *    The number of ready fds, 0 on timeout or negative error code.
+ */
+static int wait_for_events(struct audio_thread* thread,
+                           const struct timespec* wait_ts,
+                           struct epoll_event* events,
+                           int max_events) {
+  struct itimerspec its;
+  int timeout_ms = -1;
+  int rc;
+
+  /* Always rearm since the timer is level triggered. A zero it_value disarms
+   * it and drops an expiration that was not read. */
+  memset(&its, 0, sizeof(its));
+  if (wait_ts) {
+    if (wait_ts->tv_sec == 0 && wait_ts->tv_nsec == 0) {
+      timeout_ms = 0;
+    } else {
+      its.it_value = *wait_ts;
+    }
   }
+  timerfd_settime(thread->timer_fd, 0, &its, NULL);
 
-  return &thread->pollfds[thread->num_pollfds - 1];
+  rc = epoll_wait(thread->wait_set_fd, events, max_events, timeout_ms);
+  if (rc < 0) {
+    return -errno;
+  }
+  return rc;
 }
 
 static int continuous_zero_sleep_count = 0;
@@ -824,29 +1120,26 @@ static void check_busyloop(struct timespec* wait_ts) {
  */
 static void* audio_io_thread(void* arg) {
   struct audio_thread* thread = (struct audio_thread*)arg;
-  struct open_dev* adev;
-  struct dev_stream* curr;
+  struct epoll_event events[MAX_WAIT_EVENTS];
   struct timespec ts;
-  int msg_fd;
   int rc;
+  int i;
 
-  msg_fd = thread->to_thread_fds[0];
+  current_thread = thread;
+  atlog = thread->atlog;
 
   // Attempt to get realtime scheduling
   if (cras_set_rt_scheduling(CRAS_SERVER_RT_THREAD_PRIORITY) == 0) {
     cras_set_thread_priority(CRAS_SERVER_RT_THREAD_PRIORITY);
   }
 
-  thread->pollfds[0].fd = msg_fd;
-  thread->pollfds[0].events = POLLIN;
-
   while (1) {
     struct timespec* wait_ts;
     struct iodev_callback_list* iodev_cb;
+    bool msg_ready = false;
     int non_empty;
 
     wait_ts = NULL;
-    thread->num_pollfds = 1;
 
     // device opened
     dev_io_run(&thread->open_devs[CRAS_STREAM_OUTPUT],
@@ -859,43 +1152,7 @@ static void* audio_io_thread(void* arg) {
       wait_ts = &ts;
     }
 
-  restart_poll_loop:
-    thread->num_pollfds = 1;
-
-    DL_FOREACH (iodev_callbacks, iodev_cb) {
-      if (iodev_cb->trigger != TRIGGER_POLL) {
-        iodev_cb->pollfd = NULL;
-        continue;
-      }
-      iodev_cb->pollfd = add_pollfd(thread, iodev_cb->fd, iodev_cb->events);
-      if (!iodev_cb->pollfd) {
-        goto restart_poll_loop;
-      }
-    }
-
-    // TODO(dgreid) - once per rstream not per dev_stream
-    DL_FOREACH (thread->open_devs[CRAS_STREAM_OUTPUT], adev) {
-      DL_FOREACH (adev->dev->streams, curr) {
-        int fd = dev_stream_poll_stream_fd(curr);
-        if (fd < 0) {
-          continue;
-        }
-        if (!add_pollfd(thread, fd, POLLIN)) {
-          goto restart_poll_loop;
-        }
-      }
-    }
-    DL_FOREACH (thread->open_devs[CRAS_STREAM_INPUT], adev) {
-      DL_FOREACH (adev->dev->streams, curr) {
-        int fd = dev_stream_poll_stream_fd(curr);
-        if (fd < 0) {
-          continue;
-        }
-        if (!add_pollfd(thread, fd, POLLIN)) {
-          goto restart_poll_loop;
-        }
-      }
-    }
+    update_stream_waits(thread);
 
     log_busyloop(wait_ts);
 
@@ -909,35 +1166,50 @@ static void* audio_io_thread(void* arg) {
     __sync_synchronize();
     atlog->sync_write_pos = atlog->write_pos;
 
-    rc = ppoll(thread->pollfds, thread->num_pollfds, wait_ts, NULL);
+    rc = wait_for_events(thread, wait_ts, events, MAX_WAIT_EVENTS);
     ATLOG(atlog, AUDIO_THREAD_WAKE, rc, 0, 0);
 
     // Handle callbacks registered by TRIGGER_WAKEUP
-    DL_FOREACH (iodev_callbacks, iodev_cb) {
+    DL_FOREACH (thread->callbacks, iodev_cb) {
       if (iodev_cb->trigger == TRIGGER_WAKEUP) {
         ATLOG(atlog, AUDIO_THREAD_IODEV_CB, 0, 0, 0);
         iodev_cb->cb(iodev_cb->cb_data, 0);
       }
     }
 
-    // If there's no pollfd ready to handle.
+    // If there's no fd ready to handle.
     if (rc <= 0) {
       continue;
     }
 
-    if (thread->pollfds[0].revents & POLLIN) {
-      rc = handle_audio_thread_message(thread);
-      if (rc < 0) {
-        syslog(LOG_ERR, "handle message %d", rc);
+    /* Stream fds only need to wake the thread up and the timer is rearmed
+     * before the next wait. Handle the message first, like the callbacks it
+     * may have removed. */
+    for (i = 0; i < rc; i++) {
+      if (events[i].data.ptr == thread) {
+        msg_ready = true;
+      }
+    }
+    if (msg_ready) {
+      int err = handle_audio_thread_message(thread);
+      if (err < 0) {
+        syslog(LOG_ERR, "handle message %d", err);
       }
     }
 
-    DL_FOREACH (iodev_callbacks, iodev_cb) {
-      if (iodev_cb->pollfd && iodev_cb->pollfd->revents & iodev_cb->events) {
-        ATLOG(atlog, AUDIO_THREAD_IODEV_CB, iodev_cb->pollfd->revents,
-              iodev_cb->events, 0);
-        iodev_cb->cb(iodev_cb->cb_data, iodev_cb->pollfd->revents);
+    for (i = 0; i < rc; i++) {
+      iodev_cb = (struct iodev_callback_list*)events[i].data.ptr;
+      if (!iodev_cb || events[i].data.ptr == thread ||
+          events[i].data.ptr == &thread->timer_fd) {
+        continue;
+      }
+      if (!callback_is_polled(thread, iodev_cb) ||
+          !(events[i].events & iodev_cb->events)) {
+        continue;
       }
+      ATLOG(atlog, AUDIO_THREAD_IODEV_CB, events[i].events, iodev_cb->events,
+            0);
+      iodev_cb->cb(iodev_cb->cb_data, events[i].events);
     }
   }
 
@@ -957,13 +1229,16 @@ static void* audio_io_thread(void* arg) {
  */
 static int audio_thread_post_message(struct audio_thread* thread,
                                      struct audio_thread_msg* msg) {
+  audio_thread_token_t token;
   int err, rsp;
 
-  err = write(thread->to_thread_fds[1], msg, msg->length);
+  msg->sync = 1;
+  err = cmd_ring_push(thread, msg, &token);
   if (err < 0) {
-    syslog(LOG_ERR, "Failed to post message to thread.");
+    syslog(LOG_ERR, "Failed to post message %d: %d", msg->id, err);
     return err;
   }
+
   // Synchronous action, wait for response.
   err = read_until_finished(thread->to_main_fds[0], &rsp, sizeof(rsp));
   if (err < 0) {
@@ -974,6 +1249,32 @@ static int audio_thread_post_message(struct audio_thread* thread,
   return rsp;
 }
 
+/* Write a message to the playback thread without waiting for it to be
+ * handled. Errors are logged by the audio thread.
+ * Args:
+ *    thread - thread to receive message.
+ *    msg - The message to send.
+ *    token - If not NULL, filled with the token of the message.
+ * Returns:
+ *    0 if the message is posted, negative error code otherwise.
+ */
+static int audio_thread_post_message_async(struct audio_thread* thread,
+                                           struct audio_thread_msg* msg,
+                                           audio_thread_token_t* token) {
+  audio_thread_token_t seq;
+  int rc;
+
+  msg->sync = 0;
+  rc = cmd_ring_push(thread, msg, &seq);
+  if (rc < 0) {
+    return rc;
+  }
+  if (token) {
+    *token = seq;
+  }
+  return 0;
+}
+
 static void init_open_device_msg(struct audio_thread_open_device_msg* msg,
                                  enum AUDIO_THREAD_COMMAND id,
                                  struct cras_iodev* dev) {
@@ -1085,10 +1386,119 @@ int audio_thread_dump_thread_info(struct audio_thread* thread,
   return audio_thread_post_message(thread, &msg.header);
 }
 
+// Returns true if event a was logged before event b.
+static bool event_before(const struct audio_thread_event* a,
+                         const struct audio_thread_event* b) {
+  uint32_t sec_a = a->tag_sec & 0x00ffffff;
+  uint32_t sec_b = b->tag_sec & 0x00ffffff;
+
+  return sec_a < sec_b || (sec_a == sec_b && a->nsec < b->nsec);
+}
+
+/* Merges the event logs of the threads into log in the order they were
+ * logged, keeping the latest AUDIO_THREAD_EVENT_LOG_SIZE events. */
+static void merge_event_logs(struct audio_thread_event_log* log,
+                             struct audio_debug_info** infos,
+                             unsigned int num_infos) {
+  uint64_t pos[CRAS_MAX_AUDIO_THREADS];
+  uint64_t total = 0;
+  unsigned int i;
+
+  for (i = 0; i < num_infos; i++) {
+    uint64_t write_pos = infos[i]->log.write_pos;
+
+    pos[i] = write_pos > AUDIO_THREAD_EVENT_LOG_SIZE
+                 ? write_pos - AUDIO_THREAD_EVENT_LOG_SIZE
+                 : 0;
+  }
+
+  while (true) {
+    const struct audio_thread_event* next = NULL;
+    unsigned int next_idx = 0;
+
+    for (i = 0; i < num_infos; i++) {
+      const struct audio_thread_event* ev;
+
+      if (pos[i] == infos[i]->log.write_pos) {
+        continue;
+      }
+      ev = &infos[i]->log.log[pos[i] % AUDIO_THREAD_EVENT_LOG_SIZE];
+      if (!next || event_before(ev, next)) {
+        next = ev;
+        next_idx = i;
+      }
+    }
+    if (!next) {
+      break;
+    }
+    log->log[total++ % AUDIO_THREAD_EVENT_LOG_SIZE] = *next;
+    pos[next_idx]++;
+  }
+
+  log->write_pos = total;
+  log->sync_write_pos = total;
+  log->len = AUDIO_THREAD_EVENT_LOG_SIZE;
+}
+
+int audio_thread_dump_threads_info(struct audio_thread** threads,
+                                   unsigned int num_threads,
+                                   struct audio_debug_info* info) {
+  struct audio_debug_info* infos[CRAS_MAX_AUDIO_THREADS] = {};
+  unsigned int i, j;
+  int rc = 0;
+
+  if (num_threads == 0 || num_threads > CRAS_MAX_AUDIO_THREADS) {
+    return -EINVAL;
+  }
+  if (num_threads == 1) {
+    return audio_thread_dump_thread_info(threads[0], info);
+  }
+
+  for (i = 0; i < num_threads; i++) {
+    infos[i] = (struct audio_debug_info*)calloc(1, sizeof(*infos[i]));
+    if (!infos[i]) {
+      rc = -ENOMEM;
+      goto out;
+    }
+    rc = audio_thread_dump_thread_info(threads[i], infos[i]);
+    if (rc < 0) {
+      goto out;
+    }
+  }
+
+  info->num_devs = 0;
+  info->num_streams = 0;
+  for (i = 0; i < num_threads; i++) {
+    for (j = 0; j < infos[i]->num_devs; j++) {
+      if (info->num_devs == MAX_DEBUG_DEVS) {
+        break;
+      }
+      info->devs[info->num_devs++] = infos[i]->devs[j];
+    }
+    for (j = 0; j < infos[i]->num_streams; j++) {
+      if (info->num_streams == MAX_DEBUG_STREAMS) {
+        break;
+      }
+      info->streams[info->num_streams++] = infos[i]->streams[j];
+    }
+  }
+  // The converter pool is shared by all threads.
+  info->conv_pool_hits = infos[num_threads - 1]->conv_pool_hits;
+  info->conv_pool_misses = infos[num_threads - 1]->conv_pool_misses;
+  merge_event_logs(&info->log, infos, num_threads);
+
+out:
+  for (i = 0; i < num_threads; i++) {
+    free(infos[i]);
+  }
+  return rc;
+}
+
 int audio_thread_set_aec_dump(struct audio_thread* thread,
                               cras_stream_id_t stream_id,
                               unsigned int start,
-                              int fd) {
+                              int fd,
+                              audio_thread_token_t* token) {
   struct audio_thread_aec_dump_msg msg;
 
   memset(&msg, 0, sizeof(msg));
@@ -1097,7 +1507,7 @@ int audio_thread_set_aec_dump(struct audio_thread* thread,
   msg.stream_id = stream_id;
   msg.start = start;
   msg.fd = fd;
-  return audio_thread_post_message(thread, &msg.header);
+  return audio_thread_post_message_async(thread, &msg.header, token);
 }
 
 int audio_thread_rm_callback_sync(struct audio_thread* thread, int fd) {
@@ -1113,12 +1523,12 @@ int audio_thread_rm_callback_sync(struct audio_thread* thread, int fd) {
 
 int audio_thread_config_global_remix(struct audio_thread* thread,
                                      unsigned int num_channels,
-                                     const float* coefficient) {
+                                     const float* coefficient,
+                                     audio_thread_token_t* token) {
   int err;
   int identity_remix = 1;
   unsigned int i, j;
   struct audio_thread_config_global_remix msg;
-  void* rsp;
 
   init_config_global_remix_msg(&msg);
 
@@ -1146,42 +1556,108 @@ int audio_thread_config_global_remix(struct audio_thread* thread,
     }
   }
 
-  err = write(thread->to_thread_fds[1], &msg, msg.header.length);
-  if (err < 0) {
-    syslog(LOG_ERR, "Failed to post message to thread.");
-    return err;
+  /* Only one replaced converter is kept around. Free the one replaced by the
+   * previous call, which is normally long done. */
+  if (thread->retired_remix_converter) {
+    err = audio_thread_wait_token(thread, thread->remix_retire_token);
+    if (err < 0) {
+      if (msg.fmt_conv) {
+        cras_fmt_conv_destroy(&msg.fmt_conv);
+      }
+      return err;
+    }
+    cras_fmt_conv_destroy(&thread->retired_remix_converter);
   }
-  // Synchronous action, wait for response.
-  err = read_until_finished(thread->to_main_fds[0], &rsp, sizeof(rsp));
+
+  err = audio_thread_post_message_async(thread, &msg.header,
+                                        &thread->remix_retire_token);
   if (err < 0) {
-    syslog(LOG_ERR, "Failed to read reply from thread.");
+    if (msg.fmt_conv) {
+      cras_fmt_conv_destroy(&msg.fmt_conv);
+    }
     return err;
   }
-
-  if (rsp) {
-    cras_fmt_conv_destroy((struct cras_fmt_conv**)&rsp);
+  thread->retired_remix_converter = thread->posted_remix_converter;
+  thread->posted_remix_converter = msg.fmt_conv;
+  if (token) {
+    *token = thread->remix_retire_token;
   }
   return 0;
 }
 
+int audio_thread_token_done(struct audio_thread* thread,
+                            audio_thread_token_t token) {
+  return __atomic_load_n(&thread->cmd_ring->read_seq, __ATOMIC_ACQUIRE) >=
+         token;
+}
+
+int audio_thread_wait_token(struct audio_thread* thread,
+                            audio_thread_token_t token) {
+  struct audio_thread_msg msg;
+
+  if (audio_thread_token_done(thread, token)) {
+    return 0;
+  }
+  if (!thread->started) {
+    return -EINVAL;
+  }
+
+  // Commands are handled in order, so wait for a no-op posted after it.
+  memset(&msg, 0, sizeof(msg));
+  msg.id = AUDIO_THREAD_SYNC;
+  msg.length = sizeof(msg);
+  return audio_thread_post_message(thread, &msg);
+}
+
 struct audio_thread* audio_thread_create() {
   int rc;
   struct audio_thread* thread;
+  struct iodev_callback_list* iodev_cb;
+  unsigned int log_idx;
+
+  for (log_idx = 0; log_idx < CRAS_MAX_AUDIO_THREADS; log_idx++) {
+    if (!atlog_owners[log_idx]) {
+      break;
+    }
+  }
+  if (log_idx == CRAS_MAX_AUDIO_THREADS) {
+    syslog(LOG_ERR, "Too many audio threads");
+    return NULL;
+  }
 
   thread = (struct audio_thread*)calloc(1, sizeof(*thread));
   if (!thread) {
     return NULL;
   }
 
-  thread->to_thread_fds[0] = -1;
-  thread->to_thread_fds[1] = -1;
+  thread->doorbell_fd = -1;
+  thread->ring_space_fd = -1;
   thread->to_main_fds[0] = -1;
   thread->to_main_fds[1] = -1;
+  thread->timer_fd = -1;
+  thread->wait_set_fd = -1;
 
-  // Two way pipes for communication with the device's audio thread.
-  rc = pipe(thread->to_thread_fds);
-  if (rc < 0) {
-    syslog(LOG_ERR, "Failed to pipe");
+  thread->cmd_ring = (struct audio_thread_cmd_ring*)aligned_alloc(
+      __alignof__(struct audio_thread_cmd_ring), sizeof(*thread->cmd_ring));
+  if (!thread->cmd_ring) {
+    free(thread);
+    return NULL;
+  }
+  memset(thread->cmd_ring, 0, sizeof(*thread->cmd_ring));
+
+  // Command ring doorbell and response pipe for the device's audio thread.
+  thread->doorbell_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (thread->doorbell_fd < 0) {
+    syslog(LOG_ERR, "Failed to create doorbell");
+    free(thread->cmd_ring);
+    free(thread);
+    return NULL;
+  }
+  thread->ring_space_fd = eventfd(0, EFD_CLOEXEC);
+  if (thread->ring_space_fd < 0) {
+    syslog(LOG_ERR, "Failed to create command ring eventfd");
+    close(thread->doorbell_fd);
+    free(thread->cmd_ring);
     free(thread);
     return NULL;
   }
@@ -1192,16 +1668,55 @@ struct audio_thread* audio_thread_create() {
     return NULL;
   }
 
-  if (asprintf(&atlog_name, "/ATlog-%d", getpid()) < 0) {
-    syslog(LOG_ERR, "Failed to generate ATlog name.");
-    exit(-1);
+  if (!atlog_sections) {
+    if (asprintf(&atlog_name, "/ATlog-%d", getpid()) < 0) {
+      syslog(LOG_ERR, "Failed to generate ATlog name.");
+      exit(-1);
+    }
+    atlog_sections =
+        audio_thread_event_log_init(atlog_name, CRAS_MAX_AUDIO_THREADS);
+    if (!atlog_sections) {
+      syslog(LOG_ERR, "Failed to create ATlog.");
+      exit(-1);
+    }
+  }
+  // Start clean, the section may have been left by a destroyed thread.
+  thread->atlog = &atlog_sections[log_idx];
+  memset(thread->atlog, 0, sizeof(*thread->atlog));
+  thread->atlog->len = AUDIO_THREAD_EVENT_LOG_SIZE;
+  atlog_owners[log_idx] = thread;
+  if (!primary_thread) {
+    primary_thread = thread;
+  }
+  if (!atlog) {
+    atlog = thread->atlog;
+  }
+  if (!current_thread) {
+    current_thread = thread;
   }
 
-  atlog = audio_thread_event_log_init(atlog_name);
+  thread->wait_set_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (thread->wait_set_fd < 0) {
+    syslog(LOG_ERR, "Failed to create wait set");
+    exit(-1);
+  }
+  thread->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (thread->timer_fd < 0) {
+    syslog(LOG_ERR, "Failed to create wake up timer");
+    exit(-1);
+  }
+  if (wait_set_add(thread, thread->doorbell_fd, EPOLLIN, thread) < 0 ||
+      wait_set_add(thread, thread->timer_fd, EPOLLIN, &thread->timer_fd) < 0) {
+    syslog(LOG_ERR, "Failed to populate wait set");
+    exit(-1);
+  }
 
-  thread->pollfds_size = 32;
-  thread->pollfds =
-      (struct pollfd*)malloc(sizeof(*thread->pollfds) * thread->pollfds_size);
+  // Pick up callbacks registered before any thread existed.
+  thread->callbacks = pending_callbacks;
+  pending_callbacks = NULL;
+  DL_FOREACH (thread->callbacks, iodev_cb) {
+    update_callback_wait(thread, iodev_cb);
+  }
 
   return thread;
 }
@@ -1277,6 +1792,9 @@ int audio_thread_start(struct audio_thread* thread) {
 }
 
 void audio_thread_destroy(struct audio_thread* thread) {
+  struct iodev_callback_list* iodev_cb;
+  unsigned int i;
+
   if (thread->started) {
     struct audio_thread_msg msg;
 
@@ -1286,23 +1804,66 @@ void audio_thread_destroy(struct audio_thread* thread) {
     pthread_join(thread->tid, NULL);
   }
 
-  free(thread->pollfds);
+  // Callbacks left behind go to the next thread created.
+  DL_FOREACH (thread->callbacks, iodev_cb) {
+    iodev_cb->in_wait_set = false;
+  }
+  DL_CONCAT(pending_callbacks, thread->callbacks);
+  if (thread->wait_set_fd >= 0) {
+    close(thread->wait_set_fd);
+  }
+  if (thread->timer_fd >= 0) {
+    close(thread->timer_fd);
+  }
 
-  audio_thread_event_log_deinit(atlog, atlog_name);
-  free(atlog_name);
+  if (thread == primary_thread) {
+    primary_thread = NULL;
+  }
+  atlog_owners[thread->atlog - atlog_sections] = NULL;
+  for (i = 0; i < CRAS_MAX_AUDIO_THREADS; i++) {
+    if (atlog_owners[i]) {
+      break;
+    }
+  }
+  if (i == CRAS_MAX_AUDIO_THREADS) {
+    audio_thread_event_log_deinit(atlog_sections, atlog_name,
+                                  CRAS_MAX_AUDIO_THREADS);
+    atlog_sections = NULL;
+    free(atlog_name);
+    atlog_name = NULL;
+  }
+  if (atlog == thread->atlog) {
+    atlog = primary_thread ? primary_thread->atlog : NULL;
+  }
+  if (current_thread == thread) {
+    current_thread = primary_thread;
+  }
 
-  if (thread->to_thread_fds[0] != -1) {
-    close(thread->to_thread_fds[0]);
-    close(thread->to_thread_fds[1]);
+  if (thread->doorbell_fd != -1) {
+    close(thread->doorbell_fd);
+  }
+  if (thread->ring_space_fd != -1) {
+    close(thread->ring_space_fd);
   }
   if (thread->to_main_fds[0] != -1) {
     close(thread->to_main_fds[0]);
     close(thread->to_main_fds[1]);
   }
 
-  if (thread->remix_converter) {
-    cras_fmt_conv_destroy(&thread->remix_converter);
+  /* The thread is stopped, so it handled every posted remix converter, or
+   * never started and holds none. */
+  if (thread->posted_remix_converter) {
+    cras_fmt_conv_destroy(&thread->posted_remix_converter);
+  }
+  if (thread->retired_remix_converter) {
+    cras_fmt_conv_destroy(&thread->retired_remix_converter);
+  }
+
+  // The primary thread goes last, no stream is left to reuse a converter.
+  if (!primary_thread) {
+    cras_fmt_conv_pool_clear();
   }
 
+  free(thread->cmd_ring);
   free(thread);
 }
@@ -13,18 +13,30 @@
 #include "cras/src/server/dev_io.h"
 #include "cras_types.h"
 
+struct audio_thread_cmd_ring;
+struct audio_thread_event_log;
 struct buffer_share;
 struct cras_fmt_conv;
 struct cras_iodev;
 struct cras_rstream;
 struct dev_stream;
+struct iodev_callback_list;
 
-/* Hold communication pipes and pthread info for the thread used to play or
+/* Identifies a command posted to the audio thread. Commands are handled in
+ * the order they are posted.
+ */
+typedef uint64_t audio_thread_token_t;
+
+/* Hold communication channels and pthread info for the thread used to play or
  * record audio.
  */
 struct audio_thread {
-  // Send a message from main to running thread.
-  int to_thread_fds[2];
+  // Commands queued from main to running thread.
+  struct audio_thread_cmd_ring* cmd_ring;
+  // Eventfd signaled by main after queuing commands to cmd_ring.
+  int doorbell_fd;
+  // Eventfd signaled by running thread after making room in a full cmd_ring.
+  int ring_space_fd;
   // Send a synchronous response to main from running thread.
   int to_main_fds[2];
   // Thread ID of the running playback/capture thread.
@@ -35,14 +47,22 @@ struct audio_thread {
   int suspended;
   // Lists of open input and output devices.
   struct open_dev* open_devs[CRAS_NUM_DIRECTIONS];
-  // What FDs wake up this thread.
-  struct pollfd* pollfds;
-  // Number of available poll fds.
-  size_t pollfds_size;
-  // Number of currently registered poll fds.
-  size_t num_pollfds;
+  // Timer armed with the next time an open device needs service.
+  int timer_fd;
+  // Epoll set the thread waits on.
+  int wait_set_fd;
+  // Callbacks of the devices open on this thread.
+  struct iodev_callback_list* callbacks;
+  // Event log of this thread.
+  struct audio_thread_event_log* atlog;
   // Format converter used to remix output channels.
   struct cras_fmt_conv* remix_converter;
+  // Remix converter last posted to the thread. Owned by main thread.
+  struct cras_fmt_conv* posted_remix_converter;
+  // Remix converter replaced by posted_remix_converter. Freed by main thread
+  // once the command identified by remix_retire_token is handled.
+  struct cras_fmt_conv* retired_remix_converter;
+  audio_thread_token_t remix_retire_token;
 };
 
 /*
@@ -71,6 +91,20 @@ typedef int (*thread_callback)(void* data, int revent);
  */
 struct audio_thread* audio_thread_create();
 
+/* Sets the audio thread that callbacks and streams registered from the
+ * calling thread belong to. Each audio thread starts with itself, the main
+ * thread with the first created audio thread. The main thread switches it
+ * while it opens or closes a device that runs on another audio thread.
+ * Args:
+ *    thread - The audio thread to register to.
+ * Returns:
+ *    The previous one.
+ */
+struct audio_thread* audio_thread_set_current(struct audio_thread* thread);
+
+// Gets the audio thread set by audio_thread_set_current().
+struct audio_thread* audio_thread_get_current();
+
 /* Adds an open device.
  * Args:
  *    thread - The thread to add open device to.
@@ -96,8 +130,8 @@ int audio_thread_rm_open_dev(struct audio_thread* thread,
 int audio_thread_is_dev_open(struct audio_thread* thread,
                              struct cras_iodev* dev);
 
-/* Adds a thread_callback to audio thread for requested events. By default
- * the callback trigger is set to TRIGGER_POLL.
+/* Adds a thread_callback to the current audio thread for requested events.
+ * By default the callback trigger is set to TRIGGER_POLL.
  * Args:
  *    fd - The file descriptor to be polled for the callback.
  *      The callback will be called when any of requested events matched.
@@ -110,7 +144,7 @@ void audio_thread_add_events_callback(int fd,
                                       void* data,
                                       int events);
 
-/* Removes an thread_callback from audio thread.
+/* Removes an thread_callback from the current audio thread.
  * Args:
  *    fd - The file descriptor of the previous added callback.
  */
@@ -132,6 +166,14 @@ void audio_thread_config_events_callback(
     int fd,
     enum AUDIO_THREAD_EVENTS_CB_TRIGGER trigger);
 
+/* Removes the fd of a stream from the audio thread wait set. The audio thread
+ * waits on it while the stream is pending a reply from its client. Called by
+ * dev_io when the stream is detached from its last open device.
+ * Args:
+ *    stream - The stream to stop waiting on.
+ */
+void audio_thread_unwatch_stream(struct cras_rstream* stream);
+
 /* Starts a thread created with audio_thread_create.
  * Args:
  *    thread - The thread to start.
@@ -143,7 +185,8 @@ int audio_thread_start(struct audio_thread* thread);
 // Frees an audio thread created with audio_thread_create().
 void audio_thread_destroy(struct audio_thread* thread);
 
-// Returns the shm fd for the ATlog.
+/* Returns the shm fd for the ATlog. It maps the event logs of all the audio
+ * threads, the one of the primary thread first. */
 int audio_thread_event_log_shm_fd();
 
 /* Add a stream to the thread. After this call, the ownership of the stream will
@@ -191,23 +234,50 @@ int audio_thread_disconnect_stream(struct audio_thread* thread,
 int audio_thread_dump_thread_info(struct audio_thread* thread,
                                   struct audio_debug_info* info);
 
-/* Starts or stops the aec dump task.
+/* Dumps the devices, streams and events of several audio threads into one
+ * info, with the events of all threads in the order they were logged.
+ * Args:
+ *    threads - The audio threads to dump.
+ *    num_threads - Number of threads, at most CRAS_MAX_AUDIO_THREADS.
+ *    info - Filled with the merged debug info.
+ * Returns:
+ *    0 on success, otherwise a negative error code.
+ */
+int audio_thread_dump_threads_info(struct audio_thread** threads,
+                                   unsigned int num_threads,
+                                   struct audio_debug_info* info);
+
+/* Starts or stops the aec dump task. Doesn't wait for the audio thread.
  * Args:
  *    thread - pointer to the audio thread.
  *    stream_id - id of the target stream for aec dump.
  *    start - True to start the aec dump, false to stop.
  *    fd - File to store aec dump result.
+ *    token - If not NULL, filled with the token of the posted command.
+ * Returns:
+ *    0 if the command is posted, negative error code otherwise.
  */
 int audio_thread_set_aec_dump(struct audio_thread* thread,
                               cras_stream_id_t stream_id,
                               unsigned int start,
-                              int fd);
+                              int fd,
+                              audio_thread_token_t* token);
 
 /* Configures the global converter for output remixing. Called by main
- * thread. */
+ * thread. Doesn't wait for the audio thread, the replaced converter is freed
+ * on a later call or when the thread is destroyed.
+ * Args:
+ *    thread - pointer to the audio thread.
+ *    num_channels - Number of channels of the remix matrix.
+ *    coefficient - num_channels * num_channels remix matrix.
+ *    token - If not NULL, filled with the token of the posted command.
+ * Returns:
+ *    0 if the command is posted, negative error code otherwise.
+ */
 int audio_thread_config_global_remix(struct audio_thread* thread,
                                      unsigned int num_channels,
-                                     const float* coefficient);
+                                     const float* coefficient,
+                                     audio_thread_token_t* token);
 
 /* Start ramping on a device.
  *
@@ -224,4 +294,22 @@ int audio_thread_config_global_remix(struct audio_thread* thread,
 int audio_thread_dev_start_ramp(struct audio_thread* thread,
                                 unsigned int dev_idx,
                                 enum CRAS_IODEV_RAMP_REQUEST request);
+
+/* Checks if a command posted to the audio thread has been handled.
+ * Args:
+ *    thread - a pointer to the audio thread.
+ *    token - Token of the command.
+ */
+int audio_thread_token_done(struct audio_thread* thread,
+                            audio_thread_token_t token);
+
+/* Waits until a command posted to the audio thread has been handled.
+ * Args:
+ *    thread - a pointer to the audio thread.
+ *    token - Token of the command.
+ * Returns:
+ *    0 on success, negative error code if the thread can't be reached.
+ */
+int audio_thread_wait_token(struct audio_thread* thread,
+                            audio_thread_token_t token);
 #endif  // CRAS_SRC_SERVER_AUDIO_THREAD_H_
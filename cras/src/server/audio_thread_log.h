@@ -25,38 +25,49 @@
 #define ATLOG(log, event, data1, data2, data3)
 #endif
 
-extern struct audio_thread_event_log* atlog;
+/* Event log of the calling thread. NULL on threads that are neither an audio
+ * thread nor the main thread, whose events are dropped.
+ */
+extern __thread struct audio_thread_event_log* atlog;
 extern int atlog_rw_shm_fd;
 extern int atlog_ro_shm_fd;
 
+/* Creates num_logs event logs next to each other in the shared memory region
+ * name.
+ */
 static inline struct audio_thread_event_log* audio_thread_event_log_init(
-    char* name) {
+    char* name,
+    unsigned int num_logs) {
   struct audio_thread_event_log* log;
+  unsigned int i;
 
   atlog_ro_shm_fd = -1;
   atlog_rw_shm_fd = -1;
 
   log = (struct audio_thread_event_log*)cras_shm_setup(
-      name, sizeof(*log), &atlog_rw_shm_fd, &atlog_ro_shm_fd);
+      name, sizeof(*log) * num_logs, &atlog_rw_shm_fd, &atlog_ro_shm_fd);
   /* Fallback to calloc if device shared memory resource is empty and
    * cras_shm_setup fails.
    */
   if (log == NULL) {
     syslog(LOG_WARNING, "Failed to create atlog by cras_shm_setup");
     log = (struct audio_thread_event_log*)calloc(
-        1, sizeof(struct audio_thread_event_log));
+        num_logs, sizeof(struct audio_thread_event_log));
+  }
+  for (i = 0; i < num_logs; i++) {
+    log[i].len = AUDIO_THREAD_EVENT_LOG_SIZE;
   }
-  log->len = AUDIO_THREAD_EVENT_LOG_SIZE;
 
   return log;
 }
 
 static inline void audio_thread_event_log_deinit(
     struct audio_thread_event_log* log,
-    char* name) {
+    char* name,
+    unsigned int num_logs) {
   if (log) {
     if (atlog_rw_shm_fd >= 0) {
-      munmap(log, sizeof(*log));
+      munmap(log, sizeof(*log) * num_logs);
       cras_shm_close_unlink(name, atlog_rw_shm_fd);
     } else {
       free(log);
@@ -70,6 +81,7 @@ static inline void audio_thread_event_log_deinit(
 
 /* Log a tag and the current time, Uses two words, the first is split
  * 8 bits for tag and 24 for seconds, second word is micro seconds.
+ * Does nothing if log is NULL.
  */
 static inline void audio_thread_event_log_data(
     struct audio_thread_event_log* log,
@@ -78,7 +90,12 @@ static inline void audio_thread_event_log_data(
     uint32_t data2,
     uint32_t data3) {
   struct timespec now;
-  uint64_t pos_mod_len = log->write_pos % AUDIO_THREAD_EVENT_LOG_SIZE;
+  uint64_t pos_mod_len;
+
+  if (!log) {
+    return;
+  }
+  pos_mod_len = log->write_pos % AUDIO_THREAD_EVENT_LOG_SIZE;
   clock_gettime(CLOCK_MONOTONIC_RAW, &now);
 
   log->log[pos_mod_len].tag_sec = (event << 24) | (now.tv_sec & 0x00ffffff);
@@ -28,6 +28,8 @@ struct cras_board_config {
   int32_t max_internal_mic_gain;
   int32_t max_internal_speaker_channels;
   int32_t max_headphone_channels;
+  int32_t num_audio_threads;
+  int32_t dsp_crossfade_frames;
 };
 
 /* Gets a configuration based on the config file specified.
@@ -66,6 +66,12 @@ struct cras_alsa_card {
   struct cras_card_config* config;
   enum CRAS_ALSA_CARD_TYPE card_type;
   struct cras_alsa_iodev_ops* ops;
+  /* Kept from cras_alsa_card_probe() for cras_alsa_card_complete(), released
+   * once the card is complete. */
+  snd_ctl_t* ctl;
+  char* card_name;
+  // Devices in the UCM config, NULL unless the UCM is fully specified.
+  struct ucm_section* ucm_sections;
 };
 
 static struct cras_alsa_iodev_ops cras_alsa_iodev_ops_internal_ops = {
@@ -216,19 +222,12 @@ static void alsa_control_event_pending(void* arg, int revent) {
   snd_hctl_handle_events(card->hctl);
 }
 
-static int add_controls_and_iodevs_by_matching(
-    struct cras_alsa_card_info* info,
-    struct cras_device_blocklist* blocklist,
-    struct cras_alsa_card* alsa_card,
-    const char* card_name,
-    snd_ctl_t* handle) {
+// Adds the mixer controls of a card that isn't fully specified by UCM.
+static int add_controls_by_matching(struct cras_alsa_card_info* info,
+                                    struct cras_alsa_card* alsa_card) {
   struct mixer_name* coupled_controls = NULL;
-  int dev_idx;
-  snd_pcm_info_t* dev_info;
   struct mixer_name* extra_controls = NULL;
-  int rc = 0;
-
-  snd_pcm_info_alloca(&dev_info);
+  int rc;
 
   if (alsa_card->ucm) {
     char* extra_main_volume;
@@ -258,15 +257,30 @@ static int add_controls_and_iodevs_by_matching(
       alsa_card->mixer, extra_controls, coupled_controls, info->card_type);
   if (rc) {
     syslog(LOG_ERR, "Fail adding controls to mixer for %s.", alsa_card->name);
-    goto error;
   }
 
+  mixer_name_free(coupled_controls);
+  mixer_name_free(extra_controls);
+  return rc;
+}
+
+static int add_iodevs_by_matching(struct cras_alsa_card_info* info,
+                                  struct cras_device_blocklist* blocklist,
+                                  struct cras_alsa_card* alsa_card) {
+  const char* card_name = alsa_card->card_name;
+  snd_ctl_t* handle = alsa_card->ctl;
+  int dev_idx;
+  snd_pcm_info_t* dev_info;
+  int rc;
+
+  snd_pcm_info_alloca(&dev_info);
+
   // Go through every device.
   dev_idx = -1;
   while (1) {
     rc = snd_ctl_pcm_next_device(handle, &dev_idx);
     if (rc < 0) {
-      goto error;
+      return rc;
     }
     if (dev_idx < 0) {
       break;
@@ -285,7 +299,7 @@ static int add_controls_and_iodevs_by_matching(
       if (iodev) {
         rc = cras_alsa_iodev_ops_legacy_complete_init(alsa_card->ops, iodev);
         if (rc < 0) {
-          goto error;
+          return rc;
         }
       }
     }
@@ -299,29 +313,21 @@ static int add_controls_and_iodevs_by_matching(
       if (iodev) {
         rc = cras_alsa_iodev_ops_legacy_complete_init(alsa_card->ops, iodev);
         if (rc < 0) {
-          goto error;
+          return rc;
         }
       }
     }
   }
-error:
-  mixer_name_free(coupled_controls);
-  mixer_name_free(extra_controls);
-  return rc;
+  return 0;
 }
 
-static int add_controls_and_iodevs_with_ucm(struct cras_alsa_card_info* info,
-                                            struct cras_alsa_card* alsa_card,
-                                            const char* card_name,
-                                            snd_ctl_t* handle) {
-  snd_pcm_info_t* dev_info;
+/* Adds the mixer controls of a card fully specified by UCM, and keeps the UCM
+ * sections to create the devices from. */
+static int add_controls_with_ucm(struct cras_alsa_card* alsa_card) {
+  const char* card_name = alsa_card->card_name;
   struct mixer_name* main_volume_control_names;
-  struct iodev_list_node* node;
   int rc = 0;
   struct ucm_section* section;
-  struct ucm_section* ucm_sections;
-
-  snd_pcm_info_alloca(&dev_info);
 
   main_volume_control_names = ucm_get_main_volume_names(alsa_card->ucm);
   if (main_volume_control_names) {
@@ -337,8 +343,8 @@ static int add_controls_and_iodevs_with_ucm(struct cras_alsa_card_info* info,
   }
 
   // Get info on the devices specified in the UCM config.
-  ucm_sections = ucm_get_sections(alsa_card->ucm);
-  if (!ucm_sections) {
+  alsa_card->ucm_sections = ucm_get_sections(alsa_card->ucm);
+  if (!alsa_card->ucm_sections) {
     syslog(LOG_ERR,
            "Could not retrieve any UCM SectionDevice"
            " info for '%s'.",
@@ -348,19 +354,35 @@ static int add_controls_and_iodevs_with_ucm(struct cras_alsa_card_info* info,
   }
 
   // Create all of the controls first.
-  DL_FOREACH (ucm_sections, section) {
+  DL_FOREACH (alsa_card->ucm_sections, section) {
     rc = cras_alsa_mixer_add_controls_in_section(alsa_card->mixer, section);
     if (rc) {
       syslog(LOG_ERR,
              "Failed adding controls to"
              " mixer for '%s:%s'",
              card_name, section->name);
-      goto cleanup;
+      goto cleanup_names;
     }
   }
 
+cleanup_names:
+  mixer_name_free(main_volume_control_names);
+  return rc;
+}
+
+static int add_iodevs_with_ucm(struct cras_alsa_card_info* info,
+                               struct cras_alsa_card* alsa_card) {
+  const char* card_name = alsa_card->card_name;
+  snd_ctl_t* handle = alsa_card->ctl;
+  snd_pcm_info_t* dev_info;
+  struct iodev_list_node* node;
+  int rc;
+  struct ucm_section* section;
+
+  snd_pcm_info_alloca(&dev_info);
+
   // Create all of the devices.
-  DL_FOREACH (ucm_sections, section) {
+  DL_FOREACH (alsa_card->ucm_sections, section) {
     /* If a UCM section specifies certain device as dependency
      * then don't create an alsa iodev for it, just append it
      * as node later. */
@@ -375,8 +397,7 @@ static int add_controls_and_iodevs_with_ucm(struct cras_alsa_card_info* info,
       snd_pcm_info_set_stream(dev_info, SND_PCM_STREAM_CAPTURE);
     } else {
       syslog(LOG_ERR, "Unexpected direction: %d", section->dir);
-      rc = -EINVAL;
-      goto cleanup;
+      return -EINVAL;
     }
 
     if (snd_ctl_pcm_info(handle, dev_info)) {
@@ -392,7 +413,7 @@ static int add_controls_and_iodevs_with_ucm(struct cras_alsa_card_info* info,
   /* Setup jacks and controls for the devices. If a SectionDevice is
    * dependent on another SectionDevice, it'll be added as a node to
    * a existing ALSA iodev. */
-  DL_FOREACH (ucm_sections, section) {
+  DL_FOREACH (alsa_card->ucm_sections, section) {
     DL_FOREACH (alsa_card->iodevs, node) {
       if (node->direction != section->dir) {
         continue;
@@ -410,7 +431,7 @@ static int add_controls_and_iodevs_with_ucm(struct cras_alsa_card_info* info,
       rc = cras_alsa_iodev_ops_ucm_add_nodes_and_jacks(alsa_card->ops,
                                                        node->iodev, section);
       if (rc < 0) {
-        goto cleanup;
+        return rc;
       }
     }
   }
@@ -418,12 +439,7 @@ static int add_controls_and_iodevs_with_ucm(struct cras_alsa_card_info* info,
   DL_FOREACH (alsa_card->iodevs, node) {
     cras_alsa_iodev_ops_ucm_complete_init(alsa_card->ops, node->iodev);
   }
-
-cleanup:
-  ucm_section_free_list(ucm_sections);
-cleanup_names:
-  mixer_name_free(main_volume_control_names);
-  return rc;
+  return 0;
 }
 
 static void configure_echo_reference_dev(struct cras_alsa_card* alsa_card) {
@@ -462,17 +478,26 @@ static void configure_echo_reference_dev(struct cras_alsa_card* alsa_card) {
   }
 }
 
+// Releases what was only kept for cras_alsa_card_complete().
+static void release_probe_state(struct cras_alsa_card* alsa_card) {
+  if (alsa_card->ctl) {
+    snd_ctl_close(alsa_card->ctl);
+    alsa_card->ctl = NULL;
+  }
+  free(alsa_card->card_name);
+  alsa_card->card_name = NULL;
+  ucm_section_free_list(alsa_card->ucm_sections);
+  alsa_card->ucm_sections = NULL;
+}
+
 /*
  * Exported Interface.
  */
 
-struct cras_alsa_card* cras_alsa_card_create(
-    struct cras_alsa_card_info* info,
-    const char* device_config_dir,
-    struct cras_device_blocklist* blocklist,
-    const char* ucm_suffix) {
-  snd_ctl_t* handle = NULL;
-  int rc, n;
+struct cras_alsa_card* cras_alsa_card_probe(struct cras_alsa_card_info* info,
+                                            const char* device_config_dir,
+                                            const char* ucm_suffix) {
+  int rc;
   snd_ctl_card_info_t* card_info;
   const char* card_name;
   struct cras_alsa_card* alsa_card;
@@ -493,19 +518,15 @@ struct cras_alsa_card* cras_alsa_card_create(
 
   snprintf(alsa_card->name, MAX_ALSA_CARD_NAME_LENGTH, "hw:%u",
            info->card_index);
-  alsa_card->ops = &cras_alsa_iodev_ops_internal_ops;
-  if (cras_feature_enabled(CrOSLateBootCrasSplitAlsaUSBInternal) &&
-      alsa_card->card_type == ALSA_CARD_TYPE_USB) {
-    alsa_card->ops = &cras_alsa_iodev_ops_usb_ops;
-  }
 
-  rc = snd_ctl_open(&handle, alsa_card->name, 0);
+  rc = snd_ctl_open(&alsa_card->ctl, alsa_card->name, 0);
   if (rc < 0) {
     syslog(LOG_ERR, "Fail opening control %s.", alsa_card->name);
+    alsa_card->ctl = NULL;
     goto error_bail;
   }
 
-  rc = snd_ctl_card_info(handle, card_info);
+  rc = snd_ctl_card_info(alsa_card->ctl, card_info);
   if (rc < 0) {
     syslog(LOG_WARNING, "Error getting card info.");
     goto error_bail;
@@ -516,6 +537,10 @@ struct cras_alsa_card* cras_alsa_card_create(
     syslog(LOG_WARNING, "Error getting card name.");
     goto error_bail;
   }
+  alsa_card->card_name = strdup(card_name);
+  if (alsa_card->card_name == NULL) {
+    goto error_bail;
+  }
 
   if (info->card_type == ALSA_CARD_TYPE_USB ||
       cras_system_check_ignore_ucm_suffix(card_name)) {
@@ -576,15 +601,41 @@ struct cras_alsa_card* cras_alsa_card_create(
   }
 
   if (alsa_card->ucm && ucm_has_fully_specified_ucm_flag(alsa_card->ucm)) {
-    rc = add_controls_and_iodevs_with_ucm(info, alsa_card, card_name, handle);
+    rc = add_controls_with_ucm(alsa_card);
   } else {
-    rc = add_controls_and_iodevs_by_matching(info, blocklist, alsa_card,
-                                             card_name, handle);
+    rc = add_controls_by_matching(info, alsa_card);
   }
   if (rc) {
     goto error_bail;
   }
 
+  return alsa_card;
+
+error_bail:
+  cras_alsa_card_destroy(alsa_card);
+  return NULL;
+}
+
+int cras_alsa_card_complete(struct cras_alsa_card* alsa_card,
+                            struct cras_alsa_card_info* info,
+                            struct cras_device_blocklist* blocklist) {
+  int rc, n;
+
+  alsa_card->ops = &cras_alsa_iodev_ops_internal_ops;
+  if (cras_feature_enabled(CrOSLateBootCrasSplitAlsaUSBInternal) &&
+      alsa_card->card_type == ALSA_CARD_TYPE_USB) {
+    alsa_card->ops = &cras_alsa_iodev_ops_usb_ops;
+  }
+
+  if (alsa_card->ucm_sections) {
+    rc = add_iodevs_with_ucm(info, alsa_card);
+  } else {
+    rc = add_iodevs_by_matching(info, blocklist, alsa_card);
+  }
+  if (rc) {
+    return rc;
+  }
+
   configure_echo_reference_dev(alsa_card);
 
   n = alsa_card->hctl ? snd_hctl_poll_descriptors_count(alsa_card->hctl) : 0;
@@ -595,8 +646,7 @@ struct cras_alsa_card* cras_alsa_card_create(
 
     pollfds = malloc(n * sizeof(*pollfds));
     if (pollfds == NULL) {
-      rc = -ENOMEM;
-      goto error_bail;
+      return -ENOMEM;
     }
 
     n = snd_hctl_poll_descriptors(alsa_card->hctl, pollfds, n);
@@ -604,8 +654,7 @@ struct cras_alsa_card* cras_alsa_card_create(
       registered_fd = calloc(1, sizeof(*registered_fd));
       if (registered_fd == NULL) {
         free(pollfds);
-        rc = -ENOMEM;
-        goto error_bail;
+        return -ENOMEM;
       }
       registered_fd->fd = pollfds[i].fd;
       DL_APPEND(alsa_card->hctl_poll_fds, registered_fd);
@@ -613,22 +662,34 @@ struct cras_alsa_card* cras_alsa_card_create(
           registered_fd->fd, alsa_control_event_pending, alsa_card, POLLIN);
       if (rc < 0) {
         DL_DELETE(alsa_card->hctl_poll_fds, registered_fd);
+        free(registered_fd);
         free(pollfds);
-        goto error_bail;
+        return rc;
       }
     }
     free(pollfds);
   }
 
-  snd_ctl_close(handle);
-  return alsa_card;
+  release_probe_state(alsa_card);
+  return 0;
+}
 
-error_bail:
-  if (handle != NULL) {
-    snd_ctl_close(handle);
+struct cras_alsa_card* cras_alsa_card_create(
+    struct cras_alsa_card_info* info,
+    const char* device_config_dir,
+    struct cras_device_blocklist* blocklist,
+    const char* ucm_suffix) {
+  struct cras_alsa_card* alsa_card;
+
+  alsa_card = cras_alsa_card_probe(info, device_config_dir, ucm_suffix);
+  if (alsa_card == NULL) {
+    return NULL;
   }
-  cras_alsa_card_destroy(alsa_card);
-  return NULL;
+  if (cras_alsa_card_complete(alsa_card, info, blocklist)) {
+    cras_alsa_card_destroy(alsa_card);
+    return NULL;
+  }
+  return alsa_card;
 }
 
 void cras_alsa_card_destroy(struct cras_alsa_card* alsa_card) {
@@ -639,6 +700,7 @@ void cras_alsa_card_destroy(struct cras_alsa_card* alsa_card) {
     return;
   }
 
+  release_probe_state(alsa_card);
   DL_FOREACH (alsa_card->iodevs, curr) {
     cras_alsa_iodev_ops_destroy(alsa_card->ops, curr->iodev);
     DL_DELETE(alsa_card->iodevs, curr);
@@ -36,6 +36,36 @@ struct cras_alsa_card* cras_alsa_card_create(
     struct cras_device_blocklist* blocklist,
     const char* ucm_suffix);
 
+/* The first half of cras_alsa_card_create(). Opens the card and parses its
+ * config, UCM and mixer controls without touching the iodev list or the main
+ * loop, so it can run on any thread.
+ * Args:
+ *    card_info - Contains the card index, type, and priority.
+ *    device_config_dir - The directory of device configs which contains the
+ *                        volume curves.
+ *    ucm_suffix - The ucm config name is formed as <card-name>.<suffix>
+ * Returns:
+ *    The probed card to pass to cras_alsa_card_complete(), or NULL on error.
+ */
+struct cras_alsa_card* cras_alsa_card_probe(struct cras_alsa_card_info* info,
+                                            const char* device_config_dir,
+                                            const char* ucm_suffix);
+
+/* The second half of cras_alsa_card_create(). Adds the devices of a card
+ * returned from cras_alsa_card_probe() to the system. Must be called on the
+ * main thread.
+ * Args:
+ *    alsa_card - The card returned from cras_alsa_card_probe().
+ *    card_info - The card info it was probed with.
+ *    blocklist - List of devices that should be ignored.
+ * Returns:
+ *    0 on success, otherwise a negative error code and the card should be
+ *    destroyed.
+ */
+int cras_alsa_card_complete(struct cras_alsa_card* alsa_card,
+                            struct cras_alsa_card_info* info,
+                            struct cras_device_blocklist* blocklist);
+
 /* Destroys a cras_alsa_card that was returned from cras_alsa_card_create.
  * Args:
  *    alsa_card - The cras_alsa_card pointer returned from
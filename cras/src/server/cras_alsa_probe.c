@@ -0,0 +1,247 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cras/src/server/cras_alsa_probe.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "cras/src/server/cras_alsa_card.h"
+#include "cras/src/server/cras_main_message.h"
+#include "third_party/utlist/utlist.h"
+
+enum probe_state {
+  PROBE_QUEUED,
+  PROBE_RUNNING,
+  // Probed, the result is on its way to the main thread.
+  PROBE_DONE,
+};
+
+struct probe_job {
+  struct cras_alsa_card_info info;
+  const char* device_config_dir;
+  const char* ucm_suffix;
+  unsigned int delay_us;
+  cras_alsa_probe_done done;
+  void* arg;
+  enum probe_state state;
+  // Only accessed on the main thread.
+  int cancelled;
+  struct cras_alsa_card* alsa_card;
+  struct probe_job *prev, *next;
+};
+
+struct alsa_probe_msg {
+  struct cras_main_message header;
+  struct probe_job* job;
+};
+
+static struct {
+  // Protects everything below and the state of the jobs.
+  pthread_mutex_t mutex;
+  // Signaled when a worker exits.
+  pthread_cond_t worker_exit;
+  // Jobs from cras_alsa_probe_card() until the main thread takes the result.
+  struct probe_job* jobs;
+  unsigned int max_workers;
+  unsigned int num_workers;
+  int stopping;
+} pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .worker_exit = PTHREAD_COND_INITIALIZER,
+};
+
+// The following functions are called from the probe workers.
+
+static void run_job(struct probe_job* job) {
+  struct alsa_probe_msg msg = CRAS_MAIN_MESSAGE_INIT;
+  struct cras_alsa_card* alsa_card;
+  int rc;
+
+  if (job->delay_us) {
+    usleep(job->delay_us);
+  }
+  alsa_card = cras_alsa_card_probe(&job->info, job->device_config_dir,
+                                   job->ucm_suffix);
+
+  pthread_mutex_lock(&pool.mutex);
+  job->alsa_card = alsa_card;
+  job->state = PROBE_DONE;
+  pthread_mutex_unlock(&pool.mutex);
+
+  msg.header.type = CRAS_MAIN_ALSA_PROBE;
+  msg.header.length = sizeof(msg);
+  msg.job = job;
+  rc = cras_main_message_send((struct cras_main_message*)&msg);
+  if (rc < 0) {
+    syslog(LOG_ERR, "Failed to send probe result of card %u",
+           job->info.card_index);
+    pthread_mutex_lock(&pool.mutex);
+    DL_DELETE(pool.jobs, job);
+    pthread_mutex_unlock(&pool.mutex);
+    cras_alsa_card_destroy(alsa_card);
+    free(job);
+  }
+}
+
+// Probes queued cards until there are none left.
+static void* probe_worker(void* arg) {
+  struct probe_job* job;
+
+  pthread_mutex_lock(&pool.mutex);
+  while (!pool.stopping) {
+    DL_FOREACH (pool.jobs, job) {
+      if (job->state == PROBE_QUEUED) {
+        break;
+      }
+    }
+    if (job == NULL) {
+      break;
+    }
+    job->state = PROBE_RUNNING;
+    pthread_mutex_unlock(&pool.mutex);
+    run_job(job);
+    pthread_mutex_lock(&pool.mutex);
+  }
+  pool.num_workers--;
+  pthread_cond_signal(&pool.worker_exit);
+  pthread_mutex_unlock(&pool.mutex);
+  return NULL;
+}
+
+// The following functions are called from main thread.
+
+static void handle_probe_message(struct cras_main_message* msg, void* arg) {
+  struct probe_job* job = ((struct alsa_probe_msg*)msg)->job;
+
+  pthread_mutex_lock(&pool.mutex);
+  DL_DELETE(pool.jobs, job);
+  pthread_mutex_unlock(&pool.mutex);
+
+  if (job->cancelled) {
+    cras_alsa_card_destroy(job->alsa_card);
+  } else {
+    job->done(job->alsa_card, &job->info, job->arg);
+  }
+  free(job);
+}
+
+static struct probe_job* find_job(unsigned int card_index) {
+  struct probe_job* job;
+
+  DL_FOREACH (pool.jobs, job) {
+    if (job->info.card_index == card_index && !job->cancelled) {
+      return job;
+    }
+  }
+  return NULL;
+}
+
+int cras_alsa_probe_init(unsigned int num_workers) {
+  if (num_workers == 0) {
+    return -EINVAL;
+  }
+  pthread_mutex_lock(&pool.mutex);
+  pool.max_workers = num_workers;
+  pthread_mutex_unlock(&pool.mutex);
+  return cras_main_message_add_handler(CRAS_MAIN_ALSA_PROBE,
+                                       handle_probe_message, NULL);
+}
+
+void cras_alsa_probe_deinit() {
+  struct probe_job* job;
+
+  pthread_mutex_lock(&pool.mutex);
+  pool.stopping = 1;
+  while (pool.num_workers) {
+    pthread_cond_wait(&pool.worker_exit, &pool.mutex);
+  }
+  DL_FOREACH (pool.jobs, job) {
+    DL_DELETE(pool.jobs, job);
+    cras_alsa_card_destroy(job->alsa_card);
+    free(job);
+  }
+  pool.stopping = 0;
+  pthread_mutex_unlock(&pool.mutex);
+
+  // Results still in the message pipe refer to freed jobs.
+  cras_main_message_rm_handler(CRAS_MAIN_ALSA_PROBE);
+}
+
+int cras_alsa_probe_card(const struct cras_alsa_card_info* info,
+                         const char* device_config_dir,
+                         const char* ucm_suffix,
+                         unsigned int delay_us,
+                         cras_alsa_probe_done done,
+                         void* arg) {
+  struct probe_job* job;
+  pthread_t thread;
+  int rc = 0;
+
+  if (cras_alsa_probe_pending(info->card_index)) {
+    return -EEXIST;
+  }
+
+  job = calloc(1, sizeof(*job));
+  if (job == NULL) {
+    return -ENOMEM;
+  }
+  job->info = *info;
+  job->device_config_dir = device_config_dir;
+  job->ucm_suffix = ucm_suffix;
+  job->delay_us = delay_us;
+  job->done = done;
+  job->arg = arg;
+  job->state = PROBE_QUEUED;
+
+  pthread_mutex_lock(&pool.mutex);
+  DL_APPEND(pool.jobs, job);
+  if (pool.num_workers < pool.max_workers) {
+    rc = -pthread_create(&thread, NULL, probe_worker, NULL);
+    if (rc == 0) {
+      pthread_detach(thread);
+      pool.num_workers++;
+    } else if (pool.num_workers) {
+      // A running worker takes the job once it's done.
+      rc = 0;
+    } else {
+      syslog(LOG_ERR, "Failed to start probe worker: %d", rc);
+      DL_DELETE(pool.jobs, job);
+      free(job);
+    }
+  }
+  pthread_mutex_unlock(&pool.mutex);
+  return rc;
+}
+
+int cras_alsa_probe_cancel(unsigned int card_index) {
+  struct probe_job* job;
+  int rc = 0;
+
+  pthread_mutex_lock(&pool.mutex);
+  job = find_job(card_index);
+  if (job == NULL) {
+    rc = -ENOENT;
+  } else if (job->state == PROBE_QUEUED) {
+    DL_DELETE(pool.jobs, job);
+    free(job);
+  } else {
+    // A worker still owns it, drop the result when it comes back.
+    job->cancelled = 1;
+  }
+  pthread_mutex_unlock(&pool.mutex);
+  return rc;
+}
+
+int cras_alsa_probe_pending(unsigned int card_index) {
+  struct probe_job* job;
+
+  pthread_mutex_lock(&pool.mutex);
+  job = find_job(card_index);
+  pthread_mutex_unlock(&pool.mutex);
+  return job != NULL;
+}
@@ -0,0 +1,77 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/* Probes ALSA cards on a pool of worker threads.
+ *
+ * Opening a card, loading its controls and parsing its config and UCM takes
+ * long enough that probing several cards one after the other delays the first
+ * usable device by seconds. cras_alsa_probe_card() runs cras_alsa_card_probe()
+ * on a worker and hands the probed card back to the main thread, where the
+ * caller completes it with cras_alsa_card_complete().
+ */
+
+#ifndef CRAS_SRC_SERVER_CRAS_ALSA_PROBE_H_
+#define CRAS_SRC_SERVER_CRAS_ALSA_PROBE_H_
+
+#include "cras_types.h"
+
+// Number of cards probed at the same time by the server.
+#define CRAS_ALSA_PROBE_NUM_WORKERS 4
+
+struct cras_alsa_card;
+
+/* Called on the main thread when a card has been probed.
+ * Args:
+ *    alsa_card - The probed card, owned by the callback. NULL if probing
+ *        failed.
+ *    info - The card info passed to cras_alsa_probe_card().
+ *    arg - The argument passed to cras_alsa_probe_card().
+ */
+typedef void (*cras_alsa_probe_done)(struct cras_alsa_card* alsa_card,
+                                     struct cras_alsa_card_info* info,
+                                     void* arg);
+
+/* Initializes the probe workers and the main thread handler of their results.
+ * Args:
+ *    num_workers - The most cards to probe at the same time.
+ * Returns:
+ *    0 on success, otherwise a negative error code.
+ */
+int cras_alsa_probe_init(unsigned int num_workers);
+
+/* Waits for the running probes and drops the pending ones without calling
+ * their done callbacks. */
+void cras_alsa_probe_deinit();
+
+/* Queues a card to be probed. Must be called on the main thread.
+ * Args:
+ *    info - The card to probe, copied.
+ *    device_config_dir - Passed to cras_alsa_card_probe(), must stay valid.
+ *    ucm_suffix - Passed to cras_alsa_card_probe(), must stay valid.
+ *    delay_us - Time to wait on the worker before probing, to let the card
+ *        settle after it appears.
+ *    done - Called with the result on the main thread.
+ *    arg - Passed to done.
+ * Returns:
+ *    0 on success, -EEXIST if the card is already being probed, otherwise a
+ *    negative error code.
+ */
+int cras_alsa_probe_card(const struct cras_alsa_card_info* info,
+                         const char* device_config_dir,
+                         const char* ucm_suffix,
+                         unsigned int delay_us,
+                         cras_alsa_probe_done done,
+                         void* arg);
+
+/* Cancels the probe of a card. Its done callback won't be called. Must be
+ * called on the main thread.
+ * Returns:
+ *    0 if a probe was cancelled, -ENOENT if the card isn't being probed.
+ */
+int cras_alsa_probe_cancel(unsigned int card_index);
+
+// Returns 1 if the card is being probed, 0 otherwise.
+int cras_alsa_probe_pending(unsigned int card_index);
+
+#endif  // CRAS_SRC_SERVER_CRAS_ALSA_PROBE_H_
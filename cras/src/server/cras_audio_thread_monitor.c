@@ -6,7 +6,6 @@
 #include <stdbool.h>
 #include <syslog.h>
 
-#include "cras/src/server/audio_thread.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_main_message.h"
 #include "cras/src/server/cras_observer.h"
@@ -30,8 +29,7 @@ static void take_snapshot(enum CRAS_AUDIO_THREAD_EVENT_TYPE event_type) {
   clock_gettime(CLOCK_MONOTONIC_RAW, &now_time);
   snapshot.timestamp = now_time;
   snapshot.event_type = event_type;
-  audio_thread_dump_thread_info(cras_iodev_list_get_audio_thread(),
-                                &snapshot.audio_debug_info);
+  cras_iodev_list_dump_audio_thread_info(&snapshot.audio_debug_info);
   cras_system_state_add_snapshot(&snapshot);
 }
 
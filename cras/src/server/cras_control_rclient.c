@@ -39,8 +39,7 @@ static void dump_audio_thread_info(struct cras_rclient* client) {
 
   cras_fill_client_audio_debug_info_ready(&msg);
   state = cras_system_state_get_no_lock();
-  audio_thread_dump_thread_info(cras_iodev_list_get_audio_thread(),
-                                &state->audio_debug_info);
+  cras_iodev_list_dump_audio_thread_info(&state->audio_debug_info);
   client->ops->send_message_to_client(client, &msg.header, NULL, 0);
 }
 
@@ -101,6 +100,58 @@ static void handle_request_floop(struct cras_rclient* client,
   client->ops->send_message_to_client(client, &msg.header, NULL, 0);
 }
 
+/* Sends a notification to the client. While the client has a notification
+ * interval it is added to the batch sent by send_notifications instead. */
+static void send_notification(struct cras_rclient* client,
+                              const struct cras_client_message* msg) {
+  struct cras_client_notifications* notifications = client->notifications;
+
+  if (!notifications) {
+    client->ops->send_message_to_client(client, msg, NULL, 0);
+    return;
+  }
+  if (cras_client_notifications_add(notifications, msg) == 0) {
+    return;
+  }
+  // The batch is full, send it and start another.
+  client->ops->send_message_to_client(client, &notifications->header, NULL, 0);
+  cras_fill_client_notifications(notifications);
+  cras_client_notifications_add(notifications, msg);
+}
+
+// Sends the batched notifications, called when the observer flushes.
+static void send_notifications(void* context) {
+  struct cras_rclient* client = (struct cras_rclient*)context;
+  struct cras_client_notifications* notifications = client->notifications;
+
+  if (!notifications || !notifications->num_notifications) {
+    return;
+  }
+  client->ops->send_message_to_client(client, &notifications->header, NULL, 0);
+  cras_fill_client_notifications(notifications);
+}
+
+static void set_notification_interval(struct cras_rclient* client,
+                                      unsigned int interval_ms) {
+  client->notification_interval_ms = interval_ms;
+  /* Without a batch, when interval_ms is 0 or on allocation failure, the
+   * notifications are still coalesced but sent one per message. */
+  if (interval_ms && !client->notifications) {
+    client->notifications = (struct cras_client_notifications*)malloc(
+        sizeof(*client->notifications));
+    if (client->notifications) {
+      cras_fill_client_notifications(client->notifications);
+    }
+  }
+  // Flushes what is held when batching stops.
+  cras_observer_set_interval(client->observer, interval_ms,
+                             send_notifications);
+  if (!interval_ms) {
+    free(client->notifications);
+    client->notifications = NULL;
+  }
+}
+
 // Client notification callback functions.
 
 static void send_output_volume_changed(void* context, int32_t volume) {
@@ -108,7 +159,7 @@ static void send_output_volume_changed(void* context, int32_t volume) {
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_output_volume_changed(&msg, volume);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_output_mute_changed(void* context,
@@ -119,7 +170,7 @@ static void send_output_mute_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_output_mute_changed(&msg, muted, user_muted, mute_locked);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_capture_gain_changed(void* context, int32_t gain) {
@@ -127,7 +178,7 @@ static void send_capture_gain_changed(void* context, int32_t gain) {
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_capture_gain_changed(&msg, gain);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_capture_mute_changed(void* context,
@@ -137,7 +188,7 @@ static void send_capture_mute_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_capture_mute_changed(&msg, muted, mute_locked);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_nodes_changed(void* context) {
@@ -145,7 +196,7 @@ static void send_nodes_changed(void* context) {
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_nodes_changed(&msg);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_active_node_changed(void* context,
@@ -155,7 +206,7 @@ static void send_active_node_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_active_node_changed(&msg, dir, node_id);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_output_node_volume_changed(void* context,
@@ -165,7 +216,7 @@ static void send_output_node_volume_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_output_node_volume_changed(&msg, node_id, volume);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_node_left_right_swapped_changed(void* context,
@@ -175,7 +226,7 @@ static void send_node_left_right_swapped_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_node_left_right_swapped_changed(&msg, node_id, swapped);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_input_node_gain_changed(void* context,
@@ -185,7 +236,7 @@ static void send_input_node_gain_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_input_node_gain_changed(&msg, node_id, gain);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void send_num_active_streams_changed(void* context,
@@ -195,7 +246,7 @@ static void send_num_active_streams_changed(void* context,
   struct cras_rclient* client = (struct cras_rclient*)context;
 
   cras_fill_client_num_active_streams_changed(&msg, dir, num_active_streams);
-  client->ops->send_message_to_client(client, &msg.header, NULL, 0);
+  send_notification(client, &msg.header);
 }
 
 static void register_for_notification(struct cras_rclient* client,
@@ -261,6 +312,9 @@ static void register_for_notification(struct cras_rclient* client,
     }
   } else if (!empty) {
     client->observer = cras_observer_add(&observer_ops, client);
+    cras_observer_set_interval(client->observer,
+                               client->notification_interval_ms,
+                               send_notifications);
   }
 }
 
@@ -496,8 +550,7 @@ static int ccr_handle_message_from_client(struct cras_rclient* client,
       if (!MSG_LEN_VALID(msg, struct cras_set_aec_dump)) {
         return -EINVAL;
       }
-      audio_thread_set_aec_dump(cras_iodev_list_get_audio_thread(),
-                                m->stream_id, m->start, fd);
+      cras_iodev_list_set_aec_dump(m->stream_id, m->start, fd);
       break;
     }
     case CRAS_SERVER_RELOAD_AEC_CONFIG:
@@ -519,6 +572,15 @@ static int ccr_handle_message_from_client(struct cras_rclient* client,
       handle_request_floop(client, &m->params, m->tag);
       break;
     }
+    case CRAS_SERVER_SET_NOTIFICATION_INTERVAL: {
+      const struct cras_set_notification_interval* m =
+          (const struct cras_set_notification_interval*)msg;
+      if (!MSG_LEN_VALID(msg, struct cras_set_notification_interval)) {
+        return -EINVAL;
+      }
+      set_notification_interval(client, m->interval_ms);
+      break;
+    }
     default:
       break;
   }
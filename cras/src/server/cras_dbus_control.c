@@ -13,10 +13,11 @@
 #include <syslog.h>
 
 #include "cras/src/common/cras_dbus_bindings.h"  // Generated from Makefile
-#include "cras/src/server/audio_thread.h"
+#include "cras/src/common/dumper.h"
 #include "cras/src/server/cras_bt_player.h"
 #include "cras/src/server/cras_dbus.h"
 #include "cras/src/server/cras_dbus_util.h"
+#include "cras/src/server/cras_dsp.h"
 #include "cras/src/server/cras_fl_manager.h"
 #include "cras/src/server/cras_hfp_ag_profile.h"
 #include "cras/src/server/cras_iodev.h"
@@ -626,7 +627,7 @@ static dbus_bool_t append_nodes(enum CRAS_STREAM_DIRECTION direction,
   }
 
   if (debug_info == ENABLED) {
-    audio_thread_dump_thread_info(cras_iodev_list_get_audio_thread(), &info);
+    cras_iodev_list_dump_audio_thread_info(&info);
   }
 
   for (i = 0; i < nnodes; i++) {
@@ -999,8 +1000,7 @@ static DBusHandlerResult handle_set_global_output_channel_remix(
     coefficient[i] = coeff_array[i];
   }
 
-  audio_thread_config_global_remix(cras_iodev_list_get_audio_thread(),
-                                   num_channels, coefficient);
+  cras_iodev_list_config_global_remix(num_channels, coefficient);
 
   send_empty_reply(conn, message);
   free(coefficient);
@@ -1154,6 +1154,62 @@ static DBusHandlerResult handle_get_force_sr_bt_enabled(DBusConnection* conn,
   return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+static DBusHandlerResult handle_set_dsp_profiling_enabled(DBusConnection* conn,
+                                                          DBusMessage* message,
+                                                          void* arg) {
+  int rc;
+  dbus_bool_t enabled;
+
+  rc = get_single_arg(message, DBUS_TYPE_BOOLEAN, &enabled);
+  if (rc) {
+    return rc;
+  }
+
+  cras_dsp_set_profiling_enabled(enabled);
+
+  send_empty_reply(conn, message);
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusHandlerResult handle_get_dsp_profile(DBusConnection* conn,
+                                                DBusMessage* message,
+                                                void* arg) {
+  DBusMessage* reply;
+  dbus_uint32_t serial = 0;
+  DBusHandlerResult ret = DBUS_HANDLER_RESULT_HANDLED;
+  struct dumper* d;
+  char* buf;
+  int size;
+
+  d = mem_dumper_create();
+  if (!d) {
+    return DBUS_HANDLER_RESULT_NEED_MEMORY;
+  }
+  cras_dsp_dump_profile(d);
+  mem_dumper_get(d, &buf, &size);
+
+  reply = dbus_message_new_method_return(message);
+  if (!reply) {
+    ret = DBUS_HANDLER_RESULT_NEED_MEMORY;
+    goto free_dumper;
+  }
+  if (!dbus_message_append_args(reply, DBUS_TYPE_STRING, &buf,
+                                DBUS_TYPE_INVALID)) {
+    ret = DBUS_HANDLER_RESULT_NEED_MEMORY;
+    goto unref_reply;
+  }
+  if (!dbus_connection_send(conn, reply, &serial)) {
+    ret = DBUS_HANDLER_RESULT_NEED_MEMORY;
+  }
+
+unref_reply:
+  dbus_message_unref(reply);
+free_dumper:
+  mem_dumper_free(d);
+  return ret;
+}
+
 static DBusHandlerResult handle_set_player_playback_status(DBusConnection* conn,
                                                            DBusMessage* message,
                                                            void* arg) {
@@ -1445,6 +1501,12 @@ static DBusHandlerResult handle_control_message(DBusConnection* conn,
   } else if (dbus_message_is_method_call(message, CRAS_CONTROL_INTERFACE,
                                          "GetForceSrBtEnabled")) {
     return handle_get_force_sr_bt_enabled(conn, message, arg);
+  } else if (dbus_message_is_method_call(message, CRAS_CONTROL_INTERFACE,
+                                         "SetDspProfilingEnabled")) {
+    return handle_set_dsp_profiling_enabled(conn, message, arg);
+  } else if (dbus_message_is_method_call(message, CRAS_CONTROL_INTERFACE,
+                                         "GetDspProfile")) {
+    return handle_get_dsp_profile(conn, message, arg);
   } else if (dbus_message_is_method_call(message, CRAS_CONTROL_INTERFACE,
                                          "SetPlayerPlaybackStatus")) {
     return handle_set_player_playback_status(conn, message, arg);
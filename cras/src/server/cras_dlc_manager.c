@@ -13,6 +13,8 @@
 
 #define FIRST_TRY_MSEC 5000
 #define RETRY_MSEC 60000
+// The retries don't need to be precise, let them share wake-ups.
+#define RETRY_SLACK_MSEC 1000
 #define MAX_RETRY_COUNT 10
 
 struct dlc_manager {
@@ -33,7 +35,8 @@ static void download_supported_dlc(struct cras_timer* timer, void* arg) {
     if (dlc_manager->retry_counter < MAX_RETRY_COUNT) {
       dlc_manager->retry_counter++;
       dlc_manager->retry_timer =
-          cras_tm_create_timer(tm, RETRY_MSEC, download_supported_dlc, NULL);
+          cras_tm_create_timer_with_slack(tm, RETRY_MSEC, RETRY_SLACK_MSEC,
+                                          download_supported_dlc, NULL);
       syslog(LOG_ERR, "%s: retry %d times", __func__,
              dlc_manager->retry_counter);
       return;
@@ -79,7 +82,8 @@ void cras_dlc_manager_init() {
   if (tm) {
     dlc_manager->retry_counter = 0;
     dlc_manager->retry_timer =
-        cras_tm_create_timer(tm, FIRST_TRY_MSEC, download_supported_dlc, NULL);
+        cras_tm_create_timer_with_slack(tm, FIRST_TRY_MSEC, RETRY_SLACK_MSEC,
+                                        download_supported_dlc, NULL);
   } else {
     syslog(LOG_ERR, "%s: failed to get cras timer", __func__);
   }
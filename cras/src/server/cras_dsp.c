@@ -22,13 +22,31 @@
  * (1) The client asks to (re-)load it with cras_load_pipeline().
  * (2) The client asks to reload the ini with cras_reload_ini().
  *
- * The pipeline is (re-)loaded asynchronously in an internal thread,
- * so the client needs to use cras_dsp_get_pipeline() and
- * cras_dsp_put_pipeline() to safely access the pipeline.
+ * The loader fully instantiates and warms up the new pipeline, then
+ * publishes it in next_pipeline with an atomic exchange, without taking the
+ * mutex. The next cras_dsp_get_pipeline() switches to it and lets it
+ * crossfade from the previous one. Pipelines that are not used anymore
+ * are put in retired and destroyed by the loader later, so the audio
+ * thread never frees them.
  */
+
+// Published in next_pipeline when the new pipeline could not be loaded.
+static char no_pipeline_marker;
+#define NO_PIPELINE ((struct pipeline*)&no_pipeline_marker)
+
+/* Room for retired pipelines. A switch retires at most two: the one being
+ * faded out and the one replaced. */
+#define MAX_RETIRED_PIPELINES 4
+
 struct cras_dsp_context {
   pthread_mutex_t mutex;
   struct pipeline* pipeline;
+  // The published pipeline to switch to, NULL if none.
+  struct pipeline* next_pipeline;
+  // The previous pipeline while pipeline crossfades from it.
+  struct pipeline* fading;
+  // Pipelines to destroy, NULL for empty slots.
+  struct pipeline* retired[MAX_RETIRED_PIPELINES];
 
   struct cras_expr_env env;
   int sample_rate;
@@ -37,6 +55,8 @@ struct cras_dsp_context {
 };
 
 static struct dumper* syslog_dumper;
+// Frames to crossfade over when switching to a new pipeline.
+static unsigned int crossfade_frames;
 static const char* ini_filename;
 static struct ini* global_ini;
 static struct cras_dsp_context* context_list;
@@ -112,23 +132,105 @@ bail:
   return NULL;
 }
 
+// Destroys the pipelines retired by the users of the context.
+static void collect_retired(struct cras_dsp_context* ctx) {
+  struct pipeline* pipeline;
+  int i;
+
+  for (i = 0; i < MAX_RETIRED_PIPELINES; i++) {
+    pipeline = __atomic_exchange_n(&ctx->retired[i], NULL, __ATOMIC_ACQUIRE);
+    if (pipeline) {
+      destroy_pipeline(pipeline);
+    }
+  }
+}
+
 static void cmd_load_pipeline(struct cras_dsp_context* ctx,
                               struct ini* target_ini) {
   struct pipeline *pipeline, *old_pipeline;
 
+  collect_retired(ctx);
+
   pipeline = target_ini ? prepare_pipeline(ctx, target_ini) : NULL;
+  if (pipeline) {
+    cras_dsp_pipeline_warm_up(pipeline);
+  }
 
-  // This locking is short to avoild blocking audio thread.
-  pthread_mutex_lock(&ctx->mutex);
-  old_pipeline = ctx->pipeline;
-  ctx->pipeline = pipeline;
-  pthread_mutex_unlock(&ctx->mutex);
+  old_pipeline = __atomic_exchange_n(
+      &ctx->next_pipeline, pipeline ?: NO_PIPELINE, __ATOMIC_ACQ_REL);
 
-  if (old_pipeline) {
+  // Published before but never switched to, so nobody else has seen it.
+  if (old_pipeline && old_pipeline != NO_PIPELINE) {
     destroy_pipeline(old_pipeline);
   }
 }
 
+static int num_free_retired_slots(struct cras_dsp_context* ctx) {
+  int i, n = 0;
+
+  for (i = 0; i < MAX_RETIRED_PIPELINES; i++) {
+    if (!__atomic_load_n(&ctx->retired[i], __ATOMIC_RELAXED)) {
+      n++;
+    }
+  }
+  return n;
+}
+
+// Called with the mutex held. There must be a free slot.
+static void retire_pipeline(struct cras_dsp_context* ctx,
+                            struct pipeline* pipeline) {
+  int i;
+
+  for (i = 0; i < MAX_RETIRED_PIPELINES; i++) {
+    if (!__atomic_load_n(&ctx->retired[i], __ATOMIC_RELAXED)) {
+      __atomic_store_n(&ctx->retired[i], pipeline, __ATOMIC_RELEASE);
+      return;
+    }
+  }
+}
+
+/* Retires the faded out pipeline once the fade is over, and switches to a
+ * newly published pipeline. Called with the mutex held. */
+static void update_pipeline(struct cras_dsp_context* ctx) {
+  struct pipeline *next, *old;
+
+  if (ctx->fading && !cras_dsp_pipeline_get_fade_from(ctx->pipeline)) {
+    retire_pipeline(ctx, ctx->fading);
+    ctx->fading = NULL;
+  }
+
+  if (!__atomic_load_n(&ctx->next_pipeline, __ATOMIC_RELAXED)) {
+    return;
+  }
+  // Keep the current pipeline until the loader empties the slots.
+  if (num_free_retired_slots(ctx) < 2) {
+    return;
+  }
+  next = __atomic_exchange_n(&ctx->next_pipeline, NULL, __ATOMIC_ACQUIRE);
+  if (next == NO_PIPELINE) {
+    next = NULL;
+  }
+
+  // A fade still in progress is cut short.
+  if (ctx->fading) {
+    cras_dsp_pipeline_fade_from(ctx->pipeline, NULL, 0);
+    retire_pipeline(ctx, ctx->fading);
+    ctx->fading = NULL;
+  }
+
+  old = ctx->pipeline;
+  ctx->pipeline = next;
+  if (!old) {
+    return;
+  }
+  if (next && crossfade_frames &&
+      cras_dsp_pipeline_fade_from(next, old, crossfade_frames) == 0) {
+    ctx->fading = old;
+  } else {
+    retire_pipeline(ctx, old);
+  }
+}
+
 static void cmd_reload_ini() {
   struct ini* old_ini = global_ini;
   struct cras_dsp_context* ctx;
@@ -187,6 +289,13 @@ void cras_dsp_context_free(struct cras_dsp_context* ctx) {
   DL_DELETE(context_list, ctx);
 
   pthread_mutex_destroy(&ctx->mutex);
+  collect_retired(ctx);
+  if (ctx->next_pipeline && ctx->next_pipeline != NO_PIPELINE) {
+    destroy_pipeline(ctx->next_pipeline);
+  }
+  if (ctx->fading) {
+    destroy_pipeline(ctx->fading);
+  }
   if (ctx->pipeline) {
     destroy_pipeline(ctx->pipeline);
     ctx->pipeline = NULL;
@@ -231,6 +340,7 @@ void cras_dsp_load_mock_pipeline(struct cras_dsp_context* ctx,
 
 struct pipeline* cras_dsp_get_pipeline(struct cras_dsp_context* ctx) {
   pthread_mutex_lock(&ctx->mutex);
+  update_pipeline(ctx);
   if (!ctx->pipeline) {
     pthread_mutex_unlock(&ctx->mutex);
     return NULL;
@@ -255,10 +365,36 @@ void cras_dsp_dump_info() {
   }
   DL_FOREACH (context_list, ctx) {
     cras_expr_env_dump(syslog_dumper, &ctx->env);
+    // The audio thread may switch pipelines while it is dumped.
+    pthread_mutex_lock(&ctx->mutex);
     pipeline = ctx->pipeline;
     if (pipeline) {
       cras_dsp_pipeline_dump(syslog_dumper, pipeline);
     }
+    pthread_mutex_unlock(&ctx->mutex);
+  }
+}
+
+void cras_dsp_set_crossfade_frames(int frames) {
+  crossfade_frames = frames > 0 ? frames : 0;
+}
+
+void cras_dsp_set_profiling_enabled(bool enabled) {
+  syslog(LOG_INFO, "DSP module profiling %s", enabled ? "enabled" : "disabled");
+  cras_dsp_pipeline_set_profiling(enabled);
+}
+
+void cras_dsp_dump_profile(struct dumper* d) {
+  struct cras_dsp_context* ctx;
+
+  DL_FOREACH (context_list, ctx) {
+    // The audio thread updates the profiles under the mutex.
+    pthread_mutex_lock(&ctx->mutex);
+    if (ctx->pipeline) {
+      dumpf(d, "pipeline (%s):\n", ctx->purpose);
+      cras_dsp_pipeline_dump_profile(d, ctx->pipeline);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
   }
 }
 
@@ -68,7 +68,9 @@ void cras_dsp_load_mock_pipeline(struct cras_dsp_context* ctx,
                                  unsigned int num_channels);
 
 /* Locks the pipeline in the context for access. Returns NULL if the
- * pipeline is still being loaded or cannot be loaded. */
+ * pipeline is still being loaded or cannot be loaded. A pipeline loaded
+ * since the last call replaces the current one here, crossfading from it
+ * if cras_dsp_set_crossfade_frames() allows. */
 struct pipeline* cras_dsp_get_pipeline(struct cras_dsp_context* ctx);
 
 /* Releases the pipeline in the context. This must be called in pair
@@ -80,9 +82,20 @@ void cras_dsp_put_pipeline(struct cras_dsp_context* ctx);
 // Re-reads the ini file and reloads all pipelines in the system.
 void cras_dsp_reload_ini();
 
+/* Sets the number of frames over which a reloaded pipeline fades in, 0 or
+ * less to switch at once. */
+void cras_dsp_set_crossfade_frames(int frames);
+
 // Dump current dsp information to syslog.
 void cras_dsp_dump_info();
 
+/* Enables or disables the per-module profiling of all pipelines. See
+ * cras_dsp_pipeline_set_profiling(). */
+void cras_dsp_set_profiling_enabled(bool enabled);
+
+// Dumps the module profiles of all pipelines.
+void cras_dsp_dump_profile(struct dumper* d);
+
 // Number of channels output.
 unsigned int cras_dsp_num_output_channels(const struct cras_dsp_context* ctx);
 
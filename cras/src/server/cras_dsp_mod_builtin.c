@@ -11,9 +11,11 @@
 #include "cras/src/dsp/dsp_util.h"
 #include "cras/src/dsp/eq.h"
 #include "cras/src/dsp/eq2.h"
+#include "cras/src/dsp/eqn.h"
 #include "cras/src/dsp/quad_rotation.h"
 #include "cras/src/server/cras_dsp_module.h"
 #include "cras_types.h"
+#include "cras_util.h"
 
 /*
  *  empty module functions (for source and sink)
@@ -637,6 +639,131 @@ static void eq2_init_module(struct dsp_module* module) {
   module->dump = &empty_dump;
 }
 
+/*
+ *  eqN module functions
+ */
+struct eqn_data {
+  int sample_rate;
+  // The number of input audio ports in the ini, set in eqn_init_module()
+  int num_channels;
+  struct eqn* eqn;  // Initialized in eqn_instantiate()
+
+  /* N ports for input, N for output, and 4 parameters per channel for each
+   * biquad, channel 0 first. */
+  float* ports[MAX_EQN_CHANNELS * 2 +
+               MAX_BIQUADS_PER_EQN * MAX_EQN_CHANNELS * 4];
+};
+
+static int eqn_instantiate(struct dsp_module* module,
+                           unsigned long sample_rate,
+                           struct cras_expr_env* env) {
+  struct eqn_data* data = module->data;
+
+  if (!data) {
+    syslog(LOG_ERR, "eqn_instantiate failed: %d", -ENOMEM);
+    return -ENOMEM;
+  }
+  data->eqn = eqn_new(data->num_channels);
+  if (!data->eqn) {
+    syslog(LOG_ERR, "eqn_instantiate failed for %d channels",
+           data->num_channels);
+    return -EINVAL;
+  }
+  data->sample_rate = (int)sample_rate;
+  return 0;
+}
+
+static void eqn_connect_port(struct dsp_module* module,
+                             unsigned long port,
+                             float* data_location) {
+  struct eqn_data* data = module->data;
+  if (port >= ARRAY_SIZE(data->ports)) {
+    syslog(LOG_ERR, "eqn port %lu out of range", port);
+    return;
+  }
+  data->ports[port] = data_location;
+}
+
+static void eqn_configure(struct dsp_module* module) {
+  struct eqn_data* data = module->data;
+  if (!data->eqn) {
+    syslog(LOG_ERR, "eqn is not instantiated");
+    return;
+  }
+
+  float nyquist = data->sample_rate / 2;
+  int n = data->num_channels;
+  int i, channel;
+
+  for (i = 2 * n; i < 2 * n + MAX_BIQUADS_PER_EQN * n * 4; i += 4 * n) {
+    if (!data->ports[i]) {
+      break;
+    }
+    for (channel = 0; channel < n; channel++) {
+      int k = i + channel * 4;
+      int type = (int)*data->ports[k];
+      float freq = *data->ports[k + 1];
+      float Q = *data->ports[k + 2];
+      float gain = *data->ports[k + 3];
+      eqn_append_biquad(data->eqn, channel, type, freq / nyquist, Q, gain);
+    }
+  }
+}
+
+static void eqn_run(struct dsp_module* module, unsigned long sample_count) {
+  struct eqn_data* data = module->data;
+  int n = data->num_channels;
+  int channel;
+
+  for (channel = 0; channel < n; channel++) {
+    if (data->ports[channel] != data->ports[n + channel]) {
+      memcpy(data->ports[n + channel], data->ports[channel],
+             sizeof(float) * sample_count);
+    }
+  }
+
+  eqn_process(data->eqn, &data->ports[n], (int)sample_count);
+}
+
+static void eqn_deinstantiate(struct dsp_module* module) {
+  struct eqn_data* data = module->data;
+  if (data->eqn) {
+    eqn_free(data->eqn);
+    data->eqn = NULL;
+  }
+}
+
+// The channel count outlives instantiations, so data is freed only here.
+static void eqn_free_module(struct dsp_module* module) {
+  free(module->data);
+  free(module);
+}
+
+static void eqn_init_module(struct dsp_module* module,
+                            const struct plugin* plugin) {
+  struct eqn_data* data = calloc(1, sizeof(*data));
+  const struct port* port;
+  int i;
+
+  if (data) {
+    ARRAY_ELEMENT_FOREACH (&plugin->ports, i, port) {
+      if (port->direction == PORT_INPUT && port->type == PORT_AUDIO) {
+        data->num_channels++;
+      }
+    }
+  }
+  module->data = data;
+  module->instantiate = &eqn_instantiate;
+  module->connect_port = &eqn_connect_port;
+  module->configure = &eqn_configure;
+  module->get_delay = &empty_get_delay;
+  module->run = &eqn_run;
+  module->deinstantiate = &eqn_deinstantiate;
+  module->free_module = &eqn_free_module;
+  module->get_properties = &empty_get_properties;
+  module->dump = &empty_dump;
+}
+
 /*
  *  drc module functions
  */
@@ -845,6 +972,8 @@ struct dsp_module* cras_dsp_module_load_builtin(struct plugin* plugin) {
     eq_init_module(module);
   } else if (strcmp(plugin->label, "eq2") == 0) {
     eq2_init_module(module);
+  } else if (strcmp(plugin->label, "eqN") == 0) {
+    eqn_init_module(module, plugin);
   } else if (strcmp(plugin->label, "drc") == 0) {
     drc_init_module(module);
   } else if (strcmp(plugin->label, "swap_lr") == 0) {
@@ -6,8 +6,13 @@
 #include "cras/src/server/cras_dsp_pipeline.h"
 
 #include <inttypes.h>
+#include <string.h>
 #include <sys/param.h>
 #include <syslog.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "cras/src/dsp/dsp_util.h"
 #include "cras/src/server/cras_dsp_module.h"
@@ -63,6 +68,18 @@ struct control_port {
 DECLARE_ARRAY_TYPE(struct audio_port, audio_port_array);
 DECLARE_ARRAY_TYPE(struct control_port, control_port_array);
 
+/* The number of buckets in a module profile. Bucket i counts the runs that
+ * took [2^i, 2^(i+1)) ticks, the last one also counts the longer runs. */
+#define PROFILE_BUCKETS 32
+
+// The time spent in module->run() of an instance, in profile ticks.
+struct module_profile {
+  uint64_t runs;
+  uint64_t total_ticks;
+  uint64_t max_ticks;
+  uint32_t buckets[PROFILE_BUCKETS];
+};
+
 /* An instance is a dynamic representation of a plugin. We only create
  * an instance when a plugin is needed (data actually flows through it
  * and it is not disabled). An instance also contains a pointer to a
@@ -93,6 +110,9 @@ struct instance {
   /* This is the total buffering delay from source to this instance. It is
    * in number of frames. */
   int total_delay;
+
+  // The profile of module->run(), only updated while profiling is enabled.
+  struct module_profile profile;
 };
 
 DECLARE_ARRAY_TYPE(struct instance, instance_array)
@@ -143,8 +163,27 @@ struct pipeline {
 
   // The total number of sample frames the pipeline processed
   int64_t total_samples;
+
+  /* The profiling session the module profiles belong to. The profiles are
+   * cleared when a new session is seen in cras_dsp_pipeline_run(). */
+  unsigned int profile_generation;
+
+  /* The pipeline being crossfaded out by this one, or NULL. It runs on the
+   * same input, and its output is mixed in with a gain falling from 1 to 0
+   * over fade_frames. fade_pos is the number of frames faded so far. */
+  struct pipeline* fade_from;
+  unsigned int fade_frames;
+  unsigned int fade_pos;
 };
 
+/* Module profiling state. It is changed in the main thread and read by the
+ * audio threads running the pipelines. */
+static bool profiling_enabled;
+static unsigned int profiling_generation;
+// The tick counter and the monotonic clock when profiling was last enabled.
+static uint64_t profiling_start_ticks;
+static struct timespec profiling_start_time;
+
 static struct instance* find_instance_by_plugin(const instance_array* instances,
                                                 const struct plugin* plugin) {
   int i;
@@ -797,16 +836,89 @@ struct ini* cras_dsp_pipeline_get_ini(struct pipeline* pipeline) {
   return pipeline->ini;
 }
 
+/* Reads the cycle counter used for module profiles. It is only compared
+ * with itself, the rate is measured against the monotonic clock when the
+ * profiles are dumped. */
+static inline uint64_t profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+static void profile_add(struct module_profile* profile, uint64_t ticks) {
+  int bucket = ticks ? 63 - __builtin_clzll(ticks) : 0;
+
+  profile->runs++;
+  profile->total_ticks += ticks;
+  profile->max_ticks = MAX(profile->max_ticks, ticks);
+  profile->buckets[MIN(bucket, PROFILE_BUCKETS - 1)]++;
+}
+
+// cras_dsp_pipeline_run() with every module->run() timed.
+static void run_profiled(struct pipeline* pipeline, int sample_count) {
+  int i;
+  struct instance* instance;
+  unsigned int generation =
+      __atomic_load_n(&profiling_generation, __ATOMIC_ACQUIRE);
+  uint64_t begin, end;
+
+  if (pipeline->profile_generation != generation) {
+    ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+      memset(&instance->profile, 0, sizeof(instance->profile));
+    }
+    pipeline->profile_generation = generation;
+  }
+
+  begin = profile_ticks();
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    struct dsp_module* module = instance->module;
+    module->run(module, sample_count);
+    end = profile_ticks();
+    profile_add(&instance->profile, end - begin);
+    begin = end;
+  }
+}
+
 void cras_dsp_pipeline_run(struct pipeline* pipeline, int sample_count) {
   int i;
   struct instance* instance;
 
+  if (__atomic_load_n(&profiling_enabled, __ATOMIC_RELAXED)) {
+    run_profiled(pipeline, sample_count);
+    return;
+  }
+
   ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
     struct dsp_module* module = instance->module;
     module->run(module, sample_count);
   }
 }
 
+void cras_dsp_pipeline_set_profiling(bool enabled) {
+  if (enabled == __atomic_load_n(&profiling_enabled, __ATOMIC_RELAXED)) {
+    return;
+  }
+  if (enabled) {
+    // Start a new session, the pipelines drop their old profiles.
+    clock_gettime(CLOCK_MONOTONIC, &profiling_start_time);
+    profiling_start_ticks = profile_ticks();
+    __atomic_add_fetch(&profiling_generation, 1, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&profiling_enabled, enabled, __ATOMIC_RELEASE);
+}
+
+bool cras_dsp_pipeline_get_profiling() {
+  return __atomic_load_n(&profiling_enabled, __ATOMIC_RELAXED);
+}
+
 void cras_dsp_pipeline_add_statistic(struct pipeline* pipeline,
                                      const struct timespec* time_delta,
                                      int samples) {
@@ -830,6 +942,67 @@ void cras_dsp_pipeline_add_statistic(struct pipeline* pipeline,
   pipeline->total_time += t;
 }
 
+int cras_dsp_pipeline_fade_from(struct pipeline* pipeline,
+                                struct pipeline* from,
+                                unsigned int frames) {
+  if (!from || !frames) {
+    pipeline->fade_from = NULL;
+    return 0;
+  }
+  if (from == pipeline || from->input_channels != pipeline->input_channels ||
+      from->output_channels != pipeline->output_channels ||
+      from->sample_rate != pipeline->sample_rate) {
+    return -EINVAL;
+  }
+  pipeline->fade_from = from;
+  pipeline->fade_frames = frames;
+  pipeline->fade_pos = 0;
+  return 0;
+}
+
+struct pipeline* cras_dsp_pipeline_get_fade_from(struct pipeline* pipeline) {
+  return pipeline->fade_from;
+}
+
+void cras_dsp_pipeline_warm_up(struct pipeline* pipeline) {
+  int i;
+
+  for (i = 0; i < pipeline->input_channels; i++) {
+    memset(cras_dsp_pipeline_get_source_buffer(pipeline, i), 0,
+           sizeof(float) * DSP_BUFFER_SIZE);
+  }
+  cras_dsp_pipeline_run(pipeline, DSP_BUFFER_SIZE);
+}
+
+/* Runs the pipeline being faded out, whose source buffers already hold the
+ * input, and mixes its output into sink, the output of the pipeline. */
+static void run_fade(struct pipeline* pipeline,
+                     float* const* sink,
+                     size_t chunk) {
+  struct pipeline* from = pipeline->fade_from;
+  unsigned int pos = pipeline->fade_pos;
+  float step = 1.0f / pipeline->fade_frames;
+  size_t frames = MIN(chunk, (size_t)(pipeline->fade_frames - pos));
+  int i;
+  size_t j;
+
+  cras_dsp_pipeline_run(from, chunk);
+
+  for (i = 0; i < from->output_channels; i++) {
+    const float* faded = cras_dsp_pipeline_get_sink_buffer(from, i);
+    float* out = sink[i];
+    for (j = 0; j < frames; j++) {
+      float gain = (pos + j) * step;
+      out[j] = out[j] * gain + faded[j] * (1.0f - gain);
+    }
+  }
+
+  pipeline->fade_pos += frames;
+  if (pipeline->fade_pos >= pipeline->fade_frames) {
+    pipeline->fade_from = NULL;
+  }
+}
+
 int cras_dsp_pipeline_apply(struct pipeline* pipeline,
                             uint8_t* buf,
                             snd_pcm_format_t format,
@@ -870,8 +1043,20 @@ int cras_dsp_pipeline_apply(struct pipeline* pipeline,
       return rc;
     }
 
+    /* The input is kept for the pipeline being faded out, in place
+     * modules may overwrite it. */
+    if (pipeline->fade_from) {
+      for (i = 0; i < input_channels; i++) {
+        memcpy(cras_dsp_pipeline_get_source_buffer(pipeline->fade_from, i),
+               source[i], sizeof(float) * chunk);
+      }
+    }
+
     // Run the pipeline
     cras_dsp_pipeline_run(pipeline, chunk);
+    if (pipeline->fade_from) {
+      run_fade(pipeline, sink, chunk);
+    }
 
     // interleave and convert back to int16_t
     rc = dsp_util_interleave(sink, buf, output_channels, format, chunk);
@@ -1001,5 +1186,72 @@ void cras_dsp_pipeline_dump(struct dumper* d, struct pipeline* pipeline) {
                        &instance->output_control_ports);
   }
   dumpf(d, " peak_buf = %d\n", pipeline->peak_buf);
+  cras_dsp_pipeline_dump_profile(d, pipeline);
   dumpf(d, "---- pipeline dump end ----\n");
 }
+
+/* Returns the nanoseconds per profile tick measured since profiling was
+ * enabled, or 0 if too little time has passed to tell. */
+static double profile_ns_per_tick() {
+  struct timespec now, elapsed;
+  uint64_t ticks = profile_ticks() - profiling_start_ticks;
+  double ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  subtract_timespecs(&now, &profiling_start_time, &elapsed);
+  ns = elapsed.tv_sec * 1e9 + elapsed.tv_nsec;
+  if (ns < 1e6 || !ticks) {
+    return 0;
+  }
+  return ns / ticks;
+}
+
+void cras_dsp_pipeline_dump_profile(struct dumper* d,
+                                    struct pipeline* pipeline) {
+  int i, j;
+  struct instance* instance;
+  uint64_t total_ticks = 0;
+  double scale;
+  const char* state;
+  const char* unit = "ns";
+
+  if (!pipeline->profile_generation ||
+      pipeline->profile_generation != profiling_generation) {
+    dumpf(d, " module profiles: none, profiling is %s\n",
+          cras_dsp_pipeline_get_profiling() ? "starting" : "disabled");
+    return;
+  }
+
+  state = cras_dsp_pipeline_get_profiling() ? "enabled" : "disabled";
+  scale = profile_ns_per_tick();
+  if (scale) {
+    dumpf(d, " module profiles (%s, %g ns per tick):\n", state, scale);
+  } else {
+    // Print ticks until the tick rate can be measured.
+    dumpf(d, " module profiles (%s, in ticks):\n", state);
+    scale = 1;
+    unit = " ticks";
+  }
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    total_ticks += instance->profile.total_ticks;
+  }
+  ARRAY_ELEMENT_FOREACH (&pipeline->instances, i, instance) {
+    const struct module_profile* profile = &instance->profile;
+
+    dumpf(d, "  [%d]%s runs=%" PRIu64 ", ticks=%" PRIu64 " (%.1f%%)\n", i,
+          instance->plugin->title, profile->runs, profile->total_ticks,
+          total_ticks ? profile->total_ticks * 100.0 / total_ticks : 0.0);
+    if (!profile->runs) {
+      continue;
+    }
+    dumpf(d, "   avg=%.0f%s, max=%.0f%s\n",
+          (double)profile->total_ticks / profile->runs * scale, unit,
+          profile->max_ticks * scale, unit);
+    for (j = 0; j < PROFILE_BUCKETS; j++) {
+      if (profile->buckets[j]) {
+        dumpf(d, "   >= %.0f%s: %u\n", (double)(1ULL << j) * scale, unit,
+              profile->buckets[j]);
+      }
+    }
+  }
+}
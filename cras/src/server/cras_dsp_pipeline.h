@@ -10,6 +10,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "cras/src/common/dumper.h"
@@ -129,6 +130,15 @@ struct ini* cras_dsp_pipeline_get_ini(struct pipeline* pipeline);
  * than DSP_BUFFER_SIZE */
 void cras_dsp_pipeline_run(struct pipeline* pipeline, int sample_count);
 
+/* Enables or disables the profiling of modules in cras_dsp_pipeline_run().
+ * While it is enabled the time of every module->run() call is added to a
+ * histogram of the instance. Enabling it again clears the previous
+ * profiles of all pipelines. Disabled, it costs one flag check per run. */
+void cras_dsp_pipeline_set_profiling(bool enabled);
+
+// Returns whether modules are being profiled.
+bool cras_dsp_pipeline_get_profiling();
+
 /* Add a statistic of running time for the pipeline.
  *
  * Args:
@@ -154,9 +164,39 @@ int cras_dsp_pipeline_apply(struct pipeline* pipeline,
                             snd_pcm_format_t format,
                             unsigned int frames);
 
+/* Makes the pipeline crossfade from another one. Until frames frames have
+ * been processed, cras_dsp_pipeline_apply() also runs the other pipeline on
+ * the same input and mixes its output in with a gain ramping down to zero.
+ * The other pipeline must not be used or freed meanwhile.
+ * Args:
+ *    pipeline - The pipeline fading in.
+ *    from - The pipeline fading out, or NULL to stop a fade.
+ *    frames - The length of the fade, 0 to stop a fade.
+ * Returns:
+ *    0 on success, -EINVAL if the two pipelines have different channel
+ *    counts or sample rates.
+ */
+int cras_dsp_pipeline_fade_from(struct pipeline* pipeline,
+                                struct pipeline* from,
+                                unsigned int frames);
+
+/* Returns the pipeline being faded out, or NULL once the fade set by
+ * cras_dsp_pipeline_fade_from() is over. */
+struct pipeline* cras_dsp_pipeline_get_fade_from(struct pipeline* pipeline);
+
+/* Runs a block of silence through an instantiated pipeline, so modules do
+ * their first-run work and touch their buffers before the pipeline is
+ * handed to an audio thread. */
+void cras_dsp_pipeline_warm_up(struct pipeline* pipeline);
+
 // Dumps the current state of the pipeline. For debugging only
 void cras_dsp_pipeline_dump(struct dumper* d, struct pipeline* pipeline);
 
+/* Dumps the module profiles of the pipeline, which are also part of
+ * cras_dsp_pipeline_dump(). */
+void cras_dsp_pipeline_dump_profile(struct dumper* d,
+                                    struct pipeline* pipeline);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -20,6 +20,8 @@ enum cras_feature_id {
   CrOSLateBootAudioFlexibleLoopback,
   CrOSLateBootAudioAPNoiseCancellation,
   CrOSLateBootCrasSplitAlsaUSBInternal,
+  CrOSLateBootAudioFloatMixBus,
+  CrOSLateBootAudioPolyphaseResampler,
   NUM_FEATURES,
 };
 
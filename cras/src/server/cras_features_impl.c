@@ -37,9 +37,18 @@ static struct cras_feature features[NUM_FEATURES] = {
             .name = "CrOSLateBootAudioAPNoiseCancellation",
             .default_enabled = false,
         },
-    [CrOSLateBootCrasSplitAlsaUSBInternal] = {
-        .name = "CrOSLateBootCrasSplitAlsaUSBInternal",
-        .default_enabled = true,
+    [CrOSLateBootCrasSplitAlsaUSBInternal] =
+        {
+            .name = "CrOSLateBootCrasSplitAlsaUSBInternal",
+            .default_enabled = true,
+        },
+    [CrOSLateBootAudioFloatMixBus] = {
+        .name = "CrOSLateBootAudioFloatMixBus",
+        .default_enabled = false,
+    },
+    [CrOSLateBootAudioPolyphaseResampler] = {
+        .name = "CrOSLateBootAudioPolyphaseResampler",
+        .default_enabled = false,
     }};
 
 bool cras_feature_enabled(enum cras_feature_id id) {
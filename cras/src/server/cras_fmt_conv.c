@@ -3,29 +3,42 @@
  * found in the LICENSE file.
  */
 
-// For now just use speex, can add more resamplers later.
+/* Sample rate conversion uses speex, or the polyphase resampler when it is
+ * enabled and has a filter bank for the rates. */
 #include "cras/src/server/cras_fmt_conv.h"
 
 #include <endian.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <speex/speex_resampler.h>
+#include <string.h>
 #include <sys/param.h>
 #include <syslog.h>
 
+#include "cras/src/server/cras_features.h"
 #include "cras/src/server/cras_fmt_conv_ops.h"
 #include "cras/src/server/linear_resampler.h"
+#include "cras/src/server/polyphase_resampler.h"
 #include "cras_audio_format.h"
 #include "cras_util.h"
 
 /* The quality level is a value between 0 and 10. This is a tradeoff between
  * performance, latency, and quality. */
 #define SPEEX_QUALITY_LEVEL 4
+// The polyphase quality closest to SPEEX_QUALITY_LEVEL.
+#define POLYPHASE_QUALITY POLYPHASE_QUALITY_MEDIUM
 // Max number of converters, src, down/up mix, 2xformat, and linear resample.
 #define MAX_NUM_CONVERTERS 5
 // Channel index for stereo.
 #define STEREO_L 0
 #define STEREO_R 1
+// Converters kept by cras_fmt_conv_release() for reuse.
+#define CONV_POOL_SIZE 8
+// Most input channels summed into an output channel by a sparse matrix.
+#define SPARSE_MAX_TERMS 2
+// Frames remixed per block by cras_channel_remix_convert().
+#define REMIX_BLOCK_FRAMES 256
 
 /* Channel re-mapping table for multi-channel internal speakers.
  * Multi-channel internal speakers are always exposed as a stereo output
@@ -47,6 +60,9 @@ static const float internal_spk_channel_mapping[CRAS_CH_MAX][CRAS_CH_MAX] = {
     {0, 0, 0, 0, 0, +0, 0, 0, 0, 0, 0},            // FRC
 };
 
+// Converters on the hot paths, selected for the running CPU.
+static const struct cras_fmt_conv_ops* ops = &fmt_conv_ops;
+
 typedef void (*sample_format_converter_t)(const uint8_t* in,
                                           size_t in_samples,
                                           uint8_t* out);
@@ -55,11 +71,35 @@ typedef size_t (*channel_converter_t)(struct cras_fmt_conv* conv,
                                       size_t in_frames,
                                       uint8_t* out);
 
+/* How a channel conversion matrix is applied, picked from its coefficients
+ * once it is final. */
+enum channel_conv_kind {
+  // Multiplied as a whole by the SIMD ops.
+  CHANNEL_CONV_DENSE,
+  // Each output channel copies an input channel or is silent.
+  CHANNEL_CONV_COPY,
+  // Each output channel sums at most SPARSE_MAX_TERMS scaled inputs.
+  CHANNEL_CONV_SPARSE,
+};
+
+/* The non-zero coefficients of each row of a matrix. They are kept in
+ * increasing input channel order and summed like the dense multiply does,
+ * so all kinds give the same samples. */
+struct channel_conv_plan {
+  enum channel_conv_kind kind;
+  uint8_t num_terms[CRAS_CH_MAX];
+  uint8_t in_ch[CRAS_CH_MAX][SPARSE_MAX_TERMS];
+  float coef[CRAS_CH_MAX][SPARSE_MAX_TERMS];
+};
+
 // Member data for the resampler.
 struct cras_fmt_conv {
   SpeexResamplerState* speex_state;
+  // Used instead of speex_state when set.
+  struct polyphase_resampler* polyphase;
   channel_converter_t channel_converter;
   float** ch_conv_mtx;  // Coefficient matrix for mixing channels.
+  struct channel_conv_plan ch_conv_plan;
   sample_format_converter_t in_format_converter;
   sample_format_converter_t out_format_converter;
   struct linear_resampler* resampler;
@@ -69,8 +109,40 @@ struct cras_fmt_conv {
   size_t tmp_buf_frames;
   size_t pre_linear_resample;
   size_t num_converters;  // Incremented once for SRC, channel, format.
+  enum CRAS_NODE_TYPE node_type;
+  // Set when reused, until the resamplers forget the previous samples.
+  int needs_reset;
 };
 
+/* Converters given back by cras_fmt_conv_release(), oldest first. Shared by
+ * all audio threads, under conv_pool_mutex. */
+static struct cras_fmt_conv* conv_pool[CONV_POOL_SIZE];
+static unsigned int conv_pool_len;
+static uint32_t conv_pool_hits;
+static uint32_t conv_pool_misses;
+static pthread_mutex_t conv_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns true if the converter changes the sample rate.
+static inline int has_src(const struct cras_fmt_conv* conv) {
+  return conv->speex_state || conv->polyphase;
+}
+
+/* Drops the samples the resamplers kept from the previous user of a reused
+ * converter. Deferred to the first conversion to keep attaching a stream
+ * cheap. */
+static inline void reset_if_reused(struct cras_fmt_conv* conv) {
+  if (!conv->needs_reset) {
+    return;
+  }
+  if (conv->speex_state) {
+    speex_resampler_reset_mem(conv->speex_state);
+  }
+  if (conv->polyphase) {
+    polyphase_resampler_reset(conv->polyphase);
+  }
+  conv->needs_reset = 0;
+}
+
 static int is_channel_layout_equal(const struct cras_audio_format* a,
                                    const struct cras_audio_format* b) {
   int ch;
@@ -250,7 +322,7 @@ static size_t stereo_to_51(struct cras_fmt_conv* conv,
   right = conv->out_fmt.channel_layout[CRAS_CH_FR];
   center = conv->out_fmt.channel_layout[CRAS_CH_FC];
 
-  return s16_stereo_to_51(left, right, center, in, in_frames, out);
+  return ops->s16_stereo_to_51(left, right, center, in, in_frames, out);
 }
 
 static size_t quad_to_51(struct cras_fmt_conv* conv,
@@ -318,7 +390,7 @@ static size_t _51_to_stereo(struct cras_fmt_conv* conv,
                             const uint8_t* in,
                             size_t in_frames,
                             uint8_t* out) {
-  return s16_51_to_stereo(in, in_frames, out);
+  return ops->s16_51_to_stereo(in, in_frames, out);
 }
 
 static size_t _51_to_quad(struct cras_fmt_conv* conv,
@@ -382,6 +454,86 @@ static size_t default_some_to_some(struct cras_fmt_conv* conv,
                           out);
 }
 
+/* Picks how convert_channels() applies ch_conv_mtx. Zero coefficients add
+ * nothing to the dense sums, so rows are reduced to their other terms. */
+static void plan_channel_conv(struct cras_fmt_conv* conv) {
+  struct channel_conv_plan* plan = &conv->ch_conv_plan;
+  size_t num_in_ch = conv->in_fmt.num_channels;
+  size_t num_out_ch = conv->out_fmt.num_channels;
+  int copy = 1;
+
+  plan->kind = CHANNEL_CONV_DENSE;
+  if (num_out_ch > CRAS_CH_MAX || num_in_ch > CRAS_CH_MAX) {
+    return;
+  }
+  for (size_t out_ch = 0; out_ch < num_out_ch; out_ch++) {
+    unsigned int n = 0;
+
+    for (size_t in_ch = 0; in_ch < num_in_ch; in_ch++) {
+      float coef = conv->ch_conv_mtx[out_ch][in_ch];
+
+      if (coef == 0) {
+        continue;
+      }
+      if (n == SPARSE_MAX_TERMS) {
+        return;
+      }
+      plan->in_ch[out_ch][n] = in_ch;
+      plan->coef[out_ch][n] = coef;
+      copy = copy && coef == 1;
+      n++;
+    }
+    plan->num_terms[out_ch] = n;
+    copy = copy && n <= 1;
+  }
+  plan->kind = copy ? CHANNEL_CONV_COPY : CHANNEL_CONV_SPARSE;
+}
+
+static void s16_copy_channels(const struct channel_conv_plan* plan,
+                              size_t num_in_ch,
+                              size_t num_out_ch,
+                              const int16_t* in,
+                              size_t in_frames,
+                              int16_t* out) {
+  for (size_t out_ch = 0; out_ch < num_out_ch; out_ch++) {
+    const int16_t* src = in + plan->in_ch[out_ch][0];
+    int16_t* dst = out + out_ch;
+    size_t i;
+
+    if (!plan->num_terms[out_ch]) {
+      for (i = 0; i < in_frames; i++) {
+        dst[i * num_out_ch] = 0;
+      }
+      continue;
+    }
+    for (i = 0; i < in_frames; i++) {
+      dst[i * num_out_ch] = src[i * num_in_ch];
+    }
+  }
+}
+
+// Same as s16_multiply_buf_with_coef() on each row, skipping zero terms.
+static void s16_sparse_channels(const struct channel_conv_plan* plan,
+                                size_t num_in_ch,
+                                size_t num_out_ch,
+                                const int16_t* in,
+                                size_t in_frames,
+                                int16_t* out) {
+  for (size_t i = 0; i < in_frames; i++) {
+    for (size_t out_ch = 0; out_ch < num_out_ch; out_ch++) {
+      int32_t sum = 0;
+
+      for (unsigned int t = 0; t < plan->num_terms[out_ch]; t++) {
+        sum += plan->coef[out_ch][t] * in[plan->in_ch[out_ch][t]];
+      }
+      sum = MAX(sum, -0x8000);
+      out[out_ch] = MIN(sum, 0x7fff);
+    }
+    in += num_in_ch;
+    out += num_out_ch;
+  }
+}
+
 static size_t convert_channels(struct cras_fmt_conv* conv,
                                const uint8_t* in,
                                size_t in_frames,
@@ -393,8 +545,19 @@ static size_t convert_channels(struct cras_fmt_conv* conv,
   num_in_ch = conv->in_fmt.num_channels;
   num_out_ch = conv->out_fmt.num_channels;
 
-  return s16_convert_channels(ch_conv_mtx, num_in_ch, num_out_ch, in, in_frames,
-                              out);
+  switch (conv->ch_conv_plan.kind) {
+    case CHANNEL_CONV_COPY:
+      s16_copy_channels(&conv->ch_conv_plan, num_in_ch, num_out_ch,
+                        (const int16_t*)in, in_frames, (int16_t*)out);
+      return in_frames;
+    case CHANNEL_CONV_SPARSE:
+      s16_sparse_channels(&conv->ch_conv_plan, num_in_ch, num_out_ch,
+                          (const int16_t*)in, in_frames, (int16_t*)out);
+      return in_frames;
+    default:
+      return ops->s16_convert_channels(ch_conv_mtx, num_in_ch, num_out_ch, in,
+                                       in_frames, out);
+  }
 }
 
 static float** cras_internal_spk_channel_conv_matrix_create(
@@ -437,6 +600,11 @@ static float** cras_internal_spk_channel_conv_matrix_create(
  * Exported interface
  */
 
+void cras_fmt_conv_init(unsigned int cpu_flags) {
+  ops = cras_fmt_conv_get_ops(cpu_flags);
+  polyphase_resampler_init(cpu_flags);
+}
+
 struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
                                            const struct cras_audio_format* out,
                                            size_t max_frames,
@@ -454,6 +622,7 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
   conv->out_fmt = *out;
   conv->tmp_buf_frames = max_frames;
   conv->pre_linear_resample = pre_linear_resample;
+  conv->node_type = node_type;
 
   if (!is_supported_format(in)) {
     syslog(LOG_ERR, "Invalid input format %d", in->format);
@@ -478,10 +647,10 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
         conv->in_format_converter = convert_u8_to_s16le;
         break;
       case SND_PCM_FORMAT_S24_LE:
-        conv->in_format_converter = convert_s24le_to_s16le;
+        conv->in_format_converter = ops->s24le_to_s16le;
         break;
       case SND_PCM_FORMAT_S32_LE:
-        conv->in_format_converter = convert_s32le_to_s16le;
+        conv->in_format_converter = ops->s32le_to_s16le;
         break;
       case SND_PCM_FORMAT_S24_3LE:
         conv->in_format_converter = convert_s243le_to_s16le;
@@ -502,7 +671,7 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
         conv->out_format_converter = convert_s16le_to_s24le;
         break;
       case SND_PCM_FORMAT_S32_LE:
-        conv->out_format_converter = convert_s16le_to_s32le;
+        conv->out_format_converter = ops->s16le_to_s32le;
         break;
       case SND_PCM_FORMAT_S24_3LE:
         conv->out_format_converter = convert_s16le_to_s243le;
@@ -610,15 +779,25 @@ struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
       conv->channel_converter = convert_channels;
     }
   }
+  if (conv->channel_converter == convert_channels) {
+    plan_channel_conv(conv);
+  }
   // Set up sample rate conversion.
   if (in->frame_rate != out->frame_rate) {
     conv->num_converters++;
     syslog(LOG_DEBUG, "Convert from %zu to %zu Hz.", in->frame_rate,
            out->frame_rate);
-    conv->speex_state =
-        speex_resampler_init(out->num_channels, in->frame_rate, out->frame_rate,
-                             SPEEX_QUALITY_LEVEL, &rc);
-    if (conv->speex_state == NULL) {
+    if (cras_feature_enabled(CrOSLateBootAudioPolyphaseResampler)) {
+      conv->polyphase =
+          polyphase_resampler_create(out->num_channels, in->frame_rate,
+                                     out->frame_rate, POLYPHASE_QUALITY);
+    }
+    if (!conv->polyphase) {
+      conv->speex_state =
+          speex_resampler_init(out->num_channels, in->frame_rate,
+                               out->frame_rate, SPEEX_QUALITY_LEVEL, &rc);
+    }
+    if (conv->speex_state == NULL && conv->polyphase == NULL) {
       syslog(LOG_ERR, "Fail to create speex:%zu %zu %zu %d", out->num_channels,
              in->frame_rate, out->frame_rate, rc);
       cras_fmt_conv_destroy(&conv);
@@ -673,6 +852,7 @@ void cras_fmt_conv_destroy(struct cras_fmt_conv** convp) {
   if (conv->speex_state) {
     speex_resampler_destroy(conv->speex_state);
   }
+  polyphase_resampler_destroy(conv->polyphase);
   if (conv->resampler) {
     linear_resampler_destroy(conv->resampler);
   }
@@ -705,9 +885,15 @@ struct cras_fmt_conv* cras_channel_remix_conv_create(unsigned int num_channels,
     }
   }
 
+  plan_channel_conv(conv);
+
   conv->num_converters = 1;
-  conv->tmp_bufs[0] = malloc(4 *  // width in bytes largest format.
-                             num_channels);
+  conv->tmp_buf_frames = REMIX_BLOCK_FRAMES;
+  conv->tmp_bufs[0] = malloc(REMIX_BLOCK_FRAMES * 2 * num_channels);
+  if (conv->tmp_bufs[0] == NULL) {
+    cras_fmt_conv_destroy(&conv);
+    return NULL;
+  }
   return conv;
 }
 
@@ -715,9 +901,7 @@ void cras_channel_remix_convert(struct cras_fmt_conv* conv,
                                 const struct cras_audio_format* fmt,
                                 uint8_t* in_buf,
                                 size_t nframes) {
-  unsigned ch, fr;
-  int16_t* tmp = (int16_t*)conv->tmp_bufs[0];
-  int16_t* buf = (int16_t*)in_buf;
+  size_t frame_bytes = 2 * conv->in_fmt.num_channels;
 
   /*
    * Skip remix for non S16_LE format.
@@ -732,15 +916,13 @@ void cras_channel_remix_convert(struct cras_fmt_conv* conv,
     return;
   }
 
-  for (fr = 0; fr < nframes; fr++) {
-    for (ch = 0; ch < conv->in_fmt.num_channels; ch++) {
-      tmp[ch] = s16_multiply_buf_with_coef(conv->ch_conv_mtx[ch], buf,
-                                           conv->in_fmt.num_channels);
-    }
-    for (ch = 0; ch < conv->in_fmt.num_channels; ch++) {
-      buf[ch] = tmp[ch];
-    }
-    buf += conv->in_fmt.num_channels;
+  // Remixes blocks aside and copies them back, the kernels aren't in place.
+  for (size_t done = 0; done < nframes; done += REMIX_BLOCK_FRAMES) {
+    size_t frames = MIN(nframes - done, REMIX_BLOCK_FRAMES);
+    uint8_t* buf = in_buf + done * frame_bytes;
+
+    convert_channels(conv, buf, frames, conv->tmp_bufs[0]);
+    memcpy(buf, conv->tmp_bufs[0], frames * frame_bytes);
   }
 }
 
@@ -810,13 +992,15 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
   assert(conv);
   assert(*in_frames <= conv->tmp_buf_frames);
 
+  reset_if_reused(conv);
+
   if (linear_resampler_needed(conv->resampler)) {
     post_linear_resample = !conv->pre_linear_resample;
     pre_linear_resample = conv->pre_linear_resample;
   }
 
   // If no SRC, then in_frames should = out_frames.
-  if (conv->speex_state == NULL) {
+  if (!has_src(conv)) {
     fr_in = MIN(*in_frames, out_frames);
     if (out_frames < *in_frames && !logged_frames_dont_fit) {
       syslog(LOG_INFO, "fmt_conv: %u to %zu no SRC.", *in_frames, out_frames);
@@ -849,7 +1033,7 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
      * resample limit and round it to the lower bound in order
      * not to convert too many frames in the pre linear resampler.
      */
-    if (conv->speex_state != NULL) {
+    if (has_src(conv)) {
       resample_limit =
           resample_limit * conv->in_fmt.frame_rate / conv->out_fmt.frame_rate;
       /*
@@ -886,7 +1070,7 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
   }
 
   // Then SRC.
-  if (conv->speex_state != NULL) {
+  if (has_src(conv)) {
     unsigned int out_limit = out_frames;
 
     if (post_linear_resample) {
@@ -901,9 +1085,15 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
     }
     // limit frames to the output size.
     fr_out = MIN(fr_out, out_limit);
-    speex_resampler_process_interleaved_int(
-        conv->speex_state, (int16_t*)buffers[buf_idx], &fr_in,
-        (int16_t*)buffers[buf_idx + 1], &fr_out);
+    if (conv->polyphase) {
+      polyphase_resampler_process_s16(
+          conv->polyphase, (int16_t*)buffers[buf_idx], &fr_in,
+          (int16_t*)buffers[buf_idx + 1], &fr_out);
+    } else {
+      speex_resampler_process_interleaved_int(
+          conv->speex_state, (int16_t*)buffers[buf_idx], &fr_in,
+          (int16_t*)buffers[buf_idx + 1], &fr_out);
+    }
     buf_idx++;
   }
 
@@ -936,7 +1126,7 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
      * leak and, if accumulated, causes delay in multiple devices
      * use case.
      */
-    if (conv->speex_state && (fr_in == 0)) {
+    if (has_src(conv) && (fr_in == 0)) {
       *in_frames = 0;
     }
   } else {
@@ -945,10 +1135,133 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
   return fr_out;
 }
 
+int cras_fmt_conv_pre_resample_sharable(const struct cras_fmt_conv* conv) {
+  if (has_src(conv) || conv->pre_linear_resample) {
+    return 0;
+  }
+  return conv->in_fmt.format != SND_PCM_FORMAT_S16_LE ||
+         conv->channel_converter != NULL;
+}
+
+void cras_fmt_conv_convert_pre_resample(struct cras_fmt_conv* conv,
+                                        const uint8_t* in_buf,
+                                        uint8_t* out_buf,
+                                        size_t frames) {
+  const uint8_t* buf = in_buf;
+
+  assert(frames <= conv->tmp_buf_frames);
+
+  if (conv->in_fmt.format != SND_PCM_FORMAT_S16_LE) {
+    uint8_t* dst =
+        conv->channel_converter ? (uint8_t*)conv->tmp_bufs[0] : out_buf;
+
+    conv->in_format_converter(buf, frames * conv->in_fmt.num_channels, dst);
+    buf = dst;
+  }
+  if (conv->channel_converter) {
+    conv->channel_converter(conv, buf, frames, out_buf);
+  } else if (buf != out_buf) {
+    memcpy(out_buf, buf, frames * conv->out_fmt.num_channels * 2);
+  }
+}
+
+size_t cras_fmt_conv_convert_post_resample(struct cras_fmt_conv* conv,
+                                           const uint8_t* in_buf,
+                                           uint8_t* out_buf,
+                                           unsigned int* in_frames,
+                                           size_t out_frames) {
+  const uint8_t* buf = in_buf;
+  int convert_out = conv->out_fmt.format != SND_PCM_FORMAT_S16_LE;
+  unsigned int fr_in = MIN(*in_frames, out_frames);
+  size_t fr_out = fr_in;
+
+  reset_if_reused(conv);
+
+  // Same frame accounting as cras_fmt_conv_convert_frames() without SRC.
+  if (linear_resampler_needed(conv->resampler)) {
+    uint8_t* dst = convert_out ? (uint8_t*)conv->tmp_bufs[0] : out_buf;
+    unsigned int linear_resample_fr = fr_in;
+
+    fr_out = linear_resampler_resample(conv->resampler, (uint8_t*)buf,
+                                       &linear_resample_fr, dst,
+                                       MIN(conv->tmp_buf_frames, out_frames));
+    buf = dst;
+  }
+
+  if (convert_out) {
+    conv->out_format_converter(buf, fr_out * conv->out_fmt.num_channels,
+                               out_buf);
+  } else if (buf != out_buf) {
+    memcpy(out_buf, buf, fr_out * conv->out_fmt.num_channels * 2);
+  }
+  *in_frames = fr_in;
+  return fr_out;
+}
+
 int cras_fmt_conversion_needed(const struct cras_fmt_conv* conv) {
   return linear_resampler_needed(conv->resampler) || (conv->num_converters > 1);
 }
 
+int cras_fmt_conv_mix_fusable(const struct cras_fmt_conv* conv) {
+  if (conv->in_fmt.format != SND_PCM_FORMAT_S16_LE ||
+      conv->in_fmt.num_channels > 2 || conv->out_fmt.num_channels != 2) {
+    return 0;
+  }
+  if (conv->out_fmt.format != SND_PCM_FORMAT_S16_LE &&
+      conv->out_fmt.format != SND_PCM_FORMAT_S32_LE) {
+    return 0;
+  }
+  if (has_src(conv) || linear_resampler_needed(conv->resampler)) {
+    return 0;
+  }
+  return !conv->channel_converter || conv->channel_converter == mono_to_stereo;
+}
+
+static int is_format_equal(const struct cras_audio_format* a,
+                           const struct cras_audio_format* b) {
+  return a->format == b->format && a->frame_rate == b->frame_rate &&
+         a->num_channels == b->num_channels && is_channel_layout_equal(a, b);
+}
+
+/* Takes the most recently released converter created with the given
+ * arguments out of the pool, or returns NULL. */
+static struct cras_fmt_conv* conv_pool_get(const struct cras_audio_format* in,
+                                           const struct cras_audio_format* out,
+                                           size_t max_frames,
+                                           size_t pre_linear_resample,
+                                           enum CRAS_NODE_TYPE node_type) {
+  struct cras_fmt_conv* conv = NULL;
+  unsigned int i;
+
+  pthread_mutex_lock(&conv_pool_mutex);
+  for (i = conv_pool_len; i > 0; i--) {
+    conv = conv_pool[i - 1];
+    if (conv->tmp_buf_frames == max_frames &&
+        conv->pre_linear_resample == pre_linear_resample &&
+        conv->node_type == node_type && is_format_equal(&conv->in_fmt, in) &&
+        is_format_equal(&conv->out_fmt, out)) {
+      break;
+    }
+  }
+  if (i) {
+    conv_pool_len--;
+    memmove(conv_pool + i - 1, conv_pool + i,
+            sizeof(conv_pool[0]) * (conv_pool_len - i + 1));
+    conv_pool_hits++;
+  } else {
+    conv = NULL;
+    conv_pool_misses++;
+  }
+  pthread_mutex_unlock(&conv_pool_mutex);
+
+  if (conv) {
+    linear_resampler_set_rates(conv->resampler, out->frame_rate,
+                               out->frame_rate);
+    conv->needs_reset = 1;
+  }
+  return conv;
+}
+
 /* If the server cannot provide the requested format, configures an audio format
  * converter that handles transforming the input format to the format used by
  * the server. */
@@ -975,6 +1288,11 @@ int config_format_converter(struct cras_fmt_conv** conv,
          "frames = %u",
          from->format, from->frame_rate, from->num_channels, target.format,
          target.frame_rate, target.num_channels, frames);
+  *conv = conv_pool_get(from, &target, frames, (dir == CRAS_STREAM_INPUT),
+                        node_type);
+  if (*conv) {
+    return 0;
+  }
   *conv = cras_fmt_conv_create(from, &target, frames,
                                (dir == CRAS_STREAM_INPUT), node_type);
   if (!*conv) {
@@ -984,3 +1302,41 @@ int config_format_converter(struct cras_fmt_conv** conv,
 
   return 0;
 }
+
+void cras_fmt_conv_release(struct cras_fmt_conv** conv) {
+  struct cras_fmt_conv* evicted = NULL;
+
+  if (!*conv) {
+    return;
+  }
+  pthread_mutex_lock(&conv_pool_mutex);
+  // Evicts the least recently released converter.
+  if (conv_pool_len == CONV_POOL_SIZE) {
+    evicted = conv_pool[0];
+    memmove(conv_pool, conv_pool + 1,
+            sizeof(conv_pool[0]) * (CONV_POOL_SIZE - 1));
+    conv_pool_len--;
+  }
+  conv_pool[conv_pool_len++] = *conv;
+  pthread_mutex_unlock(&conv_pool_mutex);
+
+  *conv = NULL;
+  if (evicted) {
+    cras_fmt_conv_destroy(&evicted);
+  }
+}
+
+void cras_fmt_conv_pool_clear() {
+  pthread_mutex_lock(&conv_pool_mutex);
+  while (conv_pool_len) {
+    cras_fmt_conv_destroy(&conv_pool[--conv_pool_len]);
+  }
+  pthread_mutex_unlock(&conv_pool_mutex);
+}
+
+void cras_fmt_conv_pool_stats(uint32_t* hits, uint32_t* misses) {
+  pthread_mutex_lock(&conv_pool_mutex);
+  *hits = conv_pool_hits;
+  *misses = conv_pool_misses;
+  pthread_mutex_unlock(&conv_pool_mutex);
+}
@@ -18,6 +18,12 @@
 struct cras_audio_format;
 struct cras_fmt_conv;
 
+/* Selects the converter implementations for the running CPU.
+ * Args:
+ *    cpu_flags - CPU_X86_* flags as returned by cpu_get_flags().
+ */
+void cras_fmt_conv_init(unsigned int cpu_flags);
+
 // Create and destroy format converters.
 struct cras_fmt_conv* cras_fmt_conv_create(const struct cras_audio_format* in,
                                            const struct cras_audio_format* out,
@@ -83,6 +89,47 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
                                     unsigned int* in_frames,
                                     size_t out_frames);
 
+/* Checks if the sample format and channel conversion ahead of the linear
+ * resampler can be done on its own with
+ * cras_fmt_conv_convert_pre_resample(). That is when there's no sample rate
+ * conversion, so each frame is converted without keeping any state and the
+ * result only depends on the formats. Converters of the same formats can
+ * then share what was converted once.
+ * Args:
+ *    conv - The format convert to check.
+ *  Returns:
+ *    Non-zero if there's a conversion ahead of the linear resampler and it can
+ *    be done on its own.
+ */
+int cras_fmt_conv_pre_resample_sharable(const struct cras_fmt_conv* conv);
+
+/* Converts frames through the sample format and channel conversion ahead of
+ * the linear resampler. Only for converters passing
+ * cras_fmt_conv_pre_resample_sharable().
+ * Args:
+ *    conv - The format converter returned from cras_fmt_conv_create().
+ *    in_buf - Samples to convert.
+ *    out_buf - Gets frames of S16_LE samples in the channels of the output
+ *      format.
+ *    frames - Number of frames to convert, at most the frames conv was
+ *      created for.
+ */
+void cras_fmt_conv_convert_pre_resample(struct cras_fmt_conv* conv,
+                                        const uint8_t* in_buf,
+                                        uint8_t* out_buf,
+                                        size_t frames);
+
+/* Does the rest of cras_fmt_conv_convert_frames() on frames converted by
+ * cras_fmt_conv_convert_pre_resample(), that is the linear resampler and the
+ * output sample format conversion. Args and return value are the same as
+ * cras_fmt_conv_convert_frames().
+ */
+size_t cras_fmt_conv_convert_post_resample(struct cras_fmt_conv* conv,
+                                           const uint8_t* in_buf,
+                                           uint8_t* out_buf,
+                                           unsigned int* in_frames,
+                                           size_t out_frames);
+
 /* Checks if format conversion is needed for a fmt converter.
  * Args:
  *    conv - The format convert to check.
@@ -91,9 +138,20 @@ size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
  */
 int cras_fmt_conversion_needed(const struct cras_fmt_conv* conv);
 
+/* Checks if the conversion can be fused with mixing by
+ * cras_mix_add_s16_stereo(). That is from S16_LE mono or stereo to S16_LE or
+ * S32_LE stereo without any resampling at the moment.
+ * Args:
+ *    conv - The format convert to check.
+ *  Returns:
+ *    Non-zero if the conversion can be fused.
+ */
+int cras_fmt_conv_mix_fusable(const struct cras_fmt_conv* conv);
+
 /* If the server cannot provide the requested format, configures an audio format
  * converter that handles transforming the input format to the format used by
  * the server.
+ * Reuses a converter given back by cras_fmt_conv_release() if one matches.
  * Args:
  *    conv - filled with the new converter if needed.
  *    dir - the stream direction the new converter used for.
@@ -109,4 +167,24 @@ int config_format_converter(struct cras_fmt_conv** conv,
                             enum CRAS_NODE_TYPE node_type,
                             unsigned int frames);
 
+/* Gives back a converter from config_format_converter(). It is kept for a
+ * later config_format_converter() call with the same formats and size, or
+ * destroyed when enough converters are kept already. The kept converters
+ * are shared by all audio threads.
+ * Args:
+ *    conv - The converter, set to NULL.
+ */
+void cras_fmt_conv_release(struct cras_fmt_conv** conv);
+
+// Destroys the converters kept by cras_fmt_conv_release().
+void cras_fmt_conv_pool_clear();
+
+/* Gets how often config_format_converter() reused a kept converter rather
+ * than creating one.
+ * Args:
+ *    hits - Filled with the number of converters reused.
+ *    misses - Filled with the number of converters created.
+ */
+void cras_fmt_conv_pool_stats(uint32_t* hits, uint32_t* misses);
+
 #endif  // CRAS_SRC_SERVER_CRAS_FMT_CONV_H_
@@ -8,6 +8,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "cras/src/server/cras_mix.h"
+
 #define MAX(a, b)           \
   ({                        \
     __typeof__(a) _a = (a); \
@@ -735,3 +737,21 @@ size_t s16_convert_channels(float** ch_conv_mtx,
 
   return in_frames;
 }
+
+const struct cras_fmt_conv_ops* cras_fmt_conv_get_ops(unsigned int cpu_flags) {
+  /* There is no FMA table. Fusing the multiply and add of the channel
+   * matrix would change the rounding and break bit exactness. */
+#if HAVE_AVX2
+  if (cpu_flags & CPU_X86_AVX2) {
+    return &fmt_conv_ops_avx2;
+  }
+#endif
+#if HAVE_SSE42
+  if (cpu_flags & CPU_X86_SSE4_2) {
+    return &fmt_conv_ops_sse42;
+  }
+#endif
+
+  // default C implementation
+  return &fmt_conv_ops;
+}
@@ -177,4 +177,49 @@ size_t s16_convert_channels(float** ch_conv_mtx,
                             size_t in_frames,
                             uint8_t* out);
 
+/* Struct containing the converters on the stream hot paths. Every table
+ * produces exactly the same samples as the scalar functions above. The
+ * tables are built once per instruction set from cras_fmt_conv_ops_simd.c,
+ * the same way as cras_mix_ops.
+ */
+struct cras_fmt_conv_ops {
+  // See convert_s24le_to_s16le.
+  void (*s24le_to_s16le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  // See convert_s32le_to_s16le.
+  void (*s32le_to_s16le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  // See convert_s16le_to_s32le.
+  void (*s16le_to_s32le)(const uint8_t* in, size_t in_samples, uint8_t* out);
+  // See s16_stereo_to_51.
+  size_t (*s16_stereo_to_51)(size_t left,
+                             size_t right,
+                             size_t center,
+                             const uint8_t* in,
+                             size_t in_frames,
+                             uint8_t* out);
+  // See s16_51_to_stereo.
+  size_t (*s16_51_to_stereo)(const uint8_t* in,
+                             size_t in_frames,
+                             uint8_t* out);
+  // See s16_convert_channels.
+  size_t (*s16_convert_channels)(float** ch_conv_mtx,
+                                 size_t num_in_ch,
+                                 size_t num_out_ch,
+                                 const uint8_t* in,
+                                 size_t in_frames,
+                                 uint8_t* out);
+};
+
+extern const struct cras_fmt_conv_ops fmt_conv_ops;
+extern const struct cras_fmt_conv_ops fmt_conv_ops_sse42;
+extern const struct cras_fmt_conv_ops fmt_conv_ops_avx2;
+
+/*
+ * Selects the fastest converter table supported by the CPU.
+ * Args:
+ *    cpu_flags - CPU_X86_* flags of the running CPU.
+ * Returns:
+ *    The table to use, never NULL.
+ */
+const struct cras_fmt_conv_ops* cras_fmt_conv_get_ops(unsigned int cpu_flags);
+
 #endif  // CRAS_SRC_SERVER_CRAS_FMT_CONV_OPS_H_
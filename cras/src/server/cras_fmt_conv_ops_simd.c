@@ -0,0 +1,274 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "cras/src/server/cras_fmt_conv_ops.h"
+
+// function suffixes for SIMD ops
+#ifdef OPS_SSE42
+#define OPS(a) a##_sse42
+#elif defined(OPS_AVX2)
+#define OPS(a) a##_avx2
+#else
+#define OPS(a) a
+#endif
+
+/*
+ * The loops below are laid out for the compiler to vectorize them with the
+ * instruction set each table is built for. They must stay bit exact with the
+ * scalar converters in cras_fmt_conv_ops.c, so this file is never built with
+ * -ffast-math or FMA and the float expressions keep the same evaluation order.
+ */
+
+// Frames converted per block in the planar kernels.
+#define BLOCK_FRAMES 128
+
+static inline int16_t clip_s16(int32_t sum) {
+  sum = sum < -0x8000 ? -0x8000 : sum;
+  return (int16_t)(sum > 0x7fff ? 0x7fff : sum);
+}
+
+/*
+ * Splits frames of interleaved samples into one plane per channel. Inlined
+ * with a constant channel count the strided loads vectorize.
+ */
+static inline __attribute__((always_inline)) void deinterleave_n(
+    const int16_t* in,
+    const size_t num_ch,
+    size_t frames,
+    int32_t planes[][BLOCK_FRAMES]) {
+  for (size_t ch = 0; ch < num_ch; ch++) {
+    for (size_t i = 0; i < frames; i++) {
+      planes[ch][i] = in[num_ch * i + ch];
+    }
+  }
+}
+
+static void deinterleave(const int16_t* in,
+                         size_t num_ch,
+                         size_t frames,
+                         int32_t planes[][BLOCK_FRAMES]) {
+  switch (num_ch) {
+    case 2:
+      deinterleave_n(in, 2, frames, planes);
+      return;
+    case 4:
+      deinterleave_n(in, 4, frames, planes);
+      return;
+    case 6:
+      deinterleave_n(in, 6, frames, planes);
+      return;
+    case 8:
+      deinterleave_n(in, 8, frames, planes);
+      return;
+    default:
+      deinterleave_n(in, num_ch, frames, planes);
+  }
+}
+
+// Clips and writes one channel of sums back to interleaved frames.
+static inline __attribute__((always_inline)) void interleave_n(
+    const int32_t* sums,
+    size_t frames,
+    const size_t num_ch,
+    size_t ch,
+    int16_t* out) {
+  for (size_t i = 0; i < frames; i++) {
+    out[num_ch * i + ch] = clip_s16(sums[i]);
+  }
+}
+
+static void interleave(const int32_t* sums,
+                       size_t frames,
+                       size_t num_ch,
+                       size_t ch,
+                       int16_t* out) {
+  switch (num_ch) {
+    case 2:
+      interleave_n(sums, frames, 2, ch, out);
+      return;
+    case 4:
+      interleave_n(sums, frames, 4, ch, out);
+      return;
+    case 6:
+      interleave_n(sums, frames, 6, ch, out);
+      return;
+    case 8:
+      interleave_n(sums, frames, 8, ch, out);
+      return;
+    default:
+      interleave_n(sums, frames, num_ch, ch, out);
+  }
+}
+
+static void s24le_to_s16le(const uint8_t* _in,
+                           size_t in_samples,
+                           uint8_t* _out) {
+  const int32_t* in = (const int32_t*)_in;
+  int16_t* out = (int16_t*)_out;
+
+  for (size_t i = 0; i < in_samples; i++) {
+    out[i] = (int16_t)((in[i] & 0x00ffffff) >> 8);
+  }
+}
+
+static void s32le_to_s16le(const uint8_t* _in,
+                           size_t in_samples,
+                           uint8_t* _out) {
+  const int32_t* in = (const int32_t*)_in;
+  int16_t* out = (int16_t*)_out;
+
+  for (size_t i = 0; i < in_samples; i++) {
+    out[i] = (int16_t)(in[i] >> 16);
+  }
+}
+
+static void s16le_to_s32le(const uint8_t* _in,
+                           size_t in_samples,
+                           uint8_t* _out) {
+  const int16_t* in = (const int16_t*)_in;
+  uint32_t* out = (uint32_t*)_out;
+
+  for (size_t i = 0; i < in_samples; i++) {
+    out[i] = (uint32_t)(int32_t)in[i] << 16;
+  }
+}
+
+/*
+ * Same as s16_stereo_to_51(). Clearing the output dominates and memset is
+ * already vectorized, building whole frames with masks is slower than the two
+ * scattered stores.
+ */
+static size_t stereo_to_51(size_t left,
+                           size_t right,
+                           size_t center,
+                           const uint8_t* _in,
+                           size_t in_frames,
+                           uint8_t* _out) {
+  const int16_t* in = (const int16_t*)_in;
+  int16_t* out = (int16_t*)_out;
+  size_t i;
+
+  memset(out, 0, sizeof(*out) * 6 * in_frames);
+
+  if (left != -1 && right != -1) {
+    for (i = 0; i < in_frames; i++) {
+      out[6 * i + left] = in[2 * i];
+      out[6 * i + right] = in[2 * i + 1];
+    }
+  } else if (center != -1) {
+    for (i = 0; i < in_frames; i++) {
+      out[6 * i + center] = clip_s16((int32_t)in[2 * i] + in[2 * i + 1]);
+    }
+  } else {
+    for (i = 0; i < in_frames; i++) {
+      out[6 * i] = in[2 * i];
+      out[6 * i + 1] = in[2 * i + 1];
+    }
+  }
+
+  return in_frames;
+}
+
+/*
+ * Same as s16_51_to_stereo(). The three used channels are split into planes
+ * first, the interleaved 6 channel loads don't vectorize otherwise.
+ */
+static size_t _51_to_stereo(const uint8_t* _in,
+                            size_t in_frames,
+                            uint8_t* _out) {
+  const int16_t* in = (const int16_t*)_in;
+  int16_t* out = (int16_t*)_out;
+  const float normalized_factor = 0.585;
+  int32_t planes[3][BLOCK_FRAMES];
+
+  for (size_t done = 0; done < in_frames; done += BLOCK_FRAMES) {
+    size_t frames = MIN(in_frames - done, BLOCK_FRAMES);
+    const int16_t* src = in + 6 * done;
+    int16_t* dst = out + 2 * done;
+    size_t ch, i;
+
+    for (ch = 0; ch < 3; ch++) {
+      for (i = 0; i < frames; i++) {
+        planes[ch][i] = src[6 * i + ch];
+      }
+    }
+    for (i = 0; i < frames; i++) {
+      int16_t half_center = planes[2][i] * 0.707 * normalized_factor;
+
+      dst[2 * i] = planes[0][i] * normalized_factor + half_center;
+      dst[2 * i + 1] = planes[1][i] * normalized_factor + half_center;
+    }
+  }
+
+  return in_frames;
+}
+
+/*
+ * Same as s16_convert_channels(). Blocks of frames are split into planes and
+ * every output channel is accumulated one input channel at a time, so the
+ * inner loops run over contiguous samples. The sums are still truncated to
+ * int32 after each term in input channel order like
+ * s16_multiply_buf_with_coef() does.
+ */
+static size_t convert_channels(float** ch_conv_mtx,
+                               size_t num_in_ch,
+                               size_t num_out_ch,
+                               const uint8_t* _in,
+                               size_t in_frames,
+                               uint8_t* _out) {
+  const int16_t* in = (const int16_t*)_in;
+  int16_t* out = (int16_t*)_out;
+  int32_t planes[CRAS_CH_MAX][BLOCK_FRAMES];
+  int32_t sums[BLOCK_FRAMES];
+
+  if (num_in_ch > CRAS_CH_MAX) {
+    for (size_t fr = 0; fr < in_frames; fr++) {
+      for (size_t out_ch = 0; out_ch < num_out_ch; out_ch++) {
+        int32_t sum = 0;
+
+        for (size_t in_ch = 0; in_ch < num_in_ch; in_ch++) {
+          sum += ch_conv_mtx[out_ch][in_ch] * in[fr * num_in_ch + in_ch];
+        }
+        out[fr * num_out_ch + out_ch] = clip_s16(sum);
+      }
+    }
+    return in_frames;
+  }
+
+  for (size_t done = 0; done < in_frames; done += BLOCK_FRAMES) {
+    size_t frames = MIN(in_frames - done, BLOCK_FRAMES);
+    size_t i;
+
+    deinterleave(in + num_in_ch * done, num_in_ch, frames, planes);
+    for (size_t out_ch = 0; out_ch < num_out_ch; out_ch++) {
+      for (i = 0; i < frames; i++) {
+        sums[i] = 0;
+      }
+      for (size_t in_ch = 0; in_ch < num_in_ch; in_ch++) {
+        const float coef = ch_conv_mtx[out_ch][in_ch];
+        const int32_t* plane = planes[in_ch];
+
+        for (i = 0; i < frames; i++) {
+          sums[i] += coef * plane[i];
+        }
+      }
+      interleave(sums, frames, num_out_ch, out_ch, out + num_out_ch * done);
+    }
+  }
+
+  return in_frames;
+}
+
+const struct cras_fmt_conv_ops OPS(fmt_conv_ops) = {
+    .s24le_to_s16le = s24le_to_s16le,
+    .s32le_to_s16le = s32le_to_s16le,
+    .s16le_to_s32le = s16le_to_s32le,
+    .s16_stereo_to_51 = stereo_to_51,
+    .s16_51_to_stereo = _51_to_stereo,
+    .s16_convert_channels = convert_channels,
+};
@@ -22,6 +22,7 @@
 #include "cras/src/server/cras_device_monitor.h"
 #include "cras/src/server/cras_dsp.h"
 #include "cras/src/server/cras_dsp_pipeline.h"
+#include "cras/src/server/cras_features.h"
 #include "cras/src/server/cras_fmt_conv.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_main_thread_log.h"
@@ -383,7 +384,10 @@ static snd_pcm_format_t get_best_pcm_format(struct cras_iodev* iodev,
 }
 
 // Applies the DSP to the samples for the iodev if applicable.
-static int apply_dsp(struct cras_iodev* iodev, uint8_t* buf, size_t frames) {
+static int apply_dsp(struct cras_iodev* iodev,
+                     uint8_t* buf,
+                     snd_pcm_format_t format,
+                     size_t frames) {
   struct cras_dsp_context* ctx;
   struct pipeline* pipeline;
   int rc;
@@ -398,7 +402,7 @@ static int apply_dsp(struct cras_iodev* iodev, uint8_t* buf, size_t frames) {
     return 0;
   }
 
-  rc = cras_dsp_pipeline_apply(pipeline, buf, iodev->format->format, frames);
+  rc = cras_dsp_pipeline_apply(pipeline, buf, format, frames);
 
   cras_dsp_put_pipeline(ctx);
   return rc;
@@ -1046,6 +1050,7 @@ int cras_iodev_open(struct cras_iodev* iodev,
   iodev->max_cb_level = 0;
   iodev->largest_cb_level = 0;
   iodev->num_underruns = 0;
+  iodev->num_silent_frames_skipped = 0;
 
   iodev->reset_request_pending = 0;
   iodev->state = CRAS_IODEV_STATE_OPEN;
@@ -1064,6 +1069,12 @@ int cras_iodev_open(struct cras_iodev* iodev,
       iodev->state = CRAS_IODEV_STATE_NO_STREAM_RUN;
       cras_iodev_fill_odev_zeros(iodev, iodev->min_cb_level, false);
     }
+
+    // Falls back to mixing in the device format if this fails.
+    if (cras_feature_enabled(CrOSLateBootAudioFloatMixBus)) {
+      iodev->mix_bus = (float*)calloc(
+          iodev->buffer_size * iodev->format->num_channels, sizeof(float));
+    }
   } else {
     iodev->input_data = input_data_create(iodev);
     /* If this is the echo reference dev, its ext_dsp_module will
@@ -1120,6 +1131,9 @@ int cras_iodev_close(struct cras_iodev* iodev) {
     input_data_destroy(&iodev->input_data);
   }
 
+  free(iodev->mix_bus);
+  iodev->mix_bus = NULL;
+
   rc = iodev->close_dev(iodev);
   if (rc) {
     syslog(LOG_WARNING, "Error closing dev %s, rc %d", iodev->info.name, rc);
@@ -1167,11 +1181,12 @@ int cras_iodev_put_input_buffer(struct cras_iodev* iodev) {
   return min_frames;
 }
 
-int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
-                                 uint8_t* frames,
-                                 unsigned int nframes,
-                                 int* is_non_empty,
-                                 struct cras_fmt_conv* remix_converter) {
+/* The part of putting output samples after the DSP, shared between the
+ * integer and the float mix bus. */
+static int put_output_post_dsp(struct cras_iodev* iodev,
+                               uint8_t* frames,
+                               unsigned int nframes,
+                               struct cras_fmt_conv* remix_converter) {
   const struct cras_audio_format* fmt = iodev->format;
   struct cras_ramp_action ramp_action = {
       .type = CRAS_RAMP_ACTION_NONE,
@@ -1181,37 +1196,8 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
   };
   float software_volume_scaler = 1.0;
   int software_volume_needed = cras_iodev_software_volume_needed(iodev);
-  int rc;
   struct cras_loopback* loopback;
 
-  // Calculate whether the final output was non-empty, if requested.
-  if (is_non_empty) {
-    const size_t bytes = nframes * cras_get_format_bytes(fmt);
-
-    /*
-     * Speed up checking frames are all zeros using memcmp.
-     * frames contains all zeros if both conditions are met:
-     *  - frames[0] is 0.
-     *  - frames[i] == frames[i+1] for i in [0, 1, ..., bytes - 2].
-     */
-    *is_non_empty =
-        bytes ? (*frames || memcmp(frames, frames + 1, bytes - 1)) : 0;
-  }
-
-  DL_FOREACH (iodev->loopbacks, loopback) {
-    if (loopback->type == LOOPBACK_POST_MIX_PRE_DSP) {
-      loopback->hook_data(frames, nframes, iodev->format, loopback->cb_data);
-    }
-  }
-
-  ewma_power_calculate(&iodev->ewma, (int16_t*)frames,
-                       iodev->format->num_channels, nframes);
-
-  rc = apply_dsp(iodev, frames, nframes);
-  if (rc) {
-    return rc;
-  }
-
   DL_FOREACH (iodev->loopbacks, loopback) {
     if ((loopback->type == LOOPBACK_POST_DSP) ||
         (loopback->type == LOOPBACK_POST_DSP_DELAYED)) {
@@ -1269,6 +1255,94 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
   return iodev->put_buffer(iodev, nframes);
 }
 
+int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
+                                 uint8_t* frames,
+                                 unsigned int nframes,
+                                 int* is_non_empty,
+                                 struct cras_fmt_conv* remix_converter) {
+  const struct cras_audio_format* fmt = iodev->format;
+  int rc;
+  struct cras_loopback* loopback;
+
+  // Calculate whether the final output was non-empty, if requested.
+  if (is_non_empty) {
+    const size_t bytes = nframes * cras_get_format_bytes(fmt);
+
+    /*
+     * Speed up checking frames are all zeros using memcmp.
+     * frames contains all zeros if both conditions are met:
+     *  - frames[0] is 0.
+     *  - frames[i] == frames[i+1] for i in [0, 1, ..., bytes - 2].
+     */
+    *is_non_empty =
+        bytes ? (*frames || memcmp(frames, frames + 1, bytes - 1)) : 0;
+  }
+
+  DL_FOREACH (iodev->loopbacks, loopback) {
+    if (loopback->type == LOOPBACK_POST_MIX_PRE_DSP) {
+      loopback->hook_data(frames, nframes, iodev->format, loopback->cb_data);
+    }
+  }
+
+  ewma_power_calculate(&iodev->ewma, (int16_t*)frames,
+                       iodev->format->num_channels, nframes);
+
+  rc = apply_dsp(iodev, frames, fmt->format, nframes);
+  if (rc) {
+    return rc;
+  }
+
+  return put_output_post_dsp(iodev, frames, nframes, remix_converter);
+}
+
+int cras_iodev_put_output_mix_bus(struct cras_iodev* iodev,
+                                  uint8_t* frames,
+                                  unsigned int nframes,
+                                  int* is_non_empty,
+                                  struct cras_fmt_conv* remix_converter) {
+  const struct cras_audio_format* fmt = iodev->format;
+  const size_t nsamples = (size_t)nframes * fmt->num_channels;
+  uint8_t* bus = (uint8_t*)iodev->mix_bus;
+  struct cras_loopback* loopback;
+  bool converted = false;
+  unsigned int ahead;
+  int rc;
+
+  if (is_non_empty) {
+    const size_t bytes = nsamples * sizeof(float);
+
+    *is_non_empty = bytes ? (*bus || memcmp(bus, bus + 1, bytes - 1)) : 0;
+  }
+
+  // Loopbacks before the DSP take the mix in the device format.
+  DL_FOREACH (iodev->loopbacks, loopback) {
+    if (loopback->type != LOOPBACK_POST_MIX_PRE_DSP) {
+      continue;
+    }
+    if (!converted) {
+      cras_mix_float_to_format(fmt->format, frames, iodev->mix_bus, nsamples);
+      converted = true;
+    }
+    loopback->hook_data(frames, nframes, iodev->format, loopback->cb_data);
+  }
+
+  rc = apply_dsp(iodev, bus, SND_PCM_FORMAT_FLOAT_LE, nframes);
+  if (rc) {
+    return rc;
+  }
+
+  cras_mix_float_to_format(fmt->format, frames, iodev->mix_bus, nsamples);
+
+  ahead = cras_iodev_max_stream_offset(iodev);
+  memmove(iodev->mix_bus, iodev->mix_bus + nsamples,
+          (size_t)ahead * fmt->num_channels * sizeof(float));
+
+  ewma_power_calculate(&iodev->ewma, (int16_t*)frames,
+                       iodev->format->num_channels, nframes);
+
+  return put_output_post_dsp(iodev, frames, nframes, remix_converter);
+}
+
 int cras_iodev_get_input_buffer(struct cras_iodev* iodev,
                                 unsigned int* frames) {
   const unsigned int frame_bytes = cras_get_format_bytes(iodev->format);
@@ -1306,6 +1380,7 @@ int cras_iodev_get_input_buffer(struct cras_iodev* iodev,
    */
   if (*frames > iodev->input_dsp_offset) {
     rc = apply_dsp(iodev, hw_buffer + iodev->input_dsp_offset * frame_bytes,
+                   iodev->format->format,
                    *frames - iodev->input_dsp_offset);
     if (rc) {
       return rc;
@@ -306,6 +306,8 @@ struct cras_iodev {
   unsigned int largest_cb_level;
   // Number of times we have run out of data (playback only).
   unsigned int num_underruns;
+  // Frames of streams the mixer skipped for being muted or silent.
+  uint64_t num_silent_frames_skipped;
   double rate_est_underrun;
   // Timestamp of the last update to the reset quota.
   struct timespec last_reset_timeref;
@@ -350,6 +352,12 @@ struct cras_iodev {
   struct input_data* input_data;
   // The ewma instance to calculate iodev volume.
   struct ewma_power ewma;
+  /* Interleaved float32 buffer of buffer_size frames the streams are mixed
+   * into when the float mix bus is enabled, NULL otherwise. It starts at
+   * the first frame not yet put to the device. */
+  float* mix_bus;
+  // The audio thread the device is open on. Set by cras_iodev_list.
+  struct audio_thread* audio_thread;
   struct cras_iodev *prev, *next;
 };
 
@@ -646,6 +654,17 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
                                  int* is_non_empty,
                                  struct cras_fmt_conv* remix_converter);
 
+/* Like cras_iodev_put_output_buffer() but takes the first nframes frames of
+ * the float mix bus. They go through the DSP pipeline in float and are
+ * converted once to the device format into frames, then the frames mixed
+ * ahead by some streams are moved to the front of the bus.
+ */
+int cras_iodev_put_output_mix_bus(struct cras_iodev* iodev,
+                                  uint8_t* frames,
+                                  unsigned int nframes,
+                                  int* is_non_empty,
+                                  struct cras_fmt_conv* remix_converter);
+
 /* Returns a buffer to read from.
  * Args:
  *    iodev - The device.
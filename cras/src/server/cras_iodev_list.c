@@ -21,6 +21,7 @@
 #include "cras/src/server/cras_server.h"
 #include "cras/src/server/cras_server_metrics.h"
 #include "cras/src/server/cras_speak_on_mute_detector.h"
+#include "cras/src/server/cras_stream_apm.h"
 #include "cras/src/server/cras_system_state.h"
 #include "cras/src/server/cras_tm.h"
 #include "cras/src/server/server_stream.h"
@@ -92,8 +93,11 @@ static uint32_t next_iodev_idx = MAX_SPECIAL_DEVICE_IDX;
 // Call when a device is enabled or disabled.
 struct device_enabled_cb* device_enable_cbs;
 
-// Thread that handles audio input and output.
+// Primary thread that handles audio input and output.
 static struct audio_thread* audio_thread;
+// All the audio threads, audio_threads[0] being the primary one.
+static struct audio_thread* audio_threads[CRAS_MAX_AUDIO_THREADS];
+static unsigned int num_audio_threads;
 // List of all streams.
 static struct stream_list* stream_list;
 // Idle device timer.
@@ -195,6 +199,11 @@ void cras_iodev_list_set_aec_on_dsp_is_disallowed(unsigned int dev_idx,
 
 static void idle_dev_check(struct cras_timer* timer, void* data);
 
+// Gets the audio thread dev runs on, the primary one if dev isn't open.
+static struct audio_thread* dev_audio_thread(const struct cras_iodev* dev) {
+  return dev->audio_thread ? dev->audio_thread : audio_thread;
+}
+
 static struct cras_iodev* find_dev(size_t dev_index) {
   struct cras_iodev* dev;
 
@@ -456,7 +465,7 @@ static void sys_mute_change(void* context,
       cras_iodev_set_mute(dev);
     } else {
       audio_thread_dev_start_ramp(
-          audio_thread, dev->info.idx,
+          dev_audio_thread(dev), dev->info.idx,
           (should_mute ? CRAS_IODEV_RAMP_REQUEST_DOWN_MUTE
                        : CRAS_IODEV_RAMP_REQUEST_UP_UNMUTE));
     }
@@ -466,7 +475,8 @@ static void sys_mute_change(void* context,
 static void remove_all_streams_from_dev(struct cras_iodev* dev) {
   struct cras_rstream* rstream;
 
-  audio_thread_rm_open_dev(audio_thread, dev->direction, dev->info.idx);
+  audio_thread_rm_open_dev(dev_audio_thread(dev), dev->direction,
+                           dev->info.idx);
 
   DL_FOREACH (stream_list_get(stream_list), rstream) {
     if (rstream->stream_apm == NULL) {
@@ -620,10 +630,125 @@ static void possibly_clear_non_dsp_aec_echo_ref_dev_alive() {
   set_non_dsp_aec_echo_ref_dev_alive(false);
 }
 
+// Returns true if dev taps the audio of the output devices.
+static bool dev_is_tap(const struct cras_iodev* dev) {
+  if (!dev->active_node) {
+    return false;
+  }
+
+  switch (dev->active_node->type) {
+    case CRAS_NODE_TYPE_POST_MIX_PRE_DSP:
+    case CRAS_NODE_TYPE_POST_DSP:
+    case CRAS_NODE_TYPE_POST_DSP_DELAYED:
+    case CRAS_NODE_TYPE_ECHO_REFERENCE:
+    case CRAS_NODE_TYPE_FLOOP:
+    case CRAS_NODE_TYPE_FLOOP_INTERNAL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns true if dev gets the streams of the default route.
+static bool dev_is_default_route(const struct cras_iodev* dev) {
+  return dev->is_enabled || dev == fallback_devs[dev->direction];
+}
+
+/*
+ * Returns true if dev and other, two different devices, share audio: enabled
+ * devices of one direction get the same streams, loopback, echo reference and
+ * floop devices tap the enabled output devices. Devices that share audio run
+ * on the same audio thread, so that a stream is only ever serviced by one
+ * thread.
+ */
+static bool devs_share_audio(const struct cras_iodev* dev,
+                             const struct cras_iodev* other) {
+  if (dev_is_tap(dev)) {
+    return other->direction == CRAS_STREAM_OUTPUT &&
+           dev_is_default_route(other);
+  }
+  if (dev_is_tap(other)) {
+    return dev->direction == CRAS_STREAM_OUTPUT && dev_is_default_route(dev);
+  }
+  return dev->direction == other->direction && dev_is_default_route(dev) &&
+         dev_is_default_route(other);
+}
+
+// Gets the thread an open device sharing audio with dev runs on, if any.
+static struct audio_thread* shared_audio_thread(const struct cras_iodev* dev) {
+  struct cras_iodev* other;
+  int dir;
+
+  for (dir = CRAS_STREAM_OUTPUT; dir <= CRAS_STREAM_INPUT; dir++) {
+    other = fallback_devs[dir];
+    if (other && other != dev && other->audio_thread &&
+        devs_share_audio(dev, other)) {
+      return other->audio_thread;
+    }
+    DL_FOREACH (devs[dir].iodevs, other) {
+      if (other != dev && other->audio_thread && devs_share_audio(dev, other)) {
+        return other->audio_thread;
+      }
+    }
+  }
+  return NULL;
+}
+
+// Gets the audio thread the fewest open devices run on.
+static struct audio_thread* least_busy_audio_thread() {
+  unsigned int num_devs[CRAS_MAX_AUDIO_THREADS] = {};
+  struct cras_iodev* dev;
+  unsigned int i, least = 0;
+  int dir;
+
+  for (dir = CRAS_STREAM_OUTPUT; dir <= CRAS_STREAM_INPUT; dir++) {
+    for (i = 0; i < num_audio_threads; i++) {
+      if (fallback_devs[dir] &&
+          fallback_devs[dir]->audio_thread == audio_threads[i]) {
+        num_devs[i]++;
+      }
+      DL_FOREACH (devs[dir].iodevs, dev) {
+        if (dev->audio_thread == audio_threads[i]) {
+          num_devs[i]++;
+        }
+      }
+    }
+  }
+  for (i = 1; i < num_audio_threads; i++) {
+    if (num_devs[i] < num_devs[least]) {
+      least = i;
+    }
+  }
+  return audio_threads[least];
+}
+
+/* Picks the audio thread to open dev on, or the one an open dev should move
+ * to. A device runs with the devices it shares audio with, otherwise on its
+ * own thread as long as there are enough of them.
+ */
+static struct audio_thread* pick_audio_thread(const struct cras_iodev* dev) {
+  struct audio_thread* shared;
+
+  if (num_audio_threads <= 1) {
+    return audio_thread;
+  }
+
+  shared = shared_audio_thread(dev);
+  if (shared) {
+    return shared;
+  }
+  if (dev->audio_thread) {
+    return dev->audio_thread;
+  }
+  return least_busy_audio_thread();
+}
+
 /*
  * Removes all attached streams and close dev if it's opened.
  */
 static void close_dev(struct cras_iodev* dev) {
+  struct audio_thread* prev;
+
   if (!cras_iodev_is_open(dev)) {
     return;
   }
@@ -633,11 +758,72 @@ static void close_dev(struct cras_iodev* dev) {
   dev->idle_timeout.tv_sec = 0;
   // close echo ref first to avoid underrun in hardware
   possibly_disable_echo_reference(dev);
+  // Callbacks of dev are removed from the thread it runs on.
+  prev = audio_thread_set_current(dev_audio_thread(dev));
   cras_iodev_close(dev);
+  audio_thread_set_current(prev);
+  dev->audio_thread = NULL;
 
   possibly_clear_non_dsp_aec_echo_ref_dev_alive();
 }
 
+/*
+ * Attaches stream to iodevs on the audio threads they run on. Shared devices
+ * are all on one thread, so is a pinned stream's device.
+ */
+static int attach_stream(struct cras_rstream* stream,
+                         struct cras_iodev** iodevs,
+                         unsigned int num_iodevs) {
+  struct cras_iodev* thread_iodevs[NUM_OPEN_DEVS_MAX];
+  unsigned int i, j, n;
+  int rc;
+
+  for (i = 0; i < num_audio_threads; i++) {
+    n = 0;
+    for (j = 0; j < num_iodevs && n < NUM_OPEN_DEVS_MAX; j++) {
+      if (dev_audio_thread(iodevs[j]) == audio_threads[i]) {
+        thread_iodevs[n++] = iodevs[j];
+      }
+    }
+    if (!n) {
+      continue;
+    }
+    rc = audio_thread_add_stream(audio_threads[i], stream, thread_iodevs, n);
+    if (rc) {
+      return rc;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Disconnects stream from dev, or from all the devices it is attached to if
+ * dev is NULL.
+ */
+static void disconnect_stream(struct cras_rstream* stream,
+                              struct cras_iodev* dev) {
+  unsigned int i;
+
+  if (dev) {
+    audio_thread_disconnect_stream(dev_audio_thread(dev), stream, dev);
+    return;
+  }
+  for (i = 0; i < num_audio_threads; i++) {
+    audio_thread_disconnect_stream(audio_threads[i], stream, NULL);
+  }
+}
+
+// Returns the number of milliseconds left to drain stream on all threads.
+static int drain_stream(struct cras_rstream* stream) {
+  unsigned int i;
+  int ms_left = 0;
+
+  for (i = 0; i < num_audio_threads; i++) {
+    ms_left = MAX(ms_left, audio_thread_drain_stream(audio_threads[i], stream));
+  }
+  return ms_left;
+}
+
 static void idle_dev_check(struct cras_timer* timer, void* data) {
   struct enabled_dev* edev;
   struct timespec now;
@@ -701,6 +887,7 @@ static void cancel_pending_init_retries(unsigned int dev_idx) {
 
 // Open the device potentially filling the output with a pre buffer.
 static int init_device(struct cras_iodev* dev, struct cras_rstream* rstream) {
+  struct audio_thread* prev;
   int rc;
 
   cras_iodev_exit_idle(dev);
@@ -714,15 +901,23 @@ static int init_device(struct cras_iodev* dev, struct cras_rstream* rstream) {
   MAINLOG(main_log, MAIN_THREAD_DEV_INIT, dev->info.idx,
           rstream->format.num_channels, rstream->format.frame_rate);
 
+  // Callbacks of dev are added to the thread it will run on.
+  dev->audio_thread = pick_audio_thread(dev);
+  prev = audio_thread_set_current(dev->audio_thread);
   rc = cras_iodev_open(dev, rstream->cb_threshold, &rstream->format);
+  audio_thread_set_current(prev);
   if (rc) {
     dev->info.last_open_result = FAILURE;
+    dev->audio_thread = NULL;
     return rc;
   }
 
-  rc = audio_thread_add_open_dev(audio_thread, dev);
+  rc = audio_thread_add_open_dev(dev->audio_thread, dev);
   if (rc) {
+    prev = audio_thread_set_current(dev->audio_thread);
     cras_iodev_close(dev);
+    audio_thread_set_current(prev);
+    dev->audio_thread = NULL;
   }
 
   possibly_enable_echo_reference(dev);
@@ -753,13 +948,13 @@ static void suspend_devs() {
 
       dev = find_dev(rstream->pinned_dev_idx);
       if (dev) {
-        audio_thread_disconnect_stream(audio_thread, rstream, dev);
+        disconnect_stream(rstream, dev);
         if (!cras_iodev_list_dev_is_enabled(dev)) {
           close_dev(dev);
         }
       }
     } else {
-      audio_thread_disconnect_stream(audio_thread, rstream, NULL);
+      disconnect_stream(rstream, NULL);
     }
   }
   stream_list_suspended = 1;
@@ -902,7 +1097,7 @@ static int add_stream_to_open_devs(struct cras_rstream* stream,
       cras_stream_apm_add(stream->stream_apm, iodevs[i], iodevs[i]->format);
     }
   }
-  return audio_thread_add_stream(audio_thread, stream, iodevs, num_iodevs);
+  return attach_stream(stream, iodevs, num_iodevs);
 }
 
 static int init_and_attach_streams(struct cras_iodev* dev) {
@@ -1011,7 +1206,7 @@ static int init_pinned_device(struct cras_iodev* dev,
 
   cras_iodev_exit_idle(dev);
 
-  if (audio_thread_is_dev_open(audio_thread, dev)) {
+  if (audio_thread_is_dev_open(dev_audio_thread(dev), dev)) {
     return 0;
   }
 
@@ -1296,7 +1491,7 @@ static int stream_removed_cb(struct cras_rstream* rstream) {
                                      cras_system_state_get_active_node_types());
   }
 
-  rc = audio_thread_drain_stream(audio_thread, rstream);
+  rc = drain_stream(rstream);
   if (rc) {
     return rc;
   }
@@ -1335,6 +1530,13 @@ static int enable_device(struct cras_iodev* dev) {
   DL_APPEND(enabled_devs[dir], edev);
   dev->is_enabled = 1;
 
+  /* Now that dev gets the streams of the default route it must run with the
+   * other shared devices. Reopen it if it was open for pinned streams on
+   * another thread. */
+  if (dev->audio_thread && dev->audio_thread != pick_audio_thread(dev)) {
+    close_dev(dev);
+  }
+
   rc = init_and_attach_streams(dev);
   if (rc < 0) {
     syslog(LOG_ERR, "Enable device fail, rc %d", rc);
@@ -1379,7 +1581,7 @@ static int disable_device(struct enabled_dev* edev, bool force) {
       if (stream->is_pinned) {
         continue;
       }
-      audio_thread_disconnect_stream(audio_thread, stream, dev);
+      disconnect_stream(stream, dev);
     }
     return 0;
   }
@@ -1401,6 +1603,7 @@ static int disable_device(struct enabled_dev* edev, bool force) {
 
 void cras_iodev_list_init() {
   struct cras_observer_ops observer_ops;
+  unsigned int i;
 
   memset(&observer_ops, 0, sizeof(observer_ops));
   observer_ops.output_volume_changed = sys_vol_change;
@@ -1436,18 +1639,35 @@ void cras_iodev_list_init() {
   loopdev_post_dsp = loopback_iodev_create(LOOPBACK_POST_DSP);
   loopdev_post_dsp_delayed = loopback_iodev_create(LOOPBACK_POST_DSP_DELAYED);
 
-  audio_thread = audio_thread_create();
-  if (!audio_thread) {
-    syslog(LOG_ERR, "Fatal: audio thread init");
-    exit(-ENOMEM);
+  num_audio_threads = MIN(MAX(cras_system_get_num_audio_threads(), 1),
+                          CRAS_MAX_AUDIO_THREADS);
+  for (i = 0; i < num_audio_threads; i++) {
+    audio_threads[i] = audio_thread_create();
+    if (!audio_threads[i]) {
+      syslog(LOG_ERR, "Fatal: audio thread init");
+      exit(-ENOMEM);
+    }
+    audio_thread_start(audio_threads[i]);
+    if (cras_stream_apm_add_audio_thread(audio_threads[i]) < 0) {
+      syslog(LOG_ERR, "Failed to add APM commands to audio thread %u", i);
+    }
   }
-  audio_thread_start(audio_thread);
+  audio_thread = audio_threads[0];
 
   cras_iodev_list_update_device_list();
 }
 
 void cras_iodev_list_deinit() {
-  audio_thread_destroy(audio_thread);
+  unsigned int i;
+
+  // The primary thread goes last, the others log to it.
+  for (i = num_audio_threads; i > 0; i--) {
+    cras_stream_apm_rm_audio_thread(audio_threads[i - 1]);
+    audio_thread_destroy(audio_threads[i - 1]);
+    audio_threads[i - 1] = NULL;
+  }
+  num_audio_threads = 0;
+  audio_thread = NULL;
   loopback_iodev_destroy(loopdev_post_dsp);
   loopback_iodev_destroy(loopdev_post_mix);
   loopback_iodev_destroy(loopdev_post_dsp_delayed);
@@ -1783,8 +2003,8 @@ int cras_iodev_list_suspend_hotword_streams() {
       continue;
     }
 
-    audio_thread_disconnect_stream(audio_thread, stream, hotword_dev);
-    audio_thread_add_stream(audio_thread, stream, &empty_hotword_dev, 1);
+    disconnect_stream(stream, hotword_dev);
+    attach_stream(stream, &empty_hotword_dev, 1);
   }
   close_pinned_device(hotword_dev);
   hotword_suspended = 1;
@@ -1817,8 +2037,8 @@ int cras_iodev_list_resume_hotword_stream() {
       continue;
     }
 
-    audio_thread_disconnect_stream(audio_thread, stream, empty_hotword_dev);
-    audio_thread_add_stream(audio_thread, stream, &hotword_dev, 1);
+    disconnect_stream(stream, empty_hotword_dev);
+    attach_stream(stream, &hotword_dev, 1);
   }
   close_pinned_device(empty_hotword_dev);
   hotword_suspended = 0;
@@ -2143,7 +2363,37 @@ void cras_iodev_list_test_dev_command(unsigned int iodev_idx,
 }
 
 struct audio_thread* cras_iodev_list_get_audio_thread() {
-  return audio_thread;
+  // While a device is opened or closed, the thread it runs on.
+  return audio_thread_get_current();
+}
+
+int cras_iodev_list_dump_audio_thread_info(struct audio_debug_info* info) {
+  if (num_audio_threads == 0) {
+    return -EINVAL;
+  }
+  return audio_thread_dump_threads_info(audio_threads, num_audio_threads,
+                                        info);
+}
+
+void cras_iodev_list_set_aec_dump(cras_stream_id_t stream_id,
+                                  unsigned int start,
+                                  int fd) {
+  unsigned int i;
+
+  // Only the thread servicing the stream uses fd.
+  for (i = 0; i < num_audio_threads; i++) {
+    audio_thread_set_aec_dump(audio_threads[i], stream_id, start, fd, NULL);
+  }
+}
+
+void cras_iodev_list_config_global_remix(unsigned int num_channels,
+                                         const float* coefficient) {
+  unsigned int i;
+
+  for (i = 0; i < num_audio_threads; i++) {
+    audio_thread_config_global_remix(audio_threads[i], num_channels,
+                                     coefficient, NULL);
+  }
 }
 
 struct stream_list* cras_iodev_list_get_stream_list() {
@@ -2270,7 +2520,7 @@ static int remove_then_reconnect_stream(struct cras_rstream* rstream) {
   unsigned int num_iodevs = 0;
   int rc;
 
-  audio_thread_disconnect_stream(audio_thread, rstream, NULL);
+  disconnect_stream(rstream, NULL);
 
   /* This is in main thread so we are confident the open devices
    * list doesn't change since we disconnect |rstream|.
@@ -234,9 +234,37 @@ void cras_iodev_list_test_dev_command(unsigned int iodev_idx,
                                       unsigned int data_len,
                                       const uint8_t* data);
 
-// Gets the audio thread used by the devices.
+/* Gets the audio thread used by the devices. While the main thread opens or
+ * closes a device, this is the audio thread that device runs on.
+ */
 struct audio_thread* cras_iodev_list_get_audio_thread();
 
+/* Dumps the devices, streams and event logs of all the audio threads.
+ * Args:
+ *    info - Filled with the debug info of all threads.
+ * Returns:
+ *    0 on success, otherwise a negative error code.
+ */
+int cras_iodev_list_dump_audio_thread_info(struct audio_debug_info* info);
+
+/* Starts or stops the aec dump of a stream, on whichever audio thread runs it.
+ * Args:
+ *    stream_id - id of the target stream for aec dump.
+ *    start - True to start the aec dump, false to stop.
+ *    fd - File to store aec dump result.
+ */
+void cras_iodev_list_set_aec_dump(cras_stream_id_t stream_id,
+                                  unsigned int start,
+                                  int fd);
+
+/* Configures the global converter for output remixing on all audio threads.
+ * Args:
+ *    num_channels - Number of channels of the remix matrix.
+ *    coefficient - num_channels * num_channels remix matrix.
+ */
+void cras_iodev_list_config_global_remix(unsigned int num_channels,
+                                         const float* coefficient);
+
 // Gets the list of all active audio streams attached to devices.
 struct stream_list* cras_iodev_list_get_stream_list();
 
@@ -23,6 +23,8 @@ enum CRAS_MAIN_MESSAGE_TYPE {
   CRAS_MAIN_NON_EMPTY_AUDIO_STATE,
   CRAS_MAIN_SPEAK_ON_MUTE,
   CRAS_MAIN_STREAM_APM,
+  // Card probe worker -> main thread
+  CRAS_MAIN_ALSA_PROBE,
 };
 
 /* Structure of the header of the message handled by main thread.
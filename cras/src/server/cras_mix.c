@@ -187,3 +187,34 @@ void cras_mix_add_scale_stride(snd_pcm_format_t fmt,
 size_t cras_mix_mute_buffer(uint8_t* dst, size_t frame_bytes, size_t count) {
   return ops->mute_buffer(dst, frame_bytes, count);
 }
+
+void cras_mix_add_float(snd_pcm_format_t fmt,
+                        float* dst,
+                        const uint8_t* src,
+                        unsigned int count,
+                        int mute,
+                        float mix_vol) {
+  ops->add_float(fmt, dst, src, count, mute, mix_vol);
+}
+
+void cras_mix_float_to_format(snd_pcm_format_t fmt,
+                              uint8_t* dst,
+                              const float* src,
+                              unsigned int count) {
+  ops->float_to_format(fmt, dst, src, count);
+}
+
+int cras_mix_add_s16_stereo(snd_pcm_format_t fmt,
+                            uint8_t* dst,
+                            const int16_t* src,
+                            unsigned int frames,
+                            unsigned int in_channels,
+                            int mute,
+                            float mix_vol) {
+  return ops->add_s16_stereo(fmt, dst, src, frames, in_channels, mute,
+                             mix_vol);
+}
+
+int cras_mix_is_silent(const uint8_t* buf, size_t bytes) {
+  return ops->is_silent(buf, bytes);
+}
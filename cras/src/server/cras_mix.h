@@ -17,6 +17,9 @@ struct cras_audio_shm;
 #define CPU_X86_FMA 8
 #define CPU_X86_FMA_CRASH 16
 
+// Returns the CPU_X86_* flags of the running CPU.
+int cpu_get_flags();
+
 void cras_mix_init();
 
 /* Scale the given buffer with the provided scaler and increment.
@@ -95,4 +98,67 @@ void cras_mix_add_scale_stride(snd_pcm_format_t fmt,
  */
 size_t cras_mix_mute_buffer(uint8_t* dst, size_t frame_bytes, size_t count);
 
+/* Converts and adds samples into a float32 mix bus. Unlike cras_mix_add()
+ * nothing is clipped, dst has to be cleared before the first stream.
+ * Args:
+ *    fmt - The format of the samples in src.
+ *    dst - The float mix bus, samples normalized to [-1, 1).
+ *    src - Buffer of samples to mix from.
+ *    count - The number of samples to mix.
+ *    mute - Mute the source if set.
+ *    mix_vol - Amount to scale the source by.
+ */
+void cras_mix_add_float(snd_pcm_format_t fmt,
+                        float* dst,
+                        const uint8_t* src,
+                        unsigned int count,
+                        int mute,
+                        float mix_vol);
+
+/* Converts samples of a float32 mix bus to the given format, clipping the
+ * values out of range.
+ * Args:
+ *    fmt - The format to convert to.
+ *    dst - Buffer to write the converted samples to.
+ *    src - The float mix bus.
+ *    count - The number of samples to convert.
+ */
+void cras_mix_float_to_format(snd_pcm_format_t fmt,
+                              uint8_t* dst,
+                              const float* src,
+                              unsigned int count);
+
+/* Converts S16_LE mono or stereo samples to a stereo device format, scales
+ * and adds them to dst in one pass. Stereo samples are copied and mono ones
+ * duplicated to both channels. Gives the same result as converting with
+ * cras_fmt_conv then calling cras_mix_add() on the converted samples.
+ * Args:
+ *    fmt - The format of dst, SND_PCM_FORMAT_S16_LE or SND_PCM_FORMAT_S32_LE.
+ *    dst - Stereo buffer of samples to mix to.
+ *    src - Buffer of S16_LE samples to mix from.
+ *    frames - The number of frames to mix.
+ *    in_channels - The number of channels in src, 1 or 2.
+ *    mute - Is the stream providing the buffer muted.
+ *    mix_vol - Scaler for the buffer to be mixed.
+ * Returns:
+ *    0 on success, -EINVAL if fmt or in_channels isn't supported.
+ */
+int cras_mix_add_s16_stereo(snd_pcm_format_t fmt,
+                            uint8_t* dst,
+                            const int16_t* src,
+                            unsigned int frames,
+                            unsigned int in_channels,
+                            int mute,
+                            float mix_vol);
+
+/* Checks if a buffer holds nothing but zeros, that is digital silence in
+ * any of the integer sample formats.
+ * Args:
+ *    buf - The samples to check.
+ *    bytes - The size of buf in bytes.
+ * Returns:
+ *    Non-zero if every byte of buf is zero.
+ */
+int cras_mix_is_silent(const uint8_t* buf, size_t bytes);
+
 #endif  // CRAS_SRC_SERVER_CRAS_MIX_H_
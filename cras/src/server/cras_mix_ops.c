@@ -5,9 +5,12 @@
 
 #include "cras/src/server/cras_mix_ops.h"
 
+#include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "cras/src/server/cras_system_state.h"
+#include "cras_util.h"
 
 #define MAX_VOLUME_TO_SCALE 0.9999999
 #define MIN_VOLUME_TO_SCALE 0.0000001
@@ -823,6 +826,198 @@ static void cras_mix_add_scale_stride_s24_3le(uint8_t* dst,
   }
 }
 
+/*
+ * Fused convert, scale and mix of S16_LE mono or stereo streams into stereo
+ * S16_LE or S32_LE devices. Each produces the same samples as converting
+ * with cras_fmt_conv and then cras_mix_add() but in a single pass, without
+ * the intermediate buffers.
+ */
+
+static inline int16_t mix_sample_s16_le(int16_t dst, int16_t s, float vol) {
+  int32_t sum = dst + (int16_t)(s * vol);
+
+  sum = sum > INT16_MAX ? INT16_MAX : sum;
+  sum = sum < INT16_MIN ? INT16_MIN : sum;
+  return sum;
+}
+
+/* The scaled sample is converted through int32 rather than int64 as there
+ * is no vector conversion from float to int64. That's exact since vol is at
+ * most 1.0 after fused_mix_vol(). */
+static inline int32_t mix_sample_s32_le(int32_t dst, int16_t s, float vol) {
+  int32_t in = (int32_t)((uint32_t)(int32_t)s << 16);
+  int64_t sum = (int64_t)dst + (int32_t)(in * vol);
+
+  sum = sum > INT32_MAX ? INT32_MAX : sum;
+  sum = sum < INT32_MIN ? INT32_MIN : sum;
+  return sum;
+}
+
+/* Volumes close enough to 1.0 aren't applied by cras_mix_add(). Scaling by
+ * exactly 1.0 instead is lossless for S16 samples and keeps the loops below
+ * free of branches. */
+static inline float fused_mix_vol(float vol) {
+  return vol > MAX_VOLUME_TO_SCALE ? 1.0f : vol;
+}
+
+static void cras_mix_add_s16_stereo_s16_le(int16_t* dst,
+                                           const int16_t* src,
+                                           unsigned int frames,
+                                           unsigned int in_channels,
+                                           float vol) {
+  size_t i;
+
+  vol = fused_mix_vol(vol);
+  if (in_channels == 1) {
+    for (i = 0; i < frames; i++) {
+      dst[2 * i] = mix_sample_s16_le(dst[2 * i], src[i], vol);
+      dst[2 * i + 1] = mix_sample_s16_le(dst[2 * i + 1], src[i], vol);
+    }
+  } else {
+    for (i = 0; i < (size_t)frames * 2; i++) {
+      dst[i] = mix_sample_s16_le(dst[i], src[i], vol);
+    }
+  }
+}
+
+static void cras_mix_add_s16_stereo_s32_le(int32_t* dst,
+                                           const int16_t* src,
+                                           unsigned int frames,
+                                           unsigned int in_channels,
+                                           float vol) {
+  size_t i;
+
+  vol = fused_mix_vol(vol);
+  if (in_channels == 1) {
+    for (i = 0; i < frames; i++) {
+      dst[2 * i] = mix_sample_s32_le(dst[2 * i], src[i], vol);
+      dst[2 * i + 1] = mix_sample_s32_le(dst[2 * i + 1], src[i], vol);
+    }
+  } else {
+    for (i = 0; i < (size_t)frames * 2; i++) {
+      dst[i] = mix_sample_s32_le(dst[i], src[i], vol);
+    }
+  }
+}
+
+/*
+ * Float32 mix bus functions. Samples on the bus are normalized to [-1, 1)
+ * and are only clipped when converted back to the device format.
+ */
+
+static void cras_mix_add_float_s16_le(float* dst,
+                                      const uint8_t* src,
+                                      unsigned int count,
+                                      float scaler) {
+  const int16_t* in = (const int16_t*)src;
+  unsigned int i;
+
+  scaler /= 32768.0f;
+  for (i = 0; i < count; i++) {
+    dst[i] += in[i] * scaler;
+  }
+}
+
+static void cras_mix_add_float_s24_le(float* dst,
+                                      const uint8_t* src,
+                                      unsigned int count,
+                                      float scaler) {
+  const int32_t* in = (const int32_t*)src;
+  unsigned int i;
+
+  // Sign extend from bit 23 by scaling the sample in the top 24 bits.
+  scaler /= 2147483648.0f;
+  for (i = 0; i < count; i++) {
+    dst[i] += (int32_t)((uint32_t)in[i] << 8) * scaler;
+  }
+}
+
+static void cras_mix_add_float_s32_le(float* dst,
+                                      const uint8_t* src,
+                                      unsigned int count,
+                                      float scaler) {
+  const int32_t* in = (const int32_t*)src;
+  unsigned int i;
+
+  scaler /= 2147483648.0f;
+  for (i = 0; i < count; i++) {
+    dst[i] += in[i] * scaler;
+  }
+}
+
+static void cras_mix_add_float_s24_3le(float* dst,
+                                       const uint8_t* src,
+                                       unsigned int count,
+                                       float scaler) {
+  int32_t frame;
+  unsigned int i;
+
+  scaler /= 2147483648.0f;
+  for (i = 0; i < count; i++, src += 3) {
+    convert_single_s243le_to_s32le(&frame, src);
+    dst[i] += frame * scaler;
+  }
+}
+
+/* Scales a float sample to an integer of the given full scale, rounding to
+ * the nearest value and clipping to the integer range. */
+static inline int64_t float_to_int(float f, float full_scale) {
+  f *= full_scale;
+  f += (f >= 0) ? 0.5f : -0.5f;
+  if (f >= full_scale) {
+    return (int64_t)full_scale - 1;
+  }
+  if (f < -full_scale) {
+    return -(int64_t)full_scale;
+  }
+  return (int64_t)f;
+}
+
+static void cras_float_to_s16_le(uint8_t* dst,
+                                 const float* src,
+                                 unsigned int count) {
+  int16_t* out = (int16_t*)dst;
+  unsigned int i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = float_to_int(src[i], 32768.0f);
+  }
+}
+
+static void cras_float_to_s24_le(uint8_t* dst,
+                                 const float* src,
+                                 unsigned int count) {
+  int32_t* out = (int32_t*)dst;
+  unsigned int i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = float_to_int(src[i], 8388608.0f);
+  }
+}
+
+static void cras_float_to_s32_le(uint8_t* dst,
+                                 const float* src,
+                                 unsigned int count) {
+  int32_t* out = (int32_t*)dst;
+  unsigned int i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = float_to_int(src[i], 2147483648.0f);
+  }
+}
+
+static void cras_float_to_s24_3le(uint8_t* dst,
+                                  const float* src,
+                                  unsigned int count) {
+  int32_t frame;
+  unsigned int i;
+
+  for (i = 0; i < count; i++, dst += 3) {
+    frame = float_to_int(src[i], 2147483648.0f);
+    convert_single_s32le_to_s243le(dst, &frame);
+  }
+}
+
 static void scale_buffer_increment(snd_pcm_format_t fmt,
                                    uint8_t* buff,
                                    unsigned int count,
@@ -912,15 +1107,115 @@ static void mix_add_scale_stride(snd_pcm_format_t fmt,
   }
 }
 
+static int mix_add_s16_stereo(snd_pcm_format_t fmt,
+                              uint8_t* dst,
+                              const int16_t* src,
+                              unsigned int frames,
+                              unsigned int in_channels,
+                              int mute,
+                              float mix_vol) {
+  if (in_channels != 1 && in_channels != 2) {
+    return -EINVAL;
+  }
+
+  switch (fmt) {
+    case SND_PCM_FORMAT_S16_LE:
+      if (!mute && mix_vol >= MIN_VOLUME_TO_SCALE) {
+        cras_mix_add_s16_stereo_s16_le((int16_t*)dst, src, frames, in_channels,
+                                       mix_vol);
+      }
+      return 0;
+    case SND_PCM_FORMAT_S32_LE:
+      if (!mute && mix_vol >= MIN_VOLUME_TO_SCALE) {
+        cras_mix_add_s16_stereo_s32_le((int32_t*)dst, src, frames, in_channels,
+                                       mix_vol);
+      }
+      return 0;
+    default:
+      return -EINVAL;
+  }
+}
+
+static void mix_add_float(snd_pcm_format_t fmt,
+                          float* dst,
+                          const uint8_t* src,
+                          unsigned int count,
+                          int mute,
+                          float mix_vol) {
+  if (mute || (mix_vol < MIN_VOLUME_TO_SCALE)) {
+    return;
+  }
+
+  switch (fmt) {
+    case SND_PCM_FORMAT_S16_LE:
+      return cras_mix_add_float_s16_le(dst, src, count, mix_vol);
+    case SND_PCM_FORMAT_S24_LE:
+      return cras_mix_add_float_s24_le(dst, src, count, mix_vol);
+    case SND_PCM_FORMAT_S32_LE:
+      return cras_mix_add_float_s32_le(dst, src, count, mix_vol);
+    case SND_PCM_FORMAT_S24_3LE:
+      return cras_mix_add_float_s24_3le(dst, src, count, mix_vol);
+    default:
+      break;
+  }
+}
+
+static void mix_float_to_format(snd_pcm_format_t fmt,
+                                uint8_t* dst,
+                                const float* src,
+                                unsigned int count) {
+  switch (fmt) {
+    case SND_PCM_FORMAT_S16_LE:
+      return cras_float_to_s16_le(dst, src, count);
+    case SND_PCM_FORMAT_S24_LE:
+      return cras_float_to_s24_le(dst, src, count);
+    case SND_PCM_FORMAT_S32_LE:
+      return cras_float_to_s32_le(dst, src, count);
+    case SND_PCM_FORMAT_S24_3LE:
+      return cras_float_to_s24_3le(dst, src, count);
+    default:
+      break;
+  }
+}
+
 static size_t mix_mute_buffer(uint8_t* dst, size_t frame_bytes, size_t count) {
   memset(dst, 0, count * frame_bytes);
   return count;
 }
 
+// Bytes OR-reduced at once before checking for sound.
+#define SILENCE_BLOCK_BYTES 256
+
+/* The loop over a block has no branch so it vectorizes, a block with sound
+ * ends the scan. */
+static int mix_is_silent(const uint8_t* buf, size_t bytes) {
+  uint64_t words[SILENCE_BLOCK_BYTES / sizeof(uint64_t)];
+  uint64_t acc = 0;
+  size_t i, j;
+
+  for (i = 0; i + SILENCE_BLOCK_BYTES <= bytes; i += SILENCE_BLOCK_BYTES) {
+    memcpy(words, buf + i, SILENCE_BLOCK_BYTES);
+    for (j = 0; j < ARRAY_SIZE(words); j++) {
+      acc |= words[j];
+    }
+    if (acc) {
+      return 0;
+    }
+  }
+  for (; i < bytes; i++) {
+    acc |= buf[i];
+  }
+  return !acc;
+}
+
 const struct cras_mix_ops OPS(mixer_ops) = {
     .scale_buffer = scale_buffer,
     .scale_buffer_increment = scale_buffer_increment,
     .add = mix_add,
     .add_scale_stride = mix_add_scale_stride,
     .mute_buffer = mix_mute_buffer,
+    .add_float = mix_add_float,
+    .float_to_format = mix_float_to_format,
+    .add_s16_stereo = mix_add_s16_stereo,
+    .is_silent = mix_is_silent,
 };
@@ -54,5 +54,27 @@ struct cras_mix_ops {
                            float scaler);
   // cras_mix_mute_buffer.
   size_t (*mute_buffer)(uint8_t* dst, size_t frame_bytes, size_t count);
+  // See cras_mix_add_float.
+  void (*add_float)(snd_pcm_format_t fmt,
+                    float* dst,
+                    const uint8_t* src,
+                    unsigned int count,
+                    int mute,
+                    float mix_vol);
+  // See cras_mix_float_to_format.
+  void (*float_to_format)(snd_pcm_format_t fmt,
+                          uint8_t* dst,
+                          const float* src,
+                          unsigned int count);
+  // See cras_mix_add_s16_stereo.
+  int (*add_s16_stereo)(snd_pcm_format_t fmt,
+                        uint8_t* dst,
+                        const int16_t* src,
+                        unsigned int frames,
+                        unsigned int in_channels,
+                        int mute,
+                        float mix_vol);
+  // See cras_mix_is_silent.
+  int (*is_silent)(const uint8_t* buf, size_t bytes);
 };
 #endif
@@ -5,14 +5,30 @@
 
 #include "cras/src/server/cras_observer.h"
 
+#include <time.h>
+
 #include "cras/src/server/cras_alert.h"
 #include "cras/src/server/cras_iodev_list.h"
+#include "cras/src/server/cras_system_state.h"
+#include "cras/src/server/cras_tm.h"
 #include "cras_types.h"
+#include "cras_util.h"
 #include "third_party/utlist/utlist.h"
 
+struct cras_observer_pending;
+
 struct cras_observer_client {
   struct cras_observer_ops ops;
   void* context;
+  // Minimum time between batches of notifications, 0 to not hold them.
+  unsigned int interval_ms;
+  // Called after each batch of notifications is delivered.
+  void (*flushed)(void* context);
+  // Notifications held until flush_timer fires, oldest first.
+  struct cras_observer_pending* pending;
+  struct cras_timer* flush_timer;
+  // The earliest time the next batch can be delivered.
+  struct timespec next_flush;
   struct cras_observer_client *next, *prev;
 };
 
@@ -111,16 +127,161 @@ struct cras_observer_alert_data_general_survey {
   const char* node_type_pair;
 };
 
+// The data of any alert, for holding a copy of it.
+union cras_observer_alert_data {
+  struct cras_observer_alert_data_volume volume;
+  struct cras_observer_alert_data_mute mute;
+  struct cras_observer_alert_data_active_node active_node;
+  struct cras_observer_alert_data_node_volume node_volume;
+  struct cras_observer_alert_data_node_lr_swapped node_lr_swapped;
+  struct cras_observer_alert_data_suspend suspend;
+  struct cras_observer_alert_data_streams streams;
+  struct cras_observer_alert_data_num_non_chrome_output_streams
+      num_non_chrome_output_streams;
+  struct cras_observer_alert_data_input_streams input_streams;
+  struct cras_observer_non_empty_audio_state non_empty_audio_state;
+};
+
+// Calls the callback of a client for one kind of alert.
+typedef void (*cras_observer_deliver)(struct cras_observer_client* client,
+                                      const void* data);
+
+// A notification held for a client.
+struct cras_observer_pending {
+  cras_observer_deliver deliver;
+  // Tells apart notifications of the same kind, e.g. by node or direction.
+  uint64_t key;
+  union cras_observer_alert_data data;
+  struct cras_observer_pending *next, *prev;
+};
+
 // Global observer instance.
 static struct cras_observer_server* g_observer;
 
 // Empty observer ops.
 static struct cras_observer_ops g_empty_ops;
 
+/*
+ * Notification delivery.
+ */
+
+// Delivers the notifications held for client in the order they were held.
+static void deliver_pending(struct cras_observer_client* client) {
+  struct cras_observer_pending *pending, *list;
+
+  list = client->pending;
+  client->pending = NULL;
+  DL_FOREACH (list, pending) {
+    DL_DELETE(list, pending);
+    pending->deliver(client, &pending->data);
+    free(pending);
+  }
+}
+
+// Ends a batch of notifications delivered to client.
+static void end_batch(struct cras_observer_client* client) {
+  struct timespec interval;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &client->next_flush);
+  ms_to_timespec(client->interval_ms, &interval);
+  add_timespecs(&client->next_flush, &interval);
+  if (client->flushed) {
+    client->flushed(client->context);
+  }
+}
+
+static void cancel_flush(struct cras_observer_client* client) {
+  if (client->flush_timer) {
+    cras_tm_cancel_timer(cras_system_state_get_tm(), client->flush_timer);
+    client->flush_timer = NULL;
+  }
+}
+
+static void flush_timeout(struct cras_timer* timer, void* arg) {
+  struct cras_observer_client* client = (struct cras_observer_client*)arg;
+
+  client->flush_timer = NULL;
+  deliver_pending(client);
+  end_batch(client);
+}
+
+/* Delivers a notification to client right away, after the notifications held
+ * for it so they stay in order. */
+static void notify_now(struct cras_observer_client* client,
+                       cras_observer_deliver deliver,
+                       const void* data) {
+  cancel_flush(client);
+  deliver_pending(client);
+  deliver(client, data);
+  end_batch(client);
+}
+
+/* Holds a notification for client until the interval since its last batch
+ * has passed. Only the last value of each deliver function and key is kept.
+ * Clients without an interval get the notification right away. */
+static void notify(struct cras_observer_client* client,
+                   cras_observer_deliver deliver,
+                   uint64_t key,
+                   const void* data,
+                   size_t size) {
+  struct cras_observer_pending* pending;
+  struct timespec now, delay;
+  unsigned int delay_ms = 0;
+
+  if (!client->interval_ms) {
+    notify_now(client, deliver, data);
+    return;
+  }
+
+  DL_FOREACH (client->pending, pending) {
+    if (pending->deliver == deliver && pending->key == key) {
+      break;
+    }
+  }
+  if (!pending) {
+    pending = (struct cras_observer_pending*)calloc(1, sizeof(*pending));
+    if (!pending) {
+      notify_now(client, deliver, data);
+      return;
+    }
+    pending->deliver = deliver;
+    pending->key = key;
+    DL_APPEND(client->pending, pending);
+  }
+  if (size) {
+    memcpy(&pending->data, data, size);
+  }
+
+  if (client->flush_timer) {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+  if (timespec_after(&client->next_flush, &now)) {
+    subtract_timespecs(&client->next_flush, &now, &delay);
+    delay_ms = timespec_to_ms(&delay);
+  }
+  client->flush_timer = cras_tm_create_timer(cras_system_state_get_tm(),
+                                             delay_ms, flush_timeout, client);
+  if (!client->flush_timer) {
+    deliver_pending(client);
+    end_batch(client);
+  }
+}
+
 /*
  * Alert handlers for delayed callbacks.
  */
 
+static void deliver_output_volume(struct cras_observer_client* client,
+                                  const void* data) {
+  const struct cras_observer_alert_data_volume* volume_data =
+      (const struct cras_observer_alert_data_volume*)data;
+
+  if (client->ops.output_volume_changed) {
+    client->ops.output_volume_changed(client->context, volume_data->volume);
+  }
+}
+
 static void output_volume_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_volume* volume_data =
@@ -128,11 +289,23 @@ static void output_volume_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.output_volume_changed) {
-      client->ops.output_volume_changed(client->context, volume_data->volume);
+      notify(client, deliver_output_volume, 0, data, sizeof(*volume_data));
     }
   }
 }
 
+static void deliver_output_mute(struct cras_observer_client* client,
+                                const void* data) {
+  const struct cras_observer_alert_data_mute* mute_data =
+      (const struct cras_observer_alert_data_mute*)data;
+
+  if (client->ops.output_mute_changed) {
+    client->ops.output_mute_changed(client->context, mute_data->muted,
+                                    mute_data->user_muted,
+                                    mute_data->mute_locked);
+  }
+}
+
 static void output_mute_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_mute* mute_data =
@@ -140,13 +313,21 @@ static void output_mute_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.output_mute_changed) {
-      client->ops.output_mute_changed(client->context, mute_data->muted,
-                                      mute_data->user_muted,
-                                      mute_data->mute_locked);
+      notify(client, deliver_output_mute, 0, data, sizeof(*mute_data));
     }
   }
 }
 
+static void deliver_capture_gain(struct cras_observer_client* client,
+                                 const void* data) {
+  const struct cras_observer_alert_data_volume* volume_data =
+      (const struct cras_observer_alert_data_volume*)data;
+
+  if (client->ops.capture_gain_changed) {
+    client->ops.capture_gain_changed(client->context, volume_data->volume);
+  }
+}
+
 static void capture_gain_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_volume* volume_data =
@@ -154,11 +335,22 @@ static void capture_gain_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.capture_gain_changed) {
-      client->ops.capture_gain_changed(client->context, volume_data->volume);
+      notify(client, deliver_capture_gain, 0, data, sizeof(*volume_data));
     }
   }
 }
 
+static void deliver_capture_mute(struct cras_observer_client* client,
+                                 const void* data) {
+  const struct cras_observer_alert_data_mute* mute_data =
+      (const struct cras_observer_alert_data_mute*)data;
+
+  if (client->ops.capture_mute_changed) {
+    client->ops.capture_mute_changed(client->context, mute_data->muted,
+                                     mute_data->mute_locked);
+  }
+}
+
 static void capture_mute_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_mute* mute_data =
@@ -166,12 +358,18 @@ static void capture_mute_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.capture_mute_changed) {
-      client->ops.capture_mute_changed(client->context, mute_data->muted,
-                                       mute_data->mute_locked);
+      notify(client, deliver_capture_mute, 0, data, sizeof(*mute_data));
     }
   }
 }
 
+static void deliver_nodes(struct cras_observer_client* client,
+                          const void* data) {
+  if (client->ops.nodes_changed) {
+    client->ops.nodes_changed(client->context);
+  }
+}
+
 static void nodes_prepare(struct cras_alert* alert) {
   cras_iodev_list_update_device_list();
 }
@@ -181,11 +379,22 @@ static void nodes_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.nodes_changed) {
-      client->ops.nodes_changed(client->context);
+      notify(client, deliver_nodes, 0, data, 0);
     }
   }
 }
 
+static void deliver_active_node(struct cras_observer_client* client,
+                                const void* data) {
+  const struct cras_observer_alert_data_active_node* node_data =
+      (const struct cras_observer_alert_data_active_node*)data;
+
+  if (client->ops.active_node_changed) {
+    client->ops.active_node_changed(client->context, node_data->direction,
+                                    node_data->node_id);
+  }
+}
+
 static void active_node_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_active_node* node_data =
@@ -193,12 +402,23 @@ static void active_node_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.active_node_changed) {
-      client->ops.active_node_changed(client->context, node_data->direction,
-                                      node_data->node_id);
+      notify(client, deliver_active_node, node_data->direction, data,
+             sizeof(*node_data));
     }
   }
 }
 
+static void deliver_output_node_volume(struct cras_observer_client* client,
+                                       const void* data) {
+  const struct cras_observer_alert_data_node_volume* node_data =
+      (const struct cras_observer_alert_data_node_volume*)data;
+
+  if (client->ops.output_node_volume_changed) {
+    client->ops.output_node_volume_changed(client->context, node_data->node_id,
+                                           node_data->volume);
+  }
+}
+
 static void output_node_volume_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_node_volume* node_data =
@@ -206,12 +426,24 @@ static void output_node_volume_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.output_node_volume_changed) {
-      client->ops.output_node_volume_changed(
-          client->context, node_data->node_id, node_data->volume);
+      notify(client, deliver_output_node_volume, node_data->node_id, data,
+             sizeof(*node_data));
     }
   }
 }
 
+static void deliver_node_left_right_swapped(struct cras_observer_client* client,
+                                            const void* data) {
+  const struct cras_observer_alert_data_node_lr_swapped* node_data =
+      (const struct cras_observer_alert_data_node_lr_swapped*)data;
+
+  if (client->ops.node_left_right_swapped_changed) {
+    client->ops.node_left_right_swapped_changed(client->context,
+                                                node_data->node_id,
+                                                node_data->swapped);
+  }
+}
+
 static void node_left_right_swapped_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_node_lr_swapped* node_data =
@@ -219,12 +451,23 @@ static void node_left_right_swapped_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.node_left_right_swapped_changed) {
-      client->ops.node_left_right_swapped_changed(
-          client->context, node_data->node_id, node_data->swapped);
+      notify(client, deliver_node_left_right_swapped, node_data->node_id, data,
+             sizeof(*node_data));
     }
   }
 }
 
+static void deliver_input_node_gain(struct cras_observer_client* client,
+                                    const void* data) {
+  const struct cras_observer_alert_data_node_volume* node_data =
+      (const struct cras_observer_alert_data_node_volume*)data;
+
+  if (client->ops.input_node_gain_changed) {
+    client->ops.input_node_gain_changed(client->context, node_data->node_id,
+                                        node_data->volume);
+  }
+}
+
 static void input_node_gain_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_node_volume* node_data =
@@ -232,12 +475,22 @@ static void input_node_gain_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.input_node_gain_changed) {
-      client->ops.input_node_gain_changed(client->context, node_data->node_id,
-                                          node_data->volume);
+      notify(client, deliver_input_node_gain, node_data->node_id, data,
+             sizeof(*node_data));
     }
   }
 }
 
+static void deliver_suspend_changed(struct cras_observer_client* client,
+                                    const void* data) {
+  const struct cras_observer_alert_data_suspend* suspend_data =
+      (const struct cras_observer_alert_data_suspend*)data;
+
+  if (client->ops.suspend_changed) {
+    client->ops.suspend_changed(client->context, suspend_data->suspended);
+  }
+}
+
 static void suspend_changed_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_suspend* suspend_data =
@@ -245,11 +498,23 @@ static void suspend_changed_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.suspend_changed) {
-      client->ops.suspend_changed(client->context, suspend_data->suspended);
+      notify(client, deliver_suspend_changed, 0, data, sizeof(*suspend_data));
     }
   }
 }
 
+static void deliver_num_active_streams(struct cras_observer_client* client,
+                                       const void* data) {
+  const struct cras_observer_alert_data_streams* streams_data =
+      (const struct cras_observer_alert_data_streams*)data;
+
+  if (client->ops.num_active_streams_changed) {
+    client->ops.num_active_streams_changed(client->context,
+                                           streams_data->direction,
+                                           streams_data->num_active_streams);
+  }
+}
+
 static void num_active_streams_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_streams* streams_data =
@@ -257,13 +522,26 @@ static void num_active_streams_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.num_active_streams_changed) {
-      client->ops.num_active_streams_changed(client->context,
-                                             streams_data->direction,
-                                             streams_data->num_active_streams);
+      notify(client, deliver_num_active_streams, streams_data->direction, data,
+             sizeof(*streams_data));
     }
   }
 }
 
+static void deliver_num_non_chrome_output_streams(
+    struct cras_observer_client* client,
+    const void* data) {
+  const struct cras_observer_alert_data_num_non_chrome_output_streams*
+      streams_data =
+          (const struct cras_observer_alert_data_num_non_chrome_output_streams*)
+              data;
+
+  if (client->ops.num_non_chrome_output_streams_changed) {
+    client->ops.num_non_chrome_output_streams_changed(
+        client->context, streams_data->num_non_chrome_output_streams);
+  }
+}
+
 static void num_non_chrome_output_streams_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_num_non_chrome_output_streams* streams_data =
@@ -271,12 +549,24 @@ static void num_non_chrome_output_streams_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.num_non_chrome_output_streams_changed) {
-      client->ops.num_non_chrome_output_streams_changed(
-          client->context, streams_data->num_non_chrome_output_streams);
+      notify(client, deliver_num_non_chrome_output_streams, 0, data,
+             sizeof(*streams_data));
     }
   }
 }
 
+static void deliver_num_input_streams_with_permission(
+    struct cras_observer_client* client,
+    const void* data) {
+  const struct cras_observer_alert_data_input_streams* input_streams_data =
+      (const struct cras_observer_alert_data_input_streams*)data;
+
+  if (client->ops.num_input_streams_with_permission_changed) {
+    client->ops.num_input_streams_with_permission_changed(
+        client->context, (uint32_t*)input_streams_data->num_input_streams);
+  }
+}
+
 static void num_input_streams_with_permission_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_alert_data_input_streams* input_streams_data =
@@ -284,25 +574,45 @@ static void num_input_streams_with_permission_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.num_input_streams_with_permission_changed) {
-      client->ops.num_input_streams_with_permission_changed(
-          client->context, input_streams_data->num_input_streams);
+      notify(client, deliver_num_input_streams_with_permission, 0, data,
+             sizeof(*input_streams_data));
     }
   }
 }
 
+static void deliver_hotword_triggered(struct cras_observer_client* client,
+                                      const void* data) {
+  const struct cras_observer_alert_data_hotword_triggered* triggered_data =
+      (const struct cras_observer_alert_data_hotword_triggered*)data;
+
+  if (client->ops.hotword_triggered) {
+    client->ops.hotword_triggered(client->context, triggered_data->tv_sec,
+                                  triggered_data->tv_nsec);
+  }
+}
+
 static void hotword_triggered_alert(void* arg, void* data) {
   struct cras_observer_client* client;
-  struct cras_observer_alert_data_hotword_triggered* triggered_data =
-      (struct cras_observer_alert_data_hotword_triggered*)data;
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.hotword_triggered) {
-      client->ops.hotword_triggered(client->context, triggered_data->tv_sec,
-                                    triggered_data->tv_nsec);
+      notify_now(client, deliver_hotword_triggered, data);
     }
   }
 }
 
+static void deliver_non_empty_audio_state_changed(
+    struct cras_observer_client* client,
+    const void* data) {
+  const struct cras_observer_non_empty_audio_state* non_empty_audio_data =
+      (const struct cras_observer_non_empty_audio_state*)data;
+
+  if (client->ops.non_empty_audio_state_changed) {
+    client->ops.non_empty_audio_state_changed(client->context,
+                                              non_empty_audio_data->non_empty);
+  }
+}
+
 static void non_empty_audio_state_changed_alert(void* arg, void* data) {
   struct cras_observer_client* client;
   struct cras_observer_non_empty_audio_state* non_empty_audio_data =
@@ -310,65 +620,102 @@ static void non_empty_audio_state_changed_alert(void* arg, void* data) {
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.non_empty_audio_state_changed) {
-      client->ops.non_empty_audio_state_changed(
-          client->context, non_empty_audio_data->non_empty);
+      notify(client, deliver_non_empty_audio_state_changed, 0, data,
+             sizeof(*non_empty_audio_data));
     }
   }
 }
 
+static void deliver_bt_battery_changed(struct cras_observer_client* client,
+                                       const void* data) {
+  const struct cras_observer_alert_data_bt_battery_changed* triggered_data =
+      (const struct cras_observer_alert_data_bt_battery_changed*)data;
+
+  if (client->ops.bt_battery_changed) {
+    client->ops.bt_battery_changed(client->context, triggered_data->address,
+                                   triggered_data->level);
+  }
+}
+
 static void bt_battery_changed_alert(void* arg, void* data) {
   struct cras_observer_client* client;
-  struct cras_observer_alert_data_bt_battery_changed* triggered_data =
-      (struct cras_observer_alert_data_bt_battery_changed*)data;
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.bt_battery_changed) {
-      client->ops.bt_battery_changed(client->context, triggered_data->address,
-                                     triggered_data->level);
+      notify_now(client, deliver_bt_battery_changed, data);
     }
   }
 }
 
+static void deliver_severe_underrun(struct cras_observer_client* client,
+                                    const void* data) {
+  if (client->ops.severe_underrun) {
+    client->ops.severe_underrun(client->context);
+  }
+}
+
 static void severe_underrun_alert(void* arg, void* data) {
   struct cras_observer_client* client;
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.severe_underrun) {
-      client->ops.severe_underrun(client->context);
+      notify(client, deliver_severe_underrun, 0, data, 0);
     }
   }
 }
 
+static void deliver_underrun(struct cras_observer_client* client,
+                             const void* data) {
+  if (client->ops.underrun) {
+    client->ops.underrun(client->context);
+  }
+}
+
 static void underrun_alert(void* arg, void* data) {
   struct cras_observer_client* client;
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.underrun) {
-      client->ops.underrun(client->context);
+      notify(client, deliver_underrun, 0, data, 0);
     }
   }
 }
 
+static void deliver_general_survey(struct cras_observer_client* client,
+                                   const void* data) {
+  const struct cras_observer_alert_data_general_survey* triggered_data =
+      (const struct cras_observer_alert_data_general_survey*)data;
+
+  if (client->ops.general_survey) {
+    client->ops.general_survey(client->context, triggered_data->stream_type,
+                               triggered_data->client_type,
+                               triggered_data->node_type_pair);
+  }
+}
+
 static void general_survey_alert(void* arg, void* data) {
   struct cras_observer_client* client;
-  struct cras_observer_alert_data_general_survey* triggered_data =
-      (struct cras_observer_alert_data_general_survey*)data;
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.general_survey) {
-      client->ops.general_survey(client->context, triggered_data->stream_type,
-                                 triggered_data->client_type,
-                                 triggered_data->node_type_pair);
+      notify_now(client, deliver_general_survey, data);
     }
   }
 }
 
+static void deliver_speak_on_mute_detected(struct cras_observer_client* client,
+                                           const void* data) {
+  if (client->ops.speak_on_mute_detected) {
+    client->ops.speak_on_mute_detected(client->context);
+  }
+}
+
 static void speak_on_mute_detected_alert(void* arg, void* data) {
   struct cras_observer_client* client;
 
   DL_FOREACH (g_observer->clients, client) {
     if (client->ops.speak_on_mute_detected) {
-      client->ops.speak_on_mute_detected(client->context);
+      notify(client, deliver_speak_on_mute_detected, 0, data, 0);
     }
   }
 }
@@ -522,10 +869,32 @@ struct cras_observer_client* cras_observer_add(
   return client;
 }
 
+void cras_observer_set_interval(struct cras_observer_client* client,
+                                unsigned int interval_ms,
+                                void (*flushed)(void* context)) {
+  if (!client) {
+    return;
+  }
+  client->interval_ms = interval_ms;
+  client->flushed = flushed;
+  if (!interval_ms && client->pending) {
+    cancel_flush(client);
+    deliver_pending(client);
+    end_batch(client);
+  }
+}
+
 void cras_observer_remove(struct cras_observer_client* client) {
+  struct cras_observer_pending* pending;
+
   if (!client) {
     return;
   }
+  cancel_flush(client);
+  DL_FOREACH (client->pending, pending) {
+    DL_DELETE(client->pending, pending);
+    free(pending);
+  }
   DL_DELETE(g_observer->clients, client);
   free(client);
 }
@@ -40,6 +40,22 @@ void cras_observer_get_ops(const struct cras_observer_client* client,
 void cras_observer_set_ops(struct cras_observer_client* client,
                            const struct cras_observer_ops* ops);
 
+/* Set how often notifications are delivered to a client. Notifications that
+ * happen within interval_ms of the last batch are held, keeping only the last
+ * value of each kind, and delivered together once the interval has passed.
+ * Notifications that can't wait, like a hotword trigger, are delivered right
+ * away along with the held ones.
+ * Args:
+ *    client - The client to modify.
+ *    interval_ms - The minimum time between batches, 0 delivers every
+ *        notification right away, which is the default.
+ *    flushed - Called with the client context after each batch is delivered,
+ *        or NULL.
+ */
+void cras_observer_set_interval(struct cras_observer_client* client,
+                                unsigned int interval_ms,
+                                void (*flushed)(void* context));
+
 // Returns non-zero if the given ops are empty.
 int cras_observer_ops_are_empty(const struct cras_observer_ops* ops);
 
@@ -30,6 +30,11 @@ struct cras_rclient {
   // than CRAS_CLIENT_TYPE_UNKNOWN, rclient will overwrite incoming
   // messages' client type.
   enum CRAS_CLIENT_TYPE client_type;
+  // Minimum time between notifications, see cras_observer_set_interval.
+  unsigned int notification_interval_ms;
+  // Notifications batched into one message while notification_interval_ms
+  // is non-zero, NULL otherwise.
+  struct cras_client_notifications* notifications;
 };
 
 // Operations for cras_rclient.
@@ -30,6 +30,7 @@ int rclient_send_message_to_client(const struct cras_rclient* client,
 void rclient_destroy(struct cras_rclient* client) {
   cras_observer_remove(client->observer);
   stream_list_rm_all_client_streams(cras_iodev_list_get_stream_list(), client);
+  free(client->notifications);
   free(client);
 }
 
@@ -145,7 +146,8 @@ int rclient_handle_client_stream_connect(struct cras_rclient* client,
   struct cras_rstream_config stream_config;
   int rc, header_fd, samples_fd;
   size_t samples_size;
-  int stream_fds[2];
+  int stream_fds[3];
+  unsigned int num_stream_fds = 2;
 
   rc = rclient_validate_stream_connect_params(client, msg, aud_fd,
                                               client_shm_fd);
@@ -226,8 +228,15 @@ int rclient_handle_client_stream_connect(struct cras_rclient* client,
   /* If we're using client-provided shm, samples_fd here refers to the
    * same shm area as client_shm_fd */
   stream_fds[1] = samples_fd;
+  /* A third fd tells the client the server accepted the SHM_DOORBELL
+   * transport. */
+  stream_fds[2] = cras_rstream_get_doorbell_fd(stream);
+  if (stream_fds[2] >= 0) {
+    num_stream_fds++;
+  }
 
-  rc = client->ops->send_message_to_client(client, reply, stream_fds, 2);
+  rc = client->ops->send_message_to_client(client, reply, stream_fds,
+                                           num_stream_fds);
   if (rc < 0) {
     syslog(LOG_WARNING, "Failed to send connected messaged\n");
     stream_list_rm(cras_iodev_list_get_stream_list(), stream->stream_id);
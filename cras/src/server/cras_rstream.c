@@ -7,6 +7,7 @@
 
 #include <fcntl.h>
 #include <stdint.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <syslog.h>
@@ -219,6 +220,30 @@ static int get_audio_request_reply(const struct cras_rstream* stream,
   return rc;
 }
 
+/*
+ * Handles the latest reply a doorbell client posted in shm. The doorbell fd
+ * is watched edge triggered, so its counter is only cleared by the audio
+ * thread when it starts waiting for the next reply.
+ * Returns:
+ *   1 if a new reply was handled, 0 if there is none.
+ *   A negative error code if the client replied with an error.
+ */
+static int handle_doorbell_reply(struct cras_rstream* stream) {
+  uint32_t seq = cras_shm_get_reply_seq(stream->shm);
+  int32_t err;
+
+  if (seq == stream->reply_seq) {
+    return 0;
+  }
+  stream->reply_seq = seq;
+  clear_pending_reply(stream);
+  err = cras_shm_get_reply_error(stream->shm);
+  if (err < 0) {
+    return err;
+  }
+  return 1;
+}
+
 /*
  * Reads and handles one audio message from client.
  * Returns:
@@ -230,6 +255,10 @@ static int read_and_handle_client_message(struct cras_rstream* stream) {
   struct audio_message msg;
   int rc;
 
+  if (stream_uses_doorbell(stream)) {
+    return handle_doorbell_reply(stream);
+  }
+
   rc = get_audio_request_reply(stream, &msg);
   if (rc <= 0) {
     clear_pending_reply(stream);
@@ -323,6 +352,14 @@ int cras_rstream_create(struct cras_rstream_config* config,
 
   stream->fd = config->audio_fd;
   config->audio_fd = -1;
+  stream->doorbell_fd = -1;
+  if (stream_uses_doorbell(stream) && !stream_is_server_only(stream)) {
+    stream->doorbell_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  }
+  if (stream->doorbell_fd < 0 && stream_uses_doorbell(stream)) {
+    // Fall back to the stream socket.
+    stream->flags &= ~SHM_DOORBELL;
+  }
   stream->buf_state = buffer_share_create(stream->buffer_frames);
   disallow_non_supported_dsp_effects(&config->effects);
   stream->stream_apm = (stream->direction == CRAS_STREAM_INPUT)
@@ -347,6 +384,9 @@ void cras_rstream_destroy(struct cras_rstream* stream) {
   cras_server_metrics_stream_destroy(stream);
   cras_system_state_stream_removed(stream->direction, stream->client_type);
   close(stream->fd);
+  if (stream_uses_doorbell(stream)) {
+    close(stream->doorbell_fd);
+  }
   cras_audio_shm_destroy(stream->shm);
   cras_audio_area_destroy(stream->audio_area);
   buffer_share_destroy(stream->buf_state);
@@ -408,6 +448,15 @@ int cras_rstream_request_audio(struct cras_rstream* stream,
 
   stream->last_fetch_ts = *now;
 
+  if (stream_uses_doorbell(stream)) {
+    rc = cras_shm_post_request(stream->shm, stream->cb_threshold);
+    if (rc < 0) {
+      return rc;
+    }
+    set_pending_reply(stream);
+    return 0;
+  }
+
   init_audio_message(&msg, AUDIO_MESSAGE_REQUEST_DATA, stream->cb_threshold);
   rc = write(stream->fd, &msg, sizeof(msg));
   if (rc < 0) {
@@ -431,6 +480,15 @@ int cras_rstream_audio_ready(struct cras_rstream* stream, size_t count) {
     return 0;
   }
 
+  if (stream_uses_doorbell(stream)) {
+    rc = cras_shm_post_request(stream->shm, count);
+    if (rc < 0) {
+      return rc;
+    }
+    set_pending_reply(stream);
+    return 0;
+  }
+
   init_audio_message(&msg, AUDIO_MESSAGE_DATA_READY, count);
   rc = write(stream->fd, &msg, sizeof(msg));
   if (rc < 0) {
@@ -562,6 +620,14 @@ int cras_rstream_flush_old_audio_messages(struct cras_rstream* stream) {
     return 0;
   }
 
+  if (stream_uses_doorbell(stream)) {
+    err = read_and_handle_client_message(stream);
+    if (err < 0) {
+      syslog(LOG_WARNING, "Error reply from client: rc: %d", err);
+    }
+    return 0;
+  }
+
   pollfd.fd = stream->fd;
   pollfd.events = POLLIN;
 
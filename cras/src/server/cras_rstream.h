@@ -45,6 +45,14 @@ struct cras_rstream {
   uint32_t flags;
   // Socket for requesting and sending audio buffer events.
   int fd;
+  /* Eventfd rung by the client after posting a reply in shm. Only valid
+   * when SHM_DOORBELL is set in flags, otherwise audio messages are
+   * exchanged on fd. */
+  int doorbell_fd;
+  // The latest reply_seq handled from the shm header.
+  uint32_t reply_seq;
+  // The audio thread waits on the audio fd for the reply of the client.
+  int reply_wait_armed;
   // Buffer size in frames.
   size_t buffer_frames;
   // Callback client when this much is left.
@@ -170,7 +178,13 @@ static inline int cras_rstream_get_format(const struct cras_rstream* stream,
 
 // Gets the fd to be used to poll this client for audio.
 static inline int cras_rstream_get_audio_fd(const struct cras_rstream* stream) {
-  return stream->fd;
+  return (stream->flags & SHM_DOORBELL) ? stream->doorbell_fd : stream->fd;
+}
+
+// Gets the doorbell fd to hand to the client, or -1 if not used.
+static inline int cras_rstream_get_doorbell_fd(
+    const struct cras_rstream* stream) {
+  return (stream->flags & SHM_DOORBELL) ? stream->doorbell_fd : -1;
 }
 
 // Gets the is_draning flag.
@@ -225,6 +239,11 @@ static inline int stream_is_server_only(const struct cras_rstream* s) {
   return s->flags & SERVER_ONLY;
 }
 
+// Checks if the stream exchanges audio messages through the shm doorbell.
+static inline int stream_uses_doorbell(const struct cras_rstream* s) {
+  return s->flags & SHM_DOORBELL;
+}
+
 // Gets the enabled effects of this stream.
 unsigned int cras_rstream_get_effects(const struct cras_rstream* stream);
 
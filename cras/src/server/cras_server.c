@@ -9,15 +9,17 @@
 #include <dbus/dbus.h>
 #endif
 #include <errno.h>
-#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/param.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <syslog.h>
@@ -31,10 +33,13 @@
 #endif
 #include "cras/src/common/cras_metrics.h"
 #include "cras/src/common/cras_string.h"
+#include "cras/src/dsp/dsp_util.h"
 #include "cras/src/server/cras_alert.h"
 #include "cras/src/server/cras_alsa_helpers.h"
+#include "cras/src/server/cras_alsa_probe.h"
 #include "cras/src/server/cras_audio_thread_monitor.h"
 #include "cras/src/server/cras_device_monitor.h"
+#include "cras/src/server/cras_fmt_conv.h"
 #include "cras/src/server/cras_hotword_handler.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_main_message.h"
@@ -55,8 +60,27 @@
 #include "cras_util.h"
 #include "third_party/utlist/utlist.h"
 
+// Maximum number of ready fds handled per wake up.
+#define MAX_WAIT_EVENTS 64
+
+// Kinds of fds in the wait set of the main loop.
+enum server_fd_type {
+  SERVER_FD_SOCKET,
+  SERVER_FD_CLIENT,
+  SERVER_FD_CALLBACK,
+  SERVER_FD_TASKS,
+  SERVER_FD_TIMER,
+};
+
+/* First member of everything added to the wait set. The wait set hands it back
+ * to tell what became ready. */
+struct server_fd {
+  enum server_fd_type type;
+};
+
 // Store a list of clients that are attached to the server.
 struct attached_client {
+  struct server_fd wait;
   // Unique identifier for this client.
   size_t id;
   // socket file descriptor used to communicate with client.
@@ -65,8 +89,6 @@ struct attached_client {
   struct ucred ucred;
   // rclient to handle messages from this client.
   struct cras_rclient* client;
-  // Pointer to struct pollfd for this callback.
-  struct pollfd* pollfd;
   struct attached_client *next, *prev;
 };
 
@@ -77,14 +99,13 @@ struct attached_client {
  * to watch file descriptors.  The client can then read or write the fd.
  */
 struct client_callback {
+  struct server_fd wait;
   // The file descriptor passed to select.
   int select_fd;
   // The funciton to call when fd is ready.
   void (*callback)(void* data, int revents);
   // Pointer passed to the callback.
   void* callback_data;
-  // Pointer to struct pollfd for this callback.
-  struct pollfd* pollfd;
   int deleted;
   // The events to poll for.
   int events;
@@ -100,25 +121,65 @@ struct system_task {
 
 // A structure wraps data related to server socket.
 struct server_socket {
+  struct server_fd wait;
   struct sockaddr_un addr;
   int fd;
   enum CRAS_CONNECTION_TYPE type;
 };
 
-// Local server data.
+/* Local server data. The server sockets, clients and callbacks are added to
+ * the wait set as they come and go, so the main loop only waits and dispatches
+ * the ready fds. System tasks and timers wake it through an eventfd and a
+ * timerfd in the same set.
+ */
 struct server_data {
   struct attached_client* clients_head;
   size_t num_clients;
   struct client_callback* client_callbacks;
   struct system_task* system_tasks;
-  size_t num_client_callbacks;
   size_t next_client_id;
   struct server_socket server_sockets[CRAS_NUM_CONN_TYPE];
-} server_instance;
+  // The epoll set the main loop waits on.
+  int wait_fd;
+  // eventfd signaled when a system task is added.
+  int task_fd;
+  // timerfd armed for the next cras_tm timer.
+  int timer_fd;
+  struct server_fd task_wait;
+  struct server_fd timer_wait;
+} server_instance = {
+    .wait_fd = -1,
+    .task_fd = -1,
+    .timer_fd = -1,
+    .task_wait = {.type = SERVER_FD_TASKS},
+    .timer_wait = {.type = SERVER_FD_TIMER},
+};
+
+/* Adds fd to the wait set of the main loop.
+ * Returns:
+ *    0 on success, negative error code on failure.
+ */
+static int wait_set_add(int fd, uint32_t events, struct server_fd* data) {
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = data;
+  if (epoll_ctl(server_instance.wait_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+static void wait_set_rm(int fd) {
+  // The fd may already be closed, which removed it from the set.
+  epoll_ctl(server_instance.wait_fd, EPOLL_CTL_DEL, fd, NULL);
+}
 
 // Cleanup a given server_socket
 static void server_socket_cleanup(struct server_socket* socket) {
   if (socket && socket->fd >= 0) {
+    wait_set_rm(socket->fd);
     close(socket->fd);
     socket->fd = -1;
     unlink(socket->addr.sun_path);
@@ -128,6 +189,7 @@ static void server_socket_cleanup(struct server_socket* socket) {
 /* Remove a client from the list and destroy it.  Calling rclient_destroy will
  * also free all the streams owned by the client */
 static void remove_client(struct attached_client* client) {
+  wait_set_rm(client->fd);
   close(client->fd);
   DL_DELETE(server_instance.clients_head, client);
   server_instance.num_clients--;
@@ -251,9 +313,9 @@ static void handle_new_connection(struct server_socket* server_socket) {
   // When full, getting an error is preferable to blocking.
   cras_make_fd_nonblocking(connection_fd);
 
+  poll_client->wait.type = SERVER_FD_CLIENT;
   poll_client->fd = connection_fd;
   poll_client->next = NULL;
-  poll_client->pollfd = NULL;
   fill_client_info(poll_client);
 
   poll_client->client =
@@ -263,6 +325,12 @@ static void handle_new_connection(struct server_socket* server_socket) {
     goto error;
   }
 
+  if (wait_set_add(connection_fd, EPOLLIN, &poll_client->wait) < 0) {
+    syslog(LOG_WARNING, "failed to wait on client");
+    cras_rclient_destroy(poll_client->client);
+    goto error;
+  }
+
   DL_APPEND(server_instance.clients_head, poll_client);
   server_instance.num_clients++;
   // Send a current list of available inputs and outputs.
@@ -284,35 +352,35 @@ static int add_select_fd(int fd,
                          int events,
                          void* server_data) {
   struct client_callback* new_cb;
-  struct client_callback* client_cb;
   struct server_data* serv;
+  int rc;
 
   serv = (struct server_data*)server_data;
   if (serv == NULL) {
     return -EINVAL;
   }
 
-  // Check if fd already exists.
-  DL_FOREACH (serv->client_callbacks, client_cb) {
-    if (client_cb->select_fd == fd && !client_cb->deleted) {
-      return -EEXIST;
-    }
-  }
-
   new_cb = (struct client_callback*)calloc(1, sizeof(*new_cb));
   if (new_cb == NULL) {
     return -ENOMEM;
   }
 
+  new_cb->wait.type = SERVER_FD_CALLBACK;
   new_cb->select_fd = fd;
   new_cb->callback = cb;
   new_cb->callback_data = callback_data;
   new_cb->deleted = 0;
   new_cb->events = events;
-  new_cb->pollfd = NULL;
+
+  /* The poll events are the same bits as their epoll counterparts. Adding an
+   * fd that is already in the set fails with -EEXIST. */
+  rc = wait_set_add(fd, events, &new_cb->wait);
+  if (rc < 0) {
+    free(new_cb);
+    return rc;
+  }
 
   DL_APPEND(serv->client_callbacks, new_cb);
-  server_instance.num_client_callbacks++;
   return 0;
 }
 
@@ -328,9 +396,12 @@ static void rm_select_fd(int fd, void* server_data) {
     return;
   }
 
+  /* The entry is freed by cleanup_select_fds() once the ready fds of this
+   * wake up were dispatched, it may still be among them. */
   DL_FOREACH (serv->client_callbacks, client_cb) {
-    if (client_cb->select_fd == fd) {
+    if (client_cb->select_fd == fd && !client_cb->deleted) {
       client_cb->deleted = 1;
+      wait_set_rm(fd);
     }
   }
 }
@@ -358,6 +429,8 @@ static int add_task(void (*cb)(void* data),
   new_task->callback_data = callback_data;
 
   DL_APPEND(serv->system_tasks, new_task);
+  // Wake up the main loop to run it.
+  eventfd_write(serv->task_fd, 1);
   return 0;
 }
 
@@ -375,12 +448,142 @@ static void cleanup_select_fds(void* server_data) {
   DL_FOREACH (serv->client_callbacks, client_cb) {
     if (client_cb->deleted) {
       DL_DELETE(serv->client_callbacks, client_cb);
-      server_instance.num_client_callbacks--;
       free(client_cb);
     }
   }
 }
 
+// Maps the CPU_X86_* flags to the instruction sets the DSP kernels may use.
+static unsigned int dsp_x86_features(unsigned int cpu_flags) {
+  unsigned int features = 0;
+
+  if (cpu_flags & CPU_X86_AVX2) {
+    features |= DSP_X86_AVX2;
+  }
+  // Exclude APUs that crash when FMA is enabled: (b/184852038)
+  if ((cpu_flags & CPU_X86_FMA) && !(cpu_flags & CPU_X86_FMA_CRASH)) {
+    features |= DSP_X86_FMA;
+  }
+  return features;
+}
+
+/* Creates the wait set of the main loop along with the eventfd and timerfd
+ * that wake it up for system tasks and timers.
+ * Returns:
+ *    0 on success, negative error code on failure.
+ */
+static int create_wait_set(struct server_data* serv) {
+  int rc;
+
+  serv->wait_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (serv->wait_fd < 0) {
+    return -errno;
+  }
+  serv->task_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (serv->task_fd < 0) {
+    return -errno;
+  }
+  serv->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (serv->timer_fd < 0) {
+    return -errno;
+  }
+  rc = wait_set_add(serv->task_fd, EPOLLIN, &serv->task_wait);
+  if (rc < 0) {
+    return rc;
+  }
+  return wait_set_add(serv->timer_fd, EPOLLIN, &serv->timer_wait);
+}
+
+// Runs the system tasks added since the last call.
+static void run_system_tasks(struct server_data* serv) {
+  struct system_task* tasks;
+  struct system_task* system_task;
+  eventfd_t count;
+
+  if (!serv->system_tasks) {
+    return;
+  }
+  eventfd_read(serv->task_fd, &count);
+
+  // Tasks added by these callbacks wake up the next wait.
+  tasks = serv->system_tasks;
+  serv->system_tasks = NULL;
+  DL_FOREACH (tasks, system_task) {
+    system_task->callback(system_task->callback_data);
+    DL_DELETE(tasks, system_task);
+    free(system_task);
+  }
+}
+
+/* Waits for ready fds in the wait set, or for the next timer of tm to expire.
+ * Returns:
+ *    The number of ready fds, 0 on timeout or negative error code.
+ */
+static int wait_for_events(struct server_data* serv,
+                           struct cras_tm* tm,
+                           struct epoll_event* events,
+                           int max_events) {
+  struct itimerspec its;
+  struct timespec ts;
+  int timeout_ms = -1;
+  int rc;
+
+  /* A zero it_value disarms the timer, so a timer that is already due is
+   * handled by not blocking at all. */
+  memset(&its, 0, sizeof(its));
+  if (cras_tm_get_next_timeout(tm, &ts)) {
+    if (ts.tv_sec == 0 && ts.tv_nsec == 0) {
+      timeout_ms = 0;
+    } else {
+      its.it_value = ts;
+    }
+  }
+  timerfd_settime(serv->timer_fd, 0, &its, NULL);
+
+  rc = epoll_wait(serv->wait_fd, events, max_events, timeout_ms);
+  if (rc < 0) {
+    return -errno;
+  }
+  return rc;
+}
+
+// Handles a ready fd of the wait set.
+static void dispatch_event(struct server_data* serv,
+                           const struct epoll_event* event) {
+  struct server_fd* wait = (struct server_fd*)event->data.ptr;
+  struct client_callback* client_cb;
+  uint64_t expirations;
+
+  switch (wait->type) {
+    case SERVER_FD_SOCKET:
+      if (event->events & EPOLLIN) {
+        handle_new_connection((struct server_socket*)wait);
+      }
+      break;
+    case SERVER_FD_CLIENT:
+      if (event->events & EPOLLIN) {
+        handle_message_from_client((struct attached_client*)wait);
+      }
+      break;
+    case SERVER_FD_CALLBACK:
+      // Skip callbacks removed while handling an earlier fd.
+      client_cb = (struct client_callback*)wait;
+      if (!client_cb->deleted && (event->events & client_cb->events)) {
+        client_cb->callback(client_cb->callback_data, event->events);
+      }
+      break;
+    case SERVER_FD_TASKS:
+      // Run at the top of the next loop iteration.
+      break;
+    case SERVER_FD_TIMER:
+      // Expired timers are called for every wake up, just clear it.
+      if (read(serv->timer_fd, &expirations, sizeof(expirations)) < 0) {
+        syslog(LOG_DEBUG, "Reading timerfd: %d", errno);
+      }
+      break;
+  }
+}
+
 /* Checks that at least two outputs are present (one will be the "empty"
  * default device. */
 void check_output_exists(struct cras_timer* t, void* data) {
@@ -394,6 +597,8 @@ void check_output_exists(struct cras_timer* t, void* data) {
  */
 
 int cras_server_init() {
+  int rc;
+
   // Log to syslog.
   openlog("cras_server", LOG_PID, LOG_USER);
   if (cras_rust_init_logging()) {
@@ -403,11 +608,26 @@ int cras_server_init() {
 
   server_instance.next_client_id = RESERVED_CLIENT_IDS;
 
+  // Initializes all server_sockets
+  for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
+    server_instance.server_sockets[conn_type].fd = -1;
+  }
+
+  /* Create the wait set first, select fds may be added as soon as the select
+   * handler is set below. */
+  rc = create_wait_set(&server_instance);
+  if (rc < 0) {
+    syslog(LOG_ERR, "Creating the main loop wait set: %d", rc);
+    return rc;
+  }
+
   // Initialize global observer.
   cras_observer_server_init();
 
-  // init mixer with CPU capabilities
+  // init mixer, format converters and DSP kernels with CPU capabilities
   cras_mix_init();
+  cras_fmt_conv_init(cpu_get_flags());
+  dsp_set_x86_features(dsp_x86_features(cpu_get_flags()));
 
   /* Allow clients to register callbacks for file descriptors.
    * add_select_fd and rm_select_fd will add and remove file descriptors
@@ -416,11 +636,6 @@ int cras_server_init() {
   cras_system_set_add_task_handler(add_task, &server_instance);
   cras_main_message_init();
 
-  // Initializes all server_sockets
-  for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
-    server_instance.server_sockets[conn_type].fd = -1;
-  }
-
   return 0;
 }
 
@@ -484,6 +699,12 @@ static int create_and_listen_server_socket(
     goto error;
   }
 
+  server_socket->wait.type = SERVER_FD_SOCKET;
+  rc = wait_set_add(socket_fd, EPOLLIN, &server_socket->wait);
+  if (rc < 0) {
+    goto error;
+  }
+
   server_socket->fd = socket_fd;
   server_socket->type = conn_type;
   return 0;
@@ -504,26 +725,17 @@ static void cleanup_server_sockets() {
 
 int cras_server_run(unsigned int profile_disable_mask) {
   static const unsigned int OUTPUT_CHECK_MS = 5 * 1000;
+  static const unsigned int OUTPUT_CHECK_SLACK_MS = 1000;
 #if CRAS_DBUS
   DBusConnection* dbus_conn;
 #endif
   int rc = 0;
-  struct attached_client* elm;
-  struct client_callback* client_cb;
-  struct system_task* tasks;
-  struct system_task* system_task;
   struct cras_tm* tm;
-  struct timespec ts, *poll_timeout;
-  int timers_active;
-  struct pollfd* pollfds;
-  struct pollfd* pollfds_tmp;
-  unsigned int pollfds_size = 32;
-  unsigned int num_pollfds, poll_size_needed;
+  struct epoll_event events[MAX_WAIT_EVENTS];
+  int num_events;
 
-  pollfds = malloc(sizeof(*pollfds) * pollfds_size);
-
-  if (!pollfds) {
-    return -ENOMEM;
+  if (cras_alsa_probe_init(CRAS_ALSA_PROBE_NUM_WORKERS) < 0) {
+    goto bail;
   }
 
   cras_udev_start_sound_subsystem_monitor();
@@ -579,93 +791,27 @@ int cras_server_run(unsigned int profile_disable_mask) {
   }
 
   // After a delay, make sure there is at least one real output device.
-  cras_tm_create_timer(tm, OUTPUT_CHECK_MS, check_output_exists, 0);
+  cras_tm_create_timer_with_slack(tm, OUTPUT_CHECK_MS, OUTPUT_CHECK_SLACK_MS,
+                                  check_output_exists, 0);
 
   // Download DLC packages
   cras_dlc_manager_init();
 
   // Main server loop - client callbacks are run from this context.
   while (1) {
-    poll_size_needed = CRAS_NUM_CONN_TYPE + server_instance.num_clients +
-                       server_instance.num_client_callbacks;
-    if (poll_size_needed > pollfds_size) {
-      pollfds_size = 2 * poll_size_needed;
-      pollfds_tmp = realloc(pollfds, sizeof(*pollfds) * pollfds_size);
-      if (!pollfds_tmp) {
-        goto bail;
-      }
-      pollfds = pollfds_tmp;
-    }
-
-    for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
-      pollfds[conn_type].fd = server_instance.server_sockets[conn_type].fd;
-      pollfds[conn_type].events = POLLIN;
-    }
-    num_pollfds = CRAS_NUM_CONN_TYPE;
-
-    DL_FOREACH (server_instance.clients_head, elm) {
-      pollfds[num_pollfds].fd = elm->fd;
-      pollfds[num_pollfds].events = POLLIN;
-      elm->pollfd = &pollfds[num_pollfds];
-      num_pollfds++;
-    }
-    DL_FOREACH (server_instance.client_callbacks, client_cb) {
-      if (client_cb->deleted) {
-        continue;
-      }
-      pollfds[num_pollfds].fd = client_cb->select_fd;
-      pollfds[num_pollfds].events = client_cb->events;
-      client_cb->pollfd = &pollfds[num_pollfds];
-      num_pollfds++;
-    }
-
-    tasks = server_instance.system_tasks;
-    server_instance.system_tasks = NULL;
-    DL_FOREACH (tasks, system_task) {
-      system_task->callback(system_task->callback_data);
-      DL_DELETE(tasks, system_task);
-      free(system_task);
-    }
-
-    timers_active = cras_tm_get_next_timeout(tm, &ts);
-
-    /*
-     * If new client task has been scheduled, no need to wait
-     * for timeout, just do another loop to execute them.
-     */
-    if (server_instance.system_tasks) {
-      poll_timeout = NULL;
-    } else {
-      poll_timeout = timers_active ? &ts : NULL;
-    }
+    run_system_tasks(&server_instance);
 
-    rc = ppoll(pollfds, num_pollfds, poll_timeout, NULL);
-    if (rc < 0) {
+    num_events = wait_for_events(&server_instance, tm, events, MAX_WAIT_EVENTS);
+    if (num_events < 0) {
       continue;
     }
 
     cras_tm_call_callbacks(tm);
 
-    // Check for new connections.
-    for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
-      if (pollfds[conn_type].revents & POLLIN) {
-        handle_new_connection(&server_instance.server_sockets[conn_type]);
-      }
-    }
-
-    // Check if there are messages pending for any clients.
-    DL_FOREACH (server_instance.clients_head, elm) {
-      if (elm->pollfd && elm->pollfd->revents & POLLIN) {
-        handle_message_from_client(elm);
-      }
-    }
-    // Check any client-registered fd/callback pairs.
-    DL_FOREACH (server_instance.client_callbacks, client_cb) {
-      if (!client_cb->deleted && client_cb->pollfd &&
-          (client_cb->pollfd->revents & client_cb->events)) {
-        client_cb->callback(client_cb->callback_data,
-                            client_cb->pollfd->revents);
-      }
+    /* Only the ready fds: new connections, messages pending for clients and
+     * client-registered fd/callback pairs. */
+    for (int i = 0; i < num_events; i++) {
+      dispatch_event(&server_instance, &events[i]);
     }
 
     cleanup_select_fds(&server_instance);
@@ -681,7 +827,7 @@ int cras_server_run(unsigned int profile_disable_mask) {
 
 bail:
   cleanup_server_sockets();
-  free(pollfds);
+  cras_alsa_probe_deinit();
   cras_observer_server_free();
   return rc;
 }
@@ -6,6 +6,7 @@
 #include "cras/src/server/cras_stream_apm.h"
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <string.h>
 #include <syslog.h>
 #include <webrtc-apm/webrtc_apm.h>
@@ -131,6 +132,12 @@ struct active_apm {
   struct active_apm *prev, *next;
 }* active_apms;
 
+/* Protects |active_apms| and |cached_vad_target|. The input devices an APM
+ * processes and the echo ref feeding its reverse side may run on different
+ * audio threads.
+ */
+static pthread_mutex_t active_apms_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 // Commands sent to be handled in main thread.
 enum CRAS_STREAM_APM_MSG_TYPE {
   APM_DISALLOW_AEC_ON_DSP,
@@ -173,8 +180,14 @@ struct apm_message {
   void* data1;
 };
 
-// Socket pair to send message from main thread to audio thread.
-static int to_thread_fds[2] = {-1, -1};
+// Pipe to send message from main thread to an audio thread.
+struct apm_thread_pipe {
+  struct audio_thread* thread;
+  int fds[2];
+};
+
+// One pipe for each audio thread. Owned by main thread.
+static struct apm_thread_pipe thread_pipes[CRAS_MAX_AUDIO_THREADS];
 
 static const char* aec_config_dir = NULL;
 static char ini_name[MAX_INI_NAME_LENGTH + 1];
@@ -227,6 +240,15 @@ static bool stream_apm_should_enable_vad(struct cras_stream_apm* stream_apm) {
   return cached_vad_target == stream_apm;
 }
 
+/*
+ * Returns true if |idev| runs on the calling audio thread. Only that thread
+ * changes the DSP effects of |idev| and the APMs processing its data.
+ */
+static bool runs_on_this_thread(const struct cras_iodev* idev) {
+  return !idev->audio_thread ||
+         idev->audio_thread == audio_thread_get_current();
+}
+
 /*
  * Analyzes the active APMs on the idev and returns whether any of them
  * cause a conflict to enabling DSP |effect| on |idev|.
@@ -373,7 +395,8 @@ static void send_disallow_aec_on_dsp_msg_from_info(uint32_t info) {
 /*
  * Iterates all active apms and applies the restrictions to determine
  * whether or not to activate effects on DSP for each associated
- * input devices. Called in audio thread.
+ * input devices running on the calling thread. Called in audio thread
+ * with |active_apms_mutex| held.
  */
 static void update_supported_dsp_effects_activation() {
   /*
@@ -401,6 +424,10 @@ static void update_supported_dsp_effects_activation() {
     apm = active->apm;
     struct cras_iodev* const idev = apm->idev;
 
+    if (!runs_on_this_thread(idev)) {
+      continue;
+    }
+
     // Try to activate effects on DSP.
     bool aec_on_dsp = false;
     bool ns_on_dsp = false;
@@ -455,10 +482,15 @@ static void update_supported_dsp_effects_activation() {
   }
 }
 
-// Reconfigure APMs to update their VAD enabled status.
+/* Reconfigure APMs running on the calling thread to update their VAD enabled
+ * status. Called with |active_apms_mutex| held.
+ */
 static void reconfigure_apm_vad() {
   struct active_apm* active;
   LL_FOREACH (active_apms, active) {
+    if (!runs_on_this_thread(active->apm->idev)) {
+      continue;
+    }
     webrtc_apm_enable_vad(active->apm->apm_ptr,
                           stream_apm_should_enable_vad(active->stream));
   }
@@ -522,7 +554,11 @@ static struct active_apm* get_active_apm(struct cras_stream_apm* stream,
 
 struct cras_apm* cras_stream_apm_get_active(struct cras_stream_apm* stream,
                                             const struct cras_iodev* idev) {
-  struct active_apm* active = get_active_apm(stream, idev);
+  struct active_apm* active;
+
+  pthread_mutex_lock(&active_apms_mutex);
+  active = get_active_apm(stream, idev);
+  pthread_mutex_unlock(&active_apms_mutex);
   return active ? active->apm : NULL;
 }
 
@@ -727,18 +763,14 @@ struct cras_apm* cras_stream_apm_add(struct cras_stream_apm* stream,
   return apm;
 }
 
-void cras_stream_apm_start(struct cras_stream_apm* stream,
-                           const struct cras_iodev* idev) {
+// Starts the APM of |stream| on |idev|. Called with |active_apms_mutex| held.
+static void start_apm(struct cras_stream_apm* stream,
+                      const struct cras_iodev* idev) {
   struct active_apm* active;
   struct cras_apm* apm;
 
-  if (stream == NULL) {
-    return;
-  }
-
   // Check if this apm has already been started.
-  apm = cras_stream_apm_get_active(stream, idev);
-  if (apm) {
+  if (get_active_apm(stream, idev)) {
     return;
   }
 
@@ -761,14 +793,21 @@ void cras_stream_apm_start(struct cras_stream_apm* stream,
   reconfigure_apm_vad();
 }
 
-void cras_stream_apm_stop(struct cras_stream_apm* stream,
-                          struct cras_iodev* idev) {
-  struct active_apm* active;
-
+void cras_stream_apm_start(struct cras_stream_apm* stream,
+                           const struct cras_iodev* idev) {
   if (stream == NULL) {
     return;
   }
 
+  pthread_mutex_lock(&active_apms_mutex);
+  start_apm(stream, idev);
+  pthread_mutex_unlock(&active_apms_mutex);
+}
+
+// Stops the APM of |stream| on |idev|. Called with |active_apms_mutex| held.
+static void stop_apm(struct cras_stream_apm* stream, struct cras_iodev* idev) {
+  struct active_apm* active;
+
   active = get_active_apm(stream, idev);
   if (active) {
     DL_DELETE(active_apms, active);
@@ -806,6 +845,17 @@ void cras_stream_apm_stop(struct cras_stream_apm* stream,
   }
 }
 
+void cras_stream_apm_stop(struct cras_stream_apm* stream,
+                          struct cras_iodev* idev) {
+  if (stream == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&active_apms_mutex);
+  stop_apm(stream, idev);
+  pthread_mutex_unlock(&active_apms_mutex);
+}
+
 int cras_stream_apm_destroy(struct cras_stream_apm* stream) {
   struct cras_apm* apm;
 
@@ -826,13 +876,14 @@ static int process_reverse(struct float_buffer* fbuf,
                            unsigned int frame_rate,
                            const struct cras_iodev* echo_ref) {
   struct active_apm* active;
-  int ret;
+  int ret = 0;
   float* const* rp;
   unsigned int unused;
 
   // Caller side ensures fbuf is full and hasn't been read at all.
   rp = float_buffer_read_pointer(fbuf, 0, &unused);
 
+  pthread_mutex_lock(&active_apms_mutex);
   DL_FOREACH (active_apms, active) {
     if (!(active->stream->effects & APM_ECHO_CANCELLATION)) {
       continue;
@@ -878,17 +929,18 @@ static int process_reverse(struct float_buffer* fbuf,
         active->apm->apm_ptr, num_unique_channels, frame_rate, rp);
     if (ret) {
       syslog(LOG_ERR, "APM process reverse err");
-      return ret;
+      break;
     }
   }
-  return 0;
+  pthread_mutex_unlock(&active_apms_mutex);
+  return ret;
 }
 
 /*
  * When APM reverse module has state changes, this callback function is called
  * to ask stream APMs if there's need to process data on the reverse side.
  * This is expected to be called from cras_apm_reverse_state_update() in
- * audio thread so it's safe to access |active_apms|.
+ * audio thread with |active_apms_mutex| held.
  * Args:
  *     default_reverse - True means |echo_ref| is the default reverse module
  *         provided by the system default audio output device.
@@ -958,11 +1010,24 @@ static void get_apm_ini(const char* config_dir) {
   }
 }
 
+// Sends the message to every audio thread.
 static int send_apm_message_explicit(enum APM_THREAD_CMD cmd, void* data1) {
   struct apm_message msg;
+  unsigned int i;
+  int rc;
+
   msg.cmd = cmd;
   msg.data1 = data1;
-  return write(to_thread_fds[1], &msg, sizeof(msg));
+  for (i = 0; i < CRAS_MAX_AUDIO_THREADS; i++) {
+    if (!thread_pipes[i].thread) {
+      continue;
+    }
+    rc = write(thread_pipes[i].fds[1], &msg, sizeof(msg));
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  return 0;
 }
 
 static int send_apm_message(enum APM_THREAD_CMD cmd) {
@@ -987,8 +1052,11 @@ static void on_output_devices_changed() {
   cras_iodev_list_reconnect_streams_with_apm();
 }
 
-// Receives commands and handles them in audio thread.
+/* Receives commands and handles them in audio thread. Every audio thread
+ * gets the commands and updates the APMs of its input devices.
+ */
 static int apm_thread_callback(void* arg, int revents) {
+  struct apm_thread_pipe* thread_pipe = (struct apm_thread_pipe*)arg;
   struct apm_message msg;
   int rc;
 
@@ -998,11 +1066,12 @@ static int apm_thread_callback(void* arg, int revents) {
   }
 
   if (revents & POLLIN) {
-    rc = read(to_thread_fds[0], &msg, sizeof(msg));
+    rc = read(thread_pipe->fds[0], &msg, sizeof(msg));
     if (rc <= 0) {
       syslog(LOG_ERR, "Read APM message error");
       goto read_write_err;
     }
+    pthread_mutex_lock(&active_apms_mutex);
     switch (msg.cmd) {
       case APM_REVERSE_DEV_CHANGED:
       case APM_SET_AEC_REF:
@@ -1015,21 +1084,24 @@ static int apm_thread_callback(void* arg, int revents) {
       default:
         break;
     }
+    pthread_mutex_unlock(&active_apms_mutex);
   }
 
   return 0;
 
 read_write_err:
-  audio_thread_rm_callback(to_thread_fds[0]);
+  audio_thread_rm_callback(thread_pipe->fds[0]);
   return 0;
 }
 
 static void possibly_track_voice_activity(struct cras_apm* apm) {
+  struct active_apm* active;
+
+  pthread_mutex_lock(&active_apms_mutex);
   if (!cached_vad_target) {
-    return;
+    goto unlock;
   }
 
-  struct active_apm* active;
   DL_FOREACH (active_apms, active) {
     // Match only the first apm. We don't care mutiple inputs.
     if (active->stream->apms != apm) {
@@ -1046,28 +1118,20 @@ static void possibly_track_voice_activity(struct cras_apm* apm) {
       syslog(LOG_ERR, "failed to send speak on mute message: %s",
              cras_strerror(-rc));
     }
-    return;
+    break;
   }
+unlock:
+  pthread_mutex_unlock(&active_apms_mutex);
 }
 
 int cras_stream_apm_init(const char* device_config_dir) {
   static const char* cras_apm_metrics_prefix = "Cras.";
-  int rc;
 
   aec_config_dir = device_config_dir;
   get_aec_ini(aec_config_dir);
   get_apm_ini(aec_config_dir);
   webrtc_apm_init_metrics(cras_apm_metrics_prefix);
 
-  rc = pipe(to_thread_fds);
-  if (rc < 0) {
-    syslog(LOG_ERR, "Failed to pipe");
-    return rc;
-  }
-
-  audio_thread_add_events_callback(to_thread_fds[0], apm_thread_callback, NULL,
-                                   POLLIN | POLLERR | POLLHUP);
-
   return cras_apm_reverse_init(process_reverse, process_reverse_needed,
                                on_output_devices_changed);
 }
@@ -1085,16 +1149,61 @@ void cras_stream_apm_reload_aec_config() {
 }
 
 int cras_stream_apm_deinit() {
+  unsigned int i;
+
   cras_apm_reverse_deinit();
-  audio_thread_rm_callback_sync(cras_iodev_list_get_audio_thread(),
-                                to_thread_fds[0]);
-  if (to_thread_fds[0] != -1) {
-    close(to_thread_fds[0]);
-    close(to_thread_fds[1]);
+  for (i = 0; i < CRAS_MAX_AUDIO_THREADS; i++) {
+    if (thread_pipes[i].thread) {
+      cras_stream_apm_rm_audio_thread(thread_pipes[i].thread);
+    }
   }
   return 0;
 }
 
+int cras_stream_apm_add_audio_thread(struct audio_thread* thread) {
+  struct apm_thread_pipe* thread_pipe = NULL;
+  struct audio_thread* prev;
+  unsigned int i;
+  int rc;
+
+  for (i = 0; i < CRAS_MAX_AUDIO_THREADS; i++) {
+    if (!thread_pipes[i].thread) {
+      thread_pipe = &thread_pipes[i];
+      break;
+    }
+  }
+  if (!thread_pipe) {
+    return -ENOSPC;
+  }
+
+  rc = pipe(thread_pipe->fds);
+  if (rc < 0) {
+    syslog(LOG_ERR, "Failed to pipe");
+    return rc;
+  }
+  thread_pipe->thread = thread;
+
+  prev = audio_thread_set_current(thread);
+  audio_thread_add_events_callback(thread_pipe->fds[0], apm_thread_callback,
+                                   thread_pipe, POLLIN | POLLERR | POLLHUP);
+  audio_thread_set_current(prev);
+  return 0;
+}
+
+void cras_stream_apm_rm_audio_thread(struct audio_thread* thread) {
+  unsigned int i;
+
+  for (i = 0; i < CRAS_MAX_AUDIO_THREADS; i++) {
+    if (thread_pipes[i].thread != thread) {
+      continue;
+    }
+    audio_thread_rm_callback_sync(thread, thread_pipes[i].fds[0]);
+    close(thread_pipes[i].fds[0]);
+    close(thread_pipes[i].fds[1]);
+    thread_pipes[i].thread = NULL;
+  }
+}
+
 // Clamp the value between -1 and +1.
 static inline float clamp1(float value) {
   return value < -1 ? -1 : (value > 1 ? 1 : value);
@@ -1232,7 +1341,11 @@ struct cras_audio_format* cras_stream_apm_get_format(struct cras_apm* apm) {
 
 bool cras_stream_apm_get_use_tuned_settings(struct cras_stream_apm* stream,
                                             const struct cras_iodev* idev) {
-  struct active_apm* active = get_active_apm(stream, idev);
+  struct active_apm* active;
+
+  pthread_mutex_lock(&active_apms_mutex);
+  active = get_active_apm(stream, idev);
+  pthread_mutex_unlock(&active_apms_mutex);
   if (active == NULL) {
     return false;
   }
@@ -11,6 +11,7 @@
 struct cras_audio_area;
 struct cras_audio_format;
 struct cras_apm;
+struct audio_thread;
 struct cras_stream_apm;
 struct cras_iodev;
 struct float_buffer;
@@ -27,6 +28,15 @@ void cras_stream_apm_reload_aec_config();
 // Deinitialize stream apm to free all allocated resources.
 int cras_stream_apm_deinit();
 
+/*
+ * Lets |thread| handle the APM commands from main thread for the input
+ * devices it runs. Called in main thread for every audio thread.
+ */
+int cras_stream_apm_add_audio_thread(struct audio_thread* thread);
+
+// Stops sending APM commands to |thread|. Called in main thread.
+void cras_stream_apm_rm_audio_thread(struct audio_thread* thread);
+
 /*
  * Creates an stream apm to hold all APM instances created when a stream
  * attaches to iodev(s). This should be called in main thread.
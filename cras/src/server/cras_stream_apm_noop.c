@@ -21,6 +21,10 @@ void cras_stream_apm_reload_aec_config() {}
 int cras_stream_apm_deinit() {
   return 0;
 }
+int cras_stream_apm_add_audio_thread(struct audio_thread* thread) {
+  return 0;
+}
+void cras_stream_apm_rm_audio_thread(struct audio_thread* thread) {}
 struct cras_stream_apm* cras_stream_apm_create(uint64_t effects) {
   return NULL;
 }
@@ -19,6 +19,7 @@
 #include "cras/src/server/config/cras_device_blocklist.h"
 #include "cras/src/server/cras_alert.h"
 #include "cras/src/server/cras_alsa_card.h"
+#include "cras/src/server/cras_alsa_probe.h"
 #include "cras/src/server/cras_iodev_list.h"
 #include "cras/src/server/cras_main_thread_log.h"
 #include "cras/src/server/cras_observer.h"
@@ -73,6 +74,9 @@ struct feature_state {
  *    feature_state - The feature state. See struct feature_state.
  *    speak_on_mute_detection_enabled - Whether speak on mute detection is
  * enabled.
+ *    num_audio_threads - Number of audio threads devices are spread across.
+ *    dsp_crossfade_frames - Frames to crossfade over when a DSP pipeline is
+ *      reloaded.
  */
 static struct {
   struct cras_server_state* exp_state;
@@ -105,6 +109,8 @@ static struct {
   struct cras_feature_tier feature_tier;
   struct feature_state feature_state;
   bool speak_on_mute_detection_enabled;
+  int num_audio_threads;
+  int dsp_crossfade_frames;
 } state;
 
 // The string format is CARD1,CARD2,CARD3. Divide it into a list.
@@ -202,6 +208,8 @@ void cras_system_state_init(const char* device_config_dir,
   exp_state->max_headphone_channels = board_config.max_headphone_channels;
   exp_state->num_non_chrome_output_streams = 0;
   exp_state->nc_standalone_mode = board_config.nc_standalone_mode;
+  state.num_audio_threads = board_config.num_audio_threads;
+  state.dsp_crossfade_frames = board_config.dsp_crossfade_frames;
 
   if ((rc = pthread_mutex_init(&state.update_lock, 0) != 0)) {
     syslog(LOG_ERR, "Fatal: system state mutex init");
@@ -537,21 +545,36 @@ int cras_system_get_max_headphone_channels() {
   return state.exp_state->max_headphone_channels;
 }
 
-int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info) {
+int cras_system_get_num_audio_threads() {
+  return state.num_audio_threads;
+}
+
+int cras_system_get_dsp_crossfade_frames() {
+  return state.dsp_crossfade_frames;
+}
+
+static int append_alsa_card(struct cras_alsa_card* alsa_card) {
   struct card_list* card;
+
+  card = calloc(1, sizeof(*card));
+  if (card == NULL) {
+    cras_alsa_card_destroy(alsa_card);
+    return -ENOMEM;
+  }
+  card->card = alsa_card;
+  DL_APPEND(state.cards, card);
+  return 0;
+}
+
+int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info) {
   struct cras_alsa_card* alsa_card;
-  unsigned card_index;
 
   if (alsa_card_info == NULL) {
     return -EINVAL;
   }
 
-  card_index = alsa_card_info->card_index;
-
-  DL_FOREACH (state.cards, card) {
-    if (card_index == cras_alsa_card_get_index(card->card)) {
-      return -EEXIST;
-    }
+  if (cras_system_alsa_card_exists(alsa_card_info->card_index)) {
+    return -EEXIST;
   }
   alsa_card =
       cras_alsa_card_create(alsa_card_info, state.device_config_dir,
@@ -559,13 +582,41 @@ int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info) {
   if (alsa_card == NULL) {
     return -ENOMEM;
   }
-  card = calloc(1, sizeof(*card));
-  if (card == NULL) {
-    return -ENOMEM;
+  return append_alsa_card(alsa_card);
+}
+
+// Merges a card probed by a worker into the system.
+static void alsa_card_probed(struct cras_alsa_card* alsa_card,
+                             struct cras_alsa_card_info* info,
+                             void* arg) {
+  int rc;
+
+  if (alsa_card == NULL) {
+    syslog(LOG_ERR, "Failed to probe card %u", info->card_index);
+    return;
   }
-  card->card = alsa_card;
-  DL_APPEND(state.cards, card);
-  return 0;
+  rc = cras_alsa_card_complete(alsa_card, info, state.device_blocklist);
+  if (rc < 0) {
+    syslog(LOG_ERR, "Failed to add devices of card %u: %d", info->card_index,
+           rc);
+    cras_alsa_card_destroy(alsa_card);
+    return;
+  }
+  append_alsa_card(alsa_card);
+}
+
+int cras_system_probe_alsa_card(struct cras_alsa_card_info* alsa_card_info,
+                                unsigned int delay_us) {
+  if (alsa_card_info == NULL) {
+    return -EINVAL;
+  }
+
+  if (cras_system_alsa_card_exists(alsa_card_info->card_index)) {
+    return -EEXIST;
+  }
+  return cras_alsa_probe_card(alsa_card_info, state.device_config_dir,
+                              state.internal_ucm_suffix, delay_us,
+                              alsa_card_probed, NULL);
 }
 
 int cras_system_remove_alsa_card(size_t alsa_card_index) {
@@ -577,7 +628,7 @@ int cras_system_remove_alsa_card(size_t alsa_card_index) {
     }
   }
   if (card == NULL) {
-    return -EINVAL;
+    return cras_alsa_probe_cancel(alsa_card_index) == 0 ? 0 : -EINVAL;
   }
   DL_DELETE(state.cards, card);
   cras_alsa_card_destroy(card->card);
@@ -593,7 +644,7 @@ int cras_system_alsa_card_exists(unsigned alsa_card_index) {
       return 1;
     }
   }
-  return 0;
+  return cras_alsa_probe_pending(alsa_card_index);
 }
 
 int cras_system_set_select_handler(int (*add)(int fd,
@@ -205,6 +205,12 @@ int cras_system_get_max_internal_speaker_channels();
 // Returns the maximum headphone channels.
 int cras_system_get_max_headphone_channels();
 
+// Returns the number of audio threads devices are spread across.
+int cras_system_get_num_audio_threads();
+
+// Returns the frames to crossfade over when a DSP pipeline is reloaded.
+int cras_system_get_dsp_crossfade_frames();
+
 /* Adds a card at the given index to the system.  When a new card is found
  * (through a udev event notification) this will add the card to the system,
  * causing its devices to become available for playback/capture.
@@ -216,8 +222,22 @@ int cras_system_get_max_headphone_channels();
  */
 int cras_system_add_alsa_card(struct cras_alsa_card_info* alsa_card_info);
 
+/* Like cras_system_add_alsa_card(), but probes the card on a worker thread so
+ * several cards can be probed at once. Its devices are added on the main
+ * thread once probing is done.
+ * Args:
+ *    alsa_card_info - Info about the alsa card (Index, type, etc.).
+ *    delay_us - Time to wait before probing, to let the card settle.
+ * Returns:
+ *    0 if the card is being probed, negative error on failure (Card already
+ *    exists or is being probed).
+ */
+int cras_system_probe_alsa_card(struct cras_alsa_card_info* alsa_card_info,
+                                unsigned int delay_us);
+
 /* Removes a card.  When a device is removed this will do the cleanup.  Device
- * at index must have been added using cras_system_add_alsa_card().
+ * at index must have been added using cras_system_add_alsa_card() or
+ * cras_system_probe_alsa_card(). A card still being probed is dropped.
  * Args:
  *    alsa_card_index - Index ALSA uses to refer to the card.  The X in "hw:X".
  * Returns:
@@ -230,7 +250,7 @@ int cras_system_remove_alsa_card(size_t alsa_card_index);
  * Args:
  *    alsa_card_index - Index ALSA uses to refer to the card.  The X in "hw:X".
  * Returns:
- *    1 if the card has already been added, 0 if not.
+ *    1 if the card has already been added or is being probed, 0 if not.
  */
 int cras_system_alsa_card_exists(unsigned alsa_card_index);
 
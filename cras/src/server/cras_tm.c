@@ -5,25 +5,42 @@
 
 #include "cras/src/server/cras_tm.h"
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <time.h>
 
 #include "cras_util.h"
-#include "third_party/utlist/utlist.h"
+
+// Initial number of timers the heap has room for.
+#define INITIAL_HEAP_SIZE 16
 
 // Represents an armed timer.
 struct cras_timer {
   // timespec at which the timer should fire.
   struct timespec ts;
-  // Callback to call when the timer expires.
+  // Orders timers expiring at the same time by creation.
+  uint64_t seq;
+  // Callback to call when the timer expires, NULL once cancelled.
   void (*cb)(struct cras_timer* t, void* data);
   // Data passed to the callback.
   void* cb_data;
-  struct cras_timer *next, *prev;
 };
 
-// Timer Manager, keeps a list of active timers.
+/* Timer Manager, keeps the armed timers in a binary min-heap ordered by
+ * expiration. Cancelled timers are only marked and stay in the heap until they
+ * reach the top or the heap is compacted, so cancelling is O(1) amortized. The
+ * top of the heap is never a cancelled timer.
+ */
 struct cras_tm {
-  struct cras_timer* timers;
+  struct cras_timer** heap;
+  // Number of timers in the heap, including cancelled ones.
+  size_t size;
+  // Number of timers the heap has room for.
+  size_t capacity;
+  // Number of cancelled timers still in the heap.
+  size_t num_cancelled;
+  // Sequence number of the next timer created.
+  uint64_t next_seq;
 };
 
 // Local Functions.
@@ -48,15 +65,128 @@ static inline int timespec_sooner(const struct timespec* a,
           (a->tv_sec == b->tv_sec && a->tv_nsec <= b->tv_nsec));
 }
 
+/* Rounds ts up to a multiple of the largest power of two milliseconds not
+ * larger than slack_ms. Timers created around the same time with similar slack
+ * then expire together, and none is delayed by more than its slack.
+ */
+static void align_ts(struct timespec* ts, unsigned int slack_ms) {
+  uint64_t grain = 1;
+  uint64_t ms;
+
+  while (grain * 2 <= slack_ms) {
+    grain *= 2;
+  }
+  if (grain == 1) {
+    return;
+  }
+  ms = (uint64_t)ts->tv_sec * 1000 + (ts->tv_nsec + 999999) / 1000000;
+  ms = (ms + grain - 1) / grain * grain;
+  ts->tv_sec = ms / 1000;
+  ts->tv_nsec = (ms % 1000) * 1000000;
+}
+
+// Checks if timer a should fire before timer b.
+static inline int timer_before(const struct cras_timer* a,
+                               const struct cras_timer* b) {
+  if (a->ts.tv_sec != b->ts.tv_sec || a->ts.tv_nsec != b->ts.tv_nsec) {
+    return timespec_sooner(&a->ts, &b->ts);
+  }
+  return a->seq < b->seq;
+}
+
+static void sift_up(struct cras_tm* tm, size_t i) {
+  struct cras_timer* t = tm->heap[i];
+
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!timer_before(t, tm->heap[parent])) {
+      break;
+    }
+    tm->heap[i] = tm->heap[parent];
+    i = parent;
+  }
+  tm->heap[i] = t;
+}
+
+static void sift_down(struct cras_tm* tm, size_t i) {
+  struct cras_timer* t = tm->heap[i];
+
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= tm->size) {
+      break;
+    }
+    if (child + 1 < tm->size &&
+        timer_before(tm->heap[child + 1], tm->heap[child])) {
+      child++;
+    }
+    if (!timer_before(tm->heap[child], t)) {
+      break;
+    }
+    tm->heap[i] = tm->heap[child];
+    i = child;
+  }
+  tm->heap[i] = t;
+}
+
+// Removes and returns the timer at the top of the heap.
+static struct cras_timer* pop_top(struct cras_tm* tm) {
+  struct cras_timer* top = tm->heap[0];
+
+  tm->size--;
+  if (tm->size) {
+    tm->heap[0] = tm->heap[tm->size];
+    sift_down(tm, 0);
+  }
+  return top;
+}
+
+// Frees cancelled timers at the top of the heap.
+static void prune_top(struct cras_tm* tm) {
+  while (tm->size && !tm->heap[0]->cb) {
+    free(pop_top(tm));
+    tm->num_cancelled--;
+  }
+}
+
+// Frees all cancelled timers and rebuilds the heap from the rest.
+static void compact(struct cras_tm* tm) {
+  size_t i, n = 0;
+
+  for (i = 0; i < tm->size; i++) {
+    if (tm->heap[i]->cb) {
+      tm->heap[n++] = tm->heap[i];
+    } else {
+      free(tm->heap[i]);
+    }
+  }
+  tm->size = n;
+  tm->num_cancelled = 0;
+  for (i = n / 2; i-- > 0;) {
+    sift_down(tm, i);
+  }
+}
+
 // Exported Interface.
 
-struct cras_timer* cras_tm_create_timer(struct cras_tm* tm,
-                                        unsigned int ms,
-                                        void (*cb)(struct cras_timer* t,
-                                                   void* data),
-                                        void* cb_data) {
+struct cras_timer* cras_tm_create_timer_with_slack(
+    struct cras_tm* tm,
+    unsigned int ms,
+    unsigned int slack_ms,
+    void (*cb)(struct cras_timer* t, void* data),
+    void* cb_data) {
   struct cras_timer* t;
 
+  if (tm->size == tm->capacity) {
+    size_t capacity = tm->capacity ? tm->capacity * 2 : INITIAL_HEAP_SIZE;
+    struct cras_timer** heap = realloc(tm->heap, capacity * sizeof(*tm->heap));
+    if (!heap) {
+      return NULL;
+    }
+    tm->heap = heap;
+    tm->capacity = capacity;
+  }
+
   t = calloc(1, sizeof(*t));
   if (!t) {
     return NULL;
@@ -64,18 +194,34 @@ struct cras_timer* cras_tm_create_timer(struct cras_tm* tm,
 
   t->cb = cb;
   t->cb_data = cb_data;
+  t->seq = tm->next_seq++;
 
   clock_gettime(CLOCK_MONOTONIC_RAW, &t->ts);
   add_ms_ts(&t->ts, ms);
+  align_ts(&t->ts, slack_ms);
 
-  DL_APPEND(tm->timers, t);
+  tm->heap[tm->size++] = t;
+  sift_up(tm, tm->size - 1);
 
   return t;
 }
 
+struct cras_timer* cras_tm_create_timer(struct cras_tm* tm,
+                                        unsigned int ms,
+                                        void (*cb)(struct cras_timer* t,
+                                                   void* data),
+                                        void* cb_data) {
+  return cras_tm_create_timer_with_slack(tm, ms, 0, cb, cb_data);
+}
+
 void cras_tm_cancel_timer(struct cras_tm* tm, struct cras_timer* t) {
-  DL_DELETE(tm->timers, t);
-  free(t);
+  t->cb = NULL;
+  tm->num_cancelled++;
+  if (tm->num_cancelled * 2 > tm->size) {
+    compact(tm);
+  } else {
+    prune_top(tm);
+  }
 }
 
 struct cras_tm* cras_tm_init() {
@@ -83,30 +229,24 @@ struct cras_tm* cras_tm_init() {
 }
 
 void cras_tm_deinit(struct cras_tm* tm) {
-  struct cras_timer* t;
+  size_t i;
 
-  DL_FOREACH (tm->timers, t) {
-    DL_DELETE(tm->timers, t);
-    free(t);
+  for (i = 0; i < tm->size; i++) {
+    free(tm->heap[i]);
   }
+  free(tm->heap);
   free(tm);
 }
 
 int cras_tm_get_next_timeout(const struct cras_tm* tm, struct timespec* ts) {
-  struct cras_timer* t;
   struct timespec now;
-  struct timespec* min;
+  const struct timespec* min;
 
-  if (!tm->timers) {
+  if (!tm->size) {
     return 0;
   }
 
-  min = &tm->timers->ts;
-  DL_FOREACH (tm->timers, t) {
-    if (timespec_sooner(&t->ts, min)) {
-      min = &t->ts;
-    }
-  }
+  min = &tm->heap[0]->ts;
 
   clock_gettime(CLOCK_MONOTONIC_RAW, &now);
 
@@ -122,24 +262,17 @@ int cras_tm_get_next_timeout(const struct cras_tm* tm, struct timespec* ts) {
 
 void cras_tm_call_callbacks(struct cras_tm* tm) {
   struct timespec now;
-  struct cras_timer *t, *next;
+  struct cras_timer* t;
 
   clock_gettime(CLOCK_MONOTONIC_RAW, &now);
 
-  /* Don't use DL_FOREACH to iterate timers because in each loop the
-   * next timer pointer is stored for later access but it could be
-   * cancelled and freed in current timer's callback causing invalid
-   * memory access. */
-  t = tm->timers;
-  while (t) {
-    next = t->next;
-    if (timespec_sooner(&t->ts, &now)) {
-      t->cb(t, t->cb_data);
-      /* Update next timer because it could have been modified
-       * in t->cb(). */
-      next = t->next;
-      cras_tm_cancel_timer(tm, t);
-    }
-    t = next;
+  /* The timer is taken off the heap before its callback runs, so the
+   * callback is free to create and cancel other timers. Timers it creates
+   * that are already due are run in this pass too. */
+  while (tm->size && timespec_sooner(&tm->heap[0]->ts, &now)) {
+    t = pop_top(tm);
+    t->cb(t, t->cb_data);
+    free(t);
+    prune_top(tm);
   }
 }
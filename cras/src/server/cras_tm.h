@@ -32,7 +32,29 @@ struct cras_timer* cras_tm_create_timer(struct cras_tm* tm,
                                                    void* data),
                                         void* cb_data);
 
-// Deletes a timer returned from cras_tm_create_timer.
+/* Creates a timer that may fire up to slack_ms milliseconds late. Expiration
+ * times are rounded up so that timers with slack tend to fire together, which
+ * lets the main thread wake less often. Use for timers that don't need to be
+ * precise, such as retries and idle checks.
+ * Args:
+ *    tm - Timer manager.
+ *    ms - Call 'cb' in at least ms milliseconds.
+ *    slack_ms - Call 'cb' at most this many milliseconds after 'ms'.
+ *    cb - The callback to call at timeout.
+ *    cb_data - Passed to the callback when it is run.
+ * Returns:
+ *    Pointer to a newly allocated timer, passed timer to cras_tm_cancel_timer
+ *    to cancel before it fires.
+ */
+struct cras_timer* cras_tm_create_timer_with_slack(
+    struct cras_tm* tm,
+    unsigned int ms,
+    unsigned int slack_ms,
+    void (*cb)(struct cras_timer* t, void* data),
+    void* cb_data);
+
+/* Deletes a timer returned from cras_tm_create_timer or
+ * cras_tm_create_timer_with_slack. */
 void cras_tm_cancel_timer(struct cras_tm* tm, struct cras_timer* t);
 
 // Interface for system to create the timer manager.
@@ -173,18 +173,16 @@ static void set_factory_default(unsigned card_number) {
   }
 }
 
-static inline void udev_delay_for_alsa() {
-  /* Provide a small delay so that the udev message can
-   * propogate throughout the whole system, and Alsa can set up
-   * the new device.  Without a small delay, an error of the
-   * form:
-   *
-   *    Fail opening control hw:?
-   *
-   * will be produced by cras_alsa_card_create().
-   */
-  usleep(125000);  // 0.125 second
-}
+/* Provide a small delay so that the udev message can
+ * propogate throughout the whole system, and Alsa can set up
+ * the new device.  Without a small delay, an error of the
+ * form:
+ *
+ *    Fail opening control hw:?
+ *
+ * will be produced by cras_alsa_card_probe().
+ */
+#define ALSA_SETTLE_DELAY_US 125000  // 0.125 second
 
 /* Reads the "descriptors" file of the usb device and returns the
  * checksum of the contents. Returns 0 if the file can not be read */
@@ -293,18 +291,19 @@ static void device_add_alsa(struct udev_device* dev,
   struct cras_alsa_card_info card_info;
   memset(&card_info, 0, sizeof(card_info));
 
-  udev_delay_for_alsa();
   card_info.card_index = card;
   card_info.card_type = card_type;
   if (card_type == ALSA_CARD_TYPE_USB) {
     fill_usb_card_info(&card_info, dev);
   }
 
-  cras_system_add_alsa_card(&card_info);
+  // The delay runs on the probe worker, not to hold up other cards.
+  cras_system_probe_alsa_card(&card_info, ALSA_SETTLE_DELAY_US);
 }
 
+/* Nothing is opened on removal, so there is no settle delay to wait for. A
+ * card still being probed has its probe canceled. */
 void device_remove_alsa(const char* sysname, unsigned card) {
-  udev_delay_for_alsa();
   cras_system_remove_alsa_card(card);
 }
 
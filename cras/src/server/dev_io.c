@@ -7,8 +7,10 @@
 
 #include <poll.h>
 #include <stdbool.h>
+#include <string.h>
 #include <syslog.h>
 
+#include "cras/src/server/audio_thread.h"
 #include "cras/src/server/audio_thread_log.h"
 #include "cras/src/server/cras_audio_area.h"
 #include "cras/src/server/cras_audio_thread_monitor.h"
@@ -618,6 +620,12 @@ static int capture_to_streams(struct open_dev* adev,
                                 idev->buf_state, this_read);
     }
 
+    /* Streams of the same sample format and rate convert the area once, see
+     * dev_stream_capture(). Drop what was converted for this pass. */
+    DL_FOREACH (adev->dev->streams, stream) {
+      dev_stream_capture_finish(stream);
+    }
+
     rc = cras_iodev_put_input_buffer(idev);
     if (rc < 0) {
       return rc;
@@ -642,7 +650,8 @@ static int capture_to_streams(struct open_dev* adev,
  *    odevs - The list of open output devices, provided so streams can be
  *            removed from all devices on error.
  *    adev - The device to write to.
- *    dst - The buffer to put the samples in (returned from snd_pcm_mmap_begin)
+ *    dst - The buffer to put the samples in (returned from snd_pcm_mmap_begin),
+ *          or the float mix bus of the device if it has one.
  *    write_limit - The maximum number of frames to write to dst.
  *
  * Returns:
@@ -659,6 +668,11 @@ static unsigned int write_streams(struct open_dev** odevs,
   unsigned int max_offset = 0;
   unsigned int frame_bytes = cras_get_format_bytes(odev->format);
   unsigned int num_playing = 0;
+  bool passthrough;
+
+  if (odev->mix_bus) {
+    frame_bytes = odev->format->num_channels * sizeof(float);
+  }
   unsigned int drain_limit = write_limit;
 
   // Mix as much as we can, the minimum fill level of any stream.
@@ -701,7 +715,13 @@ static unsigned int write_streams(struct open_dev** odevs,
     write_limit = drain_limit;
   }
 
-  if (write_limit > max_offset) {
+  /* The only stream running in the format of the device is copied to dst,
+   * there's nothing to mix it with. */
+  curr = adev->dev->streams;
+  passthrough = !odev->mix_bus && curr && !curr->next &&
+                dev_stream_is_running(curr) && dev_stream_is_passthrough(curr);
+
+  if (write_limit > max_offset && !passthrough) {
     memset(dst + max_offset * frame_bytes, 0,
            (write_limit - max_offset) * frame_bytes);
   }
@@ -720,8 +740,19 @@ static unsigned int write_streams(struct open_dev** odevs,
     if (offset >= write_limit) {
       continue;
     }
-    nwritten = dev_stream_mix(curr, odev->format, dst + frame_bytes * offset,
-                              write_limit - offset);
+    if (passthrough) {
+      nwritten = dev_stream_copy(curr, odev->format, dst + frame_bytes * offset,
+                                 write_limit - offset);
+      ATLOG(atlog, AUDIO_THREAD_WRITE_STREAMS_PASSTHROUGH,
+            curr->stream->stream_id, offset, nwritten);
+    } else if (odev->mix_bus) {
+      nwritten = dev_stream_mix_float(curr, odev->format,
+                                      (float*)(dst + frame_bytes * offset),
+                                      write_limit - offset);
+    } else {
+      nwritten = dev_stream_mix(curr, odev->format, dst + frame_bytes * offset,
+                                write_limit - offset);
+    }
 
     if (nwritten < 0) {
       dev_io_remove_stream(odevs, curr->stream, NULL);
@@ -844,7 +875,9 @@ int write_output_samples(struct open_dev** odevs,
 
     // TODO(dgreid) - This assumes interleaved audio.
     dst = area->channels[0].buf;
-    written = write_streams(odevs, adev, dst, frames);
+    written = write_streams(odevs, adev,
+                            odev->mix_bus ? (uint8_t*)odev->mix_bus : dst,
+                            frames);
     if (written < (snd_pcm_sframes_t)frames) {
       /* Got all the samples from client that we can, but it
        * won't fill the request. */
@@ -866,8 +899,13 @@ int write_output_samples(struct open_dev** odevs,
       pic_interval_reset(adev->non_empty_check_pi);
     }
 
-    rc = cras_iodev_put_output_buffer(odev, dst, written, non_empty_ptr,
-                                      output_converter);
+    if (odev->mix_bus) {
+      rc = cras_iodev_put_output_mix_bus(odev, dst, written, non_empty_ptr,
+                                         output_converter);
+    } else {
+      rc = cras_iodev_put_output_buffer(odev, dst, written, non_empty_ptr,
+                                        output_converter);
+    }
 
     if (rc < 0) {
       return rc;
@@ -1353,8 +1391,13 @@ void dev_io_rm_open_dev(struct open_dev** odev_list,
   ATLOG(atlog, AUDIO_THREAD_DEV_REMOVED, dev_to_rm->dev->info.idx, 0, 0);
 
   DL_FOREACH (dev_to_rm->dev->streams, dev_stream) {
-    cras_iodev_rm_stream(dev_to_rm->dev, dev_stream->stream);
+    struct cras_rstream* stream = dev_stream->stream;
+
+    cras_iodev_rm_stream(dev_to_rm->dev, stream);
     dev_stream_destroy(dev_stream);
+    if (!stream->num_attached_devs) {
+      audio_thread_unwatch_stream(stream);
+    }
   }
 
   if (dev_to_rm->empty_pi) {
@@ -1373,6 +1416,9 @@ static void delete_stream_from_dev(struct cras_iodev* dev,
   out = cras_iodev_rm_stream(dev, stream);
   if (out) {
     dev_stream_destroy(out);
+    if (!stream->num_attached_devs) {
+      audio_thread_unwatch_stream(stream);
+    }
   }
 }
 
@@ -1420,6 +1466,40 @@ static bool find_matched_input_stream_next_cb_ts(
   return false;
 }
 
+/*
+ * Returns true if the devices play samples in the same format, so the
+ * conversion of a stream attached to both can be shared.
+ */
+static bool same_dev_format(const struct cras_iodev* a,
+                            const struct cras_iodev* b) {
+  return a->format && b->format && a->format->format == b->format->format &&
+         a->format->frame_rate == b->format->frame_rate &&
+         a->format->num_channels == b->format->num_channels &&
+         !memcmp(a->format->channel_layout, b->format->channel_layout,
+                 sizeof(a->format->channel_layout));
+}
+
+/*
+ * Lets a new output dev_stream share the conversion of the stream on another
+ * open device of the same format.
+ */
+static void share_playback_conv(struct open_dev* odevs,
+                                struct cras_iodev* dev,
+                                struct dev_stream* dev_stream) {
+  struct open_dev* open_dev;
+  struct dev_stream* other;
+
+  DL_FOREACH (odevs, open_dev) {
+    if (open_dev->dev == dev || !same_dev_format(open_dev->dev, dev)) {
+      continue;
+    }
+    DL_SEARCH_SCALAR(open_dev->dev->streams, other, stream, dev_stream->stream);
+    if (other && !dev_stream_share_playback_conv(dev_stream, other)) {
+      return;
+    }
+  }
+}
+
 int dev_io_append_stream(struct open_dev** odevs,
                          struct open_dev** idevs,
                          struct cras_rstream* stream,
@@ -1553,6 +1633,9 @@ int dev_io_append_stream(struct open_dev** odevs,
     }
 
     cras_iodev_add_stream(dev, out);
+    if (stream->direction == CRAS_STREAM_OUTPUT) {
+      share_playback_conv(*dev_list, dev, out);
+    }
 
     /*
      * For multiple inputs case, if the new stream is not the first
@@ -1589,6 +1672,9 @@ int dev_io_append_stream(struct open_dev** odevs,
       cras_iodev_rm_stream(dev, stream);
       dev_stream_destroy(out);
     }
+    if (!stream->num_attached_devs) {
+      audio_thread_unwatch_stream(stream);
+    }
   }
 
   return rc;
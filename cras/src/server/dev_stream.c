@@ -5,6 +5,9 @@
 
 #include "cras/src/server/dev_stream.h"
 
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
 #include <syslog.h>
 
 #include "cras/src/common/byte_buffer.h"
@@ -16,6 +19,7 @@
 #include "cras/src/server/cras_rtc.h"
 #include "cras/src/server/cras_server_metrics.h"
 #include "cras_shm.h"
+#include "third_party/utlist/utlist.h"
 
 /* Adjust device's sample rate by this step faster or slower. Used
  * to make sure multiple active device has stable buffer level.
@@ -61,6 +65,273 @@ unsigned int max_frames_for_conversion(unsigned int stream_frames,
          + 1;
 }
 
+// Returns the size in frames of the conv_buffer of a dev_stream.
+static unsigned int conv_buffer_frames(struct cras_fmt_conv* conv,
+                                       const struct cras_rstream* stream) {
+  unsigned int dev_frames =
+      (stream->direction == CRAS_STREAM_OUTPUT)
+          ? cras_fmt_conv_in_frames_to_out(conv, stream->buffer_frames)
+          : cras_fmt_conv_out_frames_to_in(conv, stream->buffer_frames);
+
+  return 2 * MAX(dev_frames, stream->buffer_frames);
+}
+
+/*
+ * A format converter shared by the input streams of a device that capture at
+ * the same sample format and rate. The channels are converted per stream when
+ * copying to shm, so this is the whole per stream conversion chain. The first
+ * stream to capture in a pass converts the samples into buf, the others copy
+ * them from there into their own conv_buffer, so offsets and overruns are
+ * still accounted per stream.
+ */
+struct capture_conv_share {
+  // The converter, also set as conv of every stream sharing it.
+  struct cras_fmt_conv* conv;
+  // The frames conv was created to convert at once.
+  unsigned int max_frames;
+  // Number of dev_streams sharing conv.
+  unsigned int num_users;
+  // Samples converted in the current pass.
+  uint8_t* buf;
+  // Size of buf in frames.
+  unsigned int buf_frames;
+  // The input converted in the current pass, NULL if there's none yet.
+  const uint8_t* src;
+  // Input frames read and frames converted to buf in the current pass.
+  unsigned int src_frames;
+  unsigned int conv_frames;
+};
+
+/*
+ * Returns true if stream can capture through a converter shared with the other
+ * streams of the device. Streams with APM read their own processed area and
+ * trigger only streams skip passes, so they don't share. The linear resampler
+ * rates are only the same for streams having this device as main device.
+ */
+static bool capture_conv_sharable(const struct cras_rstream* stream,
+                                  unsigned int dev_id) {
+  return stream->direction == CRAS_STREAM_INPUT && !stream->stream_apm &&
+         !(stream->flags & TRIGGER_ONLY) &&
+         (stream->main_dev.dev_id == NO_DEVICE ||
+          stream->main_dev.dev_id == dev_id);
+}
+
+// Finds a converter share on iodev that stream can join.
+static struct capture_conv_share* find_capture_conv_share(
+    struct cras_iodev* iodev,
+    const struct cras_rstream* stream,
+    unsigned int dev_id,
+    unsigned int max_frames) {
+  struct dev_stream* other;
+  const struct cras_audio_format* fmt;
+
+  if (!capture_conv_sharable(stream, dev_id)) {
+    return NULL;
+  }
+  DL_FOREACH (iodev->streams, other) {
+    if (!other->conv_share || other->dev_id != dev_id ||
+        other->stream->main_dev.dev_id != dev_id ||
+        other->conv_share->max_frames < max_frames) {
+      continue;
+    }
+    fmt = cras_fmt_conv_out_format(other->conv);
+    if (fmt->format == stream->format.format &&
+        fmt->frame_rate == stream->format.frame_rate &&
+        other->conv_share->buf_frames >=
+            conv_buffer_frames(other->conv, stream)) {
+      return other->conv_share;
+    }
+  }
+  return NULL;
+}
+
+static struct capture_conv_share* capture_conv_share_create(
+    struct cras_fmt_conv* conv,
+    unsigned int max_frames,
+    unsigned int buf_frames) {
+  struct capture_conv_share* share;
+
+  share = calloc(1, sizeof(*share));
+  if (!share) {
+    return NULL;
+  }
+  share->buf = malloc((size_t)buf_frames *
+                      cras_get_format_bytes(cras_fmt_conv_out_format(conv)));
+  if (!share->buf) {
+    free(share);
+    return NULL;
+  }
+  share->conv = conv;
+  share->max_frames = max_frames;
+  share->buf_frames = buf_frames;
+  return share;
+}
+
+/*
+ * Drops the reference dev_stream holds on its converter share. Returns true
+ * if it was the last one and the converter is to be destroyed.
+ */
+static bool capture_conv_share_leave(struct dev_stream* dev_stream) {
+  struct capture_conv_share* share = dev_stream->conv_share;
+
+  dev_stream->conv_share = NULL;
+  if (--share->num_users) {
+    return false;
+  }
+  free(share->buf);
+  free(share);
+  return true;
+}
+
+/*
+ * Moves dev_stream from its shared converter to one of its own. Used when its
+ * input no longer follows the other streams of the share, for example after an
+ * overrun left it behind or when its main device changed.
+ */
+static int capture_conv_unshare(struct dev_stream* dev_stream) {
+  struct cras_rstream* stream = dev_stream->stream;
+  struct cras_fmt_conv* conv;
+  unsigned int max_frames;
+  int rc;
+
+  max_frames = max_frames_for_conversion(
+      stream->buffer_frames, stream->format.frame_rate, dev_stream->dev_rate);
+  rc = config_format_converter(
+      &conv, CRAS_STREAM_INPUT, cras_fmt_conv_in_format(dev_stream->conv),
+      &stream->format, dev_stream->iodev->active_node->type, max_frames);
+  if (rc) {
+    return rc;
+  }
+  capture_conv_share_leave(dev_stream);
+  dev_stream->conv = conv;
+  return 0;
+}
+
+// Chunks of shm a playback_conv_share keeps converted per period.
+#define PLAYBACK_SHARE_CHUNKS 2
+
+/*
+ * The sample format and channel conversion of an output stream shared by its
+ * dev_streams on devices of the same format. Without sample rate conversion
+ * it's done frame by frame, so the first device to mix converts the frames it
+ * reads from shm and the others mix from the converted ones. The readable
+ * region of shm can be split in two, so two chunks are kept. They are valid
+ * until the read pointer of the stream moves.
+ */
+struct playback_conv_share {
+  // Number of dev_streams sharing the conversion.
+  unsigned int num_users;
+  // Frames each chunk can hold.
+  unsigned int buf_frames;
+  // The chunk to replace next.
+  unsigned int next;
+  struct {
+    // Where in shm the converted samples are from, NULL if unused.
+    const uint8_t* src;
+    // Number of frames converted.
+    unsigned int frames;
+    // S16_LE samples in the channels of the device.
+    uint8_t* buf;
+  } chunks[PLAYBACK_SHARE_CHUNKS];
+};
+
+static void playback_conv_share_destroy(struct playback_conv_share* share) {
+  for (unsigned int i = 0; i < PLAYBACK_SHARE_CHUNKS; i++) {
+    free(share->chunks[i].buf);
+  }
+  free(share);
+}
+
+static struct playback_conv_share* playback_conv_share_create(
+    const struct dev_stream* dev_stream) {
+  const struct cras_rstream* stream = dev_stream->stream;
+  const struct cras_audio_format* fmt;
+  struct playback_conv_share* share;
+
+  share = calloc(1, sizeof(*share));
+  if (!share) {
+    return NULL;
+  }
+  fmt = cras_fmt_conv_out_format(dev_stream->conv);
+  share->buf_frames = max_frames_for_conversion(
+      stream->buffer_frames, stream->format.frame_rate, fmt->frame_rate);
+  for (unsigned int i = 0; i < PLAYBACK_SHARE_CHUNKS; i++) {
+    share->chunks[i].buf =
+        malloc((size_t)share->buf_frames * fmt->num_channels * 2);
+    if (!share->chunks[i].buf) {
+      playback_conv_share_destroy(share);
+      return NULL;
+    }
+  }
+  return share;
+}
+
+/*
+ * Returns the frames at src converted ahead of the linear resampler of conv.
+ * They are converted unless another device did already in this period.
+ */
+static const uint8_t* playback_conv_share_get(
+    struct playback_conv_share* share,
+    struct cras_fmt_conv* conv,
+    const uint8_t* src,
+    unsigned int frames) {
+  unsigned int in_bytes = cras_get_format_bytes(cras_fmt_conv_in_format(conv));
+  unsigned int out_bytes = cras_fmt_conv_out_format(conv)->num_channels * 2;
+  unsigned int i, offset;
+
+  for (i = 0; i < PLAYBACK_SHARE_CHUNKS; i++) {
+    typeof(share->chunks[0])* chunk = &share->chunks[i];
+
+    if (!chunk->src || src < chunk->src ||
+        src >= chunk->src + (size_t)chunk->frames * in_bytes ||
+        (src - chunk->src) % in_bytes) {
+      continue;
+    }
+    offset = (src - chunk->src) / in_bytes;
+    if (offset + frames > share->buf_frames) {
+      break;
+    }
+    // Devices may read a little further, convert what's missing.
+    if (offset + frames > chunk->frames) {
+      cras_fmt_conv_convert_pre_resample(
+          conv, chunk->src + (size_t)chunk->frames * in_bytes,
+          chunk->buf + (size_t)chunk->frames * out_bytes,
+          offset + frames - chunk->frames);
+      chunk->frames = offset + frames;
+    }
+    return chunk->buf + (size_t)offset * out_bytes;
+  }
+
+  i = share->next;
+  share->next = (share->next + 1) % PLAYBACK_SHARE_CHUNKS;
+  cras_fmt_conv_convert_pre_resample(conv, src, share->chunks[i].buf, frames);
+  share->chunks[i].src = src;
+  share->chunks[i].frames = frames;
+  return share->chunks[i].buf;
+}
+
+int dev_stream_share_playback_conv(struct dev_stream* dev_stream,
+                                   struct dev_stream* other) {
+  struct playback_conv_share* share = other->playback_share;
+
+  if (!dev_stream->conv || !other->conv ||
+      !cras_fmt_conv_pre_resample_sharable(dev_stream->conv) ||
+      !cras_fmt_conv_pre_resample_sharable(other->conv)) {
+    return -EINVAL;
+  }
+  if (!share) {
+    share = playback_conv_share_create(other);
+    if (!share) {
+      return -ENOMEM;
+    }
+    share->num_users = 1;
+    other->playback_share = share;
+  }
+  share->num_users++;
+  dev_stream->playback_share = share;
+  return 0;
+}
+
 struct dev_stream* dev_stream_create(struct cras_rstream* stream,
                                      unsigned int dev_id,
                                      const struct cras_audio_format* dev_fmt,
@@ -70,8 +341,9 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
   struct dev_stream* out;
   struct cras_audio_format* stream_fmt = &stream->format;
   int rc = 0;
-  unsigned int max_frames, dev_frames, buf_bytes;
+  unsigned int max_frames, buf_bytes;
   const struct cras_audio_format* ofmt;
+  struct capture_conv_share* share = NULL;
 
   out = calloc(1, sizeof(*out));
   out->iodev = iodev;
@@ -95,10 +367,15 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
      * format to configure format converter.
      */
     cras_stream_apm_start(stream->stream_apm, iodev);
-    ofmt = cras_rstream_post_processing_format(stream, iodev) ?: dev_fmt,
-    rc =
-        config_format_converter(&out->conv, stream->direction, ofmt, stream_fmt,
-                                iodev->active_node->type, max_frames);
+    share = find_capture_conv_share(iodev, stream, dev_id, max_frames);
+    if (share) {
+      out->conv = share->conv;
+    } else {
+      ofmt = cras_rstream_post_processing_format(stream, iodev) ?: dev_fmt,
+      rc = config_format_converter(&out->conv, stream->direction, ofmt,
+                                   stream_fmt, iodev->active_node->type,
+                                   max_frames);
+    }
   }
   if (rc) {
     free(out);
@@ -107,12 +384,7 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
 
   ofmt = cras_fmt_conv_out_format(out->conv);
 
-  dev_frames =
-      (stream->direction == CRAS_STREAM_OUTPUT)
-          ? cras_fmt_conv_in_frames_to_out(out->conv, stream->buffer_frames)
-          : cras_fmt_conv_out_frames_to_in(out->conv, stream->buffer_frames);
-
-  out->conv_buffer_size_frames = 2 * MAX(dev_frames, stream->buffer_frames);
+  out->conv_buffer_size_frames = conv_buffer_frames(out->conv, stream);
 
   /* Create conversion buffer and area using the output format
    * of the format converter. Note that this format might not be
@@ -121,6 +393,18 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
   out->conv_buffer = byte_buffer_create(buf_bytes);
   out->conv_area = cras_audio_area_create(ofmt->num_channels);
 
+  /* Streams converting on their own start a share others can join, which
+   * is only worth it if there's a conversion to do. */
+  if (!share && capture_conv_sharable(stream, dev_id) &&
+      cras_fmt_conversion_needed(out->conv)) {
+    share = capture_conv_share_create(out->conv, max_frames,
+                                      out->conv_buffer_size_frames);
+  }
+  if (share) {
+    share->num_users++;
+    out->conv_share = share;
+  }
+
   // Use sleep interval hint from argument if it is provided
   if (sleep_interval_ts) {
     stream->sleep_interval_ts = *sleep_interval_ts;
@@ -145,9 +429,14 @@ void dev_stream_destroy(struct dev_stream* dev_stream) {
   cras_rtc_remove_stream(dev_stream->stream, dev_stream->dev_id);
   if (dev_stream->conv) {
     cras_audio_area_destroy(dev_stream->conv_area);
-    cras_fmt_conv_destroy(&dev_stream->conv);
+    if (!dev_stream->conv_share || capture_conv_share_leave(dev_stream)) {
+      cras_fmt_conv_release(&dev_stream->conv);
+    }
     byte_buffer_destroy(&dev_stream->conv_buffer);
   }
+  if (dev_stream->playback_share && !--dev_stream->playback_share->num_users) {
+    playback_conv_share_destroy(dev_stream->playback_share);
+  }
   free(dev_stream);
 }
 
@@ -166,15 +455,26 @@ void dev_stream_set_dev_rate(struct dev_stream* dev_stream,
   } else {
     double new_rate = dev_rate * dev_rate_ratio / main_rate_ratio +
                       coarse_rate_adjust_step * coarse_rate_adjust;
+
+    // Streams sharing the converter need the rates of the main device.
+    if (dev_stream->conv_share && dev_stream->conv_share->num_users > 1 &&
+        capture_conv_unshare(dev_stream)) {
+      return;
+    }
     cras_fmt_conv_set_linear_resample_rates(dev_stream->conv, dev_rate,
                                             new_rate);
   }
 }
 
-int dev_stream_mix(struct dev_stream* dev_stream,
-                   const struct cras_audio_format* fmt,
-                   uint8_t* dst,
-                   unsigned int num_to_write) {
+/* Mixes the samples of a stream in the format of the device, or converts
+ * them into the float32 mix bus of the device if float_bus is set. Like
+ * cras_mix_add(), an index of zero copies the samples over dst instead. */
+static int mix_stream(struct dev_stream* dev_stream,
+                      const struct cras_audio_format* fmt,
+                      uint8_t* dst,
+                      unsigned int num_to_write,
+                      bool float_bus,
+                      unsigned int index) {
   struct cras_rstream* rstream = dev_stream->stream;
   uint8_t* src;
   uint8_t* target = dst;
@@ -184,7 +484,11 @@ int dev_stream_mix(struct dev_stream* dev_stream,
   unsigned int num_samples;
   size_t frames = 0;
   unsigned int dev_frames;
+  unsigned int in_frame_bytes;
+  unsigned int out_frame_bytes;
+  unsigned int skipped = 0;
   float mix_vol;
+  bool fused, stateless;
 
   fr_in_buf = dev_stream_playback_frames(dev_stream);
   if (fr_in_buf <= 0) {
@@ -199,6 +503,18 @@ int dev_stream_mix(struct dev_stream* dev_stream,
   // Stream volume scaler.
   mix_vol = cras_rstream_get_volume_scaler(dev_stream->stream);
 
+  /* Simple format and channel conversions are done while mixing, to save
+   * a pass through conv_buffer. */
+  fused = !float_bus && index && cras_fmt_conversion_needed(dev_stream->conv) &&
+          cras_fmt_conv_mix_fusable(dev_stream->conv);
+  /* Unless samples go through a converter, which may keep some of the past
+   * ones, silent or muted blocks can be skipped. */
+  stateless = fused || !cras_fmt_conversion_needed(dev_stream->conv);
+  in_frame_bytes =
+      cras_get_format_bytes(cras_fmt_conv_in_format(dev_stream->conv));
+  out_frame_bytes = float_bus ? fmt->num_channels * sizeof(float)
+                              : cras_get_format_bytes(fmt);
+
   fr_written = 0;
   fr_read = 0;
   while (fr_written < num_to_write) {
@@ -208,7 +524,42 @@ int dev_stream_mix(struct dev_stream* dev_stream,
     if (frames == 0) {
       break;
     }
-    if (cras_fmt_conversion_needed(dev_stream->conv)) {
+    dev_frames = MIN(frames, num_to_write - fr_written);
+    if (stateless &&
+        (cras_rstream_get_mute(rstream) ||
+         cras_mix_is_silent(src, dev_frames * in_frame_bytes))) {
+      // Nothing to add, but a copy must still overwrite dst.
+      if (!index) {
+        memset(target, 0, dev_frames * out_frame_bytes);
+      }
+      target += dev_frames * out_frame_bytes;
+      fr_written += dev_frames;
+      fr_read += dev_frames;
+      skipped += dev_frames;
+      continue;
+    }
+    if (fused) {
+      cras_mix_add_s16_stereo(
+          fmt->format, target, (const int16_t*)src, dev_frames,
+          cras_fmt_conv_in_format(dev_stream->conv)->num_channels,
+          cras_rstream_get_mute(rstream), mix_vol);
+      target += dev_frames * cras_get_format_bytes(fmt);
+      fr_written += dev_frames;
+      fr_read += dev_frames;
+      continue;
+    }
+    if (cras_fmt_conversion_needed(dev_stream->conv) &&
+        dev_stream->playback_share) {
+      // Same as below with the conversion shared with other devices.
+      read_frames = MIN(frames, num_to_write - fr_written);
+      dev_frames = cras_fmt_conv_convert_post_resample(
+          dev_stream->conv,
+          playback_conv_share_get(dev_stream->playback_share,
+                                  dev_stream->conv, src, read_frames),
+          dev_stream->conv_buffer->bytes, &read_frames,
+          num_to_write - fr_written);
+      src = dev_stream->conv_buffer->bytes;
+    } else if (cras_fmt_conversion_needed(dev_stream->conv)) {
       read_frames = frames;
       dev_frames = cras_fmt_conv_convert_frames(
           dev_stream->conv, src, dev_stream->conv_buffer->bytes, &read_frames,
@@ -219,19 +570,53 @@ int dev_stream_mix(struct dev_stream* dev_stream,
       read_frames = dev_frames;
     }
     num_samples = dev_frames * fmt->num_channels;
-    cras_mix_add(fmt->format, target, src, num_samples, 1,
-                 cras_rstream_get_mute(rstream), mix_vol);
-    target += dev_frames * cras_get_format_bytes(fmt);
+    if (float_bus) {
+      cras_mix_add_float(fmt->format, (float*)target, src, num_samples,
+                         cras_rstream_get_mute(rstream), mix_vol);
+      target += num_samples * sizeof(float);
+    } else {
+      cras_mix_add(fmt->format, target, src, num_samples, index,
+                   cras_rstream_get_mute(rstream), mix_vol);
+      target += dev_frames * cras_get_format_bytes(fmt);
+    }
     fr_written += dev_frames;
     fr_read += read_frames;
   }
 
   cras_rstream_dev_offset_update(rstream, fr_read, dev_stream->dev_id);
-  ATLOG(atlog, AUDIO_THREAD_DEV_STREAM_MIX, fr_written, fr_read, 0);
+  if (skipped) {
+    dev_stream->iodev->num_silent_frames_skipped += skipped;
+  }
+  ATLOG(atlog, AUDIO_THREAD_DEV_STREAM_MIX, fr_written, fr_read, skipped);
 
   return fr_written;
 }
 
+int dev_stream_mix(struct dev_stream* dev_stream,
+                   const struct cras_audio_format* fmt,
+                   uint8_t* dst,
+                   unsigned int num_to_write) {
+  return mix_stream(dev_stream, fmt, dst, num_to_write, false, 1);
+}
+
+int dev_stream_copy(struct dev_stream* dev_stream,
+                    const struct cras_audio_format* fmt,
+                    uint8_t* dst,
+                    unsigned int num_to_write) {
+  return mix_stream(dev_stream, fmt, dst, num_to_write, false, 0);
+}
+
+int dev_stream_is_passthrough(const struct dev_stream* dev_stream) {
+  return !cras_fmt_conversion_needed(dev_stream->conv);
+}
+
+int dev_stream_mix_float(struct dev_stream* dev_stream,
+                         const struct cras_audio_format* fmt,
+                         float* dst,
+                         unsigned int num_to_write) {
+  return mix_stream(dev_stream, fmt, (uint8_t*)dst, num_to_write, true, 1);
+}
+
 // Copy from the captured buffer to the temporary format converted buffer.
 static unsigned int capture_with_fmt_conv(struct dev_stream* dev_stream,
                                           const uint8_t* source_samples,
@@ -271,6 +656,75 @@ static unsigned int capture_with_fmt_conv(struct dev_stream* dev_stream,
   return total_read;
 }
 
+/*
+ * Copies the samples the converter share has converted in this pass to the
+ * conv_buffer of dev_stream, converting them first if it's the first stream
+ * sharing to capture. The streams all read the same area and it holds no more
+ * than any of them can take, so the others get what the first one read.
+ * Returns the number of input frames read, or -EAGAIN if dev_stream reads
+ * from elsewhere or can't fit what was converted.
+ */
+static int capture_with_shared_conv(struct dev_stream* dev_stream,
+                                    const uint8_t* source_samples,
+                                    unsigned int num_frames) {
+  struct capture_conv_share* share = dev_stream->conv_share;
+  unsigned int frame_bytes;
+  unsigned int copied = 0;
+  unsigned int write_frames;
+  uint8_t* buffer;
+
+  frame_bytes = cras_get_format_bytes(cras_fmt_conv_out_format(share->conv));
+
+  if (!share->src) {
+    share->src_frames = num_frames;
+    share->conv_frames = cras_fmt_conv_convert_frames(
+        share->conv, source_samples, share->buf, &share->src_frames,
+        MIN(share->buf_frames, buf_available(dev_stream->conv_buffer) /
+                                   frame_bytes));
+    share->src = source_samples;
+  } else if (share->src != source_samples ||
+             share->conv_frames >
+                 buf_available(dev_stream->conv_buffer) / frame_bytes) {
+    return -EAGAIN;
+  }
+
+  dev_stream->conv_area->num_channels =
+      cras_fmt_conv_out_format(share->conv)->num_channels;
+  while (copied < share->conv_frames) {
+    buffer = buf_write_pointer_size(dev_stream->conv_buffer, &write_frames);
+    write_frames = MIN(write_frames / frame_bytes, share->conv_frames - copied);
+    memcpy(buffer, share->buf + (size_t)copied * frame_bytes,
+           (size_t)write_frames * frame_bytes);
+    buf_increment_write(dev_stream->conv_buffer,
+                        (size_t)write_frames * frame_bytes);
+    copied += write_frames;
+  }
+
+  return share->src_frames;
+}
+
+/*
+ * Converts captured samples to the conv_buffer of dev_stream, once for all the
+ * streams sharing its converter. Returns the number of input frames read.
+ */
+static unsigned int capture_conv(struct dev_stream* dev_stream,
+                                 const uint8_t* source_samples,
+                                 unsigned int num_frames) {
+  int rc;
+
+  if (dev_stream->conv_share && dev_stream->conv_share->num_users > 1) {
+    rc = capture_with_shared_conv(dev_stream, source_samples, num_frames);
+    if (rc >= 0) {
+      return rc;
+    }
+    // Its input diverged from the other streams, convert on its own.
+    if (capture_conv_unshare(dev_stream)) {
+      return 0;
+    }
+  }
+  return capture_with_fmt_conv(dev_stream, source_samples, num_frames);
+}
+
 /* Copy from the converted buffer to the stream shm.  These have the same format
  * at this point. */
 static unsigned int capture_copy_converted_to_stream(
@@ -350,9 +804,9 @@ unsigned int dev_stream_capture(struct dev_stream* dev_stream,
 
     format_bytes =
         cras_get_format_bytes(cras_fmt_conv_in_format(dev_stream->conv));
-    nread = capture_with_fmt_conv(
-        dev_stream, area->channels[0].buf + area_offset * format_bytes,
-        fr_to_capture);
+    nread = capture_conv(dev_stream,
+                         area->channels[0].buf + area_offset * format_bytes,
+                         fr_to_capture);
 
     capture_copy_converted_to_stream(dev_stream, rstream, software_gain_scaler);
   } else {
@@ -377,6 +831,12 @@ unsigned int dev_stream_capture(struct dev_stream* dev_stream,
   return nread;
 }
 
+void dev_stream_capture_finish(struct dev_stream* dev_stream) {
+  if (dev_stream->conv_share) {
+    dev_stream->conv_share->src = NULL;
+  }
+}
+
 int dev_stream_attached_devs(const struct dev_stream* dev_stream) {
   return dev_stream->stream->num_attached_devs;
 }
@@ -485,6 +945,12 @@ void dev_stream_update_next_wake_time(struct dev_stream* dev_stream) {
 
 int dev_stream_playback_update_rstream(struct dev_stream* dev_stream) {
   cras_rstream_update_output_read_pointer(dev_stream->stream);
+  // What was converted is stale once the read pointer moves.
+  if (dev_stream->playback_share) {
+    for (unsigned int i = 0; i < PLAYBACK_SHARE_CHUNKS; i++) {
+      dev_stream->playback_share->chunks[i].src = NULL;
+    }
+  }
   return 0;
 }
 
@@ -621,24 +1087,6 @@ int dev_stream_request_playback_samples(struct dev_stream* dev_stream,
   return 0;
 }
 
-int dev_stream_poll_stream_fd(const struct dev_stream* dev_stream) {
-  const struct cras_rstream* stream = dev_stream->stream;
-
-  /* For streams which rely on dev level timing, we should
-   * let client response wake audio thread up. */
-  if (stream_uses_input(stream) && (stream->flags & USE_DEV_TIMING) &&
-      cras_rstream_is_pending_reply(stream)) {
-    return stream->fd;
-  }
-
-  if (!stream_uses_output(stream) || !cras_rstream_is_pending_reply(stream) ||
-      cras_rstream_get_is_draining(stream)) {
-    return -EINVAL;
-  }
-
-  return stream->fd;
-}
-
 /*
  * Gets proper wake up time for an input stream. It considers both
  * time for samples to reach one callback level, and the time for next callback.
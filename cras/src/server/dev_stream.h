@@ -15,6 +15,8 @@
 #include "cras/src/server/cras_rstream.h"
 #include "cras_types.h"
 
+struct capture_conv_share;
+struct playback_conv_share;
 struct cras_audio_area;
 struct cras_fmt_conv;
 struct cras_iodev;
@@ -31,6 +33,12 @@ struct dev_stream {
   struct cras_rstream* stream;
   // Sample rate or format converter.
   struct cras_fmt_conv* conv;
+  /* For input, set when conv is shared with the other streams of iodev
+   * capturing at the same sample format and rate. */
+  struct capture_conv_share* conv_share;
+  /* For output, set when the stream plays to other devices of the same
+   * format and the conversion ahead of the linear resampler is shared. */
+  struct playback_conv_share* playback_share;
   // The buffer for converter if needed.
   struct byte_buffer* conv_buffer;
   struct cras_audio_area* conv_area;
@@ -92,6 +100,21 @@ void dev_stream_set_dev_rate(struct dev_stream* dev_stream,
                              double main_rate_ratio,
                              int coarse_rate_adjust);
 
+/*
+ * Makes an output dev_stream share the sample format and channel conversion of
+ * its stream with other, the dev_stream of the same stream on another device
+ * of identical format. Each keeps its own linear resampler, so rate drift is
+ * still corrected per device.
+ * Args:
+ *    dev_stream - The new dev_stream of the stream.
+ *    other - A dev_stream of the same stream on a device of the same format.
+ * Returns:
+ *    0 on success, -EINVAL if there's no conversion that can be shared or
+ *    -ENOMEM.
+ */
+int dev_stream_share_playback_conv(struct dev_stream* dev_stream,
+                                   struct dev_stream* other);
+
 /*
  * Renders count frames from shm into dst.  Updates count if anything is
  * written. If it's muted and the only stream zero memory.
@@ -106,6 +129,42 @@ int dev_stream_mix(struct dev_stream* dev_stream,
                    uint8_t* dst,
                    unsigned int num_to_write);
 
+/*
+ * Like dev_stream_mix() but copies the samples over what's in dst instead of
+ * mixing them in. For the only stream playing to a device, it's a plain
+ * memcpy from shm when dev_stream_is_passthrough() and the stream is neither
+ * muted nor scaled.
+ * Args:
+ *    dev_stream - The struct holding the stream to copy.
+ *    format - The format of the audio device.
+ *    dst - The destination buffer.
+ *    num_to_write - The number of frames written.
+ */
+int dev_stream_copy(struct dev_stream* dev_stream,
+                    const struct cras_audio_format* fmt,
+                    uint8_t* dst,
+                    unsigned int num_to_write);
+
+/*
+ * Returns non-zero if the stream plays in the format of its device, so its
+ * samples go to the device without any conversion.
+ */
+int dev_stream_is_passthrough(const struct dev_stream* dev_stream);
+
+/*
+ * Like dev_stream_mix() but adds the samples into the float32 mix bus of the
+ * device. The bus keeps the headroom, so nothing is clipped here.
+ * Args:
+ *    dev_stream - The struct holding the stream to mix.
+ *    format - The format of the audio device.
+ *    dst - The float mix bus, interleaved in the channels of format.
+ *    num_to_write - The number of frames written.
+ */
+int dev_stream_mix_float(struct dev_stream* dev_stream,
+                         const struct cras_audio_format* fmt,
+                         float* dst,
+                         unsigned int num_to_write);
+
 /*
  * Reads froms from the source into the dev_stream.
  * Args:
@@ -119,6 +178,13 @@ unsigned int dev_stream_capture(struct dev_stream* dev_stream,
                                 unsigned int area_offset,
                                 float software_gain_scaler);
 
+/*
+ * Ends a capture pass over the input area given to dev_stream_capture(). The
+ * samples converted once for the streams sharing a converter with this one are
+ * dropped, the next pass converts new ones.
+ */
+void dev_stream_capture_finish(struct dev_stream* dev_stream);
+
 // Returns the number of iodevs this stream has attached to.
 int dev_stream_attached_devs(const struct dev_stream* dev_stream);
 
@@ -202,12 +268,6 @@ int dev_stream_wake_time(struct dev_stream* dev_stream,
                          int is_cap_limit_stream,
                          struct timespec* wake_time_out);
 
-/*
- * Returns a non-negative fd if the fd is expecting a message and should be
- * added to the list of descriptors to poll.
- */
-int dev_stream_poll_stream_fd(const struct dev_stream* dev_stream);
-
 static inline int dev_stream_is_running(struct dev_stream* dev_stream) {
   return dev_stream->is_running;
 }
@@ -8,6 +8,11 @@
 #include "cras/src/server/cras_audio_area.h"
 #include "cras_util.h"
 
+// Frames resampled per block, see linear_resampler_resample.
+#define BLOCK_FRAMES 64
+// Bits of the interpolation weight between two input frames.
+#define FRAC_BITS 15
+
 // A linear resampler.
 struct linear_resampler {
   // The number of channles in once frames.
@@ -22,8 +27,12 @@ struct linear_resampler {
   unsigned int to_times_100;
   // The denominator of the rate factor used for SRC.
   unsigned int from_times_100;
-  // The rate factor used for linear resample.
-  float f;
+  /* Input frames advanced per output frame, from / to in Q32.32 fixed
+   * point rounded down. */
+  uint64_t step;
+  /* What rounding down step dropped, in units of 1 / to_times_100 of the
+   * least significant bit. Accumulating it keeps positions exact. */
+  uint64_t step_rem;
 };
 
 struct linear_resampler* linear_resampler_create(unsigned int num_channels,
@@ -53,11 +62,26 @@ void linear_resampler_destroy(struct linear_resampler* lr) {
 void linear_resampler_set_rates(struct linear_resampler* lr,
                                 float from,
                                 float to) {
-  lr->f = (float)to / from;
   lr->to_times_100 = to * 100;
   lr->from_times_100 = from * 100;
   lr->src_offset = 0;
   lr->dst_offset = 0;
+  if (lr->to_times_100 == 0) {
+    lr->to_times_100 = 1;
+  }
+  lr->step = ((uint64_t)lr->from_times_100 << 32) / lr->to_times_100;
+  lr->step_rem = ((uint64_t)lr->from_times_100 << 32) % lr->to_times_100;
+}
+
+/* Returns frames * num / den in Q32.32 fixed point, rounded down. The
+ * operands are rates times 100 and offsets wrapped at those, so neither
+ * frames * num nor the remainder shifted by 32 bits overflow. */
+static uint64_t scale_q32(unsigned int frames,
+                          unsigned int num,
+                          unsigned int den) {
+  uint64_t n = (uint64_t)frames * num;
+
+  return ((n / den) << 32) + (((n % den) << 32) / den);
 }
 
 /* Assuming the linear resampler transforms X frames of input buffer into
@@ -72,17 +96,24 @@ void linear_resampler_set_rates(struct linear_resampler* lr,
  * when the resampled frames number isn't sufficient to consume the first
  * buffer at input or output offset(index 0), always count as one buffer
  * used so the intput/output offset can always increment.
+ *
+ * Positions are computed in the same Q32.32 fixed point as
+ * linear_resampler_resample so the counts here always match what it consumes
+ * and produces.
  */
 unsigned int linear_resampler_out_frames_to_in(struct linear_resampler* lr,
                                                unsigned int frames) {
-  float in_frames;
+  uint64_t in_frames, offset;
+
   if (frames == 0) {
     return 0;
   }
 
-  in_frames = (float)(lr->dst_offset + frames) / lr->f;
-  if ((in_frames > lr->src_offset)) {
-    return 1 + (unsigned int)(in_frames - lr->src_offset);
+  in_frames = scale_q32(lr->dst_offset + frames, lr->from_times_100,
+                        lr->to_times_100);
+  offset = (uint64_t)lr->src_offset << 32;
+  if (in_frames > offset) {
+    return 1 + (unsigned int)((in_frames - offset) >> 32);
   } else {
     return 1;
   }
@@ -90,14 +121,17 @@ unsigned int linear_resampler_out_frames_to_in(struct linear_resampler* lr,
 
 unsigned int linear_resampler_in_frames_to_out(struct linear_resampler* lr,
                                                unsigned int frames) {
-  float out_frames;
-  if (frames == 0) {
+  uint64_t out_frames, offset;
+
+  if (frames == 0 || lr->from_times_100 == 0) {
     return 0;
   }
 
-  out_frames = lr->f * (lr->src_offset + frames - 1);
-  if (out_frames > lr->dst_offset) {
-    return 1 + (unsigned int)(out_frames - lr->dst_offset);
+  out_frames = scale_q32(lr->src_offset + frames - 1, lr->to_times_100,
+                         lr->from_times_100);
+  offset = (uint64_t)lr->dst_offset << 32;
+  if (out_frames > offset) {
+    return 1 + (unsigned int)((out_frames - offset) >> 32);
   } else {
     return 1;
   }
@@ -107,16 +141,113 @@ int linear_resampler_needed(struct linear_resampler* lr) {
   return lr->from_times_100 != lr->to_times_100;
 }
 
+/*
+ * Interpolates frames from input frame idx[i] towards frame idx[i] + 1 with
+ * weight frac[i] in Q0.15. The samples are gathered first so the arithmetic
+ * runs as a separate loop the compiler vectorizes.
+ */
+static void interpolate_mono(const int16_t* in,
+                             const unsigned int* idx,
+                             const int32_t* frac,
+                             size_t frames,
+                             int16_t* out) {
+  int32_t s0[BLOCK_FRAMES], s1[BLOCK_FRAMES];
+  size_t i;
+
+  for (i = 0; i < frames; i++) {
+    s0[i] = in[idx[i]];
+    s1[i] = in[idx[i] + 1];
+  }
+  for (i = 0; i < frames; i++) {
+    out[i] = s0[i] + (((s1[i] - s0[i]) * frac[i] + (1 << (FRAC_BITS - 1))) >>
+                      FRAC_BITS);
+  }
+}
+
+static void interpolate_stereo(const int16_t* in,
+                               const unsigned int* idx,
+                               const int32_t* frac,
+                               size_t frames,
+                               int16_t* out) {
+  int32_t s0[2 * BLOCK_FRAMES], s1[2 * BLOCK_FRAMES], w[2 * BLOCK_FRAMES];
+  size_t i;
+
+  for (i = 0; i < frames; i++) {
+    s0[2 * i] = in[2 * idx[i]];
+    s0[2 * i + 1] = in[2 * idx[i] + 1];
+    s1[2 * i] = in[2 * idx[i] + 2];
+    s1[2 * i + 1] = in[2 * idx[i] + 3];
+    w[2 * i] = frac[i];
+    w[2 * i + 1] = frac[i];
+  }
+  for (i = 0; i < 2 * frames; i++) {
+    out[i] = s0[i] +
+             (((s1[i] - s0[i]) * w[i] + (1 << (FRAC_BITS - 1))) >> FRAC_BITS);
+  }
+}
+
+// Any channel count, frames are |stride| int16 samples apart.
+static void interpolate_generic(const int16_t* in,
+                                const unsigned int* idx,
+                                const int32_t* frac,
+                                size_t frames,
+                                unsigned int num_channels,
+                                unsigned int stride,
+                                int16_t* out) {
+  for (size_t i = 0; i < frames; i++) {
+    const int16_t* s0 = in + idx[i] * stride;
+    const int16_t* s1 = s0 + stride;
+    int16_t* dst = out + i * stride;
+
+    for (unsigned int ch = 0; ch < num_channels; ch++) {
+      dst[ch] = s0[ch] + (((s1[ch] - s0[ch]) * frac[i] +
+                           (1 << (FRAC_BITS - 1))) >>
+                          FRAC_BITS);
+    }
+  }
+}
+
+static void interpolate(struct linear_resampler* lr,
+                        const int16_t* in,
+                        const unsigned int* idx,
+                        const int32_t* frac,
+                        size_t frames,
+                        int16_t* out) {
+  unsigned int stride = lr->format_bytes / sizeof(int16_t);
+
+  if (lr->num_channels == 1 && stride == 1) {
+    interpolate_mono(in, idx, frac, frames, out);
+  } else if (lr->num_channels == 2 && stride == 2) {
+    interpolate_stereo(in, idx, frac, frames, out);
+  } else {
+    interpolate_generic(in, idx, frac, frames, lr->num_channels, stride, out);
+  }
+}
+
+/*
+ * The input position of every output frame is tracked in Q32.32 fixed point,
+ * starting from the exact position at dst_offset and advanced by step with
+ * the dropped remainder carried like a Bresenham line, so positions never
+ * drift from (dst_offset + dst_idx) * from / to. Output frames are done in
+ * blocks: positions are resolved to an input frame and weight first, then
+ * interpolated by the loop specialized for the channel count.
+ */
 unsigned int linear_resampler_resample(struct linear_resampler* lr,
                                        uint8_t* src,
                                        unsigned int* src_frames,
                                        uint8_t* dst,
                                        unsigned dst_frames) {
-  int ch;
-  unsigned int src_idx = 0;
+  unsigned int idx[BLOCK_FRAMES];
+  int32_t frac[BLOCK_FRAMES];
+  unsigned int src_idx;
   unsigned int dst_idx = 0;
-  float src_pos;
+  unsigned int last;
+  unsigned int stride = lr->format_bytes / sizeof(int16_t);
+  unsigned int ch;
+  uint64_t pos, rem, src_base, src_end, src_pos = 0;
+  uint64_t n, carry;
   int16_t *in, *out;
+  int done = 0;
 
   /* Check for corner cases so that we can assume both src_idx and
    * dst_idx are valid with value 0 in the loop below. */
@@ -125,41 +256,55 @@ unsigned int linear_resampler_resample(struct linear_resampler* lr,
     return 0;
   }
 
-  for (dst_idx = 0; dst_idx <= dst_frames; dst_idx++) {
-    src_pos = (float)(lr->dst_offset + dst_idx) / lr->f;
-    if (src_pos > lr->src_offset) {
-      src_pos -= lr->src_offset;
-    } else {
-      src_pos = 0;
-    }
-    src_idx = (unsigned int)src_pos;
+  in = (int16_t*)src;
+  out = (int16_t*)dst;
+  last = *src_frames - 1;
+  src_base = (uint64_t)lr->src_offset << 32;
+  src_end = (uint64_t)last << 32;
 
-    if (src_pos > *src_frames - 1 || dst_idx >= dst_frames) {
-      if (src_pos > *src_frames - 1) {
-        src_idx = *src_frames - 1;
-      }
-      /* When this loop stops, dst_idx is always at the last
-       * used index incremented by 1. */
-      break;
-    }
+  n = (uint64_t)lr->dst_offset * lr->from_times_100;
+  pos = scale_q32(lr->dst_offset, lr->from_times_100, lr->to_times_100);
+  rem = ((n % lr->to_times_100) << 32) % lr->to_times_100;
 
-    in = (int16_t*)(src + src_idx * lr->format_bytes);
-    out = (int16_t*)(dst + dst_idx * lr->format_bytes);
+  /* When this loop stops, dst_idx is always at the last used index
+   * incremented by 1 and src_pos at the position for dst_idx. */
+  for (;;) {
+    unsigned int block_start = dst_idx;
+    size_t frames;
 
-    /* Don't do linear interpolcation if src_pos falls on the
-     * last index. */
-    if (src_idx == *src_frames - 1) {
-      for (ch = 0; ch < lr->num_channels; ch++) {
-        out[ch] = in[ch];
+    for (frames = 0; frames < BLOCK_FRAMES; frames++, dst_idx++) {
+      src_pos = pos > src_base ? pos - src_base : 0;
+      if (src_pos > src_end || dst_idx >= dst_frames) {
+        break;
       }
-    } else {
+      idx[frames] = src_pos >> 32;
+      frac[frames] = (src_pos & 0xffffffff) >> (32 - FRAC_BITS);
+
+      pos += lr->step;
+      rem += lr->step_rem;
+      carry = rem >= lr->to_times_100;
+      rem -= carry ? lr->to_times_100 : 0;
+      pos += carry;
+    }
+    if (frames < BLOCK_FRAMES) {
+      done = 1;
+    }
+
+    /* Don't do linear interpolation if src_pos falls on the last index,
+     * which can only happen to the last frame resolved. */
+    if (frames && idx[frames - 1] == last) {
+      frames--;
       for (ch = 0; ch < lr->num_channels; ch++) {
-        out[ch] =
-            in[ch] + (src_pos - src_idx) * (in[lr->num_channels + ch] - in[ch]);
+        out[(block_start + frames) * stride + ch] = in[last * stride + ch];
       }
     }
+    interpolate(lr, in, idx, frac, frames, out + block_start * stride);
+    if (done) {
+      break;
+    }
   }
 
+  src_idx = src_pos > src_end ? last : src_pos >> 32;
   *src_frames = src_idx + 1;
 
   lr->src_offset += *src_frames;
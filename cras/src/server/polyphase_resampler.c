@@ -0,0 +1,417 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cras/src/server/polyphase_resampler.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "cras/src/server/cras_mix.h"
+#include "cras_util.h"
+#include "third_party/utlist/utlist.h"
+
+// Input frames deinterleaved into the history per fill.
+#define BLOCK_FRAMES 256
+/* Filter banks with more phases than this would take too much memory, like
+ * 44100 to 48001 Hz. Such rates are left to the caller's other resampler. */
+#define MAX_PHASES 1024
+// Most channels a resampler converts, bounds the output block on the stack.
+#define MAX_CHANNELS 32
+
+/*
+ * Parameters of the low pass filter at each quality. The stop band starts at
+ * the Nyquist frequency of the lower rate and the pass band ends at rolloff
+ * of it. A larger Kaiser beta trades transition width for attenuation.
+ */
+static const struct {
+  // Taps per phase when not downsampling.
+  unsigned int taps;
+  float rolloff;
+  double beta;
+} qualities[POLYPHASE_QUALITY_NUM] = {
+    [POLYPHASE_QUALITY_LOW] = {16, 0.85, 6},
+    [POLYPHASE_QUALITY_MEDIUM] = {48, 0.91, 8},
+    [POLYPHASE_QUALITY_HIGH] = {96, 0.95, 10},
+};
+
+/*
+ * The filter bank converting in_rate to out_rate, built once per rate pair
+ * and quality and never freed. Output frame n is computed by phase
+ * (n * step) % num_phases over the taps input frames ending at
+ * (n * step) / num_phases.
+ */
+struct polyphase_filter {
+  unsigned int in_rate;
+  unsigned int out_rate;
+  enum POLYPHASE_QUALITY quality;
+  // out_rate / gcd(in_rate, out_rate).
+  unsigned int num_phases;
+  // in_rate / gcd(in_rate, out_rate).
+  unsigned int step;
+  unsigned int taps;
+  // num_phases rows of taps coefficients, each row reversed to be applied
+  // to the oldest input frame first.
+  float* coefs;
+  struct polyphase_filter *prev, *next;
+};
+
+struct polyphase_resampler {
+  const struct polyphase_filter* filter;
+  unsigned int num_channels;
+  // Frames each channel of history can hold.
+  unsigned int capacity;
+  // Frames in each channel of history.
+  unsigned int frames;
+  // The oldest history frame the next output frame is computed from.
+  unsigned int pos;
+  // The phase of the next output frame.
+  unsigned int phase;
+  // One plane of capacity float samples per channel.
+  float* history;
+};
+
+static struct polyphase_filter* filters;
+static pthread_mutex_t filters_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef float (*dot_func_t)(const float* a, const float* b, unsigned int n);
+
+/* n is a multiple of 8. The separate sums let the compiler keep them in one
+ * vector register. */
+static float dot(const float* a, const float* b, unsigned int n) {
+  float sum[8] = {0};
+
+  for (unsigned int i = 0; i < n; i += 8) {
+    for (unsigned int j = 0; j < 8; j++) {
+      sum[j] += a[i + j] * b[i + j];
+    }
+  }
+  return ((sum[0] + sum[4]) + (sum[1] + sum[5])) +
+         ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+
+#if HAVE_FMA
+__attribute__((target("avx2,fma"))) static float dot_fma(const float* a,
+                                                         const float* b,
+                                                         unsigned int n) {
+  float sum[8] = {0};
+
+  for (unsigned int i = 0; i < n; i += 8) {
+    for (unsigned int j = 0; j < 8; j++) {
+      sum[j] = fmaf(a[i + j], b[i + j], sum[j]);
+    }
+  }
+  return ((sum[0] + sum[4]) + (sum[1] + sum[5])) +
+         ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+#endif
+
+static dot_func_t dot_func = dot;
+
+void polyphase_resampler_init(unsigned int cpu_flags) {
+  dot_func = dot;
+#if HAVE_FMA
+  if ((cpu_flags & CPU_X86_AVX2) && (cpu_flags & CPU_X86_FMA) &&
+      !(cpu_flags & CPU_X86_FMA_CRASH)) {
+    dot_func = dot_fma;
+  }
+#endif
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b) {
+  while (b) {
+    unsigned int t = a % b;
+
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// Zeroth order modified Bessel function of the first kind, for the window.
+static double bessel_i0(double x) {
+  double sum = 1, term = 1;
+
+  for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+static struct polyphase_filter* filter_create(unsigned int in_rate,
+                                              unsigned int out_rate,
+                                              enum POLYPHASE_QUALITY quality) {
+  struct polyphase_filter* f;
+  unsigned int g = gcd(in_rate, out_rate);
+  unsigned int num_phases = out_rate / g;
+  unsigned int step = in_rate / g;
+  unsigned int taps, len;
+  double cutoff, center, i0_beta;
+
+  if (num_phases > MAX_PHASES) {
+    return NULL;
+  }
+
+  // Widen the filter by the decimation factor to keep its transition band.
+  taps = qualities[quality].taps * MAX(1, (in_rate + out_rate - 1) / out_rate);
+  taps = (taps + 7) & ~7u;
+  len = taps * num_phases;
+
+  f = (struct polyphase_filter*)calloc(1, sizeof(*f));
+  if (!f) {
+    return NULL;
+  }
+  f->coefs = (float*)calloc(len, sizeof(*f->coefs));
+  if (!f->coefs) {
+    free(f);
+    return NULL;
+  }
+  f->in_rate = in_rate;
+  f->out_rate = out_rate;
+  f->quality = quality;
+  f->num_phases = num_phases;
+  f->step = step;
+  f->taps = taps;
+
+  /* The prototype runs at in_rate * num_phases. Its cutoff in cycles per
+   * sample is half the lower rate over that. */
+  cutoff = qualities[quality].rolloff * 0.5 * MIN(in_rate, out_rate) /
+           ((double)in_rate * num_phases);
+  center = (len - 1) / 2.0;
+  i0_beta = bessel_i0(qualities[quality].beta);
+
+  for (unsigned int p = 0; p < num_phases; p++) {
+    float* row = f->coefs + p * taps;
+    double sum = 0;
+
+    for (unsigned int j = 0; j < taps; j++) {
+      double t = p + (double)num_phases * j - center;
+      double r = t / center;
+      double sinc =
+          t == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * t) / (M_PI * t);
+      double w =
+          bessel_i0(qualities[quality].beta * sqrt(MAX(0, 1 - r * r))) /
+          i0_beta;
+
+      row[taps - 1 - j] = sinc * w;
+      sum += sinc * w;
+    }
+    // Unity gain at DC in every phase keeps constant input flat.
+    for (unsigned int j = 0; j < taps; j++) {
+      row[j] /= sum;
+    }
+  }
+  return f;
+}
+
+// Finds or builds the shared filter bank.
+static const struct polyphase_filter* filter_get(
+    unsigned int in_rate,
+    unsigned int out_rate,
+    enum POLYPHASE_QUALITY quality) {
+  struct polyphase_filter* f;
+
+  pthread_mutex_lock(&filters_mutex);
+  DL_FOREACH (filters, f) {
+    if (f->in_rate == in_rate && f->out_rate == out_rate &&
+        f->quality == quality) {
+      break;
+    }
+  }
+  if (!f) {
+    f = filter_create(in_rate, out_rate, quality);
+    if (f) {
+      DL_APPEND(filters, f);
+    }
+  }
+  pthread_mutex_unlock(&filters_mutex);
+  return f;
+}
+
+struct polyphase_resampler* polyphase_resampler_create(
+    unsigned int num_channels,
+    unsigned int in_rate,
+    unsigned int out_rate,
+    enum POLYPHASE_QUALITY quality) {
+  struct polyphase_resampler* pr;
+  const struct polyphase_filter* f;
+
+  if (!num_channels || num_channels > MAX_CHANNELS || !in_rate || !out_rate ||
+      quality >= POLYPHASE_QUALITY_NUM) {
+    return NULL;
+  }
+  f = filter_get(in_rate, out_rate, quality);
+  if (!f) {
+    return NULL;
+  }
+
+  pr = (struct polyphase_resampler*)calloc(1, sizeof(*pr));
+  if (!pr) {
+    return NULL;
+  }
+  pr->filter = f;
+  pr->num_channels = num_channels;
+  pr->capacity = f->taps - 1 + BLOCK_FRAMES;
+  pr->history = (float*)malloc(sizeof(float) * pr->capacity * num_channels);
+  if (!pr->history) {
+    free(pr);
+    return NULL;
+  }
+  polyphase_resampler_reset(pr);
+  return pr;
+}
+
+void polyphase_resampler_destroy(struct polyphase_resampler* pr) {
+  if (pr) {
+    free(pr->history);
+    free(pr);
+  }
+}
+
+void polyphase_resampler_reset(struct polyphase_resampler* pr) {
+  // Start from silence so the first output frame lines up with the first
+  // input frame at the center of the filter.
+  pr->frames = pr->filter->taps - 1;
+  pr->pos = 0;
+  pr->phase = 0;
+  for (unsigned int ch = 0; ch < pr->num_channels; ch++) {
+    memset(pr->history + ch * pr->capacity, 0, sizeof(float) * pr->frames);
+  }
+}
+
+unsigned int polyphase_resampler_num_taps(
+    const struct polyphase_resampler* pr) {
+  return pr->filter->taps;
+}
+
+// Drops the history no future output frame needs to make room.
+static unsigned int compact(struct polyphase_resampler* pr) {
+  if (pr->pos) {
+    pr->frames -= pr->pos;
+    for (unsigned int ch = 0; ch < pr->num_channels; ch++) {
+      float* plane = pr->history + ch * pr->capacity;
+
+      memmove(plane, plane + pr->pos, sizeof(float) * pr->frames);
+    }
+    pr->pos = 0;
+  }
+  return pr->capacity - pr->frames;
+}
+
+static void fill_s16(struct polyphase_resampler* pr,
+                     const int16_t* in,
+                     unsigned int frames) {
+  for (unsigned int ch = 0; ch < pr->num_channels; ch++) {
+    float* plane = pr->history + ch * pr->capacity + pr->frames;
+
+    for (unsigned int i = 0; i < frames; i++) {
+      plane[i] = in[i * pr->num_channels + ch];
+    }
+  }
+  pr->frames += frames;
+}
+
+static void fill_float(struct polyphase_resampler* pr,
+                       const float* in,
+                       unsigned int frames) {
+  for (unsigned int ch = 0; ch < pr->num_channels; ch++) {
+    float* plane = pr->history + ch * pr->capacity + pr->frames;
+
+    for (unsigned int i = 0; i < frames; i++) {
+      plane[i] = in[i * pr->num_channels + ch];
+    }
+  }
+  pr->frames += frames;
+}
+
+/* Computes output frames from the history into the planar out until either
+ * max frames are done or the history runs out. Returns the frames done. */
+static unsigned int run(struct polyphase_resampler* pr,
+                        float* out,
+                        unsigned int max) {
+  const struct polyphase_filter* f = pr->filter;
+  const dot_func_t dot_fn = dot_func;
+  unsigned int done = 0;
+
+  while (done < max && pr->pos + f->taps <= pr->frames) {
+    const float* coefs = f->coefs + pr->phase * f->taps;
+
+    for (unsigned int ch = 0; ch < pr->num_channels; ch++) {
+      const float* plane = pr->history + ch * pr->capacity + pr->pos;
+
+      out[done * pr->num_channels + ch] = dot_fn(coefs, plane, f->taps);
+    }
+    done++;
+    pr->phase += f->step;
+    pr->pos += pr->phase / f->num_phases;
+    pr->phase %= f->num_phases;
+  }
+  return done;
+}
+
+static inline int16_t float_to_s16(float s) {
+  s = roundf(s);
+  s = s < -32768.0f ? -32768.0f : s;
+  return (int16_t)(s > 32767.0f ? 32767.0f : s);
+}
+
+void polyphase_resampler_process_s16(struct polyphase_resampler* pr,
+                                     const int16_t* in,
+                                     unsigned int* in_frames,
+                                     int16_t* out,
+                                     unsigned int* out_frames) {
+  float block[BLOCK_FRAMES * 8];
+  const unsigned int block_frames = ARRAY_SIZE(block) / pr->num_channels;
+  unsigned int in_done = 0, out_done = 0;
+
+  while (out_done < *out_frames) {
+    unsigned int n =
+        run(pr, block, MIN(*out_frames - out_done, block_frames));
+
+    for (unsigned int i = 0; i < n * pr->num_channels; i++) {
+      out[out_done * pr->num_channels + i] = float_to_s16(block[i]);
+    }
+    out_done += n;
+    if (n) {
+      continue;
+    }
+    if (in_done == *in_frames) {
+      break;
+    }
+    n = MIN(compact(pr), *in_frames - in_done);
+    fill_s16(pr, in + in_done * pr->num_channels, n);
+    in_done += n;
+  }
+  *in_frames = in_done;
+  *out_frames = out_done;
+}
+
+void polyphase_resampler_process_float(struct polyphase_resampler* pr,
+                                       const float* in,
+                                       unsigned int* in_frames,
+                                       float* out,
+                                       unsigned int* out_frames) {
+  unsigned int in_done = 0, out_done = 0;
+
+  while (out_done < *out_frames) {
+    unsigned int n = run(pr, out + out_done * pr->num_channels,
+                         *out_frames - out_done);
+
+    out_done += n;
+    if (n) {
+      continue;
+    }
+    if (in_done == *in_frames) {
+      break;
+    }
+    n = MIN(compact(pr), *in_frames - in_done);
+    fill_float(pr, in + in_done * pr->num_channels, n);
+    in_done += n;
+  }
+  *in_frames = in_done;
+  *out_frames = out_done;
+}
@@ -0,0 +1,86 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRAS_SRC_SERVER_POLYPHASE_RESAMPLER_H_
+#define CRAS_SRC_SERVER_POLYPHASE_RESAMPLER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A resampler for fixed rational rate pairs, like 44100 to 48000 Hz. The
+ * windowed sinc filter bank of a rate pair and quality is built once and
+ * shared read-only by every resampler converting between them.
+ */
+struct polyphase_resampler;
+
+enum POLYPHASE_QUALITY {
+  POLYPHASE_QUALITY_LOW,
+  POLYPHASE_QUALITY_MEDIUM,
+  POLYPHASE_QUALITY_HIGH,
+  POLYPHASE_QUALITY_NUM,
+};
+
+/* Picks the dot product kernel for the CPU.
+ * Args:
+ *    cpu_flags - The CPU_X86_* flags of the CPU, see cras_mix.h.
+ */
+void polyphase_resampler_init(unsigned int cpu_flags);
+
+/* Creates a polyphase resampler.
+ * Args:
+ *    num_channels - The number of interleaved channels in each frame.
+ *    in_rate - The rate to resample from.
+ *    out_rate - The rate to resample to.
+ *    quality - The quality of the filter bank.
+ * Returns:
+ *    The resampler, or NULL if the rates can't be converted with a filter
+ *    bank of reasonable size, or out of memory.
+ */
+struct polyphase_resampler* polyphase_resampler_create(
+    unsigned int num_channels,
+    unsigned int in_rate,
+    unsigned int out_rate,
+    enum POLYPHASE_QUALITY quality);
+
+// Destroys a polyphase resampler. The filter bank stays cached.
+void polyphase_resampler_destroy(struct polyphase_resampler* pr);
+
+// Forgets the past input, as if the resampler was just created.
+void polyphase_resampler_reset(struct polyphase_resampler* pr);
+
+/* Resamples interleaved S16_LE samples.
+ * Args:
+ *    pr - The resampler.
+ *    in - The input samples.
+ *    in_frames - The number of frames in in, updated to the number of frames
+ *        consumed.
+ *    out - The output buffer.
+ *    out_frames - The number of frames out can hold, updated to the number of
+ *        frames written.
+ */
+void polyphase_resampler_process_s16(struct polyphase_resampler* pr,
+                                     const int16_t* in,
+                                     unsigned int* in_frames,
+                                     int16_t* out,
+                                     unsigned int* out_frames);
+
+// Same as polyphase_resampler_process_s16() for float samples.
+void polyphase_resampler_process_float(struct polyphase_resampler* pr,
+                                       const float* in,
+                                       unsigned int* in_frames,
+                                       float* out,
+                                       unsigned int* out_frames);
+
+// Returns the number of taps in each phase of the filter bank.
+unsigned int polyphase_resampler_num_taps(const struct polyphase_resampler* pr);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CRAS_SRC_SERVER_POLYPHASE_RESAMPLER_H_
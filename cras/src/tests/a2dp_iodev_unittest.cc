@@ -929,7 +929,7 @@ struct audio_thread* cras_iodev_list_get_audio_thread() {
 void ewma_power_disable(struct ewma_power* ewma) {}
 
 // From audio_thread
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 
 void audio_thread_add_events_callback(int fd,
                                       thread_callback cb,
@@ -3,20 +3,26 @@
 // found in the LICENSE file.
 
 #include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <stdio.h>
 #include <sys/param.h>
 #include <syslog.h>
+#include <unistd.h>
 
 extern "C" {
 #include "cras/src/server/cras_alsa_card.h"
 #include "cras/src/server/cras_alsa_io.h"
 #include "cras/src/server/cras_alsa_mixer.h"
+#include "cras/src/server/cras_alsa_probe.h"
 #include "cras/src/server/cras_alsa_ucm.h"
 #include "cras/src/server/cras_alsa_usb_io.h"
 #include "cras/src/server/cras_features.h"
 #include "cras/src/server/cras_features_override.h"
 #include "cras/src/server/cras_iodev.h"
+#include "cras/src/server/cras_main_message.h"
 #include "cras_types.h"
 #include "cras_util.h"
 #include "third_party/utlist/utlist.h"
@@ -119,6 +125,19 @@ static int ucm_get_echo_reference_dev_name_for_dev_called;
 static size_t cras_system_check_ignore_ucm_suffix_called;
 static bool cras_system_check_ignore_ucm_suffix_value;
 static const char* ucm_get_echo_reference_dev_name_for_dev_return_value[4];
+// Held by the stubs cras_alsa_card_probe() calls, they run on probe workers.
+static std::mutex probe_stubs_lock;
+// Signaled when snd_hctl_load() starts or is released.
+static std::condition_variable probe_stubs_cond;
+// Makes snd_hctl_load() wait, standing in for a slow card.
+static bool snd_hctl_load_hold;
+static unsigned int snd_hctl_loading;
+static std::map<size_t, unsigned int> iodevs_per_card;
+static int main_message_fds[2];
+static cras_message_callback main_message_callback;
+static void* main_message_callback_data;
+static std::vector<struct cras_alsa_card*> probed_cards;
+static size_t card_probed_called;
 
 static void ResetStubData() {
   cras_alsa_mixer_create_called = 0;
@@ -208,6 +227,11 @@ static void ResetStubData() {
   fake_dev3.nodes = NULL;
   fake_dev4.nodes = NULL;
   cras_features_set_override(CrOSLateBootCrasSplitAlsaUSBInternal, true);
+  snd_hctl_load_hold = false;
+  snd_hctl_loading = 0;
+  iodevs_per_card.clear();
+  probed_cards.clear();
+  card_probed_called = 0;
 }
 
 TEST(AlsaCard, CreateFailInvalidCard) {
@@ -1088,10 +1112,203 @@ TEST(AlsaCard, UCMIgnoreSuffix) {
   cras_alsa_card_destroy(c);
 }
 
+TEST(AlsaCard, ProbeThenComplete) {
+  struct cras_alsa_card* c;
+  int dev_nums[] = {0};
+  int info_rets[] = {0, -1};
+  struct pollfd fds[] = {{.fd = 5, .events = POLLIN, .revents = 0}};
+  cras_alsa_card_info card_info;
+
+  ResetStubData();
+  snd_ctl_pcm_next_device_set_devs_size = ARRAY_SIZE(dev_nums);
+  snd_ctl_pcm_next_device_set_devs = dev_nums;
+  snd_ctl_pcm_info_rets_size = ARRAY_SIZE(info_rets);
+  snd_ctl_pcm_info_rets = info_rets;
+  snd_hctl_poll_descriptors_fds = fds;
+  snd_hctl_poll_descriptors_num_fds = ARRAY_SIZE(fds);
+  card_info.card_type = ALSA_CARD_TYPE_USB;
+  card_info.card_index = 0;
+
+  // Probing loads the card but adds nothing to the system.
+  c = cras_alsa_card_probe(&card_info, device_config_dir, NULL);
+  ASSERT_NE(static_cast<struct cras_alsa_card*>(NULL), c);
+  EXPECT_EQ(1, snd_hctl_load_called);
+  EXPECT_EQ(1, cras_alsa_mixer_create_called);
+  EXPECT_EQ(1, ucm_get_flag_called);
+  EXPECT_EQ(0, snd_ctl_pcm_next_device_called);
+  EXPECT_EQ(0, cras_alsa_usb_iodev_create_called);
+  EXPECT_EQ(0, cras_system_add_select_fd_called);
+  EXPECT_EQ(0, snd_ctl_close_called);
+
+  EXPECT_EQ(0, cras_alsa_card_complete(c, &card_info, fake_blocklist));
+  EXPECT_EQ(1, cras_alsa_usb_iodev_create_called);
+  EXPECT_EQ(1, cras_system_add_select_fd_called);
+  EXPECT_EQ(1, snd_ctl_close_called);
+
+  cras_alsa_card_destroy(c);
+  EXPECT_EQ(1, snd_ctl_close_called);
+  EXPECT_EQ(1, cras_alsa_usb_iodev_destroy_called);
+  EXPECT_EQ(1, cras_system_rm_select_fd_called);
+  EXPECT_EQ(cras_alsa_mixer_create_called, cras_alsa_mixer_destroy_called);
+}
+
+TEST(AlsaCard, DestroyProbedCard) {
+  struct cras_alsa_card* c;
+  cras_alsa_card_info card_info;
+
+  ResetStubData();
+  card_info.card_type = ALSA_CARD_TYPE_USB;
+  card_info.card_index = 0;
+  c = cras_alsa_card_probe(&card_info, device_config_dir, NULL);
+  ASSERT_NE(static_cast<struct cras_alsa_card*>(NULL), c);
+
+  cras_alsa_card_destroy(c);
+  EXPECT_EQ(1, snd_ctl_close_called);
+  EXPECT_EQ(1, snd_hctl_close_called);
+  EXPECT_EQ(1, ucm_destroy_called);
+  EXPECT_EQ(cras_alsa_mixer_create_called, cras_alsa_mixer_destroy_called);
+}
+
+// Runs the handler of one message from the probe workers, as the main loop.
+static void dispatch_main_message() {
+  uint8_t buf[256];
+  struct cras_main_message* msg = (struct cras_main_message*)buf;
+  size_t header = sizeof(msg->length);
+
+  ASSERT_EQ(header, read(main_message_fds[0], buf, header));
+  ASSERT_EQ(msg->length - header,
+            read(main_message_fds[0], buf + header, msg->length - header));
+  ASSERT_NE(nullptr, main_message_callback);
+  main_message_callback(msg, main_message_callback_data);
+}
+
+static void card_probed(struct cras_alsa_card* alsa_card,
+                        struct cras_alsa_card_info* info,
+                        void* arg) {
+  card_probed_called++;
+  ASSERT_NE(static_cast<struct cras_alsa_card*>(NULL), alsa_card);
+  // Every card has the same devices.
+  snd_ctl_pcm_next_device_set_devs_index = 0;
+  snd_ctl_pcm_info_rets_index = 0;
+  EXPECT_EQ(0, cras_alsa_card_complete(alsa_card, info, fake_blocklist));
+  probed_cards.push_back(alsa_card);
+}
+
+// Lets the snd_hctl_load() calls held by snd_hctl_load_hold return.
+static void release_hctl_load() {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
+  snd_hctl_load_hold = false;
+  probe_stubs_cond.notify_all();
+}
+
+/* The cards are probed by workers at the same time, while the main thread
+ * creates no iodev until the result of each card comes back. */
+TEST(AlsaCard, ProbeCardsInParallel) {
+  static const unsigned int kNumCards = 4;
+  int dev_nums[] = {0};
+  int info_rets[] = {0, -1};
+  cras_alsa_card_info card_info;
+  bool all_loading;
+
+  ResetStubData();
+  ASSERT_EQ(0, pipe(main_message_fds));
+  snd_ctl_pcm_next_device_set_devs_size = ARRAY_SIZE(dev_nums);
+  snd_ctl_pcm_next_device_set_devs = dev_nums;
+  snd_ctl_pcm_info_rets_size = ARRAY_SIZE(info_rets);
+  snd_ctl_pcm_info_rets = info_rets;
+  snd_hctl_load_hold = true;
+  card_info.card_type = ALSA_CARD_TYPE_USB;
+
+  ASSERT_EQ(0, cras_alsa_probe_init(kNumCards));
+  for (unsigned int i = 0; i < kNumCards; i++) {
+    card_info.card_index = i;
+    ASSERT_EQ(0, cras_alsa_probe_card(&card_info, device_config_dir, NULL, 0,
+                                      card_probed, NULL));
+  }
+  EXPECT_EQ(0, cras_alsa_usb_iodev_create_called);
+
+  // Every card is loading before any of them is done. The timeout only
+  // keeps a serial probe from hanging the test.
+  {
+    std::unique_lock<std::mutex> lock(probe_stubs_lock);
+    all_loading = probe_stubs_cond.wait_for(
+        lock, std::chrono::seconds(10),
+        [] { return snd_hctl_loading == kNumCards; });
+  }
+  EXPECT_TRUE(all_loading);
+  EXPECT_EQ(0, cras_alsa_usb_iodev_create_called);
+  release_hctl_load();
+
+  // Each card gets its iodev when its result is handled on the main thread.
+  for (unsigned int i = 0; i < kNumCards; i++) {
+    dispatch_main_message();
+    EXPECT_EQ(i + 1, card_probed_called);
+    EXPECT_EQ(i + 1, iodevs_per_card.size());
+  }
+  for (unsigned int i = 0; i < kNumCards; i++) {
+    EXPECT_EQ(1, iodevs_per_card[i]);
+    EXPECT_EQ(0, cras_alsa_probe_pending(i));
+  }
+  for (struct cras_alsa_card* c : probed_cards) {
+    cras_alsa_card_destroy(c);
+  }
+  cras_alsa_probe_deinit();
+  close(main_message_fds[0]);
+  close(main_message_fds[1]);
+
+  EXPECT_EQ(kNumCards, snd_hctl_load_called);
+  EXPECT_EQ(cras_alsa_mixer_create_called, cras_alsa_mixer_destroy_called);
+}
+
+TEST(AlsaCard, CancelProbe) {
+  cras_alsa_card_info card_info;
+
+  ResetStubData();
+  ASSERT_EQ(0, pipe(main_message_fds));
+  snd_hctl_load_hold = true;
+  card_info.card_type = ALSA_CARD_TYPE_USB;
+
+  // With one worker, card 0 is being probed while card 1 waits for it.
+  ASSERT_EQ(0, cras_alsa_probe_init(1));
+  card_info.card_index = 0;
+  ASSERT_EQ(0, cras_alsa_probe_card(&card_info, device_config_dir, NULL, 0,
+                                    card_probed, NULL));
+  EXPECT_EQ(-EEXIST, cras_alsa_probe_card(&card_info, device_config_dir, NULL,
+                                          0, card_probed, NULL));
+  card_info.card_index = 1;
+  ASSERT_EQ(0, cras_alsa_probe_card(&card_info, device_config_dir, NULL, 0,
+                                    card_probed, NULL));
+  EXPECT_EQ(1, cras_alsa_probe_pending(0));
+  EXPECT_EQ(1, cras_alsa_probe_pending(1));
+  // Wait for the worker to start on card 0.
+  {
+    std::unique_lock<std::mutex> lock(probe_stubs_lock);
+    probe_stubs_cond.wait(lock, [] { return snd_hctl_loading > 0; });
+  }
+
+  EXPECT_EQ(0, cras_alsa_probe_cancel(1));
+  EXPECT_EQ(0, cras_alsa_probe_cancel(0));
+  EXPECT_EQ(-ENOENT, cras_alsa_probe_cancel(0));
+  EXPECT_EQ(0, cras_alsa_probe_pending(0));
+  EXPECT_EQ(0, cras_alsa_probe_pending(1));
+  release_hctl_load();
+
+  // The result of card 0 still comes back, and is dropped.
+  dispatch_main_message();
+  EXPECT_EQ(0, card_probed_called);
+  cras_alsa_probe_deinit();
+  close(main_message_fds[0]);
+  close(main_message_fds[1]);
+
+  EXPECT_EQ(1, cras_alsa_mixer_create_called);
+  EXPECT_EQ(1, cras_alsa_mixer_destroy_called);
+}
+
 // Stubs
 
 extern "C" {
 struct cras_alsa_mixer* cras_alsa_mixer_create(const char* card_name) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   cras_alsa_mixer_create_called++;
   return cras_alsa_mixer_create_return;
 }
@@ -1101,6 +1318,7 @@ int cras_alsa_mixer_add_controls_by_name_matching(
     struct mixer_name* extra_controls,
     struct mixer_name* coupled_controls,
     enum CRAS_ALSA_CARD_TYPE card_type) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   /* Duplicate coupled_output_names to verify in the end of unittest
    * because names will get freed later in cras_alsa_card_create. */
   struct mixer_name* control;
@@ -1186,6 +1404,7 @@ struct cras_iodev* cras_alsa_usb_iodev_create(
     size_t usb_pid,
     char* usb_serial_number) {
   struct cras_iodev* result = NULL;
+  iodevs_per_card[card_index]++;
   if (cras_alsa_usb_iodev_create_called <
       cras_alsa_usb_iodev_create_return_size) {
     result =
@@ -1236,6 +1455,7 @@ size_t snd_ctl_card_info_sizeof() {
   return 10;
 }
 int snd_ctl_open(snd_ctl_t** handle, const char* name, int card) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   snd_ctl_open_called++;
   if (snd_ctl_open_return == 0) {
     *handle = reinterpret_cast<snd_ctl_t*>(0xff);
@@ -1284,6 +1504,7 @@ int snd_ctl_pcm_info(snd_ctl_t* ctl, snd_pcm_info_t* info) {
   return ret;
 }
 int snd_ctl_card_info(snd_ctl_t* ctl, snd_ctl_card_info_t* info) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   snd_ctl_card_info_called++;
   return snd_ctl_card_info_ret;
 }
@@ -1294,16 +1515,23 @@ const char* snd_ctl_card_info_get_id(const snd_ctl_card_info_t* obj) {
   return "TestId";
 }
 int snd_hctl_open(snd_hctl_t** hctlp, const char* name, int mode) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   *hctlp = snd_hctl_open_pointer_val;
   snd_hctl_open_called++;
   return snd_hctl_open_return_value;
 }
 int snd_hctl_nonblock(snd_hctl_t* hctl, int nonblock) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   snd_hctl_nonblock_called++;
   return 0;
 }
 int snd_hctl_load(snd_hctl_t* hctl) {
+  std::unique_lock<std::mutex> lock(probe_stubs_lock);
   snd_hctl_load_called++;
+  snd_hctl_loading++;
+  probe_stubs_cond.notify_all();
+  probe_stubs_cond.wait(lock, [] { return !snd_hctl_load_hold; });
+  snd_hctl_loading--;
   return snd_hctl_load_return_value;
 }
 int snd_hctl_close(snd_hctl_t* hctl) {
@@ -1340,6 +1568,7 @@ void cras_system_rm_select_fd(int fd) {
 
 struct cras_card_config* cras_card_config_create(const char* config_path,
                                                  const char* card_name) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   cras_card_config_dir = config_path;
   return NULL;
 }
@@ -1362,6 +1591,7 @@ int cras_device_blocklist_check(struct cras_device_blocklist* blocklist,
 }
 
 struct cras_use_case_mgr* ucm_create(const char* name) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   ucm_create_called++;
   strncpy(ucm_create_name, name, sizeof(ucm_create_name) - 1);
   return reinterpret_cast<struct cras_use_case_mgr*>(0x44);
@@ -1374,11 +1604,13 @@ void ucm_destroy(struct cras_use_case_mgr* mgr) {
 char* ucm_get_dev_for_mixer(struct cras_use_case_mgr* mgr,
                             const char* mixer,
                             enum CRAS_STREAM_DIRECTION dir) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   ucm_get_dev_for_mixer_called++;
   return strdup("device");
 }
 
 char* ucm_get_flag(struct cras_use_case_mgr* mgr, const char* flag_name) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   ucm_get_flag_called++;
   strncpy(ucm_get_flag_name, flag_name, sizeof(ucm_get_flag_name) - 1);
   return NULL;
@@ -1422,10 +1654,30 @@ int cras_alsa_mixer_add_controls_in_section(struct cras_alsa_mixer* cmix,
 }
 
 bool cras_system_check_ignore_ucm_suffix(const char* card_name) {
+  std::lock_guard<std::mutex> lock(probe_stubs_lock);
   cras_system_check_ignore_ucm_suffix_called++;
   return cras_system_check_ignore_ucm_suffix_value;
 }
 
+int cras_main_message_add_handler(enum CRAS_MAIN_MESSAGE_TYPE type,
+                                  cras_message_callback callback,
+                                  void* callback_data) {
+  main_message_callback = callback;
+  main_message_callback_data = callback_data;
+  return 0;
+}
+
+void cras_main_message_rm_handler(enum CRAS_MAIN_MESSAGE_TYPE type) {
+  main_message_callback = NULL;
+}
+
+int cras_main_message_send(struct cras_main_message* msg) {
+  if (write(main_message_fds[1], msg, msg->length) != (ssize_t)msg->length) {
+    return -EIO;
+  }
+  return 0;
+}
+
 void ucm_free_mixer_names(struct mixer_name* names) {
   struct mixer_name* m;
   DL_FOREACH (names, m) {
@@ -12,7 +12,7 @@ extern "C" {
 
 // Function call counters
 static int cras_system_state_add_snapshot_called;
-static int audio_thread_dump_thread_info_called;
+static int cras_iodev_list_dump_audio_thread_info_called;
 static int cras_observer_notify_severe_underrun_called;
 static int cras_observer_notify_underrun_called;
 
@@ -22,7 +22,7 @@ struct cras_audio_thread_event_message message;
 
 void ResetStubData() {
   cras_system_state_add_snapshot_called = 0;
-  audio_thread_dump_thread_info_called = 0;
+  cras_iodev_list_dump_audio_thread_info_called = 0;
   cras_observer_notify_severe_underrun_called = 0;
   cras_observer_notify_underrun_called = 0;
   type_set = (enum CRAS_MAIN_MESSAGE_TYPE)999;
@@ -71,7 +71,7 @@ TEST_F(AudioThreadMonitorTestSuite, DropSamples) {
 TEST_F(AudioThreadMonitorTestSuite, TakeSnapshot) {
   take_snapshot(AUDIO_THREAD_EVENT_DEBUG);
   EXPECT_EQ(cras_system_state_add_snapshot_called, 1);
-  EXPECT_EQ(audio_thread_dump_thread_info_called, 1);
+  EXPECT_EQ(cras_iodev_list_dump_audio_thread_info_called, 1);
 }
 
 TEST_F(AudioThreadMonitorTestSuite, EventHandlerDoubleCall) {
@@ -79,12 +79,12 @@ TEST_F(AudioThreadMonitorTestSuite, EventHandlerDoubleCall) {
   msg.event_type = AUDIO_THREAD_EVENT_DEBUG;
   handle_audio_thread_event_message((struct cras_main_message*)&msg, NULL);
   EXPECT_EQ(cras_system_state_add_snapshot_called, 1);
-  EXPECT_EQ(audio_thread_dump_thread_info_called, 1);
+  EXPECT_EQ(cras_iodev_list_dump_audio_thread_info_called, 1);
 
   // take_snapshot shouldn't be called since the time interval is short
   handle_audio_thread_event_message((struct cras_main_message*)&msg, NULL);
   EXPECT_EQ(cras_system_state_add_snapshot_called, 1);
-  EXPECT_EQ(audio_thread_dump_thread_info_called, 1);
+  EXPECT_EQ(cras_iodev_list_dump_audio_thread_info_called, 1);
 }
 
 TEST_F(AudioThreadMonitorTestSuite, EventHandlerIgnoreInvalidEvent) {
@@ -92,7 +92,7 @@ TEST_F(AudioThreadMonitorTestSuite, EventHandlerIgnoreInvalidEvent) {
   msg.event_type = (enum CRAS_AUDIO_THREAD_EVENT_TYPE)999;
   handle_audio_thread_event_message((struct cras_main_message*)&msg, NULL);
   EXPECT_EQ(cras_system_state_add_snapshot_called, 0);
-  EXPECT_EQ(audio_thread_dump_thread_info_called, 0);
+  EXPECT_EQ(cras_iodev_list_dump_audio_thread_info_called, 0);
 }
 
 TEST_F(AudioThreadMonitorTestSuite, EventHandlerSevereUnderrun) {
@@ -128,13 +128,8 @@ void cras_system_state_add_snapshot(
   cras_system_state_add_snapshot_called++;
 }
 
-struct audio_thread* cras_iodev_list_get_audio_thread() {
-  return reinterpret_cast<struct audio_thread*>(0xff);
-}
-
-int audio_thread_dump_thread_info(struct audio_thread* thread,
-                                  struct audio_debug_info* info) {
-  audio_thread_dump_thread_info_called++;
+int cras_iodev_list_dump_audio_thread_info(struct audio_debug_info* info) {
+  cras_iodev_list_dump_audio_thread_info_called++;
   return 0;
 }
 
@@ -11,6 +11,9 @@ extern "C" {
 
 #include <gtest/gtest.h>
 #include <map>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
 
 #define MAX_CALLS 10
 #define BUFFER_SIZE 8192
@@ -36,6 +39,8 @@ static unsigned int cras_iodev_put_output_buffer_nframes;
 static unsigned int cras_iodev_fill_odev_zeros_frames;
 static int dev_stream_playback_frames_ret;
 static int dev_stream_mix_called;
+static int dev_stream_copy_called;
+static int dev_stream_is_passthrough_ret;
 static unsigned int dev_stream_update_next_wake_time_called;
 static unsigned int dev_stream_request_playback_samples_called;
 static unsigned int cras_iodev_prepare_output_before_write_samples_called;
@@ -85,6 +90,8 @@ void ResetGlobalStubData() {
   cras_iodev_frames_to_play_in_sleep_called = 0;
   dev_stream_playback_frames_ret = 0;
   dev_stream_mix_called = 0;
+  dev_stream_copy_called = 0;
+  dev_stream_is_passthrough_ret = 0;
   dev_stream_request_playback_samples_called = 0;
   dev_stream_update_next_wake_time_called = 0;
   cras_iodev_prepare_output_before_write_samples_called = 0;
@@ -113,6 +120,7 @@ void SetupRstream(struct cras_rstream* rstream,
   uint32_t used_size = 4096 * frame_bytes;
 
   memset(rstream, 0, sizeof(*rstream));
+  rstream->fd = -1;
   rstream->direction = direction;
   rstream->cb_threshold = 480;
   rstream->format.frame_rate = 48000;
@@ -525,6 +533,359 @@ TEST_F(StreamDeviceSuite, AddOutputStream) {
   TearDownRstream(&rstream);
 }
 
+static int WaitSetReadyCount(struct audio_thread* thread) {
+  struct epoll_event events[4];
+  return epoll_wait(thread->wait_set_fd, events, 4, 0);
+}
+
+TEST_F(StreamDeviceSuite, StreamFdInWaitSet) {
+  struct cras_iodev iodev, iodev2, *iodevs[] = {&iodev, &iodev2};
+  struct cras_rstream rstream;
+  int sv[2];
+  char c = 0;
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+  SetupDevice(&iodev, CRAS_STREAM_OUTPUT);
+  SetupDevice(&iodev2, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream, CRAS_STREAM_OUTPUT);
+  rstream.fd = sv[0];
+
+  thread_add_open_dev(thread_, &iodev);
+  thread_add_open_dev(thread_, &iodev2);
+  thread_add_stream(thread_, &rstream, iodevs, 2);
+  EXPECT_EQ(2, rstream.num_attached_devs);
+
+  // Messages from the client don't wake the thread up unless it waits for a
+  // reply.
+  cras_rstream_is_pending_reply_ret = 0;
+  update_stream_waits(thread_);
+  ASSERT_EQ(1, write(sv[1], &c, 1));
+  EXPECT_EQ(0, WaitSetReadyCount(thread_));
+  ASSERT_EQ(1, read(sv[0], &c, 1));
+
+  // A client reply wakes the thread up.
+  cras_rstream_is_pending_reply_ret = 1;
+  update_stream_waits(thread_);
+  ASSERT_EQ(1, write(sv[1], &c, 1));
+  EXPECT_EQ(1, WaitSetReadyCount(thread_));
+  // Edge triggered, unread data doesn't wake the thread up again.
+  EXPECT_EQ(0, WaitSetReadyCount(thread_));
+
+  // Still attached to iodev2, so it stays in the wait set.
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev.info.idx);
+  ASSERT_EQ(1, write(sv[1], &c, 1));
+  EXPECT_EQ(1, WaitSetReadyCount(thread_));
+
+  // Handled replies stop the wait.
+  cras_rstream_is_pending_reply_ret = 0;
+  update_stream_waits(thread_);
+  ASSERT_EQ(1, write(sv[1], &c, 1));
+  EXPECT_EQ(0, WaitSetReadyCount(thread_));
+
+  cras_rstream_is_pending_reply_ret = 1;
+  update_stream_waits(thread_);
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev2.info.idx);
+  EXPECT_EQ(0, rstream.num_attached_devs);
+  ASSERT_EQ(1, write(sv[1], &c, 1));
+  EXPECT_EQ(0, WaitSetReadyCount(thread_));
+
+  close(sv[0]);
+  close(sv[1]);
+  TearDownRstream(&rstream);
+}
+
+static int wait_set_callback(void* data, int revents) {
+  return 0;
+}
+
+TEST_F(StreamDeviceSuite, CallbackFdInWaitSet) {
+  int sv[2];
+  char c = 0;
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+  ASSERT_EQ(1, write(sv[1], &c, 1));
+
+  audio_thread_add_events_callback(sv[0], wait_set_callback, NULL, POLLIN);
+  EXPECT_EQ(1, WaitSetReadyCount(thread_));
+
+  // Only callbacks triggered by poll are in the wait set.
+  audio_thread_config_events_callback(sv[0], TRIGGER_WAKEUP);
+  EXPECT_EQ(0, WaitSetReadyCount(thread_));
+  audio_thread_config_events_callback(sv[0], TRIGGER_POLL);
+  EXPECT_EQ(1, WaitSetReadyCount(thread_));
+
+  audio_thread_rm_callback(sv[0]);
+  EXPECT_EQ(0, WaitSetReadyCount(thread_));
+
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST_F(StreamDeviceSuite, CallbackOnCurrentThread) {
+  struct audio_thread* thread2 = audio_thread_create();
+  struct audio_thread* prev;
+  int sv[2];
+  char c = 0;
+
+  ASSERT_NE(nullptr, thread2);
+  EXPECT_EQ(thread_, audio_thread_get_current());
+  EXPECT_EQ(thread_->atlog, atlog);
+  EXPECT_NE(thread_->atlog, thread2->atlog);
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+  ASSERT_EQ(1, write(sv[1], &c, 1));
+
+  // Registered to the thread the device being opened runs on.
+  prev = audio_thread_set_current(thread2);
+  EXPECT_EQ(thread_, prev);
+  audio_thread_add_events_callback(sv[0], wait_set_callback, NULL, POLLIN);
+  EXPECT_EQ(0, WaitSetReadyCount(thread_));
+  EXPECT_EQ(1, WaitSetReadyCount(thread2));
+  audio_thread_rm_callback(sv[0]);
+  EXPECT_EQ(0, WaitSetReadyCount(thread2));
+  audio_thread_set_current(prev);
+
+  audio_thread_destroy(thread2);
+  EXPECT_EQ(thread_, audio_thread_get_current());
+  EXPECT_EQ(thread_->atlog, atlog);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST_F(StreamDeviceSuite, EventLogSections) {
+  struct audio_thread* threads[CRAS_MAX_AUDIO_THREADS];
+  int shm_fd = audio_thread_event_log_shm_fd();
+  unsigned int i;
+
+  // Every thread logs to its own section of the shared event log.
+  threads[0] = thread_;
+  for (i = 1; i < CRAS_MAX_AUDIO_THREADS; i++) {
+    threads[i] = audio_thread_create();
+    ASSERT_NE(nullptr, threads[i]);
+    EXPECT_EQ(thread_->atlog + i, threads[i]->atlog);
+    EXPECT_EQ(AUDIO_THREAD_EVENT_LOG_SIZE, threads[i]->atlog->len);
+  }
+  EXPECT_EQ(shm_fd, audio_thread_event_log_shm_fd());
+  EXPECT_EQ(nullptr, audio_thread_create());
+
+  // A new thread takes the free section and starts with an empty log.
+  ATLOG(threads[1]->atlog, AUDIO_THREAD_WAKE, 0, 0, 0);
+  audio_thread_destroy(threads[1]);
+  threads[1] = audio_thread_create();
+  ASSERT_NE(nullptr, threads[1]);
+  EXPECT_EQ(thread_->atlog + 1, threads[1]->atlog);
+  EXPECT_EQ(0, threads[1]->atlog->write_pos);
+
+  for (i = 1; i < CRAS_MAX_AUDIO_THREADS; i++) {
+    audio_thread_destroy(threads[i]);
+  }
+  EXPECT_EQ(thread_->atlog, atlog);
+}
+
+static void FillEventLog(struct audio_thread_event_log* log,
+                         uint64_t first,
+                         uint64_t last,
+                         unsigned int step_ns,
+                         unsigned int offset_ns,
+                         uint32_t data) {
+  for (uint64_t i = first; i < last; i++) {
+    struct audio_thread_event* ev =
+        &log->log[i % AUDIO_THREAD_EVENT_LOG_SIZE];
+    uint64_t ns = i * step_ns + offset_ns;
+
+    ev->tag_sec = (AUDIO_THREAD_WAKE << 24) | (ns / 1000000000);
+    ev->nsec = ns % 1000000000;
+    ev->data1 = data;
+    ev->data2 = i;
+  }
+  log->write_pos = last;
+}
+
+TEST(AudioThreadEventLog, MergeEventLogs) {
+  struct audio_debug_info* infos[2];
+  struct audio_thread_event_log* merged;
+
+  infos[0] = (struct audio_debug_info*)calloc(1, sizeof(*infos[0]));
+  infos[1] = (struct audio_debug_info*)calloc(1, sizeof(*infos[1]));
+  merged = (struct audio_thread_event_log*)calloc(1, sizeof(*merged));
+
+  // Events 1s apart, the second thread logs between two of the first.
+  FillEventLog(&infos[0]->log, 0, 3, 1000000000, 0, 0);
+  FillEventLog(&infos[1]->log, 0, 2, 1000000000, 500000000, 1);
+  merge_event_logs(merged, infos, 2);
+
+  static const uint32_t order[] = {0, 1, 0, 1, 0};
+  ASSERT_EQ(5, merged->write_pos);
+  EXPECT_EQ(5, merged->sync_write_pos);
+  EXPECT_EQ(AUDIO_THREAD_EVENT_LOG_SIZE, merged->len);
+  for (unsigned int i = 0; i < 5; i++) {
+    EXPECT_EQ(order[i], merged->log[i].data1);
+    EXPECT_EQ(i / 2, merged->log[i].data2);
+  }
+
+  free(infos[0]);
+  free(infos[1]);
+  free(merged);
+}
+
+TEST(AudioThreadEventLog, MergeKeepsLatestEvents) {
+  struct audio_debug_info* infos[2];
+  struct audio_thread_event_log* merged;
+  uint64_t total = AUDIO_THREAD_EVENT_LOG_SIZE + 20;
+
+  infos[0] = (struct audio_debug_info*)calloc(1, sizeof(*infos[0]));
+  infos[1] = (struct audio_debug_info*)calloc(1, sizeof(*infos[1]));
+  merged = (struct audio_thread_event_log*)calloc(1, sizeof(*merged));
+
+  // The first log wrapped, only its last AUDIO_THREAD_EVENT_LOG_SIZE events
+  // are left. The second thread logged once after all of them.
+  FillEventLog(&infos[0]->log, 0, total, 1000, 0, 0);
+  FillEventLog(&infos[1]->log, 0, 1, 1000, total * 1000, 1);
+  merge_event_logs(merged, infos, 2);
+
+  ASSERT_EQ(AUDIO_THREAD_EVENT_LOG_SIZE + 1, merged->write_pos);
+  // The oldest event was overwritten by the one of the second thread.
+  EXPECT_EQ(1, merged->log[0].data1);
+  EXPECT_EQ(0, merged->log[1].data1);
+  EXPECT_EQ(total - AUDIO_THREAD_EVENT_LOG_SIZE + 1, merged->log[1].data2);
+  EXPECT_EQ(total - 1,
+            merged->log[AUDIO_THREAD_EVENT_LOG_SIZE - 1].data2);
+
+  free(infos[0]);
+  free(infos[1]);
+  free(merged);
+}
+
+TEST(AudioThreadEventLog, DropEventsWithoutLog) {
+  struct audio_thread_event_log* saved = atlog;
+
+  // Threads other than the audio and main threads have no event log.
+  atlog = NULL;
+  ATLOG(atlog, AUDIO_THREAD_WAKE, 0, 0, 0);
+  atlog = saved;
+}
+
+TEST_F(StreamDeviceSuite, WaitForEventsTimeout) {
+  struct epoll_event events[4];
+  struct timespec ts = {0, 1000000};
+
+  // The wake up timer fires.
+  ASSERT_EQ(1, wait_for_events(thread_, &ts, events, 4));
+  EXPECT_EQ(&thread_->timer_fd, events[0].data.ptr);
+
+  // A zero timeout disarms the fired timer and returns immediately.
+  ts.tv_nsec = 0;
+  EXPECT_EQ(0, wait_for_events(thread_, &ts, events, 4));
+}
+
+// Handles the commands of one doorbell ring, like the running thread does.
+static void* HandleOneDoorbell(void* arg) {
+  struct audio_thread* thread = static_cast<struct audio_thread*>(arg);
+  struct pollfd pfd = {thread->doorbell_fd, POLLIN, 0};
+
+  atlog = thread->atlog;
+  if (poll(&pfd, 1, 5000) == 1) {
+    handle_audio_thread_message(thread);
+  }
+  return NULL;
+}
+
+struct CmdRingPushArgs {
+  struct audio_thread* thread;
+  struct audio_thread_msg* msg;
+  audio_thread_token_t token;
+  int rc;
+};
+
+static void* CmdRingPushThread(void* arg) {
+  struct CmdRingPushArgs* args = static_cast<struct CmdRingPushArgs*>(arg);
+
+  args->rc = cmd_ring_push(args->thread, args->msg, &args->token);
+  return NULL;
+}
+
+TEST_F(StreamDeviceSuite, StartRampReturnsThreadResult) {
+  struct cras_iodev iodev;
+
+  SetupDevice(&iodev, CRAS_STREAM_OUTPUT);
+  thread_add_open_dev(thread_, &iodev);
+  iodev.ramp = reinterpret_cast<cras_ramp*>(0x123);
+
+  pthread_t handler;
+
+  thread_->started = 1;
+  ASSERT_EQ(0, pthread_create(&handler, NULL, HandleOneDoorbell, thread_));
+  EXPECT_EQ(0, audio_thread_dev_start_ramp(thread_, iodev.info.idx,
+                                           CRAS_IODEV_RAMP_REQUEST_DOWN_MUTE));
+  pthread_join(handler, NULL);
+  EXPECT_EQ(&iodev, cras_iodev_start_ramp_odev);
+  EXPECT_EQ(CRAS_IODEV_RAMP_REQUEST_DOWN_MUTE, cras_iodev_start_ramp_request);
+
+  // The error of an unknown device reaches the caller.
+  ResetStubData();
+  ASSERT_EQ(0, pthread_create(&handler, NULL, HandleOneDoorbell, thread_));
+  EXPECT_EQ(-EINVAL,
+            audio_thread_dev_start_ramp(thread_, iodev.info.idx + 1,
+                                        CRAS_IODEV_RAMP_REQUEST_DOWN_MUTE));
+  pthread_join(handler, NULL);
+  EXPECT_EQ(NULL, cras_iodev_start_ramp_odev);
+  thread_->started = 0;
+
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev.info.idx);
+}
+
+TEST_F(StreamDeviceSuite, CommandRingPreservesOrder) {
+  struct audio_thread_msg msg;
+  audio_thread_token_t first, second;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.id = AUDIO_THREAD_SYNC;
+  msg.length = sizeof(msg);
+  ASSERT_EQ(0, cmd_ring_push(thread_, &msg, &first));
+  ASSERT_EQ(0, cmd_ring_push(thread_, &msg, &second));
+  EXPECT_LT(first, second);
+
+  cmd_ring_pop(thread_);
+  EXPECT_TRUE(audio_thread_token_done(thread_, first));
+  EXPECT_FALSE(audio_thread_token_done(thread_, second));
+  cmd_ring_pop(thread_);
+  EXPECT_TRUE(audio_thread_token_done(thread_, second));
+  EXPECT_EQ(NULL, cmd_ring_peek(thread_->cmd_ring));
+}
+
+TEST_F(StreamDeviceSuite, CommandRingFullWaitsForRoom) {
+  struct audio_thread_msg msg;
+  struct CmdRingPushArgs args;
+  pthread_t pusher;
+  audio_thread_token_t token;
+  unsigned int i;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.id = AUDIO_THREAD_SYNC;
+  msg.length = sizeof(msg);
+  for (i = 0; i < CMD_RING_SLOTS; i++) {
+    ASSERT_EQ(0, cmd_ring_push(thread_, &msg, &token));
+  }
+
+  // Nothing will make room if the thread isn't running.
+  EXPECT_EQ(-EAGAIN, cmd_ring_push(thread_, &msg, &token));
+
+  // Otherwise the push blocks until the thread handles a command.
+  thread_->started = 1;
+  args = {thread_, &msg, 0, -1};
+  ASSERT_EQ(0, pthread_create(&pusher, NULL, CmdRingPushThread, &args));
+  cmd_ring_pop(thread_);
+  pthread_join(pusher, NULL);
+  thread_->started = 0;
+  EXPECT_EQ(0, args.rc);
+  EXPECT_FALSE(audio_thread_token_done(thread_, args.token));
+
+  for (i = 0; i < CMD_RING_SLOTS; i++) {
+    cmd_ring_pop(thread_);
+  }
+  EXPECT_TRUE(audio_thread_token_done(thread_, args.token));
+}
+
 TEST_F(StreamDeviceSuite, OutputStreamFetchTime) {
   struct cras_iodev iodev, *piodev = &iodev;
   struct cras_rstream rstream1, rstream2;
@@ -879,6 +1240,46 @@ TEST_F(StreamDeviceSuite, MixOutputSamples) {
   TearDownRstream(&rstream2);
 }
 
+TEST_F(StreamDeviceSuite, CopyOutputSamplesOfSinglePassthroughStream) {
+  struct cras_iodev iodev, *piodev = &iodev;
+  struct cras_rstream rstream1;
+  struct cras_rstream rstream2;
+  struct open_dev* adev;
+
+  ResetGlobalStubData();
+
+  SetupDevice(&iodev, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream1, CRAS_STREAM_OUTPUT);
+  SetupRstream(&rstream2, CRAS_STREAM_OUTPUT);
+  cras_iodev_get_output_buffer_area = cras_audio_area_create(2);
+  thread_add_open_dev(thread_, &iodev);
+  thread_add_stream(thread_, &rstream1, &piodev, 1);
+  adev = thread_->open_devs[CRAS_STREAM_OUTPUT];
+  iodev.state = CRAS_IODEV_STATE_NORMAL_RUN;
+  cras_iodev_prepare_output_before_write_samples_state =
+      CRAS_IODEV_STATE_NORMAL_RUN;
+  frames_queued_ = 0;
+  dev_stream_playback_frames_ret = 100;
+  dev_stream_set_running(iodev.streams);
+
+  // A stream in the format of the device is copied, not mixed.
+  dev_stream_is_passthrough_ret = 1;
+  write_output_samples(&thread_->open_devs[CRAS_STREAM_OUTPUT], adev, nullptr);
+  EXPECT_EQ(1, dev_stream_copy_called);
+  EXPECT_EQ(0, dev_stream_mix_called);
+
+  // Nothing is copied over another stream.
+  thread_add_stream(thread_, &rstream2, &piodev, 1);
+  dev_stream_set_running(iodev.streams->prev);
+  write_output_samples(&thread_->open_devs[CRAS_STREAM_OUTPUT], adev, nullptr);
+  EXPECT_EQ(1, dev_stream_copy_called);
+  EXPECT_EQ(2, dev_stream_mix_called);
+
+  thread_rm_open_dev(thread_, CRAS_STREAM_OUTPUT, iodev.info.idx);
+  TearDownRstream(&rstream1);
+  TearDownRstream(&rstream2);
+}
+
 TEST_F(StreamDeviceSuite, DoPlaybackNoStream) {
   struct cras_iodev iodev;
 
@@ -1059,6 +1460,10 @@ double cras_iodev_get_est_rate_ratio(const struct cras_iodev* iodev) {
   return 1.0;
 }
 
+double cras_iodev_get_rate_est_underrun_ratio(const struct cras_iodev* iodev) {
+  return 0;
+}
+
 unsigned int cras_iodev_max_stream_offset(const struct cras_iodev* iodev) {
   return 0;
 }
@@ -1127,6 +1532,16 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
   return 0;
 }
 
+int cras_iodev_put_output_mix_bus(struct cras_iodev* iodev,
+                                  uint8_t* frames,
+                                  unsigned int nframes,
+                                  int* non_empty,
+                                  struct cras_fmt_conv* output_converter) {
+  cras_iodev_put_output_buffer_called++;
+  cras_iodev_put_output_buffer_nframes = nframes;
+  return 0;
+}
+
 int cras_iodev_get_input_buffer(struct cras_iodev* iodev, unsigned* frames) {
   return 0;
 }
@@ -1145,6 +1560,13 @@ int cras_iodev_get_dsp_delay(const struct cras_iodev* iodev) {
 
 void cras_fmt_conv_destroy(struct cras_fmt_conv** conv) {}
 
+void cras_fmt_conv_pool_clear() {}
+
+void cras_fmt_conv_pool_stats(uint32_t* hits, uint32_t* misses) {
+  *hits = 0;
+  *misses = 0;
+}
+
 struct cras_fmt_conv* cras_channel_remix_conv_create(unsigned int num_channels,
                                                      const float* coefficient) {
   return NULL;
@@ -1211,6 +1633,13 @@ unsigned int dev_stream_capture(struct dev_stream* dev_stream,
   return 0;
 }
 
+void dev_stream_capture_finish(struct dev_stream* dev_stream) {}
+
+int dev_stream_share_playback_conv(struct dev_stream* dev_stream,
+                                   struct dev_stream* other) {
+  return -EINVAL;
+}
+
 unsigned int dev_stream_capture_avail(const struct dev_stream* dev_stream) {
   return 0;
 }
@@ -1230,6 +1659,7 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
                                      const struct timespec* sleep_interval_ts) {
   struct dev_stream* out = static_cast<dev_stream*>(calloc(1, sizeof(*out)));
   out->stream = stream;
+  stream->num_attached_devs++;
   init_cb_ts_ = *cb_ts;
   if (sleep_interval_ts) {
     sleep_interval_ts_ = *sleep_interval_ts;
@@ -1240,6 +1670,7 @@ struct dev_stream* dev_stream_create(struct cras_rstream* stream,
 }
 
 void dev_stream_destroy(struct dev_stream* dev_stream) {
+  dev_stream->stream->num_attached_devs--;
   free(dev_stream);
 }
 
@@ -1251,6 +1682,26 @@ int dev_stream_mix(struct dev_stream* dev_stream,
   return num_to_write;
 }
 
+int dev_stream_mix_float(struct dev_stream* dev_stream,
+                         const struct cras_audio_format* fmt,
+                         float* dst,
+                         unsigned int num_to_write) {
+  dev_stream_mix_called++;
+  return num_to_write;
+}
+
+int dev_stream_copy(struct dev_stream* dev_stream,
+                    const struct cras_audio_format* fmt,
+                    uint8_t* dst,
+                    unsigned int num_to_write) {
+  dev_stream_copy_called++;
+  return num_to_write;
+}
+
+int dev_stream_is_passthrough(const struct dev_stream* dev_stream) {
+  return dev_stream_is_passthrough_ret;
+}
+
 int dev_stream_playback_frames(const struct dev_stream* dev_stream) {
   return dev_stream_playback_frames_ret;
 }
@@ -1259,10 +1710,6 @@ int dev_stream_playback_update_rstream(struct dev_stream* dev_stream) {
   return 0;
 }
 
-int dev_stream_poll_stream_fd(const struct dev_stream* dev_stream) {
-  return dev_stream->stream->fd;
-}
-
 int dev_stream_request_playback_samples(struct dev_stream* dev_stream,
                                         const struct timespec* now) {
   dev_stream_request_playback_samples_called++;
@@ -38,7 +38,6 @@ static size_t cras_system_set_capture_mute_locked_value;
 static int cras_system_set_capture_mute_locked_called;
 static int cras_system_state_dump_snapshots_called;
 static size_t cras_make_fd_nonblocking_called;
-static audio_thread* iodev_get_thread_return;
 static int stream_list_add_stream_return;
 static unsigned int stream_list_add_stream_called;
 static unsigned int stream_list_disconnect_stream_called;
@@ -57,6 +56,8 @@ static size_t cras_observer_set_ops_called;
 static size_t cras_observer_ops_are_empty_called;
 static struct cras_observer_ops cras_observer_ops_are_empty_empty_ops;
 static size_t cras_observer_remove_called;
+static size_t cras_observer_set_interval_called;
+static unsigned int cras_observer_set_interval_ms;
 static struct packet_status_logger wbs_logger;
 
 void ResetStubData() {
@@ -77,7 +78,6 @@ void ResetStubData() {
   cras_system_set_capture_mute_locked_called = 0;
   cras_system_state_dump_snapshots_called = 0;
   cras_make_fd_nonblocking_called = 0;
-  iodev_get_thread_return = reinterpret_cast<audio_thread*>(0xad);
   stream_list_add_stream_return = 0;
   stream_list_add_stream_called = 0;
   stream_list_disconnect_stream_called = 0;
@@ -96,6 +96,8 @@ void ResetStubData() {
   memset(&cras_observer_ops_are_empty_empty_ops, 0,
          sizeof(cras_observer_ops_are_empty_empty_ops));
   cras_observer_remove_called = 0;
+  cras_observer_set_interval_called = 0;
+  cras_observer_set_interval_ms = 0;
 }
 
 namespace {
@@ -685,6 +687,78 @@ TEST_F(RClientMessagesSuite, SendNumActiveStreamsChanged) {
   EXPECT_EQ(msg->num_active_streams, num_active_streams);
 }
 
+// Reads one message from the pipe, which doesn't keep message boundaries.
+static ssize_t ReadMessage(int fd, uint8_t* buf) {
+  struct cras_client_message* header = (struct cras_client_message*)buf;
+  ssize_t rc;
+
+  rc = read(fd, buf, sizeof(*header));
+  if (rc != (ssize_t)sizeof(*header)) {
+    return rc;
+  }
+  rc = read(fd, buf + rc, header->length - sizeof(*header));
+  return rc < 0 ? rc : rc + sizeof(*header);
+}
+
+TEST_F(RClientMessagesSuite, NotificationIntervalBatchesNotifications) {
+  void* void_client = reinterpret_cast<void*>(rclient_);
+  struct cras_set_notification_interval msg;
+  uint8_t buf[CRAS_CLIENT_MAX_MSG_SIZE];
+  struct cras_client_notifications* notifications =
+      (struct cras_client_notifications*)buf;
+  struct cras_client_volume_changed* volume;
+  const uint32_t kPerMessage =
+      sizeof(notifications->data) / sizeof(struct cras_client_volume_changed);
+  int32_t next_volume = 0;
+  ssize_t rc;
+
+  cras_fill_set_notification_interval(&msg, 50);
+  rc =
+      rclient_->ops->handle_message_from_client(rclient_, &msg.header, NULL, 0);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, cras_observer_set_interval_called);
+  EXPECT_EQ(50, cras_observer_set_interval_ms);
+
+  // More notifications than fit in one message.
+  for (uint32_t i = 0; i < kPerMessage + 10; i++) {
+    send_output_volume_changed(void_client, i);
+  }
+  send_notifications(void_client);
+
+  for (uint32_t n : {kPerMessage, 10u}) {
+    rc = ReadMessage(pipe_fds_[0], buf);
+    ASSERT_EQ(rc, (ssize_t)(offsetof(struct cras_client_notifications, data) +
+                            n * sizeof(*volume)));
+    EXPECT_EQ(CRAS_CLIENT_NOTIFICATIONS, notifications->header.id);
+    ASSERT_EQ(n, notifications->num_notifications);
+    for (uint32_t i = 0; i < n; i++) {
+      volume = (struct cras_client_volume_changed*)(notifications->data +
+                                                    i * sizeof(*volume));
+      EXPECT_EQ(CRAS_CLIENT_OUTPUT_VOLUME_CHANGED, volume->header.id);
+      EXPECT_EQ(sizeof(*volume), volume->header.length);
+      EXPECT_EQ(next_volume++, volume->volume);
+    }
+  }
+
+  // Nothing is sent for an empty batch.
+  send_notifications(void_client);
+
+  // Without an interval notifications are sent on their own.
+  cras_fill_set_notification_interval(&msg, 0);
+  rc =
+      rclient_->ops->handle_message_from_client(rclient_, &msg.header, NULL, 0);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(2, cras_observer_set_interval_called);
+  EXPECT_EQ(0, cras_observer_set_interval_ms);
+  EXPECT_EQ(NULL, rclient_->notifications);
+  send_output_volume_changed(void_client, 90);
+  rc = ReadMessage(pipe_fds_[0], buf);
+  ASSERT_EQ(rc, (ssize_t)sizeof(*volume));
+  volume = (struct cras_client_volume_changed*)buf;
+  EXPECT_EQ(CRAS_CLIENT_OUTPUT_VOLUME_CHANGED, volume->header.id);
+  EXPECT_EQ(90, volume->volume);
+}
+
 }  //  namespace
 
 // stubs
@@ -693,10 +767,6 @@ extern "C" {
 struct cras_bt_event_log* btlog;
 struct main_thread_event_log* main_log;
 
-struct audio_thread* cras_iodev_list_get_audio_thread() {
-  return iodev_get_thread_return;
-}
-
 void cras_iodev_list_add_active_node(enum CRAS_STREAM_DIRECTION dir,
                                      cras_node_id_t node_id) {}
 
@@ -710,8 +780,7 @@ int audio_thread_rm_stream(audio_thread* thread, cras_rstream* stream) {
 void audio_thread_add_output_dev(struct audio_thread* thread,
                                  struct cras_iodev* odev) {}
 
-int audio_thread_dump_thread_info(struct audio_thread* thread,
-                                  struct audio_debug_info* info) {
+int cras_iodev_list_dump_audio_thread_info(struct audio_debug_info* info) {
   return 0;
 }
 
@@ -723,12 +792,9 @@ int audio_thread_resume(struct audio_thread* thread) {
   return 0;
 }
 
-int audio_thread_set_aec_dump(struct audio_thread* thread,
-                              cras_stream_id_t stream_id,
-                              unsigned int start,
-                              int fd) {
-  return 0;
-}
+void cras_iodev_list_set_aec_dump(cras_stream_id_t stream_id,
+                                  unsigned int start,
+                                  int fd) {}
 
 int audio_thread_event_log_shm_fd() {
   return -1;
@@ -927,6 +993,13 @@ void cras_observer_remove(struct cras_observer_client* client) {
   cras_observer_remove_called++;
 }
 
+void cras_observer_set_interval(struct cras_observer_client* client,
+                                unsigned int interval_ms,
+                                void (*flushed)(void* context)) {
+  cras_observer_set_interval_called++;
+  cras_observer_set_interval_ms = interval_ms;
+}
+
 bool cras_audio_format_valid(const struct cras_audio_format* fmt) {
   return true;
 }
@@ -4,6 +4,9 @@
 
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <sys/socket.h>
+
+#include <vector>
 
 extern "C" {
 #include "cras_messages.h"
@@ -26,6 +29,8 @@ static int samples_ready_frames_value;
 static uint8_t* samples_ready_samples_value;
 
 static int pthread_create_returned_value;
+static std::vector<int32_t> output_volume_changed_values;
+static int nodes_changed_called;
 
 namespace {
 
@@ -40,6 +45,8 @@ void InitStaticVariables() {
   mmap_return_value = NULL;
   samples_ready_called = 0;
   samples_ready_frames_value = 0;
+  output_volume_changed_values.clear();
+  nodes_changed_called = 0;
 }
 
 class CrasClientTestSuite : public testing::Test {
@@ -206,6 +213,220 @@ TEST_F(CrasClientTestSuite, OutputStreamConnected) {
   StreamConnected(CRAS_STREAM_OUTPUT);
 }
 
+TEST_F(CrasClientTestSuite, OutputStreamConnectedDoorbell) {
+  struct cras_client_stream_connected msg;
+  struct audio_message aud_msg;
+  struct cras_audio_format server_format;
+  struct cras_audio_shm_header* header;
+  uint64_t count = 0;
+  int doorbell_fd = eventfd(0, EFD_NONBLOCK);
+  int shm_fds[3] = {0, 1, doorbell_fd};
+
+  ASSERT_GE(doorbell_fd, 0);
+  stream_.direction = CRAS_STREAM_OUTPUT;
+  stream_.config->cb_threshold = 480;
+  set_audio_format(&stream_.config->format, SND_PCM_FORMAT_S16_LE, 48000, 2);
+  set_audio_format(&server_format, SND_PCM_FORMAT_S16_LE, 48000, 2);
+  header = (struct cras_audio_shm_header*)calloc(1, sizeof(*header));
+  header->config.frame_bytes = 4;
+  header->config.used_size = shm_writable_frames_ * 4;
+  mmap_return_value = header;
+
+  // A third fd means the server accepted the doorbell transport.
+  cras_fill_client_stream_connected(&msg, 0, stream_.id, &server_format, 600,
+                                    0);
+  stream_connected(&stream_, &msg, shm_fds, 3);
+  EXPECT_EQ(CRAS_THREAD_RUNNING, stream_.thread.state);
+  EXPECT_TRUE(stream_uses_doorbell(&stream_));
+
+  // The request is read from shm.
+  cras_shm_post_request(stream_.shm, 480);
+  EXPECT_EQ(sizeof(aud_msg), wait_for_doorbell(&stream_, &aud_msg));
+  EXPECT_EQ(AUDIO_MESSAGE_REQUEST_DATA, aud_msg.id);
+  EXPECT_EQ(480, aud_msg.frames);
+
+  // The reply is posted in shm and rings the server.
+  EXPECT_EQ(0, send_playback_reply(&stream_, 480, 0));
+  EXPECT_EQ(1, cras_shm_get_reply_seq(stream_.shm));
+  EXPECT_EQ(sizeof(count), read(doorbell_fd, &count, sizeof(count)));
+  EXPECT_EQ(1, count);
+}
+
+TEST_F(CrasClientTestSuite, DoorbellRequestBeforeConnected) {
+  struct cras_client_stream_connected msg;
+  struct audio_message aud_msg;
+  struct cras_audio_format server_format;
+  struct cras_audio_shm_header* header;
+  int doorbell_fd = eventfd(0, EFD_NONBLOCK);
+  int shm_fds[3] = {0, 1, doorbell_fd};
+
+  ASSERT_GE(doorbell_fd, 0);
+  stream_.direction = CRAS_STREAM_OUTPUT;
+  stream_.config->cb_threshold = 480;
+  set_audio_format(&stream_.config->format, SND_PCM_FORMAT_S16_LE, 48000, 2);
+  set_audio_format(&server_format, SND_PCM_FORMAT_S16_LE, 48000, 2);
+  header = (struct cras_audio_shm_header*)calloc(1, sizeof(*header));
+  header->config.frame_bytes = 4;
+  header->config.used_size = shm_writable_frames_ * 4;
+  // The server posted the first request before the stream got connected.
+  header->request_seq = 1;
+  header->request_frames = 480;
+  mmap_return_value = header;
+
+  cras_fill_client_stream_connected(&msg, 0, stream_.id, &server_format, 600,
+                                    0);
+  stream_connected(&stream_, &msg, shm_fds, 3);
+  ASSERT_TRUE(stream_uses_doorbell(&stream_));
+
+  // The pending request is served without waiting on the doorbell.
+  EXPECT_EQ(sizeof(aud_msg), wait_for_doorbell(&stream_, &aud_msg));
+  EXPECT_EQ(AUDIO_MESSAGE_REQUEST_DATA, aud_msg.id);
+  EXPECT_EQ(480, aud_msg.frames);
+}
+
+TEST_F(CrasClientTestSuite, SharedCallbackThreads) {
+  struct client_stream streams[3];
+  int sv[2];
+
+  EXPECT_EQ(-EINVAL, cras_client_set_num_callback_threads(&client_, 9));
+  ASSERT_EQ(0, cras_client_set_num_callback_threads(&client_, 2));
+
+  // Streams are spread on the pool started with the first one.
+  for (int i = 0; i < 3; i++) {
+    memset(&streams[i], 0, sizeof(streams[i]));
+    streams[i].client = &client_;
+    streams[i].config = stream_.config;
+    streams[i].aud_fd = -1;
+    streams[i].wake_fds[0] = -1;
+    streams[i].wake_fds[1] = -1;
+    ASSERT_EQ(0, start_aud_thread(&streams[i]));
+    EXPECT_EQ(CRAS_THREAD_WARMUP, streams[i].thread.state);
+  }
+  EXPECT_EQ(2, pthread_create_called);
+  EXPECT_EQ(-EBUSY, cras_client_set_num_callback_threads(&client_, 1));
+  EXPECT_EQ(&client_.callback_threads[0], streams[0].cb_thread);
+  EXPECT_EQ(&client_.callback_threads[1], streams[1].cb_thread);
+  EXPECT_EQ(&client_.callback_threads[0], streams[2].cb_thread);
+
+  // Shared threads wait on the socket, not on the shm doorbell.
+  EXPECT_EQ(0, stream_connect_flags(&streams[0]) & SHM_DOORBELL);
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+  streams[0].aud_fd = sv[0];
+  EXPECT_EQ(0, callback_thread_watch(&streams[0]));
+  EXPECT_TRUE(streams[0].cb_watched);
+
+  for (int i = 0; i < 3; i++) {
+    stop_aud_thread(&streams[i], 1);
+    EXPECT_EQ(NULL, streams[i].cb_thread);
+    EXPECT_EQ(CRAS_THREAD_STOP, streams[i].thread.state);
+  }
+  EXPECT_FALSE(streams[0].cb_watched);
+  EXPECT_EQ(0, client_.callback_threads[0].num_streams);
+  EXPECT_EQ(0, pthread_join_called);
+
+  callback_threads_destroy(&client_);
+  EXPECT_EQ(2, pthread_join_called);
+  EXPECT_EQ(NULL, client_.callback_threads);
+}
+
+TEST_F(CrasClientTestSuite, DirectIoWrite) {
+  struct audio_message aud_msg = {AUDIO_MESSAGE_REQUEST_DATA, 0, 600};
+  uint8_t* samples;
+  unsigned int frames;
+  int sv[2];
+
+  stream_.client = &client_;
+  stream_.direction = CRAS_STREAM_OUTPUT;
+  stream_.config->direct_io = true;
+  stream_.config->cb_threshold = 480;
+
+  // No thread is started and the stream stays on the socket transport.
+  ASSERT_EQ(0, start_aud_thread(&stream_));
+  EXPECT_EQ(0, pthread_create_called);
+  EXPECT_EQ(0, stream_connect_flags(&stream_) & SHM_DOORBELL);
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+  stream_.aud_fd = sv[0];
+  stream_.shm = InitShm();
+  DL_APPEND(client_.streams, &stream_);
+  EXPECT_EQ(sv[0], cras_client_stream_get_poll_fd(&client_, stream_.id));
+  EXPECT_EQ(-EINVAL, cras_client_stream_begin_read(&client_, stream_.id,
+                                                   &samples, &frames, NULL, 0));
+
+  // Nothing is handed out until the stream is connected and requested.
+  EXPECT_EQ(-EAGAIN, cras_client_stream_begin_write(
+                         &client_, stream_.id, &samples, &frames, NULL, 0));
+  stream_.thread.state = CRAS_THREAD_RUNNING;
+  EXPECT_EQ(-EAGAIN, cras_client_stream_begin_write(
+                         &client_, stream_.id, &samples, &frames, NULL, 0));
+  EXPECT_EQ(-ETIMEDOUT, cras_client_stream_begin_write(
+                            &client_, stream_.id, &samples, &frames, NULL, 1));
+
+  ASSERT_EQ(sizeof(aud_msg), write(sv[1], &aud_msg, sizeof(aud_msg)));
+  ASSERT_EQ(0, cras_client_stream_begin_write(&client_, stream_.id, &samples,
+                                              &frames, NULL, -1));
+  EXPECT_EQ(cras_shm_get_write_buffer_base(stream_.shm), samples);
+  EXPECT_EQ(480, frames);
+
+  // Begin again before committing returns the same request.
+  ASSERT_EQ(0, cras_client_stream_begin_write(&client_, stream_.id, &samples,
+                                              &frames, NULL, 0));
+  EXPECT_EQ(480, frames);
+  EXPECT_EQ(-EINVAL,
+            cras_client_stream_commit_write(&client_, stream_.id, 481));
+
+  ASSERT_EQ(0, cras_client_stream_commit_write(&client_, stream_.id, 200));
+  EXPECT_EQ(200 * 4, stream_.shm->header->write_offset[0]);
+  EXPECT_EQ(1, stream_.shm->header->write_buf_idx);
+  ASSERT_EQ(sizeof(aud_msg), read(sv[1], &aud_msg, sizeof(aud_msg)));
+  EXPECT_EQ(AUDIO_MESSAGE_DATA_READY, aud_msg.id);
+  EXPECT_EQ(200, aud_msg.frames);
+  EXPECT_EQ(-EINVAL, cras_client_stream_commit_write(&client_, stream_.id, 0));
+
+  stop_aud_thread(&stream_, 1);
+  EXPECT_EQ(CRAS_THREAD_STOP, stream_.thread.state);
+  EXPECT_EQ(0, pthread_join_called);
+  DL_DELETE(client_.streams, &stream_);
+}
+
+TEST_F(CrasClientTestSuite, DirectIoReadCommitNothing) {
+  struct audio_message aud_msg = {AUDIO_MESSAGE_DATA_READY, 0, 80};
+  uint8_t* samples;
+  unsigned int frames;
+  int sv[2];
+
+  stream_.client = &client_;
+  stream_.direction = CRAS_STREAM_INPUT;
+  stream_.config->direct_io = true;
+  stream_.config->cb_threshold = 80;
+  stream_.thread.state = CRAS_THREAD_RUNNING;
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+  stream_.aud_fd = sv[0];
+  stream_.shm = InitShm();
+  stream_.shm->header->write_offset[0] = 80 * 4;
+  DL_APPEND(client_.streams, &stream_);
+
+  ASSERT_EQ(sizeof(aud_msg), write(sv[1], &aud_msg, sizeof(aud_msg)));
+  ASSERT_EQ(0, cras_client_stream_begin_read(&client_, stream_.id, &samples,
+                                             &frames, NULL, 0));
+  EXPECT_EQ(cras_shm_get_read_buffer_base(stream_.shm), samples);
+  EXPECT_EQ(80, frames);
+
+  // Using none of the samples still answers the server.
+  ASSERT_EQ(0, cras_client_stream_commit_read(&client_, stream_.id, 0));
+  ASSERT_EQ(sizeof(aud_msg), read(sv[1], &aud_msg, sizeof(aud_msg)));
+  EXPECT_EQ(AUDIO_MESSAGE_DATA_CAPTURED, aud_msg.id);
+  EXPECT_EQ(0, aud_msg.frames);
+  EXPECT_EQ(-EINVAL, cras_client_stream_commit_read(&client_, stream_.id, 0));
+  EXPECT_EQ(-EAGAIN, cras_client_stream_begin_read(&client_, stream_.id,
+                                                   &samples, &frames, NULL, 0));
+
+  stop_aud_thread(&stream_, 1);
+  DL_DELETE(client_.streams, &stream_);
+}
+
 void CrasClientTestSuite::StreamConnectedFail(CRAS_STREAM_DIRECTION direction) {
   struct cras_client_stream_connected msg;
   int shm_fds[2] = {0, 1};
@@ -335,6 +556,50 @@ TEST_F(CrasClientTestSuite, SetInputStreamVolume) {
   EXPECT_EQ(0.6f, cras_shm_get_volume_scaler(stream_.shm));
 }
 
+static void output_volume_changed(void* context, int32_t volume) {
+  output_volume_changed_values.push_back(volume);
+}
+
+static void nodes_changed(void* context) {
+  nodes_changed_called++;
+}
+
+TEST_F(CrasClientTestSuite, HandleNotifications) {
+  struct cras_client_notifications msg;
+  struct cras_client_volume_changed volume;
+  struct cras_client_nodes_changed nodes;
+  int fds[2];
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds));
+  client_.server_fd = fds[0];
+  client_.observer_ops.output_volume_changed = output_volume_changed;
+  client_.observer_ops.nodes_changed = nodes_changed;
+
+  cras_fill_client_notifications(&msg);
+  cras_fill_client_output_volume_changed(&volume, 40);
+  ASSERT_EQ(0, cras_client_notifications_add(&msg, &volume.header));
+  cras_fill_client_nodes_changed(&nodes);
+  ASSERT_EQ(0, cras_client_notifications_add(&msg, &nodes.header));
+  cras_fill_client_output_volume_changed(&volume, 60);
+  ASSERT_EQ(0, cras_client_notifications_add(&msg, &volume.header));
+  ASSERT_EQ((ssize_t)msg.header.length, write(fds[1], &msg, msg.header.length));
+  EXPECT_EQ(0, handle_message_from_server(&client_));
+  EXPECT_EQ(std::vector<int32_t>({40, 60}), output_volume_changed_values);
+  EXPECT_EQ(1, nodes_changed_called);
+
+  // A batch claiming more notifications than it holds is rejected.
+  msg.num_notifications++;
+  ASSERT_EQ((ssize_t)msg.header.length, write(fds[1], &msg, msg.header.length));
+  EXPECT_EQ(-EINVAL, handle_message_from_server(&client_));
+
+  // So is one with a notification longer than the batch.
+  cras_fill_client_notifications(&msg);
+  ASSERT_EQ(0, cras_client_notifications_add(&msg, &volume.header));
+  ((struct cras_client_message*)msg.data)->length++;
+  ASSERT_EQ((ssize_t)msg.header.length, write(fds[1], &msg, msg.header.length));
+  EXPECT_EQ(-EINVAL, handle_message_from_server(&client_));
+}
+
 TEST(CrasClientTest, InitStreamVolume) {
   cras_stream_id_t stream_id;
   struct cras_stream_params config;
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 #include "cras/src/server/cras_dsp_module.h"
 #include "cras/src/server/cras_dsp_pipeline.h"
 #include "cras_config.h"
@@ -530,4 +532,87 @@ TEST_F(DspPipelineTestSuite, Complex) {
   really_free_module(m5);
 }
 
+static std::string dump_profile(struct pipeline* p) {
+  struct dumper* d = mem_dumper_create();
+  char* buf;
+  int size;
+
+  cras_dsp_pipeline_dump_profile(d, p);
+  mem_dumper_get(d, &buf, &size);
+  std::string profile(buf, size);
+  mem_dumper_free(d);
+  return profile;
+}
+
+TEST_F(DspPipelineTestSuite, Profiling) {
+  const char* content =
+      "[M1]\n"
+      "library=builtin\n"
+      "label=source\n"
+      "purpose=playback\n"
+      "output_0={audio}\n"
+      "[M2]\n"
+      "library=builtin\n"
+      "label=sink\n"
+      "purpose=playback\n"
+      "input_0={audio}\n"
+      "\n";
+  fprintf(fp, "%s", content);
+  CloseFile();
+
+  struct cras_expr_env env = CRAS_EXPR_ENV_INIT;
+  struct ini* ini = cras_dsp_ini_create(filename);
+  ASSERT_TRUE(ini);
+  struct pipeline* p = cras_dsp_pipeline_create(ini, &env, "playback");
+  ASSERT_TRUE(p);
+  ASSERT_EQ(0, cras_dsp_pipeline_load(p));
+  ASSERT_EQ(0, cras_dsp_pipeline_instantiate(p, 48000, &env));
+  struct dsp_module* m1 = find_module("m1");
+  struct dsp_module* m2 = find_module("m2");
+  ASSERT_TRUE(m1);
+  ASSERT_TRUE(m2);
+  struct data* d1 = (struct data*)m1->data;
+  struct data* d2 = (struct data*)m2->data;
+
+  // Nothing is recorded before profiling is enabled.
+  ASSERT_FALSE(cras_dsp_pipeline_get_profiling());
+  cras_dsp_pipeline_run(p, DSP_BUFFER_SIZE);
+  EXPECT_NE(std::string::npos, dump_profile(p).find("profiling is disabled"));
+
+  cras_dsp_pipeline_set_profiling(true);
+  ASSERT_TRUE(cras_dsp_pipeline_get_profiling());
+  for (int i = 0; i < 5; i++) {
+    cras_dsp_pipeline_run(p, DSP_BUFFER_SIZE);
+  }
+  std::string profile = dump_profile(p);
+  EXPECT_NE(std::string::npos, profile.find("[0]m1 runs=5,")) << profile;
+  EXPECT_NE(std::string::npos, profile.find("[1]m2 runs=5,")) << profile;
+
+  // Disabling keeps the profiles but stops updating them.
+  cras_dsp_pipeline_set_profiling(false);
+  cras_dsp_pipeline_run(p, DSP_BUFFER_SIZE);
+  profile = dump_profile(p);
+  EXPECT_NE(std::string::npos, profile.find("[0]m1 runs=5,")) << profile;
+  EXPECT_NE(std::string::npos, profile.find("[1]m2 runs=5,")) << profile;
+
+  // Enabling again starts over.
+  cras_dsp_pipeline_set_profiling(true);
+  cras_dsp_pipeline_run(p, DSP_BUFFER_SIZE);
+  profile = dump_profile(p);
+  EXPECT_NE(std::string::npos, profile.find("[0]m1 runs=1,")) << profile;
+  EXPECT_NE(std::string::npos, profile.find("[1]m2 runs=1,")) << profile;
+  cras_dsp_pipeline_set_profiling(false);
+
+  // Profiling does not change how the modules are run.
+  ASSERT_EQ(8, d1->run_called);
+  ASSERT_EQ(8, d2->run_called);
+
+  cras_dsp_pipeline_free(p);
+  cras_dsp_ini_free(ini);
+  cras_expr_env_free(&env);
+
+  really_free_module(m1);
+  really_free_module(m2);
+}
+
 }  //  namespace
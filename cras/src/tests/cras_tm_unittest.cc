@@ -3,8 +3,11 @@
 // found in the LICENSE file.
 
 #include <gtest/gtest.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include <vector>
+
 extern "C" {
 #include "cras/src/server/cras_tm.h"
 #include "cras_types.h"
@@ -180,6 +183,163 @@ TEST_F(TimerTestSuite, AddTwoTimers) {
   cras_tm_cancel_timer(tm_, t1);
 }
 
+static std::vector<uintptr_t> fired;
+
+void record_cb(struct cras_timer* t, void* data) {
+  fired.push_back((uintptr_t)data);
+}
+
+TEST_F(TimerTestSuite, ManyTimersFireInOrder) {
+  static const unsigned int kNumTimers = 10000;
+  struct timespec ts;
+
+  fired.clear();
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 0;
+  // Expirations in a scrambled order, each shared by a few timers.
+  for (unsigned int i = 0; i < kNumTimers; i++) {
+    ASSERT_TRUE(cras_tm_create_timer(tm_, (i * 7919) % 1000, record_cb,
+                                     (void*)(uintptr_t)i));
+  }
+
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(0, ts.tv_sec);
+  EXPECT_EQ(0, ts.tv_nsec);
+
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 500 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(kNumTimers / 2 + kNumTimers / 1000, fired.size());
+
+  time_now.tv_sec = 1;
+  cras_tm_call_callbacks(tm_);
+  ASSERT_EQ(kNumTimers, fired.size());
+  EXPECT_FALSE(cras_tm_get_next_timeout(tm_, &ts));
+
+  // Sorted by expiration, timers expiring together by creation.
+  for (unsigned int i = 1; i < kNumTimers; i++) {
+    unsigned int prev = (fired[i - 1] * 7919) % 1000;
+    unsigned int cur = (fired[i] * 7919) % 1000;
+    ASSERT_TRUE(prev < cur || (prev == cur && fired[i - 1] < fired[i]));
+  }
+}
+
+TEST_F(TimerTestSuite, CancelManyTimers) {
+  static const unsigned int kNumTimers = 10000;
+  std::vector<struct cras_timer*> timers;
+  struct timespec ts;
+
+  fired.clear();
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 0;
+  for (unsigned int i = 0; i < kNumTimers; i++) {
+    timers.push_back(
+        cras_tm_create_timer(tm_, i + 1, record_cb, (void*)(uintptr_t)i));
+    ASSERT_TRUE(timers.back());
+  }
+
+  // Cancel all but every tenth timer, soonest first.
+  for (unsigned int i = 0; i < kNumTimers; i++) {
+    if (i % 10 != 9) {
+      cras_tm_cancel_timer(tm_, timers[i]);
+    }
+  }
+
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(0, ts.tv_sec);
+  EXPECT_EQ(10 * 1000000, ts.tv_nsec);
+
+  // Re-arm and cancel a timer many times while others are armed.
+  for (unsigned int i = 0; i < kNumTimers; i++) {
+    cras_tm_cancel_timer(tm_, cras_tm_create_timer(tm_, 1, test_cb, NULL));
+  }
+
+  time_now.tv_sec = 100;
+  cras_tm_call_callbacks(tm_);
+  ASSERT_EQ(kNumTimers / 10, fired.size());
+  for (unsigned int i = 0; i < fired.size(); i++) {
+    EXPECT_EQ(i * 10 + 9, fired[i]);
+  }
+  EXPECT_FALSE(cras_tm_get_next_timeout(tm_, &ts));
+}
+
+static struct cras_tm* rearm_tm;
+static unsigned int rearm_count;
+
+void rearm_cb(struct cras_timer* t, void* data) {
+  struct cras_timer** other = (struct cras_timer**)data;
+
+  // Cancel the other timer and re-arm this one in the same pass.
+  if (*other) {
+    cras_tm_cancel_timer(rearm_tm, *other);
+    *other = NULL;
+  }
+  if (++rearm_count < 3) {
+    ASSERT_TRUE(cras_tm_create_timer(rearm_tm, 0, rearm_cb, data));
+  }
+}
+
+TEST_F(TimerTestSuite, CallbackCreatesAndCancels) {
+  struct cras_timer* other;
+  struct timespec ts;
+
+  rearm_tm = tm_;
+  rearm_count = 0;
+  test_cb_called = 0;
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 0;
+  ASSERT_TRUE(cras_tm_create_timer(tm_, 1, rearm_cb, &other));
+  other = cras_tm_create_timer(tm_, 2, test_cb, NULL);
+  ASSERT_TRUE(other);
+
+  time_now.tv_nsec = 2 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(3, rearm_count);
+  EXPECT_EQ(0, test_cb_called);
+  EXPECT_FALSE(cras_tm_get_next_timeout(tm_, &ts));
+}
+
+TEST_F(TimerTestSuite, SlackCoalescesTimers) {
+  struct timespec ts;
+
+  test_cb_called = 0;
+  time_now.tv_sec = 0;
+  // Rounded up to a multiple of 512ms, the largest power of two <= 1000.
+  time_now.tv_nsec = 300 * 1000000;
+  ASSERT_TRUE(cras_tm_create_timer_with_slack(tm_, 5000, 1000, test_cb, NULL));
+  time_now.tv_nsec = 400 * 1000000 + 1;
+  ASSERT_TRUE(cras_tm_create_timer_with_slack(tm_, 5000, 1000, test_cb, NULL));
+  time_now.tv_nsec = 500 * 1000000;
+  ASSERT_TRUE(cras_tm_create_timer_with_slack(tm_, 5000, 1000, test_cb, NULL));
+
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(5, ts.tv_sec);
+  EXPECT_EQ(132 * 1000000, ts.tv_nsec);
+
+  // All three share a single wake-up, none of them fires early or later
+  // than its slack.
+  time_now.tv_sec = 5;
+  time_now.tv_nsec = 631 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(0, test_cb_called);
+  time_now.tv_nsec = 632 * 1000000;
+  cras_tm_call_callbacks(tm_);
+  EXPECT_EQ(3, test_cb_called);
+  EXPECT_FALSE(cras_tm_get_next_timeout(tm_, &ts));
+}
+
+TEST_F(TimerTestSuite, NoSlackKeepsExpiration) {
+  struct timespec ts;
+
+  time_now.tv_sec = 0;
+  time_now.tv_nsec = 123;
+  ASSERT_TRUE(cras_tm_create_timer_with_slack(tm_, 10, 1, test_cb, NULL));
+  time_now.tv_nsec = 0;
+  ASSERT_TRUE(cras_tm_get_next_timeout(tm_, &ts));
+  EXPECT_EQ(0, ts.tv_sec);
+  EXPECT_EQ(10 * 1000000 + 123, ts.tv_nsec);
+}
+
 // Stubs
 extern "C" {
 
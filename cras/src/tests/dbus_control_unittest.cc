@@ -11,7 +11,7 @@ extern "C" {
 #include "cras_types.h"
 }
 static int num_channels_val;
-static int audio_thread_config_global_remix_called;
+static int cras_iodev_list_config_global_remix_called;
 
 namespace {
 
@@ -27,7 +27,7 @@ class DBusControlTestSuite : public DBusTest {
   }
   void dbus_control_stub_reset() {
     num_channels_val = 0;
-    audio_thread_config_global_remix_called = 0;
+    cras_iodev_list_config_global_remix_called = 0;
   }
 };
 
@@ -42,7 +42,7 @@ TEST_F(DBusControlTestSuite, SetGlobalOutputChannelRemixBasic) {
       .Send();
   WaitForMatches();
   EXPECT_EQ(num_channels_val_sended, num_channels_val);
-  EXPECT_EQ(audio_thread_config_global_remix_called, 1);
+  EXPECT_EQ(cras_iodev_list_config_global_remix_called, 1);
 }
 
 TEST_F(DBusControlTestSuite, SetGlobalOutputChannelRemixInvalid) {
@@ -63,7 +63,7 @@ TEST_F(DBusControlTestSuite, SetGlobalOutputChannelRemixInvalid) {
         .WithArrayOfDouble(channels_map)
         .Send();
     WaitForMatches();
-    EXPECT_EQ(audio_thread_config_global_remix_called, 0);
+    EXPECT_EQ(cras_iodev_list_config_global_remix_called, 0);
   }
 }
 
@@ -150,14 +150,10 @@ void cras_system_state_get_input_streams_with_permission(
     uint32_t num_input_streams[CRAS_NUM_CLIENT_TYPE]) {
   return;
 }
-struct audio_thread* cras_iodev_list_get_audio_thread() {
-  return NULL;
-}
-int audio_thread_config_global_remix(struct audio_thread* thread,
-                                     unsigned int num_channels) {
-  audio_thread_config_global_remix_called++;
+void cras_iodev_list_config_global_remix(unsigned int num_channels,
+                                         const float* coefficient) {
+  cras_iodev_list_config_global_remix_called++;
   num_channels_val = num_channels;
-  return 0;
 }
 int cras_iodev_list_set_hotword_model(cras_node_id_t id,
                                       const char* model_name) {
@@ -187,6 +183,12 @@ void cras_system_set_force_sr_bt_enabled(bool enabled) {
 bool cras_system_get_force_sr_bt_enabled() {
   return true;
 }
+void cras_dsp_set_profiling_enabled(bool enabled) {
+  return;
+}
+void cras_dsp_dump_profile(struct dumper* d) {
+  return;
+}
 int cras_bt_player_update_playback_status(DBusConnection* conn,
                                           const char* status) {
   return 0;
@@ -228,8 +230,7 @@ bool cras_system_state_internal_cards_detected() {
 int cras_system_state_num_non_chrome_output_streams() {
   return 0;
 }
-int audio_thread_dump_thread_info(struct audio_thread* thread,
-                                  struct audio_debug_info* info) {
+int cras_iodev_list_dump_audio_thread_info(struct audio_debug_info* info) {
   return 0;
 }
 int is_utf8_string(const char* string) {
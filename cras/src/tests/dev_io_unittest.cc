@@ -18,7 +18,7 @@ extern "C" {
 #include "cras_types.h"
 #include "third_party/utlist/utlist.h"
 
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 }
 
 #include "cras/src/server/input_data.h"
@@ -402,6 +402,8 @@ int cras_audio_thread_event_severe_underrun() {
   return 0;
 }
 
+void audio_thread_unwatch_stream(struct cras_rstream* stream) {}
+
 int dev_stream_attached_devs(const struct dev_stream* dev_stream) {
   return 0;
 }
@@ -418,6 +420,21 @@ int dev_stream_mix(struct dev_stream* dev_stream,
                    unsigned int num_to_write) {
   return 0;
 }
+int dev_stream_mix_float(struct dev_stream* dev_stream,
+                         const struct cras_audio_format* fmt,
+                         float* dst,
+                         unsigned int num_to_write) {
+  return 0;
+}
+int dev_stream_copy(struct dev_stream* dev_stream,
+                    const struct cras_audio_format* fmt,
+                    uint8_t* dst,
+                    unsigned int num_to_write) {
+  return 0;
+}
+int dev_stream_is_passthrough(const struct dev_stream* dev_stream) {
+  return 0;
+}
 void dev_stream_set_dev_rate(struct dev_stream* dev_stream,
                              unsigned int dev_rate,
                              double dev_rate_ratio,
@@ -454,6 +471,12 @@ unsigned int dev_stream_capture(struct dev_stream* dev_stream,
   dev_stream_capture_software_gain_scaler_val = software_gain_scaler;
   return 0;
 }
+void dev_stream_capture_finish(struct dev_stream* dev_stream) {}
+
+int dev_stream_share_playback_conv(struct dev_stream* dev_stream,
+                                   struct dev_stream* other) {
+  return -EINVAL;
+}
 void dev_stream_update_next_wake_time(struct dev_stream* dev_stream) {}
 int dev_stream_request_playback_samples(struct dev_stream* dev_stream,
                                         const struct timespec* now) {
@@ -19,7 +19,7 @@ extern "C" {
 namespace {
 
 extern "C" {
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 // For audio_thread_log.h use.
 int atlog_rw_shm_fd;
 int atlog_ro_shm_fd;
@@ -93,8 +93,17 @@ static struct cras_audio_format in_fmt;
 static struct cras_audio_format out_fmt;
 static struct cras_audio_area_copy_call copy_area_call;
 static struct fmt_conv_call conv_frames_call;
+static int cras_fmt_conv_convert_frames_called;
 static int cras_audio_area_create_num_channels_val;
 static int cras_fmt_conversion_needed_val;
+static int cras_fmt_conv_mix_fusable_val;
+static int cras_fmt_conv_pre_resample_sharable_val;
+static int cras_fmt_conv_convert_pre_resample_called;
+static unsigned int cras_fmt_conv_convert_pre_resample_frames;
+static int cras_fmt_conv_convert_post_resample_called;
+static unsigned int mix_add_s16_stereo_in_channels;
+static int cras_mix_is_silent_val;
+static int cras_mix_add_called;
 static int cras_fmt_conv_set_linear_resample_rates_called;
 static float cras_fmt_conv_set_linear_resample_rates_from;
 static float cras_fmt_conv_set_linear_resample_rates_to;
@@ -143,6 +152,14 @@ class CreateSuite : public testing::Test {
     config_format_converter_from_fmt = NULL;
     config_format_converter_called = 0;
     cras_fmt_conversion_needed_val = 0;
+    cras_fmt_conv_mix_fusable_val = 0;
+    cras_fmt_conv_pre_resample_sharable_val = 0;
+    cras_fmt_conv_convert_pre_resample_called = 0;
+    cras_fmt_conv_convert_pre_resample_frames = 0;
+    cras_fmt_conv_convert_post_resample_called = 0;
+    mix_add_s16_stereo_in_channels = 0;
+    cras_mix_is_silent_val = 0;
+    cras_mix_add_called = 0;
     cras_fmt_conv_set_linear_resample_rates_called = 0;
 
     cras_rstream_audio_ready_called = 0;
@@ -153,14 +170,16 @@ class CreateSuite : public testing::Test {
 
     memset(&copy_area_call, 0xff, sizeof(copy_area_call));
     memset(&conv_frames_call, 0xff, sizeof(conv_frames_call));
+    cras_fmt_conv_convert_frames_called = 0;
 
     ASSERT_FALSE(asprintf(&atlog_name, "/ATlog-%d", getpid()) < 0);
     // To avoid un-used variable warning.
     atlog_rw_shm_fd = atlog_ro_shm_fd = -1;
-    atlog = audio_thread_event_log_init(atlog_name);
+    atlog = audio_thread_event_log_init(atlog_name, 1);
 
     devstr.stream = &rstream_;
     devstr.conv = NULL;
+    devstr.conv_share = NULL;
     devstr.conv_buffer = NULL;
     devstr.conv_buffer_size_frames = 0;
 
@@ -195,7 +214,7 @@ class CreateSuite : public testing::Test {
     free(rstream_.shm->header);
     free(rstream_.shm->samples);
     free(rstream_.shm);
-    audio_thread_event_log_deinit(atlog, atlog_name);
+    audio_thread_event_log_deinit(atlog, atlog_name, 1);
     free(atlog_name);
   }
 
@@ -556,6 +575,132 @@ TEST_F(CreateSuite, CaptureAvailConvBufHasSamples) {
   dev_stream_destroy(dev_stream);
 }
 
+TEST_F(CreateSuite, CaptureSharesConverterOfSameFormat) {
+  struct cras_rstream rstream2 = rstream_;
+  struct dev_stream* ds[2];
+  unsigned int nread[2];
+  unsigned int dev_id = 0;
+
+  rstream_.format = fmt_s16le_48;
+  rstream_.direction = CRAS_STREAM_INPUT;
+  rstream_.stream_apm = NULL;
+  rstream_.main_dev.dev_id = dev_id;
+  rstream2 = rstream_;
+  SetupShm(&rstream2.shm);
+  in_fmt.frame_rate = 44100;
+  out_fmt.frame_rate = 48000;
+  cras_fmt_conversion_needed_val = 1;
+  config_format_converter_conv = reinterpret_cast<struct cras_fmt_conv*>(0x33);
+
+  ds[0] = dev_stream_create(&rstream_, dev_id, &fmt_s16le_44_1, dev->dev.get(),
+                            &cb_ts, NULL);
+  DL_APPEND(dev->dev->streams, ds[0]);
+  ds[1] = dev_stream_create(&rstream2, dev_id, &fmt_s16le_44_1, dev->dev.get(),
+                            &cb_ts, NULL);
+  DL_APPEND(dev->dev->streams, ds[1]);
+
+  // The second stream captures through the converter of the first one.
+  EXPECT_EQ(1, config_format_converter_called);
+  ASSERT_NE(nullptr, ds[0]->conv_share);
+  EXPECT_EQ(ds[0]->conv_share, ds[1]->conv_share);
+  EXPECT_EQ(ds[0]->conv, ds[1]->conv);
+
+  for (int i = 0; i < 2; i++) {
+    ds[i]->conv_area = (struct cras_audio_area*)calloc(
+        1, sizeof(*area) + 2 * sizeof(*area->channels));
+  }
+
+  // One conversion for both streams, each gets the frames in its buffer.
+  for (int i = 0; i < 2; i++) {
+    nread[i] = dev_stream_capture(ds[i], area, 0, 1.0f);
+  }
+  EXPECT_EQ(1, cras_fmt_conv_convert_frames_called);
+  EXPECT_EQ(nread[0], nread[1]);
+  EXPECT_EQ(cras_frames_at_rate(48000, kBufferFrames / 2, 44100), nread[0]);
+  EXPECT_EQ(buf_queued(ds[0]->conv_buffer), buf_queued(ds[1]->conv_buffer));
+  dev_stream_capture_finish(ds[0]);
+  dev_stream_capture_finish(ds[1]);
+
+  // The next pass converts again.
+  buf_reset(ds[0]->conv_buffer);
+  buf_reset(ds[1]->conv_buffer);
+  dev_stream_capture(ds[0], area, 0, 1.0f);
+  EXPECT_EQ(2, cras_fmt_conv_convert_frames_called);
+
+  // A stream reading elsewhere in the area gets a converter of its own.
+  dev_stream_capture(ds[1], area, 10, 1.0f);
+  EXPECT_EQ(3, cras_fmt_conv_convert_frames_called);
+  EXPECT_EQ(2, config_format_converter_called);
+  EXPECT_EQ(nullptr, ds[1]->conv_share);
+  EXPECT_NE(nullptr, ds[0]->conv_share);
+
+  for (int i = 0; i < 2; i++) {
+    free(ds[i]->conv_area);
+    DL_DELETE(dev->dev->streams, ds[i]);
+    dev_stream_destroy(ds[i]);
+  }
+  free(rstream2.shm->header);
+  free(rstream2.shm->samples);
+  free(rstream2.shm);
+}
+
+TEST_F(CreateSuite, PlaybackSharesConversionOfSameFormat) {
+  struct dev_stream* ds[2];
+  const unsigned int nfr = 100;
+  struct cras_audio_format fmt;
+  uint8_t* dst;
+
+  rstream_.format = fmt_s16le_48;
+  in_fmt.frame_rate = 48000;
+  out_fmt.frame_rate = 48000;
+  cras_fmt_conversion_needed_val = 1;
+  config_format_converter_conv = reinterpret_cast<struct cras_fmt_conv*>(0x33);
+  ds[0] = dev_stream_create(&rstream_, 0, &fmt_s16le_48, dev->dev.get(),
+                            &cb_ts, NULL);
+  ds[1] = dev_stream_create(&rstream_, 1, &fmt_s16le_48, dev->dev.get(),
+                            &cb_ts, NULL);
+
+  // Nothing to share when the converter resamples ahead of mixing.
+  EXPECT_EQ(-EINVAL, dev_stream_share_playback_conv(ds[1], ds[0]));
+  EXPECT_EQ(nullptr, ds[1]->playback_share);
+
+  cras_fmt_conv_pre_resample_sharable_val = 1;
+  ASSERT_EQ(0, dev_stream_share_playback_conv(ds[1], ds[0]));
+  ASSERT_NE(nullptr, ds[0]->playback_share);
+  EXPECT_EQ(ds[0]->playback_share, ds[1]->playback_share);
+
+  rstream_playable_frames_ret = nfr;
+  rstream_get_readable_num = nfr;
+  rstream_get_readable_ptr = rstream_.shm->samples;
+  fmt.num_channels = 2;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  dst = (uint8_t*)calloc(nfr + 20, 4);
+
+  // Both devices mix the frames converted once.
+  EXPECT_EQ(nfr, dev_stream_mix(ds[0], &fmt, dst, nfr));
+  EXPECT_EQ(nfr, dev_stream_mix(ds[1], &fmt, dst, nfr));
+  EXPECT_EQ(1, cras_fmt_conv_convert_pre_resample_called);
+  EXPECT_EQ(nfr, cras_fmt_conv_convert_pre_resample_frames);
+  EXPECT_EQ(2, cras_fmt_conv_convert_post_resample_called);
+  EXPECT_EQ(0, cras_fmt_conv_convert_frames_called);
+
+  // A device reading further converts only the frames missing.
+  rstream_playable_frames_ret = nfr + 20;
+  rstream_get_readable_num = nfr + 20;
+  EXPECT_EQ(nfr + 20, dev_stream_mix(ds[1], &fmt, dst, nfr + 20));
+  EXPECT_EQ(2, cras_fmt_conv_convert_pre_resample_called);
+  EXPECT_EQ(nfr + 20, cras_fmt_conv_convert_pre_resample_frames);
+
+  // Moving the read pointer invalidates the converted frames.
+  dev_stream_playback_update_rstream(ds[0]);
+  EXPECT_EQ(nfr, dev_stream_mix(ds[0], &fmt, dst, nfr));
+  EXPECT_EQ(3, cras_fmt_conv_convert_pre_resample_called);
+
+  free(dst);
+  dev_stream_destroy(ds[0]);
+  dev_stream_destroy(ds[1]);
+}
+
 TEST_F(CreateSuite, SetDevRateNotMainDev) {
   struct dev_stream* dev_stream;
   unsigned int dev_id = 9;
@@ -656,6 +801,60 @@ TEST_F(CreateSuite, StreamMixNoConv) {
   EXPECT_EQ(1, rstream_get_readable_call.num_called);
 }
 
+TEST_F(CreateSuite, StreamCopyNoConv) {
+  struct dev_stream dev_stream;
+  const unsigned int nfr = 100;
+  struct cras_audio_format fmt;
+
+  dev_stream.conv = NULL;
+  dev_stream.stream = reinterpret_cast<cras_rstream*>(0x5446);
+  rstream_playable_frames_ret = nfr;
+  rstream_get_readable_num = nfr;
+  rstream_get_readable_ptr = reinterpret_cast<uint8_t*>(0x4000);
+  rstream_get_readable_call.num_called = 0;
+  fmt.num_channels = 2;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  EXPECT_EQ(nfr, dev_stream_copy(&dev_stream, &fmt, (uint8_t*)0x5000, nfr));
+  EXPECT_EQ((int16_t*)0x5000, mix_add_call.dst);
+  EXPECT_EQ((int16_t*)0x4000, mix_add_call.src);
+  EXPECT_EQ(200, mix_add_call.count);
+  // Copied over dst instead of mixed into it.
+  EXPECT_EQ(0, mix_add_call.index);
+}
+
+TEST_F(CreateSuite, StreamMixSkipsSilentBlocks) {
+  struct dev_stream dev_stream;
+  struct cras_iodev iodev;
+  const unsigned int nfr = 100;
+  struct cras_audio_format fmt;
+  uint8_t dst[nfr * 4];
+
+  dev_stream.conv = NULL;
+  dev_stream.iodev = &iodev;
+  dev_stream.stream = reinterpret_cast<cras_rstream*>(0x5446);
+  iodev.num_silent_frames_skipped = 0;
+  rstream_playable_frames_ret = nfr;
+  rstream_get_readable_num = nfr;
+  rstream_get_readable_ptr = reinterpret_cast<uint8_t*>(0x4000);
+  rstream_get_readable_call.num_called = 0;
+  fmt.num_channels = 2;
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  cras_mix_is_silent_val = 1;
+
+  // Offsets still move past the silent frames, nothing is mixed.
+  EXPECT_EQ(nfr, dev_stream_mix(&dev_stream, &fmt, (uint8_t*)0x5000, nfr));
+  EXPECT_EQ(0, cras_mix_add_called);
+  EXPECT_EQ(nfr, iodev.num_silent_frames_skipped);
+
+  // A copy zeroes dst instead.
+  memset(dst, 0xff, sizeof(dst));
+  EXPECT_EQ(nfr, dev_stream_copy(&dev_stream, &fmt, dst, nfr));
+  EXPECT_EQ(0, cras_mix_add_called);
+  EXPECT_EQ(0, dst[0]);
+  EXPECT_EQ(0, dst[sizeof(dst) - 1]);
+  EXPECT_EQ(2 * nfr, iodev.num_silent_frames_skipped);
+}
+
 TEST_F(CreateSuite, StreamMixNoConvTwoPass) {
   struct dev_stream dev_stream;
   const unsigned int nfr = 100;
@@ -683,6 +882,31 @@ TEST_F(CreateSuite, StreamMixNoConvTwoPass) {
   EXPECT_EQ(2, rstream_get_readable_call.num_called);
 }
 
+TEST_F(CreateSuite, StreamMixFusedConv) {
+  struct dev_stream dev_stream;
+  const unsigned int nfr = 100;
+  struct cras_audio_format fmt;
+
+  dev_stream.conv = reinterpret_cast<cras_fmt_conv*>(0x33);
+  dev_stream.stream = reinterpret_cast<cras_rstream*>(0x5446);
+  cras_fmt_conversion_needed_val = 1;
+  cras_fmt_conv_mix_fusable_val = 1;
+  in_fmt.num_channels = 1;
+  rstream_playable_frames_ret = nfr;
+  rstream_get_readable_num = nfr;
+  rstream_get_readable_ptr = reinterpret_cast<uint8_t*>(0x4000);
+  rstream_get_readable_call.num_called = 0;
+  fmt.num_channels = 2;
+  fmt.format = SND_PCM_FORMAT_S32_LE;
+  EXPECT_EQ(nfr, dev_stream_mix(&dev_stream, &fmt, (uint8_t*)0x5000, nfr));
+
+  // Mono S16 is mixed straight into the S32 stereo buffer.
+  EXPECT_EQ((int16_t*)0x5000, mix_add_call.dst);
+  EXPECT_EQ((int16_t*)0x4000, mix_add_call.src);
+  EXPECT_EQ(nfr, mix_add_call.count);
+  EXPECT_EQ(1, mix_add_s16_stereo_in_channels);
+}
+
 TEST_F(CreateSuite, DevStreamFlushAudioMessages) {
   struct dev_stream* dev_stream;
   unsigned int dev_id = 9;
@@ -1220,12 +1444,17 @@ int config_format_converter(struct cras_fmt_conv** conv,
 
 void cras_fmt_conv_destroy(struct cras_fmt_conv* conv) {}
 
+void cras_fmt_conv_release(struct cras_fmt_conv** conv) {
+  *conv = NULL;
+}
+
 size_t cras_fmt_conv_convert_frames(struct cras_fmt_conv* conv,
                                     uint8_t* in_buf,
                                     uint8_t* out_buf,
                                     unsigned int* in_frames,
                                     unsigned int out_frames) {
   unsigned int ret;
+  cras_fmt_conv_convert_frames_called++;
   conv_frames_call.conv = conv;
   conv_frames_call.in_buf = in_buf;
   conv_frames_call.out_buf = out_buf;
@@ -1248,6 +1477,7 @@ void cras_mix_add(snd_pcm_format_t fmt,
                   unsigned int index,
                   int mute,
                   float mix_vol) {
+  cras_mix_add_called++;
   mix_add_call.dst = (int16_t*)dst;
   mix_add_call.src = (int16_t*)src;
   mix_add_call.count = count;
@@ -1256,6 +1486,33 @@ void cras_mix_add(snd_pcm_format_t fmt,
   mix_add_call.mix_vol = mix_vol;
 }
 
+int cras_mix_add_s16_stereo(snd_pcm_format_t fmt,
+                            uint8_t* dst,
+                            const int16_t* src,
+                            unsigned int frames,
+                            unsigned int in_channels,
+                            int mute,
+                            float mix_vol) {
+  mix_add_call.dst = (int16_t*)dst;
+  mix_add_call.src = (int16_t*)src;
+  mix_add_call.count = frames;
+  mix_add_call.mute = mute;
+  mix_add_call.mix_vol = mix_vol;
+  mix_add_s16_stereo_in_channels = in_channels;
+  return 0;
+}
+
+int cras_mix_is_silent(const uint8_t* buf, size_t bytes) {
+  return cras_mix_is_silent_val;
+}
+
+void cras_mix_add_float(snd_pcm_format_t fmt,
+                        float* dst,
+                        const uint8_t* src,
+                        unsigned int count,
+                        int mute,
+                        float mix_vol) {}
+
 struct cras_audio_area* cras_audio_area_create(int num_channels) {
   cras_audio_area_create_num_channels_val = num_channels;
   return NULL;
@@ -1309,6 +1566,32 @@ int cras_fmt_conversion_needed(const struct cras_fmt_conv* conv) {
   return cras_fmt_conversion_needed_val;
 }
 
+int cras_fmt_conv_mix_fusable(const struct cras_fmt_conv* conv) {
+  return cras_fmt_conv_mix_fusable_val;
+}
+
+int cras_fmt_conv_pre_resample_sharable(const struct cras_fmt_conv* conv) {
+  return cras_fmt_conv_pre_resample_sharable_val;
+}
+
+void cras_fmt_conv_convert_pre_resample(struct cras_fmt_conv* conv,
+                                        const uint8_t* in_buf,
+                                        uint8_t* out_buf,
+                                        size_t frames) {
+  cras_fmt_conv_convert_pre_resample_called++;
+  cras_fmt_conv_convert_pre_resample_frames += frames;
+}
+
+size_t cras_fmt_conv_convert_post_resample(struct cras_fmt_conv* conv,
+                                           const uint8_t* in_buf,
+                                           uint8_t* out_buf,
+                                           unsigned int* in_frames,
+                                           size_t out_frames) {
+  cras_fmt_conv_convert_post_resample_called++;
+  *in_frames = MIN(*in_frames, out_frames);
+  return *in_frames;
+}
+
 void cras_fmt_conv_set_linear_resample_rates(struct cras_fmt_conv* conv,
                                              float from,
                                              float to) {
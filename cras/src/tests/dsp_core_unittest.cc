@@ -5,12 +5,17 @@
 #include <gtest/gtest.h>
 #include <math.h>
 
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
 #include "cras/src/dsp/crossover.h"
 #include "cras/src/dsp/crossover2.h"
 #include "cras/src/dsp/drc.h"
 #include "cras/src/dsp/dsp_util.h"
 #include "cras/src/dsp/eq.h"
 #include "cras/src/dsp/eq2.h"
+#include "cras/src/dsp/eqn.h"
 #include "cras/src/dsp/quad_rotation.h"
 
 namespace {
@@ -38,6 +43,20 @@ static float magnitude_at(float* data, size_t len, float f) {
   return sqrt(re * re + im * im) * (2.0 / len);
 }
 
+// Returns the DSP_X86_* instruction sets this CPU has.
+static unsigned int cpu_x86_features() {
+  unsigned int features = 0;
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2")) {
+    features |= DSP_X86_AVX2;
+  }
+  if (__builtin_cpu_supports("fma")) {
+    features |= DSP_X86_FMA;
+  }
+#endif
+  return features;
+}
+
 TEST(QuadRotationTest, QuadRotationRotate90) {
   const int FRAMES = 10;
   const int SAMPLES = FRAMES * 4;
@@ -165,6 +184,29 @@ TEST(InterleaveTest, All) {
   }
 }
 
+TEST(InterleaveTest, Float) {
+  const int FRAMES = 12;
+  float input[FRAMES * 2];
+  float output[FRAMES * 2];
+  float* out_ptr[] = {output, output + FRAMES};
+  float output2[FRAMES * 2];
+
+  for (int i = 0; i < FRAMES * 2; i++) {
+    input[i] = i / 32.0f - 0.25f;
+  }
+
+  dsp_util_deinterleave((uint8_t*)input, out_ptr, 2, SND_PCM_FORMAT_FLOAT_LE,
+                        FRAMES);
+  for (int i = 0; i < FRAMES; i++) {
+    EXPECT_EQ(input[2 * i], output[i]);
+    EXPECT_EQ(input[2 * i + 1], output[FRAMES + i]);
+  }
+
+  dsp_util_interleave(out_ptr, (uint8_t*)output2, 2, SND_PCM_FORMAT_FLOAT_LE,
+                      FRAMES);
+  EXPECT_EQ(0, memcmp(input, output2, sizeof(input)));
+}
+
 TEST(EqTest, All) {
   struct eq* eq;
   size_t len = 44100;
@@ -299,6 +341,80 @@ TEST(Eq2Test, All) {
   eq2_free(eq2);
 }
 
+TEST(EqNTest, MatchesEq) {
+  const int num_channels = 6;
+  const enum biquad_type types[] = {BQ_LOWPASS, BQ_PEAKING, BQ_HIGHSHELF};
+  // Not a multiple of the blocks eqn works in.
+  size_t len = 4410 + 37;
+  float NQ = 44100 / 2;
+  std::vector<std::vector<float>> data(num_channels);
+  std::vector<std::vector<float>> expected(num_channels);
+  float* ptrs[num_channels];
+
+  dsp_enable_flush_denormal_to_zero();
+  // Runs the AVX2 filters if the CPU has them.
+  dsp_set_x86_features(cpu_x86_features());
+  struct eqn* eqn = eqn_new(num_channels);
+  dsp_set_x86_features(0);
+
+  ASSERT_NE(nullptr, eqn);
+  for (int ch = 0; ch < num_channels; ch++) {
+    struct eq* eq = eq_new();
+
+    data[ch].assign(len, 0);
+    add_sine(data[ch].data(), len, 100 / NQ, ch, 1);
+    add_sine(data[ch].data(), len, 5000 / NQ, 0, 0.5);
+    expected[ch] = data[ch];
+    ptrs[ch] = data[ch].data();
+
+    // A different number of biquads on each channel.
+    for (int i = 0; i <= ch % 3; i++) {
+      float freq = (500 + 1000 * ch) / NQ;
+      EXPECT_EQ(0, eq_append_biquad(eq, types[i], freq, 2, -6));
+      EXPECT_EQ(0, eqn_append_biquad(eqn, ch, types[i], freq, 2, -6));
+    }
+    eq_process(eq, expected[ch].data(), len);
+    eq_free(eq);
+  }
+
+  // In two calls to check the state carries over.
+  eqn_process(eqn, ptrs, 1000);
+  for (int ch = 0; ch < num_channels; ch++) {
+    ptrs[ch] += 1000;
+  }
+  eqn_process(eqn, ptrs, len - 1000);
+  for (int ch = 0; ch < num_channels; ch++) {
+    for (size_t i = 0; i < len; i++) {
+      ASSERT_FLOAT_EQ(expected[ch][i], data[ch][i]) << ch << " " << i;
+    }
+  }
+
+  // Test for empty input
+  eqn_process(eqn, NULL, 0);
+  eqn_free(eqn);
+}
+
+TEST(EqNTest, Limits) {
+  float f_high = 1000.0 / 22050;
+  struct eqn* eqn;
+
+  EXPECT_EQ(nullptr, eqn_new(0));
+  EXPECT_EQ(nullptr, eqn_new(MAX_EQN_CHANNELS + 1));
+
+  eqn = eqn_new(4);
+  ASSERT_NE(nullptr, eqn);
+  EXPECT_EQ(-EINVAL, eqn_append_biquad(eqn, -1, BQ_PEAKING, f_high, 5, 6));
+  EXPECT_EQ(-EINVAL, eqn_append_biquad(eqn, 4, BQ_PEAKING, f_high, 5, 6));
+
+  // Too many biquads
+  for (int i = 0; i < MAX_BIQUADS_PER_EQN; i++) {
+    EXPECT_EQ(0, eqn_append_biquad(eqn, 3, BQ_PEAKING, f_high, 5, 6));
+  }
+  EXPECT_EQ(-EINVAL, eqn_append_biquad(eqn, 3, BQ_PEAKING, f_high, 5, 6));
+  EXPECT_EQ(0, eqn_append_biquad(eqn, 0, BQ_PEAKING, f_high, 5, 6));
+  eqn_free(eqn);
+}
+
 TEST(CrossoverTest, All) {
   struct crossover xo;
   size_t len = 44100;
@@ -416,6 +532,123 @@ TEST(Crossover2Test, All) {
   free(data2R);
 }
 
+TEST(Crossover2Test, Avx2MatchesPortable) {
+  if (!(cpu_x86_features() & DSP_X86_AVX2)) {
+    GTEST_SKIP() << "No AVX2";
+  }
+  const size_t len = 4096;
+  const float NQ = 44100 / 2;
+  // Odd sizes to cover the start and end of each run.
+  const size_t chunks[] = {1, 2, 31, 480, 1000};
+  struct crossover2 simd, portable;
+  std::vector<float> in[2], out[2][6];
+
+  dsp_enable_flush_denormal_to_zero();
+  dsp_set_x86_features(DSP_X86_AVX2);
+  crossover2_init(&simd, 250 / NQ, 4000 / NQ);
+  dsp_set_x86_features(0);
+  crossover2_init(&portable, 250 / NQ, 4000 / NQ);
+  ASSERT_TRUE(simd.use_avx2);
+  ASSERT_FALSE(portable.use_avx2);
+
+  for (int ch = 0; ch < 2; ch++) {
+    in[ch].assign(len, 0);
+    add_sine(in[ch].data(), len, 62.5 / NQ, ch, 1);
+    add_sine(in[ch].data(), len, 1000 / NQ, 0, 0.5);
+    add_sine(in[ch].data(), len, 16000 / NQ, ch, 0.25);
+  }
+  for (int i = 0; i < 2; i++) {
+    struct crossover2* xo2 = i ? &portable : &simd;
+    std::vector<float>* bands = out[i];
+
+    bands[0] = in[0];
+    bands[1] = in[1];
+    for (int b = 2; b < 6; b++) {
+      bands[b].assign(len, 0);
+    }
+    for (size_t start = 0, c = 0; start < len; c++) {
+      size_t chunk = std::min(len - start, chunks[c % std::size(chunks)]);
+      crossover2_process(xo2, chunk, &bands[0][start], &bands[1][start],
+                         &bands[2][start], &bands[3][start], &bands[4][start],
+                         &bands[5][start]);
+      start += chunk;
+    }
+  }
+  /* Bit exact with the scalar filters, the margin is for builds where the
+   * portable filters are the SSE3 ones. */
+  for (int b = 0; b < 6; b++) {
+    for (size_t i = 0; i < len; i++) {
+      ASSERT_NEAR(out[1][b][i], out[0][b][i], 1e-6) << b << " " << i;
+    }
+  }
+}
+
+// Three enabled bands, as tuned on a speaker.
+static void set_drc_params(struct drc* drc) {
+  const double NQ = 44100 / 2;
+  const float params[3][8] = {
+      {0, 1, -29, 3, 6.677, 0.02, 0.2, -7},
+      {200 / NQ, 1, -32, 23, 12, 0.02, 0.2, 0.7},
+      {1200 / NQ, 1, -24, 30, 1, 0.001, 1, 0},
+  };
+
+  for (int k = 0; k < 3; k++) {
+    drc_set_param(drc, k, PARAM_CROSSOVER_LOWER_FREQ, params[k][0]);
+    drc_set_param(drc, k, PARAM_ENABLED, params[k][1]);
+    drc_set_param(drc, k, PARAM_THRESHOLD, params[k][2]);
+    drc_set_param(drc, k, PARAM_KNEE, params[k][3]);
+    drc_set_param(drc, k, PARAM_RATIO, params[k][4]);
+    drc_set_param(drc, k, PARAM_ATTACK, params[k][5]);
+    drc_set_param(drc, k, PARAM_RELEASE, params[k][6]);
+    drc_set_param(drc, k, PARAM_POST_GAIN, params[k][7]);
+  }
+}
+
+TEST(DrcTest, Avx2FmaMatchesPortable) {
+  const unsigned int avx2_fma = DSP_X86_AVX2 | DSP_X86_FMA;
+  if ((cpu_x86_features() & avx2_fma) != avx2_fma) {
+    GTEST_SKIP() << "No AVX2 and FMA";
+  }
+  const size_t len = 44100;
+  const float NQ = 44100 / 2;
+  struct drc* drcs[2];
+  std::vector<float> data[2][2];
+
+  dsp_enable_flush_denormal_to_zero();
+  for (int i = 0; i < 2; i++) {
+    drcs[i] = drc_new(44100);
+    set_drc_params(drcs[i]);
+    dsp_set_x86_features(i ? 0 : avx2_fma);
+    drc_init(drcs[i]);
+    dsp_set_x86_features(0);
+
+    // Loud then quiet, to go through attack and release.
+    for (int ch = 0; ch < 2; ch++) {
+      data[i][ch].assign(len, 0);
+      add_sine(data[i][ch].data(), len / 2, 100 / NQ, ch, 1);
+      add_sine(data[i][ch].data(), len, 3000 / NQ, 0, 0.05);
+    }
+  }
+  ASSERT_TRUE(drcs[0]->kernel[0].use_avx2_fma);
+  ASSERT_FALSE(drcs[1]->kernel[0].use_avx2_fma);
+
+  for (int i = 0; i < 2; i++) {
+    for (size_t start = 0; start < len; start += DRC_PROCESS_MAX_FRAMES) {
+      int chunk = std::min(len - start, (size_t)DRC_PROCESS_MAX_FRAMES);
+      float* ptrs[] = {&data[i][0][start], &data[i][1][start]};
+      drc_process(drcs[i], ptrs, chunk);
+    }
+    drc_free(drcs[i]);
+  }
+
+  // The gains only differ by the rounding of FMA.
+  for (int ch = 0; ch < 2; ch++) {
+    for (size_t i = 0; i < len; i++) {
+      ASSERT_NEAR(data[1][ch][i], data[0][ch][i], 1e-5) << ch << " " << i;
+    }
+  }
+}
+
 TEST(DrcTest, All) {
   size_t len = 44100;
   float NQ = len / 2;
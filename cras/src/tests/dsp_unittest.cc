@@ -4,7 +4,10 @@
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include "cras/src/server/cras_dsp.h"
+#include "cras/src/server/cras_dsp_ini.h"
 #include "cras/src/server/cras_dsp_module.h"
 
 #define FILENAME_TEMPLATE "DspTest.XXXXXX"
@@ -128,6 +131,29 @@ static void empty_dump(struct dsp_module* module, struct dumper* d) {
   dumpf(d, "built-in module\n");
 }
 
+/* A "scale" module multiplies input_0 by the control input_2 into output_1.
+ * The number of freed scale modules is counted. */
+static int scale_module_freed;
+
+static void scale_connect_port(struct dsp_module* module,
+                               unsigned long port,
+                               float* data_location) {
+  ((float**)module->data)[port] = data_location;
+}
+
+static void scale_run(struct dsp_module* module, unsigned long sample_count) {
+  float** ports = (float**)module->data;
+  for (unsigned long i = 0; i < sample_count; i++) {
+    ports[1][i] = ports[0][i] * ports[2][0];
+  }
+}
+
+static void scale_free_module(struct dsp_module* module) {
+  scale_module_freed++;
+  free(module->data);
+  free(module);
+}
+
 static void empty_init_module(struct dsp_module* module) {
   module->instantiate = &empty_instantiate;
   module->connect_port = &empty_connect_port;
@@ -140,13 +166,102 @@ static void empty_init_module(struct dsp_module* module) {
   module->dump = &empty_dump;
 }
 
+static void scale_init_module(struct dsp_module* module) {
+  empty_init_module(module);
+  module->data = calloc(3, sizeof(float*));
+  module->connect_port = &scale_connect_port;
+  module->run = &scale_run;
+  module->free_module = &scale_free_module;
+}
+
+// Runs the pipeline of ctx over frames of 1.0 and returns the output.
+static std::vector<float> apply_ones(struct cras_dsp_context* ctx,
+                                     unsigned int frames) {
+  std::vector<float> buf(frames, 1.0f);
+  struct pipeline* pipeline = cras_dsp_get_pipeline(ctx);
+  if (!pipeline) {
+    return buf;
+  }
+  cras_dsp_pipeline_apply(pipeline, (uint8_t*)buf.data(),
+                          SND_PCM_FORMAT_FLOAT_LE, frames);
+  cras_dsp_put_pipeline(ctx);
+  return buf;
+}
+
+TEST_F(DspTestSuite, CrossfadeOnReload) {
+  const char* content =
+      "[M1]\n"
+      "library=builtin\n"
+      "label=source\n"
+      "purpose=playback\n"
+      "output_0={a}\n"
+      "[M2]\n"
+      "library=builtin\n"
+      "label=scale\n"
+      "input_0={a}\n"
+      "output_1={b}\n"
+      "input_2=2.0\n"
+      "disable=(not (equal? gain \"two\"))\n"
+      "[M3]\n"
+      "library=builtin\n"
+      "label=scale\n"
+      "input_0={b}\n"
+      "output_1={c}\n"
+      "input_2=4.0\n"
+      "disable=(not (equal? gain \"four\"))\n"
+      "[M4]\n"
+      "library=builtin\n"
+      "label=sink\n"
+      "purpose=playback\n"
+      "input_0={c}\n"
+      "\n";
+  fprintf(fp, "%s", content);
+  CloseFile();
+
+  cras_dsp_init(filename);
+  cras_dsp_set_crossfade_frames(8);
+  scale_module_freed = 0;
+  struct cras_dsp_context* ctx = cras_dsp_context_new(48000, "playback");
+  cras_dsp_set_variable_string(ctx, "gain", "two");
+  cras_dsp_load_pipeline(ctx);
+
+  // Nothing to fade from at first.
+  EXPECT_EQ(std::vector<float>(4, 2.0f), apply_ones(ctx, 4));
+
+  // The new pipeline fades in over 8 frames, across two periods.
+  cras_dsp_set_variable_string(ctx, "gain", "four");
+  cras_dsp_load_pipeline(ctx);
+  EXPECT_EQ(std::vector<float>({2.0f, 2.25f, 2.5f, 2.75f}), apply_ones(ctx, 4));
+  EXPECT_EQ(std::vector<float>({3.0f, 3.25f, 3.5f, 3.75f, 4.0f, 4.0f}),
+            apply_ones(ctx, 6));
+  EXPECT_EQ(std::vector<float>(4, 4.0f), apply_ones(ctx, 4));
+
+  // The old pipeline is only destroyed by the next load.
+  EXPECT_EQ(0, scale_module_freed);
+  cras_dsp_set_crossfade_frames(0);
+  cras_dsp_set_variable_string(ctx, "gain", "two");
+  cras_dsp_load_pipeline(ctx);
+  EXPECT_EQ(1, scale_module_freed);
+
+  // Without crossfade frames the switch is immediate.
+  EXPECT_EQ(std::vector<float>(4, 2.0f), apply_ones(ctx, 4));
+
+  cras_dsp_context_free(ctx);
+  EXPECT_EQ(3, scale_module_freed);
+  cras_dsp_stop();
+}
+
 }  //  namespace
 
 extern "C" {
 struct dsp_module* cras_dsp_module_load_builtin(struct plugin* plugin) {
   struct dsp_module* module;
   module = (struct dsp_module*)calloc(1, sizeof(struct dsp_module));
-  empty_init_module(module);
+  if (strcmp(plugin->label, "scale") == 0) {
+    scale_init_module(module);
+  } else {
+    empty_init_module(module);
+  }
   return module;
 }
 void cras_dsp_module_set_sink_ext_module(struct dsp_module* module,
@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 #include <syslog.h>
 
+#include <string>
+
 #include "cras/src/common/dumper.h"
 
 namespace {
@@ -53,4 +55,20 @@ TEST(DumperTest, MemDumper) {
   mem_dumper_free(dumper);
 }
 
+TEST(DumperTest, MemDumperGrowWithArguments) {
+  struct dumper* dumper = mem_dumper_create();
+  char* buf;
+  int size;
+
+  // Longer than the initial buffer, so the arguments are formatted twice.
+  dumpf(dumper, "%s %d %s %d", std::string(100, 'x').c_str(), 1,
+        std::string(100, 'y').c_str(), 2);
+  mem_dumper_get(dumper, &buf, &size);
+  EXPECT_EQ(std::string(100, 'x') + " 1 " + std::string(100, 'y') + " 2",
+            buf);
+  EXPECT_EQ(205, size);
+
+  mem_dumper_free(dumper);
+}
+
 }  //  namespace
@@ -499,7 +499,7 @@ struct audio_thread* cras_iodev_list_get_audio_thread() {
 void ewma_power_disable(struct ewma_power* ewma) {}
 
 // From audio_thread
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 
 // From cras_bt_log
 struct cras_bt_event_log* btlog;
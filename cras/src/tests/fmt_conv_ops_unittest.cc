@@ -8,9 +8,11 @@
 #include <memory>
 #include <stdint.h>
 #include <sys/param.h>
+#include <vector>
 
 extern "C" {
 #include "cras/src/server/cras_fmt_conv_ops.h"
+#include "cras/src/server/cras_mix.h"
 #include "cras_types.h"
 }
 
@@ -1278,4 +1280,151 @@ TEST(FormatConverterOpsTest, TwentyToTwoS16LE) {
   }
 }
 
+// Converter tables runnable on this CPU. The scalar functions are the
+// reference they must match bit for bit.
+static std::vector<const struct cras_fmt_conv_ops*> SupportedOps() {
+  std::vector<const struct cras_fmt_conv_ops*> ret = {&fmt_conv_ops};
+  unsigned int cpu_flags = 0;
+
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    cpu_flags |= CPU_X86_SSE4_2;
+    ret.push_back(cras_fmt_conv_get_ops(CPU_X86_SSE4_2));
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    cpu_flags |= CPU_X86_AVX2;
+    ret.push_back(cras_fmt_conv_get_ops(CPU_X86_AVX2));
+  }
+#endif
+  ret.push_back(cras_fmt_conv_get_ops(cpu_flags));
+  return ret;
+}
+
+// Odd frame count to cover the loop tails of every vector width.
+static const size_t kSimdFrames = 1021;
+
+TEST(FormatConverterSimdOpsTest, DefaultOps) {
+  EXPECT_EQ(&fmt_conv_ops, cras_fmt_conv_get_ops(0));
+}
+
+TEST(FormatConverterSimdOpsTest, S24LEToS16LE) {
+  const size_t samples = kSimdFrames * 2;
+  S24LEPtr src = CreateS24LE(samples);
+  S16LEPtr exp = CreateS16LE(samples);
+  S16LEPtr dst = CreateS16LE(samples);
+
+  convert_s24le_to_s16le((uint8_t*)src.get(), samples, (uint8_t*)exp.get());
+  for (auto ops : SupportedOps()) {
+    ops->s24le_to_s16le((uint8_t*)src.get(), samples, (uint8_t*)dst.get());
+    EXPECT_EQ(0, memcmp(exp.get(), dst.get(), samples * sizeof(int16_t)));
+  }
+}
+
+TEST(FormatConverterSimdOpsTest, S32LEToS16LE) {
+  const size_t samples = kSimdFrames * 2;
+  S32LEPtr src = CreateS32LE(samples);
+  S16LEPtr exp = CreateS16LE(samples);
+  S16LEPtr dst = CreateS16LE(samples);
+
+  convert_s32le_to_s16le((uint8_t*)src.get(), samples, (uint8_t*)exp.get());
+  for (auto ops : SupportedOps()) {
+    ops->s32le_to_s16le((uint8_t*)src.get(), samples, (uint8_t*)dst.get());
+    EXPECT_EQ(0, memcmp(exp.get(), dst.get(), samples * sizeof(int16_t)));
+  }
+}
+
+TEST(FormatConverterSimdOpsTest, S16LEToS32LE) {
+  const size_t samples = kSimdFrames * 2;
+  S16LEPtr src = CreateS16LE(samples);
+  S32LEPtr exp = CreateS32LE(samples);
+  S32LEPtr dst = CreateS32LE(samples);
+
+  convert_s16le_to_s32le((uint8_t*)src.get(), samples, (uint8_t*)exp.get());
+  for (auto ops : SupportedOps()) {
+    ops->s16le_to_s32le((uint8_t*)src.get(), samples, (uint8_t*)dst.get());
+    EXPECT_EQ(0, memcmp(exp.get(), dst.get(), samples * sizeof(int32_t)));
+  }
+}
+
+TEST(FormatConverterSimdOpsTest, StereoTo51) {
+  // left, right and center placements, -1 when missing.
+  const size_t layouts[][3] = {
+      {0, 1, 2},          {4, 5, (size_t)-1},          {3, 3, 2},
+      {(size_t)-1, 1, 2}, {(size_t)-1, (size_t)-1, 2}, {(size_t)-1, 0, 5},
+      {(size_t)-1, (size_t)-1, (size_t)-1},
+  };
+  S16LEPtr src = CreateS16LE(kSimdFrames * 2);
+  S16LEPtr exp = CreateS16LE(kSimdFrames * 6);
+  S16LEPtr dst = CreateS16LE(kSimdFrames * 6);
+
+  for (auto& l : layouts) {
+    s16_stereo_to_51(l[0], l[1], l[2], (uint8_t*)src.get(), kSimdFrames,
+                     (uint8_t*)exp.get());
+    for (auto ops : SupportedOps()) {
+      size_t ret = ops->s16_stereo_to_51(l[0], l[1], l[2], (uint8_t*)src.get(),
+                                         kSimdFrames, (uint8_t*)dst.get());
+      EXPECT_EQ(kSimdFrames, ret);
+      EXPECT_EQ(0, memcmp(exp.get(), dst.get(),
+                          kSimdFrames * 6 * sizeof(int16_t)));
+    }
+  }
+}
+
+TEST(FormatConverterSimdOpsTest, _51ToStereo) {
+  S16LEPtr src = CreateS16LE(kSimdFrames * 6);
+  S16LEPtr exp = CreateS16LE(kSimdFrames * 2);
+  S16LEPtr dst = CreateS16LE(kSimdFrames * 2);
+
+  // Full scale samples on the first frames.
+  for (size_t i = 0; i < 6; i++) {
+    src[i] = SHRT_MAX;
+    src[6 + i] = SHRT_MIN;
+  }
+  s16_51_to_stereo((uint8_t*)src.get(), kSimdFrames, (uint8_t*)exp.get());
+  for (auto ops : SupportedOps()) {
+    size_t ret = ops->s16_51_to_stereo((uint8_t*)src.get(), kSimdFrames,
+                                       (uint8_t*)dst.get());
+    EXPECT_EQ(kSimdFrames, ret);
+    EXPECT_EQ(0,
+              memcmp(exp.get(), dst.get(), kSimdFrames * 2 * sizeof(int16_t)));
+  }
+}
+
+TEST(FormatConverterSimdOpsTest, ConvertChannels) {
+  // in and out channel counts, including the ones above CRAS_CH_MAX.
+  const size_t layouts[][2] = {{2, 4}, {2, 6}, {2, 8}, {6, 2},  {6, 4},
+                               {6, 6}, {8, 8}, {3, 5}, {11, 2}, {12, 3}};
+
+  for (auto& l : layouts) {
+    const size_t in_ch = l[0];
+    const size_t out_ch = l[1];
+    S16LEPtr src = CreateS16LE(kSimdFrames * in_ch);
+    S16LEPtr exp = CreateS16LE(kSimdFrames * out_ch);
+    S16LEPtr dst = CreateS16LE(kSimdFrames * out_ch);
+    std::vector<float> ch_conv_mtx(in_ch * out_ch);
+    std::unique_ptr<float*[]> mtx(new float*[out_ch]);
+
+    // Coefficients in [-1.5, 1.5] so that some of the sums clip.
+    for (size_t i = 0; i < ch_conv_mtx.size(); i++) {
+      ch_conv_mtx[i] = (float)(rand() % 3001 - 1500) / 1000;
+    }
+    for (size_t i = 0; i < out_ch; i++) {
+      mtx[i] = &ch_conv_mtx[i * in_ch];
+    }
+
+    s16_convert_channels(mtx.get(), in_ch, out_ch, (uint8_t*)src.get(),
+                         kSimdFrames, (uint8_t*)exp.get());
+    for (auto ops : SupportedOps()) {
+      size_t ret =
+          ops->s16_convert_channels(mtx.get(), in_ch, out_ch,
+                                    (uint8_t*)src.get(), kSimdFrames,
+                                    (uint8_t*)dst.get());
+      EXPECT_EQ(kSimdFrames, ret);
+      EXPECT_EQ(0, memcmp(exp.get(), dst.get(),
+                          kSimdFrames * out_ch * sizeof(int16_t)))
+          << in_ch << " to " << out_ch;
+    }
+  }
+}
+
 extern "C" {}  // extern "C"
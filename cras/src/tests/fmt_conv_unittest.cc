@@ -6,6 +6,11 @@
 #include <math.h>
 #include <sys/param.h>
 
+#include <algorithm>
+#include <vector>
+
+#include "cras/src/tests/scoped_features_override.h"
+
 extern "C" {
 #include "cras/src/server/cras_fmt_conv.h"
 #include "cras_types.h"
@@ -1731,6 +1736,60 @@ TEST(FormatConverterTest, ConvertS32LEToS16LEDownmix51ToStereo441To48) {
   free(out_buff);
 }
 
+// Test 44.1 to 48kHz through the polyphase resampler in small chunks.
+TEST(FormatConverterTest, ConvertS16LEStereo441To48Polyphase) {
+  ScopedFeaturesOverride feature_override(
+      {CrOSLateBootAudioPolyphaseResampler});
+  struct cras_fmt_conv* c;
+  struct cras_audio_format in_fmt;
+  struct cras_audio_format out_fmt;
+  const size_t buf_size = 4410;
+  const unsigned int chunk = 441;
+  size_t in_done = 0, out_done = 0;
+  int16_t* in_buff;
+  int16_t* out_buff;
+  int i;
+
+  ResetStub();
+  in_fmt.format = out_fmt.format = SND_PCM_FORMAT_S16_LE;
+  in_fmt.num_channels = out_fmt.num_channels = 2;
+  in_fmt.frame_rate = 44100;
+  out_fmt.frame_rate = 48000;
+  for (i = 0; i < CRAS_CH_MAX; i++) {
+    in_fmt.channel_layout[i] = stereo_channel_layout[i];
+    out_fmt.channel_layout[i] = stereo_channel_layout[i];
+  }
+
+  c = cras_fmt_conv_create(&in_fmt, &out_fmt, buf_size, 0,
+                           CRAS_NODE_TYPE_LINEOUT);
+  ASSERT_NE(c, (void*)NULL);
+  EXPECT_TRUE(cras_fmt_conversion_needed(c));
+  EXPECT_FALSE(cras_fmt_conv_mix_fusable(c));
+
+  in_buff = (int16_t*)malloc(buf_size * 4);
+  out_buff = (int16_t*)malloc(buf_size * 2 * 4);
+  for (i = 0; i < (int)buf_size * 2; i++) {
+    in_buff[i] = 1000;
+  }
+  while (in_done < buf_size) {
+    unsigned int in_frames = MIN(chunk, buf_size - in_done);
+
+    out_done += cras_fmt_conv_convert_frames(
+        c, (uint8_t*)(in_buff + in_done * 2),
+        (uint8_t*)(out_buff + out_done * 2), &in_frames, 2 * chunk);
+    ASSERT_GT(in_frames, 0);
+    in_done += in_frames;
+  }
+  // All but the frames still in the filter come out at the new rate.
+  EXPECT_LE(out_done, 4800);
+  EXPECT_GT(out_done, 4700);
+  EXPECT_NEAR(out_buff[2 * (out_done - 1)], 1000, 1);
+
+  cras_fmt_conv_destroy(&c);
+  free(in_buff);
+  free(out_buff);
+}
+
 // Test Invalid buffer length just truncates.
 TEST(FormatConverterTest, ConvertS32LEToS16LEDownmix51ToStereo96To48Short) {
   struct cras_fmt_conv* c;
@@ -1955,6 +2014,103 @@ TEST(FormatConverterTest, ConfigConverterNoNeedForInput) {
   cras_fmt_conv_destroy(&c);
 }
 
+TEST(FormatConverterTest, ConfigConverterReusesReleased) {
+  int i;
+  struct cras_fmt_conv* c = NULL;
+  struct cras_fmt_conv* reused = NULL;
+  struct cras_fmt_conv* other = NULL;
+  struct cras_audio_format in_fmt;
+  struct cras_audio_format out_fmt;
+  uint32_t hits, misses, hits_before, misses_before;
+
+  ResetStub();
+  cras_fmt_conv_pool_clear();
+  in_fmt.format = out_fmt.format = SND_PCM_FORMAT_S16_LE;
+  in_fmt.num_channels = 1;
+  out_fmt.num_channels = 2;
+  in_fmt.frame_rate = 44100;
+  out_fmt.frame_rate = 48000;
+  for (i = 0; i < CRAS_CH_MAX; i++) {
+    in_fmt.channel_layout[i] = mono_channel_layout[i];
+    out_fmt.channel_layout[i] = stereo_channel_layout[i];
+  }
+  cras_fmt_conv_pool_stats(&hits_before, &misses_before);
+
+  config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 4096);
+  ASSERT_NE(c, (void*)NULL);
+  cras_fmt_conv_release(&c);
+  EXPECT_EQ(c, (void*)NULL);
+
+  // A different size or node type doesn't match.
+  config_format_converter(&other, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 2048);
+  ASSERT_NE(other, (void*)NULL);
+  cras_fmt_conv_destroy(&other);
+  config_format_converter(&other, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_INTERNAL_SPEAKER, 4096);
+  ASSERT_NE(other, (void*)NULL);
+  cras_fmt_conv_destroy(&other);
+
+  config_format_converter(&reused, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 4096);
+  ASSERT_NE(reused, (void*)NULL);
+  EXPECT_EQ(2, cras_fmt_conv_out_format(reused)->num_channels);
+
+  cras_fmt_conv_pool_stats(&hits, &misses);
+  EXPECT_EQ(1, hits - hits_before);
+  EXPECT_EQ(3, misses - misses_before);
+
+  // The pool is empty again, the next one is created.
+  config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 4096);
+  EXPECT_NE(c, reused);
+  cras_fmt_conv_destroy(&c);
+  cras_fmt_conv_destroy(&reused);
+}
+
+TEST(FormatConverterTest, ConverterPoolEvictsOldest) {
+  int i;
+  struct cras_fmt_conv* convs[9];
+  struct cras_fmt_conv* c = NULL;
+  struct cras_audio_format in_fmt;
+  struct cras_audio_format out_fmt;
+  uint32_t hits, misses, hits_before, misses_before;
+
+  ResetStub();
+  cras_fmt_conv_pool_clear();
+  in_fmt.format = out_fmt.format = SND_PCM_FORMAT_S16_LE;
+  in_fmt.num_channels = out_fmt.num_channels = 2;
+  in_fmt.frame_rate = out_fmt.frame_rate = 48000;
+  for (i = 0; i < CRAS_CH_MAX; i++) {
+    in_fmt.channel_layout[i] = stereo_channel_layout[i];
+    out_fmt.channel_layout[i] = stereo_channel_layout[i];
+  }
+
+  // One more converter than the pool keeps, each of a different size.
+  for (i = 0; i < 9; i++) {
+    config_format_converter(&convs[i], CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                            CRAS_NODE_TYPE_HEADPHONE, 256 * (i + 1));
+    ASSERT_NE(convs[i], (void*)NULL);
+  }
+  for (i = 0; i < 9; i++) {
+    cras_fmt_conv_release(&convs[i]);
+  }
+  cras_fmt_conv_pool_stats(&hits_before, &misses_before);
+
+  config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 256);
+  cras_fmt_conv_destroy(&c);
+  config_format_converter(&c, CRAS_STREAM_OUTPUT, &in_fmt, &out_fmt,
+                          CRAS_NODE_TYPE_HEADPHONE, 256 * 9);
+  cras_fmt_conv_destroy(&c);
+
+  cras_fmt_conv_pool_stats(&hits, &misses);
+  EXPECT_EQ(1, hits - hits_before);
+  EXPECT_EQ(1, misses - misses_before);
+  cras_fmt_conv_pool_clear();
+}
+
 TEST(ChannelRemixTest, ChannelRemixAppliedOrNot) {
   float coeff[4] = {0.5, 0.5, 0.26, 0.73};
   struct cras_fmt_conv* conv;
@@ -2002,6 +2158,53 @@ TEST(ChannelRemixTest, ChannelRemixAppliedOrNot) {
   free(res);
 }
 
+// Remixes frames of buf with coeff the way the dense matrix multiply does.
+static std::vector<int16_t> RemixReference(const std::vector<int16_t>& buf,
+                                           const float* coeff,
+                                           unsigned int num_channels) {
+  std::vector<int16_t> res(buf.size());
+
+  for (size_t i = 0; i < buf.size(); i += num_channels) {
+    for (unsigned int out_ch = 0; out_ch < num_channels; out_ch++) {
+      int32_t sum = 0;
+
+      for (unsigned int in_ch = 0; in_ch < num_channels; in_ch++) {
+        sum += coeff[out_ch * num_channels + in_ch] * buf[i + in_ch];
+      }
+      res[i + out_ch] = std::min(std::max(sum, -0x8000), 0x7fff);
+    }
+  }
+  return res;
+}
+
+TEST(ChannelRemixTest, MatrixKinds) {
+  // Swaps left and right, and drops the third channel.
+  const float copy[9] = {0, 1, 0, 1, 0, 0, 0, 0, 0};
+  // At most two terms per row.
+  const float sparse[9] = {0.7, 0, 0.7, 0, 1, 0, 0, 0.5, -0.5};
+  // Mixes all three channels into each.
+  const float dense[9] = {0.3, 0.3, 0.3, 0.5, 0.25, 0.25, 1, -1, 1};
+  const float* coeffs[] = {copy, sparse, dense};
+  struct cras_audio_format fmt;
+  // Not a multiple of the block the remix works in.
+  const unsigned int frames = 1000;
+
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  fmt.num_channels = 3;
+  for (const float* coeff : coeffs) {
+    struct cras_fmt_conv* conv = cras_channel_remix_conv_create(3, coeff);
+    int16_t* data = (int16_t*)ralloc(frames * 3 * 2);
+    std::vector<int16_t> buf(data, data + frames * 3);
+    std::vector<int16_t> res = RemixReference(buf, coeff, 3);
+
+    ASSERT_NE(conv, nullptr);
+    cras_channel_remix_convert(conv, &fmt, (uint8_t*)buf.data(), frames);
+    EXPECT_EQ(res, buf);
+    cras_fmt_conv_destroy(&conv);
+    free(data);
+  }
+}
+
 extern "C" {
 float** cras_channel_conv_matrix_alloc(size_t in_ch, size_t out_ch) {
   int i;
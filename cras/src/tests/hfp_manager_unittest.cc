@@ -197,7 +197,7 @@ int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen) {
 }
 
 // From audio_thread
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 
 // From cras_bt_log
 struct cras_bt_event_log* btlog;
@@ -3312,6 +3312,14 @@ int audio_thread_start(struct audio_thread* thread) {
 
 void audio_thread_destroy(struct audio_thread* thread) {}
 
+struct audio_thread* audio_thread_set_current(struct audio_thread* t) {
+  return &thread;
+}
+
+struct audio_thread* audio_thread_get_current() {
+  return &thread;
+}
+
 int audio_thread_set_active_dev(struct audio_thread* thread,
                                 struct cras_iodev* dev) {
   audio_thread_set_active_dev_called++;
@@ -3389,6 +3397,27 @@ int audio_thread_drain_stream(struct audio_thread* thread,
   return audio_thread_drain_stream_return;
 }
 
+int audio_thread_set_aec_dump(struct audio_thread* thread,
+                              cras_stream_id_t stream_id,
+                              unsigned int start,
+                              int fd,
+                              audio_thread_token_t* token) {
+  return 0;
+}
+
+int audio_thread_config_global_remix(struct audio_thread* thread,
+                                     unsigned int num_channels,
+                                     const float* coefficient,
+                                     audio_thread_token_t* token) {
+  return 0;
+}
+
+int audio_thread_dump_threads_info(struct audio_thread** threads,
+                                   unsigned int num_threads,
+                                   struct audio_debug_info* info) {
+  return 0;
+}
+
 struct cras_iodev* empty_iodev_create(enum CRAS_STREAM_DIRECTION direction,
                                       enum CRAS_NODE_TYPE node_type) {
   struct cras_iodev* dev;
@@ -3633,6 +3662,10 @@ void cras_stream_apm_remove(struct cras_stream_apm* stream,
 int cras_stream_apm_init(const char* device_config_dir) {
   return 0;
 }
+int cras_stream_apm_add_audio_thread(struct audio_thread* thread) {
+  return 0;
+}
+void cras_stream_apm_rm_audio_thread(struct audio_thread* thread) {}
 int cras_stream_apm_set_aec_ref(struct cras_stream_apm* stream,
                                 struct cras_iodev* echo_ref) {
   cras_stream_apm_set_aec_ref_called++;
@@ -3663,6 +3696,10 @@ int cras_system_get_max_internal_mic_gain() {
   return cras_system_get_max_internal_mic_gain_return;
 }
 
+int cras_system_get_num_audio_threads() {
+  return 1;
+}
+
 void cras_hats_trigger_general_survey(enum CRAS_STREAM_TYPE stream_type,
                                       enum CRAS_CLIENT_TYPE client_type,
                                       const char* node_type_pair) {}
@@ -141,6 +141,14 @@ int cras_iodev_put_output_buffer(struct cras_iodev* iodev,
   return 0;
 }
 
+int cras_iodev_put_output_mix_bus(struct cras_iodev* iodev,
+                                  uint8_t* frames,
+                                  unsigned int nframes,
+                                  int* non_empty,
+                                  struct cras_fmt_conv* output_converter) {
+  return 0;
+}
+
 int cras_iodev_get_input_buffer(struct cras_iodev* iodev, unsigned* frames) {
   return 0;
 }
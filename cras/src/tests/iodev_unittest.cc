@@ -6,6 +6,7 @@
 #include <math.h>
 #include <stdio.h>
 
+#include "cras/src/tests/scoped_features_override.h"
 #include "cras_types.h"
 
 extern "C" {
@@ -64,6 +65,8 @@ static int cras_dsp_pipeline_get_delay_called;
 static int cras_dsp_pipeline_apply_called;
 static int cras_dsp_pipeline_set_sink_ext_module_called;
 static int cras_dsp_pipeline_apply_sample_count;
+static snd_pcm_format_t cras_dsp_pipeline_apply_format;
+static unsigned int cras_mix_float_to_format_count;
 static unsigned int cras_mix_mute_count;
 static unsigned int cras_dsp_num_input_channels_return;
 static unsigned int cras_dsp_num_output_channels_return;
@@ -90,7 +93,7 @@ static int is_free_running_ret;
 static int no_stream_called;
 static int no_stream_enable;
 // This will be used extensively in cras_iodev.
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 static unsigned int simple_no_stream_called;
 static int simple_no_stream_enable;
 static int dev_stream_playback_frames_ret;
@@ -173,6 +176,8 @@ void ResetStubData() {
   cras_dsp_pipeline_apply_called = 0;
   cras_dsp_pipeline_set_sink_ext_module_called = 0;
   cras_dsp_pipeline_apply_sample_count = 0;
+  cras_dsp_pipeline_apply_format = SND_PCM_FORMAT_UNKNOWN;
+  cras_mix_float_to_format_count = 0;
   cras_dsp_num_input_channels_return = 2;
   cras_dsp_num_output_channels_return = 2;
   cras_dsp_context_new_return = NULL;
@@ -207,7 +212,7 @@ void ResetStubData() {
     }
     // To avoid un-used variable warning.
     atlog_rw_shm_fd = atlog_ro_shm_fd = -1;
-    atlog = audio_thread_event_log_init(atlog_name);
+    atlog = audio_thread_event_log_init(atlog_name, 1);
   }
   device_monitor_reset_device_called = 0;
   output_underrun_called = 0;
@@ -839,6 +844,59 @@ TEST(IoDevPutOutputBuffer, DSP) {
   EXPECT_EQ(cras_dsp_get_pipeline_called, cras_dsp_put_pipeline_called);
 }
 
+TEST(IoDevPutOutputBuffer, MixBusDSP) {
+  struct cras_audio_format fmt;
+  struct cras_iodev iodev;
+  uint8_t frames[32 * 4];
+  float mix_bus[32 * 2] = {};
+  int rc;
+  int non_empty = 1;
+  struct cras_loopback pre_dsp;
+  struct cras_loopback post_dsp;
+
+  ResetStubData();
+  memset(&iodev, 0, sizeof(iodev));
+  iodev.dsp_context = reinterpret_cast<cras_dsp_context*>(0x15);
+  cras_dsp_get_pipeline_ret = 0x25;
+
+  fmt.format = SND_PCM_FORMAT_S16_LE;
+  fmt.frame_rate = 48000;
+  fmt.num_channels = 2;
+  iodev.format = &fmt;
+  iodev.put_buffer = put_buffer;
+  iodev.rate_est = reinterpret_cast<struct rate_estimator*>(0xdeadbeef);
+  iodev.mix_bus = mix_bus;
+  pre_dsp.type = LOOPBACK_POST_MIX_PRE_DSP;
+  pre_dsp.hook_data = pre_dsp_hook;
+  pre_dsp.hook_control = loopback_hook_control;
+  pre_dsp.cb_data = (void*)0x1234;
+  DL_APPEND(iodev.loopbacks, &pre_dsp);
+  post_dsp.type = LOOPBACK_POST_DSP;
+  post_dsp.hook_data = post_dsp_hook;
+  post_dsp.hook_control = loopback_hook_control;
+  post_dsp.cb_data = (void*)0x5678;
+  DL_APPEND(iodev.loopbacks, &post_dsp);
+
+  rc = cras_iodev_put_output_mix_bus(&iodev, frames, 32, &non_empty, nullptr);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(0, non_empty);
+  EXPECT_EQ(1, pre_dsp_hook_called);
+  EXPECT_EQ(frames, pre_dsp_hook_frames);
+  EXPECT_EQ(1, post_dsp_hook_called);
+  EXPECT_EQ(frames, post_dsp_hook_frames);
+  // The DSP runs on the float bus, then it's converted to the device format.
+  EXPECT_EQ(SND_PCM_FORMAT_FLOAT_LE, cras_dsp_pipeline_apply_format);
+  EXPECT_EQ(32, cras_dsp_pipeline_apply_sample_count);
+  EXPECT_EQ(64, cras_mix_float_to_format_count);
+  EXPECT_EQ(32, put_buffer_nframes);
+  EXPECT_EQ(cras_dsp_get_pipeline_called, cras_dsp_put_pipeline_called);
+
+  mix_bus[3] = 0.5f;
+  rc = cras_iodev_put_output_mix_bus(&iodev, frames, 32, &non_empty, nullptr);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, non_empty);
+}
+
 TEST(IoDevPutOutputBuffer, SoftVol) {
   struct cras_audio_format fmt;
   struct cras_iodev iodev;
@@ -1265,6 +1323,10 @@ static int configure_dev(struct cras_iodev* iodev) {
   return 0;
 }
 
+static int close_dev(struct cras_iodev* iodev) {
+  return 0;
+}
+
 TEST(IoDev, OpenOutputDeviceNoStart) {
   struct cras_iodev iodev;
 
@@ -1287,6 +1349,29 @@ TEST(IoDev, OpenOutputDeviceNoStart) {
   EXPECT_EQ(CRAS_IODEV_STATE_NO_STREAM_RUN, iodev.state);
 }
 
+TEST(IoDev, OpenOutputDeviceFloatMixBus) {
+  ScopedFeaturesOverride feature_override({CrOSLateBootAudioFloatMixBus});
+  struct cras_iodev iodev;
+
+  memset(&iodev, 0, sizeof(iodev));
+  iodev.configure_dev = configure_dev;
+  iodev.close_dev = close_dev;
+  iodev.direction = CRAS_STREAM_OUTPUT;
+  iodev.format = &audio_fmt;
+  iodev.get_buffer = get_buffer;
+  iodev.put_buffer = put_buffer;
+  ResetStubData();
+
+  iodev.state = CRAS_IODEV_STATE_CLOSE;
+
+  iodev_buffer_size = 1024;
+  cras_iodev_open(&iodev, 240, &audio_fmt);
+  EXPECT_NE(nullptr, iodev.mix_bus);
+
+  cras_iodev_close(&iodev);
+  EXPECT_EQ(nullptr, iodev.mix_bus);
+}
+
 TEST(IoDev, OpenOutputDeviceWithLowRateFmt) {
   struct cras_iodev iodev;
 
@@ -2753,6 +2838,7 @@ int cras_dsp_pipeline_apply(struct pipeline* pipeline,
                             unsigned int frames) {
   cras_dsp_pipeline_apply_called++;
   cras_dsp_pipeline_apply_sample_count = frames;
+  cras_dsp_pipeline_apply_format = format;
   return 0;
 }
 
@@ -2874,6 +2960,13 @@ size_t cras_mix_mute_buffer(uint8_t* dst, size_t frame_bytes, size_t count) {
   return count;
 }
 
+void cras_mix_float_to_format(snd_pcm_format_t fmt,
+                              uint8_t* dst,
+                              const float* src,
+                              unsigned int count) {
+  cras_mix_float_to_format_count = count;
+}
+
 struct rate_estimator* rate_estimator_create(unsigned int rate,
                                              const struct timespec* window_size,
                                              double smooth_factor) {
@@ -2997,6 +3090,10 @@ int cras_server_metrics_device_runtime(struct cras_iodev* iodev) {
   return 0;
 }
 
+int cras_server_metrics_device_gain(struct cras_iodev* iodev) {
+  return 0;
+}
+
 int cras_server_metrics_device_volume(struct cras_iodev* iodev) {
   return 0;
 }
@@ -3036,7 +3133,7 @@ int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   int rc = RUN_ALL_TESTS();
 
-  audio_thread_event_log_deinit(atlog, atlog_name);
+  audio_thread_event_log_deinit(atlog, atlog_name, 1);
   free(atlog_name);
   return rc;
 }
@@ -214,3 +214,60 @@ void cras_mix_add_scale_stride(int fmt,
 }
 
 }  //  extern "C"
+
+TEST(LinearResampler, ResampleRampAllChannelCounts) {
+  static int16_t in[6 * 400];
+  static int16_t out[6 * 400];
+
+  // Covers the mono, stereo and generic interpolation loops.
+  for (unsigned int ch = 1; ch <= 6; ch++) {
+    struct linear_resampler* lr =
+        linear_resampler_create(ch, 2 * ch, 48000, 44100);
+    unsigned int count = 300;
+    int rc;
+
+    for (unsigned int i = 0; i < 400; i++) {
+      for (unsigned int c = 0; c < ch; c++) {
+        in[i * ch + c] = i * 8 + c;
+      }
+    }
+    rc = linear_resampler_resample(lr, (uint8_t*)in, &count, (uint8_t*)out,
+                                   400);
+    EXPECT_EQ(275, rc);
+    EXPECT_EQ(300, count);
+
+    // Output frame j is at input position j * 480 / 441.
+    for (int j = 0; j < rc; j++) {
+      int exp = (int)(j * 480 * 8 / 441.0 + 0.5);
+      for (unsigned int c = 0; c < ch; c++) {
+        EXPECT_NEAR(exp + c, out[j * ch + c], 1) << ch << " " << j;
+      }
+    }
+    linear_resampler_destroy(lr);
+  }
+}
+
+TEST(LinearResampler, ConsumeOutFramesToInOverLongRun) {
+  static uint8_t in[4 * 1024];
+  static uint8_t out[4 * 1024];
+  struct linear_resampler* lr = linear_resampler_create(2, 4, 48000, 48000.37);
+  uint64_t total_in = 0;
+  uint64_t total_out = 0;
+
+  /* Long enough for the offsets to grow and wrap many times, positions
+   * must stay exact so the accounting never drifts. */
+  for (int i = 0; i < 100000; i++) {
+    unsigned int frames = linear_resampler_out_frames_to_in(lr, 480);
+    unsigned int count = frames;
+    int rc;
+
+    rc = linear_resampler_resample(lr, in, &count, out, 480);
+    EXPECT_EQ(frames, count);
+    EXPECT_GE(rc, 479);
+    EXPECT_LE(rc, 480);
+    total_in += count;
+    total_out += rc;
+  }
+  EXPECT_NEAR(total_in * 48000.37 / 48000, total_out, 2);
+  linear_resampler_destroy(lr);
+}
@@ -8,7 +8,7 @@
 
 extern "C" {
 // For audio_thread_log.h use.
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 int atlog_rw_shm_fd;
 int atlog_ro_shm_fd;
 #include "cras/src/server/audio_thread_log.h"
@@ -69,7 +69,7 @@ class LoopBackTestSuite : public testing::Test {
     ASSERT_FALSE(asprintf(&atlog_name, "/ATlog-%d", getpid()) < 0);
     // To avoid un-used variable warning.
     atlog_rw_shm_fd = atlog_ro_shm_fd = -1;
-    atlog = audio_thread_event_log_init(atlog_name);
+    atlog = audio_thread_event_log_init(atlog_name, 1);
   }
 
   virtual void TearDown() {
@@ -78,7 +78,7 @@ class LoopBackTestSuite : public testing::Test {
     EXPECT_EQ(NULL, device_enabled_callback_cb);
     EXPECT_EQ(NULL, device_disabled_callback_cb);
     free(mock_audio_area);
-    audio_thread_event_log_deinit(atlog, atlog_name);
+    audio_thread_event_log_deinit(atlog, atlog_name, 1);
     free(atlog_name);
   }
 
@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
 
+#include <vector>
+
 extern "C" {
 #include "cras/src/server/cras_mix.h"
 #include "cras_shm.h"
@@ -429,6 +431,47 @@ class MixTestSuiteS24_LE : public testing::Test {
   unsigned int fr_bytes_;
 };
 
+TEST_F(MixTestSuiteS16_LE, MixFloatRoundTrip) {
+  std::vector<float> bus(kNumSamples, 0.0f);
+
+  cras_mix_add_float(fmt_, bus.data(), (uint8_t*)src_buffer_, kNumSamples, 0,
+                     1.0);
+  cras_mix_float_to_format(fmt_, (uint8_t*)mix_buffer_, bus.data(),
+                           kNumSamples);
+  EXPECT_EQ(0, memcmp(mix_buffer_, src_buffer_, kBufferFrames * 4));
+}
+
+TEST_F(MixTestSuiteS16_LE, MixFloatTwoClip) {
+  std::vector<float> bus(kNumSamples, 0.0f);
+
+  for (size_t i = 0; i < kNumSamples; i++) {
+    src_buffer_[i] = (i % 2) ? INT16_MAX : INT16_MIN;
+  }
+  // The bus holds the sum beyond full scale, it's only clipped on conversion.
+  cras_mix_add_float(fmt_, bus.data(), (uint8_t*)src_buffer_, kNumSamples, 0,
+                     1.0);
+  cras_mix_add_float(fmt_, bus.data(), (uint8_t*)src_buffer_, kNumSamples, 0,
+                     1.0);
+  EXPECT_FLOAT_EQ(-2.0f, bus[0]);
+  cras_mix_float_to_format(fmt_, (uint8_t*)mix_buffer_, bus.data(),
+                           kNumSamples);
+  EXPECT_EQ(0, memcmp(mix_buffer_, src_buffer_, kBufferFrames * 4));
+}
+
+TEST_F(MixTestSuiteS16_LE, MixFloatMutedAndHalfVolume) {
+  std::vector<float> bus(kNumSamples, 0.0f);
+
+  cras_mix_add_float(fmt_, bus.data(), (uint8_t*)src_buffer_, kNumSamples, 1,
+                     1.0);
+  cras_mix_add_float(fmt_, bus.data(), (uint8_t*)src_buffer_, kNumSamples, 0,
+                     0.5);
+  cras_mix_float_to_format(fmt_, (uint8_t*)mix_buffer_, bus.data(),
+                           kNumSamples);
+  for (size_t i = 0; i < kNumSamples; i++) {
+    EXPECT_NEAR(src_buffer_[i] * 0.5, mix_buffer_[i], 1) << i;
+  }
+}
+
 TEST_F(MixTestSuiteS24_LE, MixFirst) {
   cras_mix_add(fmt_, (uint8_t*)mix_buffer_, (uint8_t*)src_buffer_, kNumSamples,
                0, 0, 1.0);
@@ -1296,12 +1339,102 @@ TEST_F(MixTestSuiteS24_3LE, ScaleHalfVolume) {
   EXPECT_EQ(0, memcmp(compare_buffer_, src_buffer_, kBufferFrames * fr_bytes_));
 }
 
+TEST_F(MixTestSuiteS24_3LE, MixFloatRoundTrip) {
+  std::vector<float> bus(kNumSamples, 0.0f);
+
+  cras_mix_add_float(fmt_, bus.data(), (uint8_t*)src_buffer_, kNumSamples, 0,
+                     1.0);
+  cras_mix_float_to_format(fmt_, (uint8_t*)mix_buffer_, bus.data(),
+                           kNumSamples);
+  EXPECT_EQ(0, memcmp(mix_buffer_, src_buffer_, kBufferFrames * fr_bytes_));
+}
+
 TEST_F(MixTestSuiteS24_3LE, StrideCopy) {
   TestScaleStride(1.0);
   TestScaleStride(100);
   TestScaleStride(0.1);
 }
 
+/* Converts src the way cras_fmt_conv does and mixes it with cras_mix_add(),
+ * then checks cras_mix_add_s16_stereo() gives the same samples. */
+static void TestMixS16Stereo(snd_pcm_format_t fmt,
+                             unsigned int in_channels,
+                             float vol) {
+  const size_t frames = 1024;
+  const size_t sample_bytes = (fmt == SND_PCM_FORMAT_S16_LE) ? 2 : 4;
+  std::vector<int16_t> src(frames * in_channels);
+  std::vector<int16_t> stereo(frames * 2);
+  std::vector<int32_t> converted(frames * 2);
+  std::vector<uint8_t> expected(frames * 2 * sample_bytes);
+  std::vector<uint8_t> fused(frames * 2 * sample_bytes);
+
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = (i * 7919) % 65536 - 32768;
+  }
+  for (size_t i = 0; i < expected.size(); i++) {
+    expected[i] = fused[i] = i * 31;
+  }
+
+  for (size_t i = 0; i < frames; i++) {
+    for (size_t ch = 0; ch < 2; ch++) {
+      stereo[2 * i + ch] = src[i * in_channels + ch % in_channels];
+    }
+  }
+  uint8_t* mix_src = (uint8_t*)stereo.data();
+  if (fmt == SND_PCM_FORMAT_S32_LE) {
+    for (size_t i = 0; i < stereo.size(); i++) {
+      converted[i] = (int32_t)((uint32_t)(int32_t)stereo[i] << 16);
+    }
+    mix_src = (uint8_t*)converted.data();
+  }
+  cras_mix_add(fmt, expected.data(), mix_src, frames * 2, 1, 0, vol);
+
+  EXPECT_EQ(0, cras_mix_add_s16_stereo(fmt, fused.data(), src.data(), frames,
+                                       in_channels, 0, vol));
+  EXPECT_EQ(0, memcmp(expected.data(), fused.data(), expected.size()));
+}
+
+TEST(MixS16Stereo, MatchesTwoPass) {
+  const snd_pcm_format_t fmts[] = {SND_PCM_FORMAT_S16_LE,
+                                   SND_PCM_FORMAT_S32_LE};
+
+  for (snd_pcm_format_t fmt : fmts) {
+    for (float vol : {1.0f, 0.5f}) {
+      TestMixS16Stereo(fmt, 1, vol);
+      TestMixS16Stereo(fmt, 2, vol);
+    }
+  }
+}
+
+TEST(MixS16Stereo, MutedAndUnsupported) {
+  int16_t src[4] = {100, 200, 300, 400};
+  int16_t dst[4] = {1, 2, 3, 4};
+
+  EXPECT_EQ(0, cras_mix_add_s16_stereo(SND_PCM_FORMAT_S16_LE, (uint8_t*)dst,
+                                       src, 2, 2, 1, 1.0));
+  EXPECT_EQ(1, dst[0]);
+  EXPECT_EQ(4, dst[3]);
+  EXPECT_EQ(-EINVAL,
+            cras_mix_add_s16_stereo(SND_PCM_FORMAT_S24_LE, (uint8_t*)dst, src,
+                                    2, 2, 0, 1.0));
+  EXPECT_EQ(-EINVAL, cras_mix_add_s16_stereo(SND_PCM_FORMAT_S16_LE,
+                                             (uint8_t*)dst, src, 1, 4, 0, 1.0));
+}
+
+TEST(MixIsSilent, ZerosOnly) {
+  std::vector<uint8_t> buf(1000, 0);
+
+  EXPECT_TRUE(cras_mix_is_silent(buf.data(), buf.size()));
+  EXPECT_TRUE(cras_mix_is_silent(buf.data(), 0));
+  // Sound anywhere, in a whole block or the tail.
+  for (size_t pos : {0, 255, 256, 511, 767, 999}) {
+    buf[pos] = 1;
+    EXPECT_FALSE(cras_mix_is_silent(buf.data(), buf.size())) << pos;
+    EXPECT_TRUE(cras_mix_is_silent(buf.data(), pos));
+    buf[pos] = 0;
+  }
+}
+
 // Stubs
 extern "C" {}  // extern "C"
 
@@ -67,6 +67,13 @@ static size_t cb_underrun_called;
 static size_t cb_speak_on_mute_detected_called;
 static size_t cb_num_non_chrome_output_streams_called;
 static std::vector<uint32_t> cb_num_non_chrome_output_streams_values;
+static size_t cb_hotword_triggered_called;
+static size_t cb_flushed_called;
+static size_t cras_tm_create_timer_called;
+static unsigned int cras_tm_create_timer_ms;
+static void (*cras_tm_create_timer_cb)(struct cras_timer* t, void* data);
+static void* cras_tm_create_timer_cb_data;
+static size_t cras_tm_cancel_timer_called;
 
 static void ResetStubData() {
   cras_alert_destroy_called = 0;
@@ -117,6 +124,13 @@ static void ResetStubData() {
   cb_speak_on_mute_detected_called = 0;
   cb_num_non_chrome_output_streams_called = 0;
   cb_num_non_chrome_output_streams_values.clear();
+  cb_hotword_triggered_called = 0;
+  cb_flushed_called = 0;
+  cras_tm_create_timer_called = 0;
+  cras_tm_create_timer_ms = 0;
+  cras_tm_create_timer_cb = NULL;
+  cras_tm_create_timer_cb_data = NULL;
+  cras_tm_cancel_timer_called = 0;
 }
 
 // System output volume changed.
@@ -240,6 +254,15 @@ void cb_num_non_chrome_output_streams(void* context,
   cb_context.push_back(context);
 }
 
+void cb_hotword_triggered(void* context, int64_t tv_sec, int64_t tv_nsec) {
+  cb_hotword_triggered_called++;
+  cb_context.push_back(context);
+}
+
+void cb_flushed(void* context) {
+  cb_flushed_called++;
+}
+
 class ObserverTest : public testing::Test {
  protected:
   virtual void SetUp() {
@@ -765,6 +788,94 @@ TEST_F(ObserverTest, NumNonChromeOutputStreamsChanged) {
   DoObserverRemoveClear(num_non_chrome_output_streams_alert, data);
 }
 
+TEST_F(ObserverTest, IntervalCoalescesNotifications) {
+  struct cras_observer_alert_data_volume volume;
+  struct cras_observer_alert_data_node_volume node_volume;
+  struct cras_observer_client* client;
+
+  ops1_.output_volume_changed = cb_output_volume_changed;
+  ops1_.output_node_volume_changed = cb_output_node_volume_changed;
+  client = cras_observer_add(&ops1_, context1_);
+  ASSERT_NE(client, reinterpret_cast<struct cras_observer_client*>(NULL));
+  cras_observer_set_interval(client, 100, cb_flushed);
+
+  // A volume drag only delivers the last volume of each node.
+  for (int32_t i = 0; i <= 50; i++) {
+    volume.volume = i;
+    output_volume_alert(NULL, &volume);
+    node_volume.node_id = i % 2;
+    node_volume.volume = i;
+    output_node_volume_alert(NULL, &node_volume);
+  }
+  EXPECT_EQ(0, cb_output_volume_changed_called);
+  EXPECT_EQ(0, cb_output_node_volume_changed_called);
+  // The first batch is only held until the next main loop iteration.
+  ASSERT_EQ(1, cras_tm_create_timer_called);
+  EXPECT_EQ(0, cras_tm_create_timer_ms);
+
+  cras_tm_create_timer_cb(NULL, cras_tm_create_timer_cb_data);
+  ASSERT_EQ(1, cb_output_volume_changed_called);
+  EXPECT_EQ(50, cb_output_volume_changed_volume[0]);
+  ASSERT_EQ(2, cb_output_node_volume_changed_called);
+  EXPECT_EQ(0, cb_output_node_volume_changed_node_id[0]);
+  EXPECT_EQ(50, cb_output_node_volume_changed_volume[0]);
+  EXPECT_EQ(1, cb_output_node_volume_changed_node_id[1]);
+  EXPECT_EQ(49, cb_output_node_volume_changed_volume[1]);
+  EXPECT_EQ(1, cb_flushed_called);
+
+  // The next batch waits for the interval.
+  volume.volume = 51;
+  output_volume_alert(NULL, &volume);
+  EXPECT_EQ(1, cb_output_volume_changed_called);
+  ASSERT_EQ(2, cras_tm_create_timer_called);
+  EXPECT_GT(cras_tm_create_timer_ms, 0);
+  EXPECT_LE(cras_tm_create_timer_ms, 100);
+
+  // Removing the client drops what is held.
+  cras_observer_remove(client);
+  EXPECT_EQ(1, cras_tm_cancel_timer_called);
+  EXPECT_EQ(1, cb_output_volume_changed_called);
+}
+
+TEST_F(ObserverTest, IntervalDeliversHeldBeforeHotword) {
+  struct cras_observer_alert_data_volume volume;
+  struct cras_observer_alert_data_hotword_triggered hotword = {1, 2};
+  struct cras_observer_client* client;
+
+  ops1_.output_volume_changed = cb_output_volume_changed;
+  ops1_.hotword_triggered = cb_hotword_triggered;
+  client = cras_observer_add(&ops1_, context1_);
+  cras_observer_set_interval(client, 100, cb_flushed);
+
+  volume.volume = 10;
+  output_volume_alert(NULL, &volume);
+  EXPECT_EQ(0, cb_output_volume_changed_called);
+
+  // A hotword trigger can't wait and takes the held volume along.
+  hotword_triggered_alert(NULL, &hotword);
+  EXPECT_EQ(1, cras_tm_cancel_timer_called);
+  EXPECT_EQ(1, cb_output_volume_changed_called);
+  EXPECT_EQ(1, cb_hotword_triggered_called);
+  EXPECT_EQ(1, cb_flushed_called);
+
+  // Stopping the interval delivers what is held.
+  volume.volume = 20;
+  output_volume_alert(NULL, &volume);
+  EXPECT_EQ(1, cb_output_volume_changed_called);
+  cras_observer_set_interval(client, 0, cb_flushed);
+  EXPECT_EQ(2, cras_tm_cancel_timer_called);
+  ASSERT_EQ(2, cb_output_volume_changed_called);
+  EXPECT_EQ(20, cb_output_volume_changed_volume[1]);
+
+  // Without an interval every notification is delivered right away.
+  volume.volume = 30;
+  output_volume_alert(NULL, &volume);
+  EXPECT_EQ(3, cb_output_volume_changed_called);
+  EXPECT_EQ(2, cras_tm_create_timer_called);
+
+  cras_observer_remove(client);
+}
+
 // Stubs
 extern "C" {
 
@@ -815,6 +926,26 @@ void cras_iodev_list_update_device_list() {
   cras_iodev_list_update_device_list_called++;
 }
 
+struct cras_tm* cras_system_state_get_tm() {
+  return reinterpret_cast<struct cras_tm*>(0x55);
+}
+
+struct cras_timer* cras_tm_create_timer(
+    struct cras_tm* tm,
+    unsigned int ms,
+    void (*cb)(struct cras_timer* t, void* data),
+    void* cb_data) {
+  cras_tm_create_timer_called++;
+  cras_tm_create_timer_ms = ms;
+  cras_tm_create_timer_cb = cb;
+  cras_tm_create_timer_cb_data = cb_data;
+  return reinterpret_cast<struct cras_timer*>(0x66);
+}
+
+void cras_tm_cancel_timer(struct cras_tm* tm, struct cras_timer* t) {
+  cras_tm_cancel_timer_called++;
+}
+
 }  // extern "C"
 
 }  // namespace
@@ -0,0 +1,385 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <vector>
+
+extern "C" {
+#include <alsa/asoundlib.h>
+#include <alsa/pcm_external.h>
+
+#include "cras_client.h"
+#include "cras_messages.h"
+
+// The entry point defined by SND_PCM_PLUGIN_DEFINE_FUNC(cras).
+int _snd_pcm_cras_open(snd_pcm_t** pcmp,
+                       const char* name,
+                       snd_config_t* root,
+                       snd_config_t* conf,
+                       snd_pcm_stream_t stream,
+                       int mode);
+}
+
+static const cras_stream_id_t STREAM_ID = 0x10001;
+static const unsigned int PERIOD_FRAMES = 16;
+static const unsigned int NUM_PERIODS = 4;
+static const unsigned int BUFFER_FRAMES = PERIOD_FRAMES * NUM_PERIODS;
+static const unsigned int CHANNELS = 2;
+
+// Server end and client end of the stream socket.
+static int server_fd;
+static int stream_fd;
+static int16_t alsa_buffer[BUFFER_FRAMES * CHANNELS];
+static snd_pcm_channel_area_t alsa_areas[CHANNELS];
+static int16_t stream_shm[PERIOD_FRAMES * CHANNELS];
+// Frames of the request handed out by begin_write and not committed yet.
+static unsigned int pending_frames;
+// The ioplug object of the plugin, filled by snd_pcm_ioplug_create().
+static snd_pcm_ioplug_t* ioplug;
+static int begin_write_called;
+static int commit_write_called;
+static std::vector<int16_t> played;
+
+namespace {
+
+class PcmCrasSuite : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    int fds[2];
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds));
+    server_fd = fds[0];
+    stream_fd = fds[1];
+    begin_write_called = 0;
+    commit_write_called = 0;
+    pending_frames = 0;
+    played.clear();
+
+    for (unsigned int i = 0; i < BUFFER_FRAMES * CHANNELS; i++) {
+      alsa_buffer[i] = i;
+    }
+    for (unsigned int chan = 0; chan < CHANNELS; chan++) {
+      alsa_areas[chan].addr = alsa_buffer;
+      alsa_areas[chan].first = chan * 16;
+      alsa_areas[chan].step = CHANNELS * 16;
+    }
+
+    snd_pcm_t* pcm;
+    ioplug = NULL;
+    ASSERT_EQ(0, _snd_pcm_cras_open(&pcm, "cras", NULL, NULL,
+                                    SND_PCM_STREAM_PLAYBACK, 0));
+    ASSERT_NE((void*)NULL, ioplug);
+    io_ = ioplug;
+    io_->format = SND_PCM_FORMAT_S16_LE;
+    io_->channels = CHANNELS;
+    io_->rate = 48000;
+    io_->period_size = PERIOD_FRAMES;
+    io_->buffer_size = BUFFER_FRAMES;
+    ASSERT_EQ(0, io_->callback->prepare(io_));
+    ASSERT_EQ(0, io_->callback->start(io_));
+  }
+
+  virtual void TearDown() {
+    io_->callback->close(io_);
+    close(server_fd);
+    close(stream_fd);
+  }
+
+  // Asks for a period of samples like the audio thread of the server does.
+  void RequestData() {
+    struct audio_message msg = {};
+
+    msg.id = AUDIO_MESSAGE_REQUEST_DATA;
+    msg.frames = PERIOD_FRAMES;
+    ASSERT_EQ(sizeof(msg), send(server_fd, &msg, sizeof(msg), 0));
+  }
+
+  // Sleeps in poll on the descriptors of the plugin like snd_pcm_wait().
+  unsigned short WaitPcm(int timeout_ms) {
+    struct pollfd pfd;
+    unsigned short revents = 0;
+
+    EXPECT_EQ(1, io_->callback->poll_descriptors(io_, &pfd, 1));
+    EXPECT_EQ(stream_fd, pfd.fd);
+    poll(&pfd, 1, timeout_ms);
+    EXPECT_EQ(0, io_->callback->poll_revents(io_, &pfd, 1, &revents));
+    return revents;
+  }
+
+  // Writes frames of alsa_buffer like snd_pcm_writei() does.
+  void WritePcm(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames) {
+    EXPECT_EQ(frames, io_->callback->transfer(io_, alsa_areas, offset, frames));
+    io_->appl_ptr += frames;
+  }
+
+  snd_pcm_ioplug_t* io_;
+};
+
+TEST_F(PcmCrasSuite, WriteAheadThenSleepInPoll) {
+  // The application fills the whole buffer, then only waits for space.
+  io_->state = SND_PCM_STATE_RUNNING;
+  WritePcm(0, BUFFER_FRAMES);
+  EXPECT_EQ(0, commit_write_called);
+
+  for (unsigned int period = 0; period < NUM_PERIODS; period++) {
+    RequestData();
+    EXPECT_EQ(POLLOUT, WaitPcm(100));
+    // Served on the wake, without a call to the pointer callback.
+    EXPECT_EQ(period + 1, commit_write_called);
+    EXPECT_EQ((period + 1) * PERIOD_FRAMES * CHANNELS, played.size());
+  }
+
+  ASSERT_EQ(BUFFER_FRAMES * CHANNELS, played.size());
+  for (unsigned int i = 0; i < BUFFER_FRAMES * CHANNELS; i++) {
+    EXPECT_EQ(alsa_buffer[i], played[i]);
+  }
+  EXPECT_EQ(0, io_->callback->pointer(io_));
+  EXPECT_EQ(NUM_PERIODS, commit_write_called);
+}
+
+TEST_F(PcmCrasSuite, PollTimeoutServesNothing) {
+  io_->state = SND_PCM_STATE_RUNNING;
+  WritePcm(0, BUFFER_FRAMES);
+  begin_write_called = 0;
+
+  EXPECT_EQ(0, WaitPcm(0));
+  EXPECT_EQ(0, begin_write_called);
+  EXPECT_EQ(0, commit_write_called);
+  EXPECT_EQ(0, io_->callback->pointer(io_));
+}
+
+TEST_F(PcmCrasSuite, PointerServesPendingRequests) {
+  io_->state = SND_PCM_STATE_RUNNING;
+  WritePcm(0, BUFFER_FRAMES);
+
+  RequestData();
+  RequestData();
+  EXPECT_EQ(2 * PERIOD_FRAMES, io_->callback->pointer(io_));
+  EXPECT_EQ(2, commit_write_called);
+  EXPECT_EQ(2 * PERIOD_FRAMES * CHANNELS, played.size());
+}
+
+TEST_F(PcmCrasSuite, WriteServesPendingRequest) {
+  io_->state = SND_PCM_STATE_RUNNING;
+
+  // The request waits for the application when nothing is written ahead.
+  RequestData();
+  EXPECT_EQ(POLLOUT, WaitPcm(100));
+  EXPECT_EQ(0, commit_write_called);
+
+  // The written frames go straight to the server.
+  WritePcm(0, PERIOD_FRAMES);
+  EXPECT_EQ(1, commit_write_called);
+  ASSERT_EQ(PERIOD_FRAMES * CHANNELS, played.size());
+  for (unsigned int i = 0; i < PERIOD_FRAMES * CHANNELS; i++) {
+    EXPECT_EQ(alsa_buffer[i], played[i]);
+  }
+  EXPECT_EQ(PERIOD_FRAMES, io_->callback->pointer(io_));
+}
+
+TEST_F(PcmCrasSuite, WriteQueuesFramesPastRequest) {
+  io_->state = SND_PCM_STATE_RUNNING;
+
+  // Half a period more than requested is written, the rest is queued.
+  RequestData();
+  WritePcm(0, PERIOD_FRAMES + PERIOD_FRAMES / 2);
+  EXPECT_EQ(1, commit_write_called);
+  EXPECT_EQ(PERIOD_FRAMES, io_->callback->pointer(io_));
+
+  // The next request takes the queued frames and waits for the rest.
+  RequestData();
+  EXPECT_EQ(PERIOD_FRAMES + PERIOD_FRAMES / 2, io_->callback->pointer(io_));
+  EXPECT_EQ(1, commit_write_called);
+  WritePcm(PERIOD_FRAMES + PERIOD_FRAMES / 2, PERIOD_FRAMES);
+  EXPECT_EQ(2, commit_write_called);
+
+  ASSERT_EQ(2 * PERIOD_FRAMES * CHANNELS, played.size());
+  for (unsigned int i = 0; i < 2 * PERIOD_FRAMES * CHANNELS; i++) {
+    EXPECT_EQ(alsa_buffer[i], played[i]);
+  }
+  // Half a period stays queued for the next request.
+  EXPECT_EQ(2 * PERIOD_FRAMES, io_->callback->pointer(io_));
+}
+
+TEST_F(PcmCrasSuite, DrainCommitsPartialRequest) {
+  io_->state = SND_PCM_STATE_RUNNING;
+  WritePcm(0, PERIOD_FRAMES / 2);
+
+  RequestData();
+  EXPECT_EQ(PERIOD_FRAMES / 2, io_->callback->pointer(io_));
+  EXPECT_EQ(0, commit_write_called);
+
+  io_->state = SND_PCM_STATE_DRAINING;
+  EXPECT_EQ(PERIOD_FRAMES / 2, io_->callback->pointer(io_));
+  EXPECT_EQ(1, commit_write_called);
+  EXPECT_EQ(PERIOD_FRAMES / 2 * CHANNELS, played.size());
+}
+
+}  // namespace
+
+// Stubs
+extern "C" {
+
+struct cras_audio_format* cras_audio_format_create(snd_pcm_format_t format,
+                                                   size_t frame_rate,
+                                                   size_t num_channels) {
+  struct cras_audio_format* fmt;
+
+  fmt = (struct cras_audio_format*)calloc(1, sizeof(*fmt));
+  fmt->format = format;
+  fmt->frame_rate = frame_rate;
+  fmt->num_channels = num_channels;
+  return fmt;
+}
+
+void cras_audio_format_destroy(struct cras_audio_format* fmt) {
+  free(fmt);
+}
+
+int cras_client_create(struct cras_client** client) {
+  *client = reinterpret_cast<struct cras_client*>(0x1);
+  return 0;
+}
+
+void cras_client_destroy(struct cras_client* client) {}
+
+int cras_client_connect(struct cras_client* client) {
+  return 0;
+}
+
+int cras_client_run_thread(struct cras_client* client) {
+  return 0;
+}
+
+int cras_client_stop(struct cras_client* client) {
+  return 0;
+}
+
+struct cras_stream_params* cras_client_unified_params_create(
+    enum CRAS_STREAM_DIRECTION direction,
+    unsigned int block_size,
+    enum CRAS_STREAM_TYPE stream_type,
+    uint32_t flags,
+    void* user_data,
+    cras_unified_cb_t unified_cb,
+    cras_error_cb_t err_cb,
+    struct cras_audio_format* format) {
+  return (struct cras_stream_params*)calloc(1, 1);
+}
+
+void cras_client_stream_params_destroy(struct cras_stream_params* params) {
+  free(params);
+}
+
+void cras_client_stream_params_set_client_type(
+    struct cras_stream_params* params,
+    enum CRAS_CLIENT_TYPE client_type) {}
+
+void cras_client_stream_params_enable_direct_io(
+    struct cras_stream_params* params) {}
+
+int cras_client_format_bytes_per_frame(struct cras_audio_format* fmt) {
+  return fmt->num_channels * 2;
+}
+
+int cras_client_add_stream(struct cras_client* client,
+                           cras_stream_id_t* stream_id_out,
+                           struct cras_stream_params* config) {
+  *stream_id_out = STREAM_ID;
+  return 0;
+}
+
+int cras_client_rm_stream(struct cras_client* client,
+                          cras_stream_id_t stream_id) {
+  return 0;
+}
+
+int cras_client_stream_get_poll_fd(struct cras_client* client,
+                                   cras_stream_id_t stream_id) {
+  return stream_id == STREAM_ID ? stream_fd : -EINVAL;
+}
+
+int cras_client_stream_begin_write(struct cras_client* client,
+                                   cras_stream_id_t stream_id,
+                                   uint8_t** samples,
+                                   unsigned int* frames,
+                                   struct timespec* ts,
+                                   int timeout_ms) {
+  struct audio_message msg;
+  int rc;
+
+  begin_write_called++;
+  if (!pending_frames) {
+    rc = recv(stream_fd, &msg, sizeof(msg), MSG_DONTWAIT);
+    if (rc < 0) {
+      return -EAGAIN;
+    }
+    pending_frames = msg.frames;
+  }
+  *samples = (uint8_t*)stream_shm;
+  *frames = pending_frames;
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  return 0;
+}
+
+int cras_client_stream_commit_write(struct cras_client* client,
+                                    cras_stream_id_t stream_id,
+                                    unsigned int frames) {
+  commit_write_called++;
+  pending_frames = 0;
+  played.insert(played.end(), stream_shm, stream_shm + frames * CHANNELS);
+  return 0;
+}
+
+int cras_client_stream_begin_read(struct cras_client* client,
+                                  cras_stream_id_t stream_id,
+                                  uint8_t** samples,
+                                  unsigned int* frames,
+                                  struct timespec* ts,
+                                  int timeout_ms) {
+  return -EAGAIN;
+}
+
+int cras_client_stream_commit_read(struct cras_client* client,
+                                   cras_stream_id_t stream_id,
+                                   unsigned int frames) {
+  return 0;
+}
+
+int cras_make_fd_nonblocking(int fd) {
+  return 0;
+}
+
+int snd_pcm_ioplug_create(snd_pcm_ioplug_t* io,
+                          const char* name,
+                          snd_pcm_stream_t stream,
+                          int mode) {
+  ioplug = io;
+  io->stream = stream;
+  return 0;
+}
+
+int snd_pcm_ioplug_delete(snd_pcm_ioplug_t* io) {
+  return 0;
+}
+
+int snd_pcm_ioplug_set_param_list(snd_pcm_ioplug_t* io,
+                                  int type,
+                                  unsigned int num_list,
+                                  const unsigned int* list) {
+  return 0;
+}
+
+int snd_pcm_ioplug_set_param_minmax(snd_pcm_ioplug_t* io,
+                                    int type,
+                                    unsigned int min,
+                                    unsigned int max) {
+  return 0;
+}
+
+}  // extern "C"
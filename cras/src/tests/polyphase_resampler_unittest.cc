@@ -0,0 +1,200 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "cras/src/server/polyphase_resampler.h"
+}
+
+namespace {
+
+std::vector<int16_t> Sine(unsigned int frames,
+                          unsigned int num_channels,
+                          double freq,
+                          unsigned int rate) {
+  std::vector<int16_t> buf(frames * num_channels);
+
+  for (unsigned int i = 0; i < frames; i++) {
+    for (unsigned int ch = 0; ch < num_channels; ch++) {
+      buf[i * num_channels + ch] =
+          10000 * sin(2 * M_PI * freq * i / rate + ch);
+    }
+  }
+  return buf;
+}
+
+/* Returns the SNR in dB of channel ch of out against the ideal sine, after
+ * fitting the unknown filter delay. Skips the start-up transient. */
+double SineSnr(const std::vector<int16_t>& out,
+               unsigned int num_channels,
+               unsigned int ch,
+               double freq,
+               unsigned int rate) {
+  unsigned int frames = out.size() / num_channels;
+  double sc = 0, ss = 0, cc = 0, cs = 0, ys = 0, yc = 0;
+  double signal = 0, noise = 0;
+
+  // Least squares fit of a * sin + b * cos at the given frequency.
+  for (unsigned int i = frames / 4; i < frames; i++) {
+    double s = sin(2 * M_PI * freq * i / rate);
+    double c = cos(2 * M_PI * freq * i / rate);
+    double y = out[i * num_channels + ch];
+
+    ss += s * s;
+    cc += c * c;
+    sc += s * c;
+    ys += y * s;
+    yc += y * c;
+  }
+  cs = ss * cc - sc * sc;
+  double a = (ys * cc - yc * sc) / cs;
+  double b = (yc * ss - ys * sc) / cs;
+
+  for (unsigned int i = frames / 4; i < frames; i++) {
+    double ideal = a * sin(2 * M_PI * freq * i / rate) +
+                   b * cos(2 * M_PI * freq * i / rate);
+    double err = out[i * num_channels + ch] - ideal;
+
+    signal += ideal * ideal;
+    noise += err * err;
+  }
+  return 10 * log10(signal / std::max(noise, 1e-9));
+}
+
+std::vector<int16_t> ResampleAll(struct polyphase_resampler* pr,
+                                 const std::vector<int16_t>& in,
+                                 unsigned int num_channels,
+                                 unsigned int chunk) {
+  std::vector<int16_t> out;
+  unsigned int in_offset = 0;
+  std::vector<int16_t> block(4 * chunk * num_channels + 64 * num_channels);
+
+  while (in_offset < in.size() / num_channels) {
+    unsigned int in_frames =
+        std::min<unsigned int>(chunk, in.size() / num_channels - in_offset);
+    unsigned int out_frames = block.size() / num_channels;
+
+    polyphase_resampler_process_s16(pr, &in[in_offset * num_channels],
+                                    &in_frames, block.data(), &out_frames);
+    EXPECT_GT(in_frames + out_frames, 0);
+    in_offset += in_frames;
+    out.insert(out.end(), block.begin(),
+               block.begin() + out_frames * num_channels);
+  }
+  return out;
+}
+
+TEST(PolyphaseResampler, ConstantStaysConstant) {
+  struct polyphase_resampler* pr =
+      polyphase_resampler_create(1, 44100, 48000, POLYPHASE_QUALITY_MEDIUM);
+  std::vector<int16_t> in(4410, 1000);
+
+  ASSERT_NE(pr, nullptr);
+  std::vector<int16_t> out = ResampleAll(pr, in, 1, 441);
+
+  // 4800 frames minus what is still in the filter.
+  EXPECT_GT(out.size(), 4800 - polyphase_resampler_num_taps(pr));
+  EXPECT_LE(out.size(), 4800);
+  for (unsigned int i = polyphase_resampler_num_taps(pr); i < out.size(); i++) {
+    EXPECT_NEAR(out[i], 1000, 1) << i;
+  }
+  polyphase_resampler_destroy(pr);
+}
+
+TEST(PolyphaseResampler, SineQuality) {
+  const unsigned int rates[][2] = {
+      {44100, 48000}, {16000, 48000}, {48000, 44100}, {48000, 16000}};
+
+  for (auto& r : rates) {
+    struct polyphase_resampler* pr =
+        polyphase_resampler_create(2, r[0], r[1], POLYPHASE_QUALITY_MEDIUM);
+    std::vector<int16_t> in = Sine(r[0] / 2, 2, 1000, r[0]);
+
+    ASSERT_NE(pr, nullptr);
+    std::vector<int16_t> out = ResampleAll(pr, in, 2, 480);
+    for (unsigned int ch = 0; ch < 2; ch++) {
+      EXPECT_GT(SineSnr(out, 2, ch, 1000, r[1]), 70)
+          << r[0] << " to " << r[1] << " ch " << ch;
+    }
+    polyphase_resampler_destroy(pr);
+  }
+}
+
+TEST(PolyphaseResampler, ChunkingDoesNotChangeOutput) {
+  struct polyphase_resampler* a =
+      polyphase_resampler_create(2, 44100, 48000, POLYPHASE_QUALITY_LOW);
+  struct polyphase_resampler* b =
+      polyphase_resampler_create(2, 44100, 48000, POLYPHASE_QUALITY_LOW);
+  std::vector<int16_t> in = Sine(4410, 2, 440, 44100);
+
+  std::vector<int16_t> out_a = ResampleAll(a, in, 2, 4410);
+  std::vector<int16_t> out_b = ResampleAll(b, in, 2, 7);
+  ASSERT_EQ(out_a.size(), out_b.size());
+  EXPECT_EQ(out_a, out_b);
+
+  // Resetting starts over from silence.
+  polyphase_resampler_reset(b);
+  std::vector<int16_t> out_c = ResampleAll(b, in, 2, 4410);
+  EXPECT_EQ(out_a, out_c);
+
+  polyphase_resampler_destroy(a);
+  polyphase_resampler_destroy(b);
+}
+
+TEST(PolyphaseResampler, OutputLimit) {
+  struct polyphase_resampler* pr =
+      polyphase_resampler_create(1, 16000, 48000, POLYPHASE_QUALITY_MEDIUM);
+  std::vector<int16_t> in(1600, 100);
+  std::vector<int16_t> out(480);
+  unsigned int in_frames = 1600;
+  unsigned int out_frames = 10;
+
+  polyphase_resampler_process_s16(pr, in.data(), &in_frames, out.data(),
+                                  &out_frames);
+  EXPECT_EQ(10, out_frames);
+  // Input beyond the block the output frames need is left to the caller.
+  EXPECT_LT(in_frames, 1600);
+  polyphase_resampler_destroy(pr);
+}
+
+TEST(PolyphaseResampler, FloatMatchesS16) {
+  struct polyphase_resampler* a =
+      polyphase_resampler_create(2, 16000, 48000, POLYPHASE_QUALITY_HIGH);
+  struct polyphase_resampler* b =
+      polyphase_resampler_create(2, 16000, 48000, POLYPHASE_QUALITY_HIGH);
+  std::vector<int16_t> in = Sine(800, 2, 440, 16000);
+  std::vector<float> in_f(in.begin(), in.end());
+  std::vector<int16_t> out(2400 * 2);
+  std::vector<float> out_f(2400 * 2);
+  unsigned int in_frames = 800, out_frames = 2400;
+  unsigned int in_frames_f = 800, out_frames_f = 2400;
+
+  polyphase_resampler_process_s16(a, in.data(), &in_frames, out.data(),
+                                  &out_frames);
+  polyphase_resampler_process_float(b, in_f.data(), &in_frames_f,
+                                    out_f.data(), &out_frames_f);
+  EXPECT_EQ(in_frames, in_frames_f);
+  ASSERT_EQ(out_frames, out_frames_f);
+  for (unsigned int i = 0; i < out_frames * 2; i++) {
+    EXPECT_NEAR(out[i], out_f[i], 0.5) << i;
+  }
+  polyphase_resampler_destroy(a);
+  polyphase_resampler_destroy(b);
+}
+
+TEST(PolyphaseResampler, UnsupportedRates) {
+  // 48001 shares no factor with 44100, the filter bank would be huge.
+  EXPECT_EQ(nullptr, polyphase_resampler_create(2, 44100, 48001,
+                                                POLYPHASE_QUALITY_MEDIUM));
+  EXPECT_EQ(nullptr,
+            polyphase_resampler_create(2, 0, 48000, POLYPHASE_QUALITY_MEDIUM));
+}
+
+}  // namespace
@@ -383,6 +383,63 @@ TEST_F(RstreamTestSuite, InputStreamFlushMessages) {
   cras_rstream_destroy(s);
 }
 
+TEST_F(RstreamTestSuite, OutputStreamDoorbell) {
+  struct cras_rstream* s;
+  struct timespec ts;
+  uint64_t count;
+  int rc;
+
+  config_.flags = SHM_DOORBELL;
+  rc = cras_rstream_create(&config_, &s);
+  ASSERT_EQ(0, rc);
+  ASSERT_GE(cras_rstream_get_doorbell_fd(s), 0);
+  EXPECT_EQ(cras_rstream_get_doorbell_fd(s), cras_rstream_get_audio_fd(s));
+
+  // The request is posted in shm, nothing is written to the socket.
+  rc = cras_rstream_request_audio(s, &ts);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, cras_rstream_is_pending_reply(s));
+  EXPECT_EQ(1, cras_shm_get_request_seq(s->shm));
+  EXPECT_EQ(2048, cras_shm_get_request_frames(s->shm));
+  EXPECT_EQ(1, cras_shm_get_doorbell(s->shm));
+  EXPECT_EQ(-1, recv(client_fd_, &count, sizeof(count), MSG_DONTWAIT));
+
+  // No reply yet.
+  cras_rstream_flush_old_audio_messages(s);
+  EXPECT_EQ(1, cras_rstream_is_pending_reply(s));
+
+  // Client posts the reply and rings the server.
+  cras_shm_post_reply(s->shm, 0);
+  count = 1;
+  EXPECT_EQ(sizeof(count),
+            write(cras_rstream_get_doorbell_fd(s), &count, sizeof(count)));
+  cras_rstream_flush_old_audio_messages(s);
+  EXPECT_EQ(0, cras_rstream_is_pending_reply(s));
+
+  cras_rstream_destroy(s);
+}
+
+TEST_F(RstreamTestSuite, InputStreamDoorbell) {
+  struct cras_rstream* s;
+  int rc;
+
+  config_.direction = CRAS_STREAM_INPUT;
+  config_.flags = SHM_DOORBELL;
+  rc = cras_rstream_create(&config_, &s);
+  ASSERT_EQ(0, rc);
+
+  rc = cras_rstream_audio_ready(s, 10);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(1, cras_rstream_is_pending_reply(s));
+  EXPECT_EQ(10, cras_shm_get_request_frames(s->shm));
+
+  cras_shm_post_reply(s->shm, 0);
+  cras_rstream_flush_old_audio_messages(s);
+  EXPECT_EQ(0, cras_rstream_is_pending_reply(s));
+
+  cras_rstream_destroy(s);
+}
+
 TEST_F(RstreamTestSuite, UpdateOutputReadPtr) {
   struct cras_rstream* s;
   uint8_t* buf;
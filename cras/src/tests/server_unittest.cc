@@ -0,0 +1,409 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "cras/src/server/cras_bt_manager.h"
+#include "cras/src/server/cras_dbus.h"
+#include "cras/src/server/cras_dbus_control.h"
+#include "cras/src/server/cras_rclient.h"
+#include "cras/src/server/cras_server.h"
+#include "cras/src/server/cras_server_metrics.h"
+#include "cras/src/server/cras_system_state.h"
+#include "cras/src/server/cras_tm.h"
+#include "cras_config.h"
+#include "cras_util.h"
+}
+
+namespace {
+
+// Time to wait for the server before failing a test.
+static const int kTimeoutMs = 5000;
+
+static struct cras_tm* test_tm;
+static int (*add_select_fd)(int fd,
+                            void (*callback)(void* data, int revents),
+                            void* callback_data,
+                            int events,
+                            void* select_data);
+static void (*rm_select_fd)(int fd, void* select_data);
+static void* select_data;
+static int (*add_task)(void (*cb)(void* data),
+                       void* callback_data,
+                       void* task_data);
+static void* task_data;
+static unsigned int rclient_destroy_called;
+static unsigned int messages_from_clients;
+
+// Written to by the test, read by watch_callback on the main loop.
+static int watch_fds[2];
+// Written to by the main loop, read by the test.
+static int result_fds[2];
+
+static void send_result(char c) {
+  ASSERT_EQ(1, write(result_fds[1], &c, 1));
+}
+
+static void timer_callback(struct cras_timer* t, void* data) {
+  send_result('t');
+}
+
+static void task_callback(void* data) {
+  send_result('a');
+  cras_tm_create_timer(test_tm, 1, timer_callback, NULL);
+}
+
+static void watch_callback(void* data, int revents) {
+  char c;
+
+  ASSERT_EQ(1, read(watch_fds[0], &c, 1));
+  switch (c) {
+    case 'a':
+      // Runs a task that arms a timer.
+      add_task(task_callback, NULL, task_data);
+      break;
+    case 'r':
+      // Removes and adds back the fd while its event is handled.
+      rm_select_fd(watch_fds[0], select_data);
+      ASSERT_EQ(0, add_select_fd(watch_fds[0], watch_callback, NULL, POLLIN,
+                                 select_data));
+      break;
+  }
+  send_result(c);
+}
+
+static void* run_server(void* arg) {
+  cras_server_run(0);
+  return NULL;
+}
+
+// Removes the socket files, the main loop never returns to clean them up.
+static void remove_sockets() {
+  char path[CRAS_MAX_SOCKET_PATH_SIZE];
+
+  for (int conn_type = 0; conn_type < CRAS_NUM_CONN_TYPE; conn_type++) {
+    cras_fill_socket_path((enum CRAS_CONNECTION_TYPE)conn_type, path);
+    unlink(path);
+  }
+}
+
+// Starts the main loop on its own thread, once for all tests.
+static void start_server() {
+  static bool started;
+  pthread_t thread;
+
+  if (started) {
+    return;
+  }
+  started = true;
+
+  test_tm = cras_tm_init();
+  ASSERT_EQ(0, pipe(watch_fds));
+  ASSERT_EQ(0, pipe(result_fds));
+  ASSERT_EQ(0, cras_server_init());
+  ASSERT_EQ(0, add_select_fd(watch_fds[0], watch_callback, NULL, POLLIN,
+                             select_data));
+  // Registering the same fd twice fails.
+  EXPECT_EQ(-EEXIST, add_select_fd(watch_fds[0], watch_callback, NULL, POLLIN,
+                                   select_data));
+  ASSERT_EQ(0, pthread_create(&thread, NULL, run_server, NULL));
+  pthread_detach(thread);
+  atexit(remove_sockets);
+}
+
+static int connect_client() {
+  struct sockaddr_un addr;
+  struct timeval tv = {.tv_sec = kTimeoutMs / 1000, .tv_usec = 0};
+  int fd;
+
+  fd = socket(PF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  cras_fill_socket_path(CRAS_CONTROL, addr.sun_path);
+  // Retry until the main loop is listening.
+  for (int i = 0; i < kTimeoutMs; i++) {
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+      return fd;
+    }
+    usleep(1000);
+  }
+  close(fd);
+  return -1;
+}
+
+// Reads what the main loop reported, or 0 on timeout.
+static char wait_result() {
+  struct pollfd pfd = {.fd = result_fds[0], .events = POLLIN, .revents = 0};
+  char c = 0;
+
+  if (poll(&pfd, 1, kTimeoutMs) == 1) {
+    EXPECT_EQ(1, read(result_fds[0], &c, 1));
+  }
+  return c;
+}
+
+static double elapsed_us(const struct timespec* start,
+                         const struct timespec* end) {
+  return (end->tv_sec - start->tv_sec) * 1e6 +
+         (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+TEST(ServerTest, SelectFdTaskAndTimer) {
+  start_server();
+
+  ASSERT_EQ(1, write(watch_fds[1], "a", 1));
+  EXPECT_EQ('a', wait_result());
+  // The task runs on the next iteration and its timer shortly after.
+  EXPECT_EQ('a', wait_result());
+  EXPECT_EQ('t', wait_result());
+
+  ASSERT_EQ(1, write(watch_fds[1], "r", 1));
+  EXPECT_EQ('r', wait_result());
+  // Still watched after being removed and added back.
+  ASSERT_EQ(1, write(watch_fds[1], "x", 1));
+  EXPECT_EQ('x', wait_result());
+}
+
+/* Connects many idle clients and measures the time the main loop takes to
+ * dispatch a message from one of them. The rclient stub echoes every message
+ * back to its client. */
+TEST(ServerTest, DispatchLatencyWithIdleClients) {
+  static const unsigned int kNumClients = 256;
+  static const unsigned int kNumMessages = 1000;
+  std::vector<int> clients;
+  std::vector<double> latency_us;
+  struct timespec start, end;
+  uint32_t msg, reply;
+
+  start_server();
+  rclient_destroy_called = 0;
+  messages_from_clients = 0;
+
+  for (unsigned int i = 0; i < kNumClients; i++) {
+    int fd = connect_client();
+    ASSERT_GE(fd, 0);
+    clients.push_back(fd);
+  }
+
+  // Every client gets its message handled.
+  for (unsigned int i = 0; i < kNumClients; i++) {
+    msg = i;
+    ASSERT_EQ(sizeof(msg), send(clients[i], &msg, sizeof(msg), 0));
+  }
+  for (unsigned int i = 0; i < kNumClients; i++) {
+    ASSERT_EQ(sizeof(reply), recv(clients[i], &reply, sizeof(reply), 0));
+    EXPECT_EQ(i, reply);
+  }
+
+  // One client talks while the others stay idle.
+  for (unsigned int i = 0; i < kNumMessages; i++) {
+    msg = i;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ASSERT_EQ(sizeof(msg), send(clients[0], &msg, sizeof(msg), 0));
+    ASSERT_EQ(sizeof(reply), recv(clients[0], &reply, sizeof(reply), 0));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ASSERT_EQ(i, reply);
+    latency_us.push_back(elapsed_us(&start, &end));
+  }
+  std::sort(latency_us.begin(), latency_us.end());
+  printf("%u idle clients: median %.1f us, p99 %.1f us per message\n",
+         kNumClients - 1, latency_us[kNumMessages / 2],
+         latency_us[kNumMessages * 99 / 100]);
+
+  for (int fd : clients) {
+    close(fd);
+  }
+  // All clients are removed once the main loop sees them hang up.
+  for (int i = 0; i < kTimeoutMs; i++) {
+    if (__atomic_load_n(&rclient_destroy_called, __ATOMIC_ACQUIRE) ==
+        kNumClients) {
+      break;
+    }
+    usleep(1000);
+  }
+  EXPECT_EQ(kNumClients,
+            __atomic_load_n(&rclient_destroy_called, __ATOMIC_ACQUIRE));
+  EXPECT_EQ(kNumClients + kNumMessages,
+            __atomic_load_n(&messages_from_clients, __ATOMIC_ACQUIRE));
+}
+
+}  //  namespace
+
+// Stubs
+extern "C" {
+
+int cras_fill_socket_path(enum CRAS_CONNECTION_TYPE conn_type,
+                          char* sock_path) {
+  snprintf(sock_path, CRAS_MAX_SOCKET_PATH_SIZE, "%s/server_unittest_%d_%d",
+           CRAS_UT_TMPDIR, getpid(), conn_type);
+  return 0;
+}
+
+int cras_system_set_select_handler(
+    int (*add)(int fd,
+               void (*callback)(void* data, int revents),
+               void* callback_data,
+               int events,
+               void* select_data),
+    void (*rm)(int fd, void* select_data),
+    void* data) {
+  add_select_fd = add;
+  rm_select_fd = rm;
+  select_data = data;
+  return 0;
+}
+
+int cras_system_set_add_task_handler(int (*add)(void (*cb)(void* data),
+                                                void* callback_data,
+                                                void* task_data),
+                                     void* data) {
+  add_task = add;
+  task_data = data;
+  return 0;
+}
+
+struct cras_tm* cras_system_state_get_tm() {
+  return test_tm;
+}
+
+struct cras_server_state* cras_system_state_update_begin() {
+  return NULL;
+}
+
+void cras_system_state_update_complete() {}
+
+struct cras_rclient* cras_rclient_create(int fd,
+                                         size_t id,
+                                         enum CRAS_CONNECTION_TYPE conn_type) {
+  struct cras_rclient* client =
+      (struct cras_rclient*)calloc(1, sizeof(*client));
+  client->fd = fd;
+  client->id = id;
+  return client;
+}
+
+void cras_rclient_destroy(struct cras_rclient* client) {
+  free(client);
+  __atomic_add_fetch(&rclient_destroy_called, 1, __ATOMIC_RELEASE);
+}
+
+int cras_rclient_buffer_from_client(struct cras_rclient* client,
+                                    const uint8_t* buf,
+                                    size_t buf_len,
+                                    int* fds,
+                                    int num_fds) {
+  // A hang up reads nothing, which removes the client.
+  if (buf_len == 0) {
+    return -EINVAL;
+  }
+  __atomic_add_fetch(&messages_from_clients, 1, __ATOMIC_RELEASE);
+  if (send(client->fd, buf, buf_len, 0) != (ssize_t)buf_len) {
+    return -EIO;
+  }
+  return 0;
+}
+
+int cras_rclient_send_message(const struct cras_rclient* client,
+                              const struct cras_client_message* msg,
+                              int* fds,
+                              unsigned int num_fds) {
+  return 0;
+}
+
+int cras_rust_init_logging() {
+  return 0;
+}
+
+void cras_alsa_lib_error_handler_init() {}
+
+int cras_observer_server_init() {
+  return 0;
+}
+
+void cras_observer_server_free() {}
+
+void cras_mix_init() {}
+
+int cpu_get_flags() {
+  return 0;
+}
+
+void cras_fmt_conv_init(unsigned int cpu_flags) {}
+
+void dsp_set_x86_features(unsigned int features) {}
+
+void cras_main_message_init() {}
+
+int cras_alsa_probe_init(unsigned int num_workers) {
+  return 0;
+}
+
+void cras_alsa_probe_deinit() {}
+
+void cras_udev_start_sound_subsystem_monitor() {}
+
+int cras_server_metrics_init() {
+  return 0;
+}
+
+int cras_device_monitor_init() {
+  return 0;
+}
+
+int cras_hotword_handler_init() {
+  return 0;
+}
+
+int cras_non_empty_audio_handler_init() {
+  return 0;
+}
+
+int cras_audio_thread_monitor_init() {
+  return 0;
+}
+
+int cras_stream_apm_message_handler_init() {
+  return 0;
+}
+
+DBusConnection* cras_dbus_connect_system_bus() {
+  return NULL;
+}
+
+void cras_bt_start(DBusConnection* conn, unsigned profile_disable_mask) {}
+
+void cras_dbus_control_start(DBusConnection* conn) {}
+
+void cras_dbus_dispatch(DBusConnection* conn) {}
+
+void cras_dlc_manager_init() {}
+
+int cras_iodev_list_get_outputs(struct cras_iodev_info** list_out) {
+  return 2;
+}
+
+void cras_iodev_list_update_device_list() {}
+
+void cras_metrics_log_event(const char* event) {}
+
+const char kNoCodecsFoundMetric[] = "Cras.NoCodecsFoundAtBoot";
+
+void cras_alert_process_all_pending_alerts() {}
+
+}  // extern "C"
@@ -27,6 +27,8 @@ namespace {
 static struct cras_iodev devs[2];
 static struct cras_iodev* idev = &devs[0];
 static struct cras_iodev* idev2 = &devs[1];
+static struct audio_thread* thread1 = reinterpret_cast<audio_thread*>(0x100);
+static struct audio_thread* thread2 = reinterpret_cast<audio_thread*>(0x200);
 static struct cras_stream_apm* stream;
 static struct cras_audio_area fake_audio_area;
 static unsigned int dsp_util_interleave_frames;
@@ -335,6 +337,7 @@ TEST(StreamApm, StreamAddToAlreadyOpenedDev) {
 
 TEST(StreamApm, ReverseDevChanged) {
   cras_stream_apm_init("");
+  cras_stream_apm_add_audio_thread(thread1);
   EXPECT_NE((void*)NULL, output_devices_changed_callback);
   EXPECT_NE((void*)NULL, thread_cb);
 
@@ -344,6 +347,25 @@ TEST(StreamApm, ReverseDevChanged) {
   thread_cb(cb_data, POLLIN);
   EXPECT_EQ(1, cras_apm_reverse_state_update_called);
 
+  cras_stream_apm_deinit();
+  EXPECT_EQ((void*)NULL, thread_cb);
+}
+
+TEST(StreamApm, CommandsReachEveryAudioThread) {
+  void* thread1_cb_data;
+
+  cras_stream_apm_init("");
+  cras_stream_apm_add_audio_thread(thread1);
+  thread1_cb_data = cb_data;
+  cras_stream_apm_add_audio_thread(thread2);
+  EXPECT_NE(thread1_cb_data, cb_data);
+
+  cras_apm_reverse_state_update_called = 0;
+  output_devices_changed_callback();
+  thread_cb(thread1_cb_data, POLLIN);
+  thread_cb(cb_data, POLLIN);
+  EXPECT_EQ(2, cras_apm_reverse_state_update_called);
+
   cras_stream_apm_deinit();
 }
 
@@ -413,6 +435,7 @@ TEST(ApmList, NeedsReverseProcessing) {
   cras_iodev_is_tuned_aec_use_case_value = 1;
   cras_iodev_is_dsp_aec_use_case_value = 1;
   cras_stream_apm_init("");
+  cras_stream_apm_add_audio_thread(thread1);
 
   stream = cras_stream_apm_create(APM_ECHO_CANCELLATION);
   EXPECT_NE((void*)NULL, stream);
@@ -720,7 +743,10 @@ int audio_thread_rm_callback_sync(struct audio_thread* thread, int fd) {
 }
 void audio_thread_rm_callback(int fd) {}
 
-struct audio_thread* cras_iodev_list_get_audio_thread() {
+struct audio_thread* audio_thread_set_current(struct audio_thread* thread) {
+  return NULL;
+}
+struct audio_thread* audio_thread_get_current() {
   return NULL;
 }
 void cras_iodev_list_reconnect_streams_with_apm() {}
@@ -10,6 +10,7 @@
 extern "C" {
 #include "cras/src/server/config/cras_board_config.h"
 #include "cras/src/server/cras_alert.h"
+#include "cras/src/server/cras_alsa_probe.h"
 #include "cras/src/server/cras_main_thread_log.h"
 #include "cras/src/server/cras_system_state.h"
 #include "cras/src/server/rust/include/cras_feature_tier.h"
@@ -54,6 +55,14 @@ std::unordered_map<const cras_alsa_card*, enum CRAS_ALSA_CARD_TYPE>
     card_type_map;
 std::unordered_map<const cras_alsa_card*, int> card_index_map;
 static cras_feature_tier fake_tier = {};
+static size_t cras_alsa_probe_card_called;
+static unsigned int cras_alsa_probe_card_delay_us;
+static cras_alsa_probe_done cras_alsa_probe_card_done;
+static void* cras_alsa_probe_card_arg;
+static int cras_alsa_probe_pending_index;
+static size_t cras_alsa_probe_cancel_called;
+static size_t cras_alsa_card_complete_called;
+static int cras_alsa_card_complete_return;
 
 static void ResetStubData() {
   cras_alsa_card_create_called = 0;
@@ -85,6 +94,14 @@ static void ResetStubData() {
   cras_feature_tier_init_called = 0;
   memset(&fake_board_config, 0, sizeof(fake_board_config));
   fake_tier = {};
+  cras_alsa_probe_card_called = 0;
+  cras_alsa_probe_card_delay_us = 0;
+  cras_alsa_probe_card_done = NULL;
+  cras_alsa_probe_card_arg = NULL;
+  cras_alsa_probe_pending_index = -1;
+  cras_alsa_probe_cancel_called = 0;
+  cras_alsa_card_complete_called = 0;
+  cras_alsa_card_complete_return = 0;
 }
 
 static int add_stub(int fd,
@@ -344,6 +361,77 @@ TEST(SystemStateSuite, AddCard) {
   cras_system_state_deinit();
 }
 
+TEST(SystemStateSuite, ProbeCard) {
+  ResetStubData();
+  cras_alsa_card_info info;
+
+  info.card_type = ALSA_CARD_TYPE_USB;
+  info.card_index = 0;
+  do_sys_init();
+  EXPECT_EQ(0, cras_system_probe_alsa_card(&info, 1000));
+  EXPECT_EQ(1, cras_alsa_probe_card_called);
+  EXPECT_EQ(1000, cras_alsa_probe_card_delay_us);
+  EXPECT_EQ(0, cras_alsa_card_create_called);
+  // Being probed counts as added.
+  cras_alsa_probe_pending_index = 0;
+  EXPECT_EQ(1, cras_system_alsa_card_exists(0));
+  EXPECT_EQ(-EEXIST, cras_system_probe_alsa_card(&info, 0));
+  EXPECT_EQ(-EEXIST, cras_system_add_alsa_card(&info));
+  EXPECT_EQ(1, cras_alsa_probe_card_called);
+
+  // The probed card is completed and added on the main thread.
+  cras_alsa_probe_pending_index = -1;
+  card_type_map[kFakeAlsaCards[0]] = info.card_type;
+  card_index_map[kFakeAlsaCards[0]] = 0;
+  cras_alsa_probe_card_done(kFakeAlsaCards[0], &info,
+                            cras_alsa_probe_card_arg);
+  EXPECT_EQ(1, cras_alsa_card_complete_called);
+  EXPECT_EQ(0, cras_alsa_card_destroy_called);
+  EXPECT_EQ(1, cras_system_alsa_card_exists(0));
+
+  EXPECT_EQ(0, cras_system_remove_alsa_card(0));
+  EXPECT_EQ(1, cras_alsa_card_destroy_called);
+  EXPECT_EQ(0, cras_alsa_probe_cancel_called);
+  cras_system_state_deinit();
+}
+
+TEST(SystemStateSuite, ProbeCardFailComplete) {
+  ResetStubData();
+  cras_alsa_card_info info;
+
+  info.card_type = ALSA_CARD_TYPE_USB;
+  info.card_index = 0;
+  do_sys_init();
+  EXPECT_EQ(0, cras_system_probe_alsa_card(&info, 0));
+  cras_alsa_card_complete_return = -EINVAL;
+  cras_alsa_probe_card_done(kFakeAlsaCards[0], &info,
+                            cras_alsa_probe_card_arg);
+  EXPECT_EQ(1, cras_alsa_card_destroy_called);
+  EXPECT_EQ(0, cras_system_alsa_card_exists(0));
+
+  // A failed probe adds nothing.
+  cras_alsa_probe_card_done(NULL, &info, cras_alsa_probe_card_arg);
+  EXPECT_EQ(0, cras_system_alsa_card_exists(0));
+  cras_system_state_deinit();
+}
+
+TEST(SystemStateSuite, RemoveCardBeingProbed) {
+  ResetStubData();
+  cras_alsa_card_info info;
+
+  info.card_type = ALSA_CARD_TYPE_USB;
+  info.card_index = 3;
+  do_sys_init();
+  EXPECT_EQ(0, cras_system_probe_alsa_card(&info, 0));
+  cras_alsa_probe_pending_index = 3;
+  EXPECT_EQ(0, cras_system_remove_alsa_card(3));
+  EXPECT_EQ(1, cras_alsa_probe_cancel_called);
+  EXPECT_EQ(0, cras_system_alsa_card_exists(3));
+  // Nothing to remove or cancel.
+  EXPECT_EQ(-EINVAL, cras_system_remove_alsa_card(3));
+  cras_system_state_deinit();
+}
+
 TEST(SystemSettingsRegisterSelectDescriptor, AddSelectFd) {
   void* stub_data = reinterpret_cast<void*>(44);
   void* select_data = reinterpret_cast<void*>(33);
@@ -631,6 +719,39 @@ void cras_alsa_card_destroy(struct cras_alsa_card* alsa_card) {
   cras_alsa_card_destroy_called++;
 }
 
+int cras_alsa_card_complete(struct cras_alsa_card* alsa_card,
+                            struct cras_alsa_card_info* info,
+                            struct cras_device_blocklist* blocklist) {
+  cras_alsa_card_complete_called++;
+  return cras_alsa_card_complete_return;
+}
+
+int cras_alsa_probe_card(const struct cras_alsa_card_info* info,
+                         const char* device_config_dir,
+                         const char* ucm_suffix,
+                         unsigned int delay_us,
+                         cras_alsa_probe_done done,
+                         void* arg) {
+  cras_alsa_probe_card_called++;
+  cras_alsa_probe_card_delay_us = delay_us;
+  cras_alsa_probe_card_done = done;
+  cras_alsa_probe_card_arg = arg;
+  return 0;
+}
+
+int cras_alsa_probe_cancel(unsigned int card_index) {
+  if ((int)card_index != cras_alsa_probe_pending_index) {
+    return -ENOENT;
+  }
+  cras_alsa_probe_cancel_called++;
+  cras_alsa_probe_pending_index = -1;
+  return 0;
+}
+
+int cras_alsa_probe_pending(unsigned int card_index) {
+  return (int)card_index == cras_alsa_probe_pending_index;
+}
+
 size_t cras_alsa_card_get_index(const struct cras_alsa_card* alsa_card) {
   return card_index_map[alsa_card];
 }
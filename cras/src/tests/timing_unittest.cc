@@ -18,7 +18,7 @@ extern "C" {
 #include "cras_types.h"
 #include "third_party/utlist/utlist.h"
 
-struct audio_thread_event_log* atlog;
+__thread struct audio_thread_event_log* atlog;
 }
 
 #include "cras/src/tests/dev_io_stubs.h"
@@ -26,7 +26,6 @@ struct audio_thread_event_log* atlog;
 #include "cras/src/tests/metrics_stub.h"
 #include "cras/src/tests/rstream_stub.h"
 
-#define FAKE_POLL_FD 33
 
 namespace {
 
@@ -731,10 +730,9 @@ TEST_F(TimingSuite, HotwordStreamUseDevTiming) {
 
 // One hotword stream attaches to hotword device. Input data burst to a number
 // larger than cb_threshold. Also, stream is pending client reply.
-// In this case stream fd is used to poll for next wake.
+// In this case the audio thread waits on the stream fd for the next wake.
 // And the dev wake time is unchanged from the default 20 seconds limit.
 TEST_F(TimingSuite, HotwordStreamBulkDataIsPending) {
-  int poll_fd = 0;
   cras_audio_format fmt;
   fill_audio_format(&fmt, 48000);
 
@@ -755,9 +753,8 @@ TEST_F(TimingSuite, HotwordStreamBulkDataIsPending) {
   timespec dev_time = SingleInputDevNextWake(4096, 7000, &start, &fmt, streams,
                                              CRAS_NODE_TYPE_HOTWORD);
 
-  // Need to wait for stream fd in the next ppoll.
-  poll_fd = dev_stream_poll_stream_fd(streams[0]->dstream.get());
-  EXPECT_EQ(FAKE_POLL_FD, poll_fd);
+  // Need to wait for the client reply in the next wait.
+  EXPECT_TRUE(dev_stream_is_pending_reply(streams[0]->dstream.get()));
 
   struct timespec delta;
   subtract_timespecs(&dev_time, &start, &delta);
@@ -770,10 +767,9 @@ TEST_F(TimingSuite, HotwordStreamBulkDataIsPending) {
 // One hotword stream attaches to hotword device. Input data burst to a number
 // larger than cb_threshold. However, stream is not pending client reply.
 // This happens if there was no data during capture_to_stream.
-// In this case stream fd is NOT used to poll for next wake.
+// In this case the audio thread does NOT wait on the stream fd.
 // And the dev wake time is changed to a 0 instead of default 20 seconds.
 TEST_F(TimingSuite, HotwordStreamBulkDataIsNotPending) {
-  int poll_fd = 0;
   cras_audio_format fmt;
   fill_audio_format(&fmt, 48000);
 
@@ -793,9 +789,8 @@ TEST_F(TimingSuite, HotwordStreamBulkDataIsNotPending) {
   // There is more than 1 cb_threshold of data in device.
   timespec dev_time = SingleInputDevNextWake(4096, 7000, &start, &fmt, streams);
 
-  // Does not need to wait for stream fd in the next ppoll.
-  poll_fd = dev_stream_poll_stream_fd(streams[0]->dstream.get());
-  EXPECT_EQ(-EINVAL, poll_fd);
+  // Does not need to wait for the client reply in the next wait.
+  EXPECT_FALSE(dev_stream_is_pending_reply(streams[0]->dstream.get()));
 
   struct timespec delta;
   subtract_timespecs(&dev_time, &start, &delta);
@@ -1229,6 +1224,8 @@ int cras_audio_thread_event_severe_underrun() {
   return 0;
 }
 
+void audio_thread_unwatch_stream(struct cras_rstream* stream) {}
+
 void* buffer_share_get_data(const struct buffer_share* mix, unsigned int id) {
   return NULL;
 };
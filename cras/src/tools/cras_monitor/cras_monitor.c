@@ -184,6 +184,7 @@ static void print_usage(const char* command) {
           "%s [options]\n"
           "  Where [options] are:\n"
           "    --sync|-s  - Use the synchronous connection functions.\n"
+          "    --interval|-i <ms>  - Coalesce changes within <ms>.\n"
           "    --log-level|-l <n>  - Set the syslog level (7 == "
           "LOG_DEBUG).\n",
           command);
@@ -195,8 +196,10 @@ int main(int argc, char** argv) {
   int option_character;
   bool synchronous = false;
   int log_level = LOG_WARNING;
+  unsigned int interval_ms = 0;
   static struct option long_options[] = {
       {"sync", no_argument, NULL, 's'},
+      {"interval", required_argument, NULL, 'i'},
       {"log-level", required_argument, NULL, 'l'},
       {NULL, 0, NULL, 0},
   };
@@ -205,7 +208,7 @@ int main(int argc, char** argv) {
     int option_index = 0;
 
     option_character =
-        getopt_long(argc, argv, "sl:", long_options, &option_index);
+        getopt_long(argc, argv, "si:l:", long_options, &option_index);
     if (option_character == -1) {
       break;
     }
@@ -213,6 +216,9 @@ int main(int argc, char** argv) {
       case 's':
         synchronous = !synchronous;
         break;
+      case 'i':
+        interval_ms = strtoul(optarg, NULL, 0);
+        break;
       case 'l':
         log_level = atoi(optarg);
         if (log_level < 0) {
@@ -267,6 +273,9 @@ int main(int argc, char** argv) {
   cras_client_set_num_active_streams_changed_callback(
       client, num_active_streams_changed);
   cras_client_set_state_change_callback_context(client, client);
+  if (interval_ms) {
+    cras_client_set_notification_interval(client, interval_ms);
+  }
 
   rc = cras_client_run_thread(client);
   if (rc != 0) {
@@ -925,6 +925,10 @@ static void show_alog_tag(const struct audio_thread_event_log* log,
     case AUDIO_THREAD_WRITE_STREAMS_MIXED:
       printf("%-30s write_limit:%u\n", "WRITE_STREAMS_MIXED", data1);
       break;
+    case AUDIO_THREAD_WRITE_STREAMS_PASSTHROUGH:
+      printf("%-30s id:%x offset:%u written:%d\n",
+             "WRITE_STREAMS_PASSTHROUGH", data1, data2, (int)data3);
+      break;
     case AUDIO_THREAD_WRITE_STREAMS_STREAM:
       printf("%-30s id:%x shm_frames:%u cb_pending:%u\n",
              "WRITE_STREAMS_STREAM", data1, data2, data3);
@@ -954,7 +958,8 @@ static void show_alog_tag(const struct audio_thread_event_log* log,
       printf("%-30s written:%u queued:%u\n", "A2DP_WRITE", data1, data2);
       break;
     case AUDIO_THREAD_DEV_STREAM_MIX:
-      printf("%-30s written:%u read:%u\n", "DEV_STREAM_MIX", data1, data2);
+      printf("%-30s written:%u read:%u skipped:%u\n", "DEV_STREAM_MIX", data1,
+             data2, data3);
       break;
     case AUDIO_THREAD_CAPTURE_POST:
       printf("%-30s stream:%x thresh:%u rd_buf:%u\n", "CAPTURE_POST", data1,
@@ -1091,7 +1096,8 @@ static void print_aligned_audio_debug_info(const struct audio_debug_info* info,
         "highest_hw_level: %u\n"
         "runtime: %u.%09u\n"
         "longest_wake: %u.%09u\n"
-        "software_gain_scaler: %lf\n",
+        "software_gain_scaler: %lf\n"
+        "silent_frames_skipped: %" PRIu64 "\n",
         (unsigned int)info->devs[i].dev_idx,
         (unsigned int)info->devs[i].buffer_size,
         (unsigned int)info->devs[i].min_buffer_level,
@@ -1107,10 +1113,15 @@ static void print_aligned_audio_debug_info(const struct audio_debug_info* info,
         (unsigned int)info->devs[i].runtime_nsec,
         (unsigned int)info->devs[i].longest_wake_sec,
         (unsigned int)info->devs[i].longest_wake_nsec,
-        info->devs[i].software_gain_scaler);
+        info->devs[i].software_gain_scaler,
+        (uint64_t)info->devs[i].silent_frames_skipped);
     printf("\n");
   }
 
+  printf("-------------conv_pool------------\n");
+  printf("hits: %u\nmisses: %u\n\n", (unsigned int)info->conv_pool_hits,
+         (unsigned int)info->conv_pool_misses);
+
   printf("-------------stream_dump------------\n");
   if (info->num_streams > MAX_DEBUG_STREAMS) {
     return;
@@ -2246,7 +2257,7 @@ static void show_usage() {
       "Dumps debug info from main thread\n");
   printf(
       "--dump_dsp - "
-      "Print status of dsp to syslog.\n");
+      "Print status of dsp, including module profiles, to syslog.\n");
   printf(
       "--dump_server_info - "
       "Print status of the server.\n");